@@ -0,0 +1,77 @@
+// Heap call counting, for checking that a loop stays off malloc.
+//
+//   uint64_t before = alloc_count();
+//   ... one tick ...
+//   metrics_add(&m, MC_ALLOCS, alloc_count() - before);
+//
+// With COUNT_ALLOCS defined this replaces malloc, calloc, realloc,
+// aligned_alloc and free with wrappers around glibc's own, and
+// alloc_count() is how many of the allocating calls the calling thread has
+// made (frees are not counted). The count is per thread, so a worker
+// measures its own task and nothing the other threads do meanwhile, and
+// it is a plain thread-local add: cheap enough to leave on under load.
+// posix_memalign, memalign and the like are not wrapped and go uncounted;
+// nothing here uses them.
+//
+// Compiled out unless COUNT_ALLOCS is defined: alloc_count() is then
+// always 0, and ALLOC_COUNTING tells a report not to show it. Include it
+// from one translation unit only, since it defines the allocator, and not
+// in sanitizer builds, which bring their own.
+#ifndef ALLOC_COUNT_H
+#define ALLOC_COUNT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef COUNT_ALLOCS
+
+#define ALLOC_COUNTING 1
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t n, size_t size);
+extern void* __libc_realloc(void* p, size_t size);
+extern void* __libc_memalign(size_t align, size_t size);
+extern void __libc_free(void* p);
+
+static __thread uint64_t alloc_calls_;
+
+void* malloc(size_t size) {
+    alloc_calls_++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size) {
+    alloc_calls_++;
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* p, size_t size) {
+    alloc_calls_++;
+    return __libc_realloc(p, size);
+}
+
+void* aligned_alloc(size_t align, size_t size) {
+    alloc_calls_++;
+    return __libc_memalign(align, size);
+}
+
+void free(void* p) {
+    __libc_free(p);
+}
+
+// Allocating calls made by this thread so far.
+static inline uint64_t alloc_count(void) {
+    return alloc_calls_;
+}
+
+#else
+
+#define ALLOC_COUNTING 0
+
+static inline uint64_t alloc_count(void) {
+    return 0;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,31 @@
+// Area of interest: which entities a client currently knows about.
+//
+// Each tick the server gathers the keys (entity slots) in range of a
+// client, e.g. with spatial_hash_query(), and sorts them with aoi_sort().
+// The sorted set is the key column of that tick's snapshot (snapshot.h),
+// and the state codec (game_msg.h) merges it against the client's
+// baseline in one pass: keys only in the new set entered the view, keys
+// only in the baseline left it, the rest stayed and go out only if they
+// moved.
+#ifndef AOI_H
+#define AOI_H
+
+#include <stdlib.h>
+
+static inline int aoi_cmp_int_(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+// Sort a gathered key set in place.
+static inline void aoi_sort(int* keys, int n) {
+    // sets are small and often nearly sorted: insertion sort up to a point
+    if (n > 32) { qsort(keys, (size_t)n, sizeof *keys, aoi_cmp_int_); return; }
+    for (int i = 1; i < n; i++) {
+        int k = keys[i], j = i;
+        while (j > 0 && keys[j - 1] > k) { keys[j] = keys[j - 1]; j--; }
+        keys[j] = k;
+    }
+}
+
+#endif
@@ -0,0 +1,162 @@
+// Many small matches stepped together, a vector of players at a time.
+//
+// For hosting thousands of tiny rooms (the original 16x16 board, four
+// players each) the general simulation (game_sim.h) costs more in
+// per-room bookkeeping than in rules. Here every room has the same board
+// size and player count, and the players of all rooms sit in flat
+// struct-of-arrays columns, room r owning [r * per_room, (r + 1) * per_room).
+// One batch_step() call advances every room by one tick.
+//
+// The rule is the one in game_sim.h on open floor, with one input per
+// player per tick instead of a queue. dirs[i] is player i's input this
+// tick: 0 for none, else 1 + INPUT_UP..INPUT_RIGHT (input_queue.h). A
+// player off cooldown moves one cell that way if the cell is on the board
+// (move_rules.h) and then cools down for cooldown_ticks. An input during
+// cooldown, or one off the board, is dropped and costs nothing. Feeding
+// the same inputs to a sim_t only when it is off cooldown gives the same
+// positions.
+//
+// batch_step_scalar() applies the rule one player at a time through
+// move_apply() and is the reference. batch_step() gives the same result
+// BATCH_LANES players at a time with GCC vector extensions: the
+// direction, board and cooldown checks become lane masks and the updates
+// are selects, with no branches. The vectors are generic and one register
+// wide for the target: 4 lanes of SSE2 or NEON by default, 8 with AVX2
+// (-march=native). Wider than the registers, the compiler splits every
+// operation and gains nothing.
+//
+// Ticks are int32: 2^31 ticks is 2 years at 30 Hz.
+#ifndef BATCH_SIM_H
+#define BATCH_SIM_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "game_sim.h"
+#include "input_queue.h"
+#include "move_rules.h"
+
+// Players per vector step: one register of int32 on the target. AVX-512
+// stays at 8, as GCC does by default: 16 lanes measured no faster, the
+// step being bound by memory by then.
+#if defined(__AVX2__)
+#define BATCH_LANES 8
+#else
+#define BATCH_LANES 4
+#endif
+#define BATCH_ALIGN 64
+
+typedef int32_t batch_vec_ __attribute__((vector_size(4 * BATCH_LANES)));
+typedef uint8_t batch_dirs_ __attribute__((vector_size(BATCH_LANES)));
+
+typedef struct {
+    int rooms;
+    int per_room;
+    int grid;
+    int cooldown_ticks;
+    int n;                             // rooms * per_room
+
+    // by player, [0, n)
+    int32_t* x;
+    int32_t* y;
+    int32_t* ready;                    // first tick the player may move again
+} batch_sim_t;
+
+// Player k of a fresh room starts where sim_spawn() puts player k, free
+// to move.
+static inline void batch_reset_room(batch_sim_t* b, int r) {
+    for (int k = 0; k < b->per_room; k++) {
+        int i = r * b->per_room + k, x, y;
+        sim_spawn_point(b->grid, k, &x, &y);
+        b->x[i] = x;
+        b->y[i] = y;
+        b->ready[i] = 0;
+    }
+}
+
+static inline void* batch_alloc_(int n) {
+    size_t bytes = ((size_t)n * sizeof(int32_t) + BATCH_ALIGN - 1) & ~(size_t)(BATCH_ALIGN - 1);
+    return aligned_alloc(BATCH_ALIGN, bytes ? bytes : BATCH_ALIGN);
+}
+
+// Returns -1 if out of memory.
+static inline int batch_init(batch_sim_t* b, int rooms, int per_room, int grid, int cooldown_ticks) {
+    memset(b, 0, sizeof *b);
+    b->rooms = rooms;
+    b->per_room = per_room;
+    b->grid = grid;
+    b->cooldown_ticks = cooldown_ticks;
+    b->n = rooms * per_room;
+    b->x = batch_alloc_(b->n);
+    b->y = batch_alloc_(b->n);
+    b->ready = batch_alloc_(b->n);
+    if (!b->x || !b->y || !b->ready) return -1;
+    for (int r = 0; r < rooms; r++) batch_reset_room(b, r);
+    return 0;
+}
+
+static inline void batch_free(batch_sim_t* b) {
+    free(b->x);
+    free(b->y);
+    free(b->ready);
+    memset(b, 0, sizeof *b);
+}
+
+static inline int batch_step_one_(batch_sim_t* b, int i, int32_t tick, int dir) {
+    if (dir < 1 || dir > INPUT_DIRS || tick < b->ready[i]) return 0;
+    int pos[2] = { b->x[i], b->y[i] };
+    if (!move_apply(pos, pos[0] + input_dirs_[dir - 1][0], pos[1] + input_dirs_[dir - 1][1], b->grid)) return 0;
+    b->x[i] = pos[0];
+    b->y[i] = pos[1];
+    b->ready[i] = tick + b->cooldown_ticks;
+    return 1;
+}
+
+// Reference: run tick for every room, one player at a time. Returns how
+// many players moved.
+static inline int batch_step_scalar(batch_sim_t* b, int32_t tick, const uint8_t* dirs) {
+    int moved = 0;
+    for (int i = 0; i < b->n; i++) moved += batch_step_one_(b, i, tick, dirs[i]);
+    return moved;
+}
+
+// Run tick for every room, BATCH_LANES players at a time; same result as
+// batch_step_scalar(). Returns how many players moved.
+static inline int batch_step(batch_sim_t* b, int32_t tick, const uint8_t* dirs) {
+    const int32_t last = b->grid - 1, until = tick + b->cooldown_ticks;
+    batch_vec_ moved = { 0 };
+    int i = 0;
+    for (; i + BATCH_LANES <= b->n; i += BATCH_LANES) {
+        batch_dirs_ d8;
+        batch_vec_ x, y, ready;
+        memcpy(&d8, dirs + i, sizeof d8);
+        memcpy(&x, b->x + i, sizeof x);
+        memcpy(&y, b->y + i, sizeof y);
+        memcpy(&ready, b->ready + i, sizeof ready);
+
+        // comparisons give -1 per true lane: 1 + INPUT_LEFT steps x by -1,
+        // 1 + INPUT_RIGHT by +1, and likewise for y; other codes stay put
+        batch_vec_ d = __builtin_convertvector(d8, batch_vec_);
+        batch_vec_ dx = (d == 1 + INPUT_LEFT) - (d == 1 + INPUT_RIGHT);
+        batch_vec_ dy = (d == 1 + INPUT_DOWN) - (d == 1 + INPUT_UP);
+        batch_vec_ nx = x + dx, ny = y + dy;
+        batch_vec_ go = ((dx | dy) != 0) & (ready <= tick) &
+                        (nx >= 0) & (nx <= last) & (ny >= 0) & (ny <= last);
+
+        x = (nx & go) | (x & ~go);
+        y = (ny & go) | (y & ~go);
+        ready = (until & go) | (ready & ~go);
+        moved -= go;
+        memcpy(b->x + i, &x, sizeof x);
+        memcpy(b->y + i, &y, sizeof y);
+        memcpy(b->ready + i, &ready, sizeof ready);
+    }
+
+    int total = 0;
+    for (int k = 0; k < BATCH_LANES; k++) total += moved[k];
+    for (; i < b->n; i++) total += batch_step_one_(b, i, tick, dirs[i]);
+    return total;
+}
+
+#endif
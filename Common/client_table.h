@@ -0,0 +1,292 @@
+// Connection registry: O(1) lookup by fd and by client id.
+//
+// Clients live densely in `clients[0..count)` so broadcasts iterate only
+// live connections. A sparse slot array gives each client a stable slot;
+// freed slots go on a free list and bump their generation. The public id
+// packs (generation, slot) so an id held by the console after a disconnect
+// can never reach whichever connection later reuses the slot or the fd.
+//
+// Pointers returned by the lookups stay valid until the next add/remove.
+// Each client owns its frame reassembly buffer and send queue; add/remove
+// manage them. A removed client's record stays past the end of the dense
+// array with both, and the next add reuses it, so connections coming and
+// going allocate nothing once the table has seen its peak (see
+// client_table_trim()). Sends are queued and go out on client_table_flush().
+//
+// If `msgs` is set, frames queued by client_send() come from its pools
+// instead of the heap. If `arena` is set, it holds this tick's frames
+// (msg_buf_arena()): client_table_flush() copies the ones a socket did not
+// take into `msgs`, then resets it.
+//
+// If `metrics` is set, the table records connects, frames, bytes and
+// read/write syscall timings into it; servers should use client_read(),
+// client_next_frame() and client_flush() rather than the raw frame/sendq
+// calls so nothing is missed.
+#ifndef CLIENT_TABLE_H
+#define CLIENT_TABLE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "frame.h"
+#include "metrics.h"
+#include "pool.h"
+#include "sendq.h"
+#include "tick.h"
+
+#define CT_SLOT_BITS 20                         // up to ~1M concurrent slots
+#define CT_SLOT_MASK ((1u << CT_SLOT_BITS) - 1)
+
+typedef struct {
+    int id;      // (generation << CT_SLOT_BITS) | (slot + 1); never 0
+    int fd;      // socket descriptor, -1 for clients on the UDP transport
+    int udp;     // udp_transport.h connection slot, -1 for TCP clients
+    int slot;    // index into client_table_t.slots
+    uint32_t tx_id;   // next outgoing frame id
+    frame_rx_t rx;    // inbound reassembly buffer
+    sendq_t tx;       // outbound queue
+    int flush_pending;// already listed in client_table_t.dirty
+    uint64_t bytes_in;
+    uint64_t frames_in;
+} client_t;
+
+typedef struct {
+    uint32_t gen;    // bumped on every free so stale ids stop matching
+    int dense;       // index into clients[], or -1 when free
+    int next_free;   // free-list link
+} client_slot_t;
+
+typedef struct {
+    client_t* clients;       // dense, [0, count); retired records up to cap
+    int count;
+    int cap;
+
+    client_slot_t* slots;    // sparse, [0, nslots)
+    int nslots;
+    int slot_cap;
+    int free_head;
+    int max_slots;           // cap on nslots; 0 means CT_SLOT_MASK
+
+    int* fd_slot;            // fd -> slot, -1 if unused; grown on demand
+    int fd_cap;
+
+    int* dirty;              // ids with queued output since the last flush
+    int ndirty;
+    int dirty_cap;
+
+    metrics_t* metrics;      // optional, owned by the table's thread
+    msg_pool_t* msgs;        // optional, ditto
+    arena_t* arena;          // optional, ditto
+} client_table_t;
+
+static inline int client_table_grow_(void** p, int* cap, int need, size_t elem) {
+    if (need <= *cap) return 0;
+    int ncap = *cap ? *cap : 16;
+    while (ncap < need) ncap *= 2;
+    void* np = realloc(*p, (size_t)ncap * elem);
+    if (!np) return -1;
+    *p = np;
+    *cap = ncap;
+    return 0;
+}
+
+static inline void client_table_init(client_table_t* t) {
+    memset(t, 0, sizeof *t);
+    t->free_head = -1;
+}
+
+static inline void client_table_free(client_table_t* t) {
+    for (int i = 0; i < t->cap; i++) {
+        frame_rx_free(&t->clients[i].rx);
+        sendq_clear(&t->clients[i].tx);
+    }
+    free(t->clients);
+    free(t->dirty);
+    free(t->slots);
+    free(t->fd_slot);
+    client_table_init(t);
+}
+
+static inline client_t* client_table_by_fd(client_table_t* t, int fd) {
+    if (fd < 0 || fd >= t->fd_cap) return NULL;
+    int s = t->fd_slot[fd];
+    return s < 0 ? NULL : &t->clients[t->slots[s].dense];
+}
+
+static inline client_t* client_table_by_id(client_table_t* t, int id) {
+    uint32_t uid = (uint32_t)id;
+    int s = (int)(uid & CT_SLOT_MASK) - 1;
+    if (s < 0 || s >= t->nslots) return NULL;
+    client_slot_t* sl = &t->slots[s];
+    if (sl->dense < 0 || sl->gen != (uid >> CT_SLOT_BITS)) return NULL;
+    return &t->clients[sl->dense];
+}
+
+// Register a freshly accepted fd (or -1 for a connection without one).
+// Returns NULL on allocation failure or once max_slots are in use.
+static inline client_t* client_table_add(client_table_t* t, int fd) {
+    if (fd >= t->fd_cap) {
+        int old = t->fd_cap;
+        if (client_table_grow_((void**)&t->fd_slot, &t->fd_cap, fd + 1, sizeof(int)) < 0) return NULL;
+        for (int i = old; i < t->fd_cap; i++) t->fd_slot[i] = -1;
+    }
+    int old = t->cap;
+    if (client_table_grow_((void**)&t->clients, &t->cap, t->count + 1, sizeof(client_t)) < 0) return NULL;
+    memset(t->clients + old, 0, (size_t)(t->cap - old) * sizeof(client_t));
+
+    // a retired record brings its buffers; a failure below leaves them there
+    client_t* c = &t->clients[t->count];
+    frame_rx_t rx = c->rx;
+    sendq_t tx = c->tx;
+    if (fd >= 0 && !rx.buf && frame_rx_init(&rx, FRAME_RX_CAP) < 0) return NULL;
+    rx.head = rx.tail = 0;
+    c->rx = rx;
+
+    int s = t->free_head;
+    if (s >= 0) {
+        t->free_head = t->slots[s].next_free;
+    } else {
+        uint32_t max = t->max_slots > 0 ? (uint32_t)t->max_slots : CT_SLOT_MASK;
+        if ((uint32_t)t->nslots >= max ||
+            client_table_grow_((void**)&t->slots, &t->slot_cap, t->nslots + 1, sizeof(client_slot_t)) < 0)
+            return NULL;
+        s = t->nslots++;
+        t->slots[s].gen = 0;
+    }
+
+    client_slot_t* sl = &t->slots[s];
+    sl->dense = t->count;
+    sl->next_free = -1;
+    if (fd >= 0) t->fd_slot[fd] = s;
+
+    t->count++;
+    memset(c, 0, sizeof *c);
+    c->id = (int)((sl->gen << CT_SLOT_BITS) | (uint32_t)(s + 1));
+    c->fd = fd;
+    c->udp = -1;
+    c->slot = s;
+    c->rx = rx;
+    c->tx = tx;
+    if (t->metrics) {
+        metrics_add(t->metrics, MC_ACCEPTS, 1);
+        metrics_set(t->metrics, MC_CLIENTS, (uint64_t)t->count);
+    }
+    return c;
+}
+
+// Drop a client: swap-remove from the dense array and recycle the slot.
+// Drops what was queued for it but does not close the fd; its record and
+// buffers wait past the end of the array for the next add.
+static inline void client_table_remove(client_table_t* t, client_t* c) {
+    int s = c->slot;
+    int d = t->slots[s].dense;
+    if (c->fd >= 0 && c->fd < t->fd_cap) t->fd_slot[c->fd] = -1;
+    sendq_reset(&c->tx);
+
+    int last = --t->count;
+    if (d != last) {
+        client_t retired = t->clients[d];
+        t->clients[d] = t->clients[last];
+        t->clients[last] = retired;
+        t->slots[t->clients[d].slot].dense = d;
+    }
+
+    client_slot_t* sl = &t->slots[s];
+    sl->dense = -1;
+    sl->gen = (sl->gen + 1) & ((1u << (31 - CT_SLOT_BITS)) - 1);
+    sl->next_free = t->free_head;
+    t->free_head = s;
+    if (t->metrics) {
+        metrics_add(t->metrics, MC_DISCONNECTS, 1);
+        metrics_set(t->metrics, MC_CLIENTS, (uint64_t)t->count);
+    }
+}
+
+// Free the buffers of removed clients' records, e.g. after a peak.
+static inline void client_table_trim(client_table_t* t) {
+    for (int i = t->count; i < t->cap; i++) {
+        frame_rx_free(&t->clients[i].rx);
+        sendq_clear(&t->clients[i].tx);
+    }
+}
+
+// Queue a reference to a shared buffer for c. Returns a SENDQ_* code; on
+// SENDQ_KICK the caller should drop the client.
+static inline int client_send_buf(client_table_t* t, client_t* c, msg_buf_t* b, int droppable) {
+    int r = sendq_push(&c->tx, b, droppable);
+    if (t->metrics) metrics_add(t->metrics, r == SENDQ_OK ? MC_FRAMES_OUT : r == SENDQ_DROPPED ? MC_DROPPED : MC_KICKED, 1);
+    if (r == SENDQ_OK && !c->flush_pending) {
+        if (client_table_grow_((void**)&t->dirty, &t->dirty_cap, t->ndirty + 1, sizeof(int)) < 0)
+            return SENDQ_KICK;
+        t->dirty[t->ndirty++] = c->id;
+        c->flush_pending = 1;
+    }
+    return r;
+}
+
+// Queue a frame addressed to c alone.
+static inline int client_send(client_table_t* t, client_t* c, uint8_t type,
+                              const void* payload, uint16_t len) {
+    msg_buf_t* b = msg_buf_frame(t->msgs, type, c->tx_id++, payload, len);
+    if (!b) return SENDQ_KICK;
+    int r = client_send_buf(t, c, b, 0);
+    msg_buf_unref(b);
+    return r;
+}
+
+// One read() into c's reassembly buffer; same results as frame_rx_fill().
+static inline ssize_t client_read(client_table_t* t, client_t* c) {
+    if (!t->metrics) return frame_rx_fill(&c->rx, c->fd);
+    int64_t t0 = mono_ns();
+    ssize_t n = frame_rx_fill(&c->rx, c->fd);
+    metrics_observe(t->metrics, MH_READ_NS, (uint64_t)(mono_ns() - t0));
+    metrics_add(t->metrics, MC_READ_CALLS, 1);
+    if (n > 0) {
+        c->bytes_in += (uint64_t)n;
+        metrics_add(t->metrics, MC_BYTES_IN, (uint64_t)n);
+    }
+    return n;
+}
+
+// Pop the next complete inbound frame; same results as frame_rx_next().
+static inline int client_next_frame(client_table_t* t, client_t* c, frame_t* f) {
+    int r = frame_rx_next(&c->rx, f);
+    if (r > 0) {
+        c->frames_in++;
+        if (t->metrics) metrics_add(t->metrics, MC_FRAMES_IN, 1);
+    }
+    return r;
+}
+
+// Write out c's queue now; same results as sendq_flush().
+static inline int client_flush(client_table_t* t, client_t* c) {
+    if (!t->metrics) return sendq_flush(&c->tx, c->fd);
+    uint64_t sent = c->tx.sent, writes = c->tx.writes;
+    int64_t t0 = mono_ns();
+    int r = sendq_flush(&c->tx, c->fd);
+    metrics_observe(t->metrics, MH_WRITE_NS, (uint64_t)(mono_ns() - t0));
+    metrics_add(t->metrics, MC_WRITE_CALLS, c->tx.writes - writes);
+    metrics_add(t->metrics, MC_BYTES_OUT, c->tx.sent - sent);
+    metrics_observe(t->metrics, MH_BACKLOG, c->tx.bytes);
+    return r;
+}
+
+// Write out everything queued since the last flush. Sockets that fill up
+// keep their data queued and finish on the next writable event. `drop` is
+// called (with `ctx`) for clients whose socket failed. Every client with
+// an arena frame queued is flushed here, so what they kept is copied out
+// before the arena is reset.
+static inline void client_table_flush(client_table_t* t, void (*drop)(client_t*, void*), void* ctx) {
+    int n = t->ndirty;
+    t->ndirty = 0;
+    for (int i = 0; i < n; i++) {
+        client_t* c = client_table_by_id(t, t->dirty[i]);
+        if (!c) continue;
+        c->flush_pending = 0;
+        if (client_flush(t, c) < 0 || (t->arena && sendq_spill(&c->tx, t->msgs) < 0)) drop(c, ctx);
+    }
+    if (t->arena) arena_reset(t->arena);
+}
+
+#endif
@@ -0,0 +1,193 @@
+// Entity store: game objects as struct-of-arrays columns.
+//
+// Live entities occupy [0, count) of every column, so the simulation, the
+// state encoder and the renderer each walk only the fields they need over
+// contiguous, 64-byte aligned memory, and never visit empty slots. Handles
+// work like client ids in client_table.h: a sparse slot array maps a
+// stable slot to the entity's current dense index, destroy swap-removes the
+// last entity into the hole and bumps the slot's generation, and the handle
+// packs (generation, slot) so a stale handle never resolves to whoever
+// reuses the slot. Create and destroy are O(1); columns grow by doubling.
+//
+// Slots are reused last-freed-first, so a store that never holds more than
+// N entities never hands out a slot >= N; the demos use the slot as the
+// player number on the wire.
+//
+// Column meanings are up to the caller beyond the obvious: `cooldown` is
+// the time of the last move in whatever clock the game runs on (ticks on
+// the server, ns in the single-player demo), `owner` the controlling
+// client id (-1 none).
+#ifndef ENTITY_STORE_H
+#define ENTITY_STORE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ENTITY_ALIGN 64                              // cache line
+#define ENTITY_SLOT_BITS 20
+#define ENTITY_SLOT_MASK ((1u << ENTITY_SLOT_BITS) - 1)
+
+typedef uint32_t entity_t;      // (generation << ENTITY_SLOT_BITS) | (slot + 1)
+#define ENTITY_NONE 0u
+
+enum {
+    ENTITY_MOVED = 1u << 0,     // position changed this tick
+    ENTITY_LOCAL = 1u << 1,     // driven by this process's keyboard
+    ENTITY_SETTLE = 1u << 2,    // moved last tick, not this one
+};
+
+typedef struct {
+    uint32_t gen;
+    int dense;                  // index into the columns, -1 when free
+    int next_free;
+} entity_slot_t;
+
+typedef struct {
+    // dense columns, [0, count)
+    int32_t* x;
+    int32_t* y;
+    float (*color)[3];
+    int64_t* cooldown;
+    int32_t* owner;
+    uint32_t* flags;
+    entity_t* handle;           // dense index -> handle
+    int count;
+    int cap;
+
+    entity_slot_t* slots;       // sparse, [0, nslots)
+    int nslots;
+    int slot_cap;
+    int free_head;
+} entity_store_t;
+
+static inline int entity_slot(entity_t h) {
+    return (int)(h & ENTITY_SLOT_MASK) - 1;
+}
+
+// Replace *col with an aligned copy of room for ncap elements.
+static inline int entity_grow_col_(void** col, int count, int ncap, size_t elem) {
+    size_t bytes = ((size_t)ncap * elem + ENTITY_ALIGN - 1) & ~(size_t)(ENTITY_ALIGN - 1);
+    void* p = aligned_alloc(ENTITY_ALIGN, bytes);
+    if (!p) return -1;
+    if (*col) memcpy(p, *col, (size_t)count * elem);
+    free(*col);
+    *col = p;
+    return 0;
+}
+
+static inline int entity_store_reserve(entity_store_t* s, int need) {
+    if (need <= s->cap) return 0;
+    int ncap = s->cap ? s->cap : 16;
+    while (ncap < need) ncap *= 2;
+    if (entity_grow_col_((void**)&s->x, s->count, ncap, sizeof *s->x) < 0 ||
+        entity_grow_col_((void**)&s->y, s->count, ncap, sizeof *s->y) < 0 ||
+        entity_grow_col_((void**)&s->color, s->count, ncap, sizeof *s->color) < 0 ||
+        entity_grow_col_((void**)&s->cooldown, s->count, ncap, sizeof *s->cooldown) < 0 ||
+        entity_grow_col_((void**)&s->owner, s->count, ncap, sizeof *s->owner) < 0 ||
+        entity_grow_col_((void**)&s->flags, s->count, ncap, sizeof *s->flags) < 0 ||
+        entity_grow_col_((void**)&s->handle, s->count, ncap, sizeof *s->handle) < 0)
+        return -1;   // columns already grown keep their data; cap stays valid
+    s->cap = ncap;
+    return 0;
+}
+
+// cap is a hint; the store grows past it. Returns -1 if out of memory.
+static inline int entity_store_init(entity_store_t* s, int cap) {
+    memset(s, 0, sizeof *s);
+    s->free_head = -1;
+    return entity_store_reserve(s, cap > 0 ? cap : 16);
+}
+
+static inline void entity_store_free(entity_store_t* s) {
+    free(s->x);
+    free(s->y);
+    free(s->color);
+    free(s->cooldown);
+    free(s->owner);
+    free(s->flags);
+    free(s->handle);
+    free(s->slots);
+    memset(s, 0, sizeof *s);
+    s->free_head = -1;
+}
+
+// Dense index of a live entity, or -1 for a stale or invalid handle.
+static inline int entity_index(const entity_store_t* s, entity_t h) {
+    int slot = entity_slot(h);
+    if (slot < 0 || slot >= s->nslots) return -1;
+    const entity_slot_t* sl = &s->slots[slot];
+    if (sl->dense < 0 || sl->gen != (h >> ENTITY_SLOT_BITS)) return -1;
+    return sl->dense;
+}
+
+// New entity at the end of the columns: position 0,0, black, no owner.
+// Returns ENTITY_NONE if out of memory.
+static inline entity_t entity_create(entity_store_t* s) {
+    if (entity_store_reserve(s, s->count + 1) < 0) return ENTITY_NONE;
+
+    int slot = s->free_head;
+    if (slot >= 0) {
+        s->free_head = s->slots[slot].next_free;
+    } else {
+        if ((uint32_t)s->nslots >= ENTITY_SLOT_MASK) return ENTITY_NONE;
+        if (s->nslots == s->slot_cap) {
+            int ncap = s->slot_cap ? 2 * s->slot_cap : 16;
+            entity_slot_t* p = realloc(s->slots, (size_t)ncap * sizeof *p);
+            if (!p) return ENTITY_NONE;
+            s->slots = p;
+            s->slot_cap = ncap;
+        }
+        slot = s->nslots++;
+        s->slots[slot].gen = 0;
+    }
+
+    entity_slot_t* sl = &s->slots[slot];
+    int i = s->count++;
+    sl->dense = i;
+    sl->next_free = -1;
+
+    entity_t h = (sl->gen << ENTITY_SLOT_BITS) | (uint32_t)(slot + 1);
+    s->x[i] = s->y[i] = 0;
+    s->color[i][0] = s->color[i][1] = s->color[i][2] = 0.0f;
+    s->cooldown[i] = 0;
+    s->owner[i] = -1;
+    s->flags[i] = 0;
+    s->handle[i] = h;
+    return h;
+}
+
+// Swap-remove: the last entity moves into the hole. Returns -1 for a stale
+// handle. Dense indices of other entities may change; handles do not.
+static inline int entity_destroy(entity_store_t* s, entity_t h) {
+    int i = entity_index(s, h);
+    if (i < 0) return -1;
+
+    int last = --s->count;
+    if (i != last) {
+        s->x[i] = s->x[last];
+        s->y[i] = s->y[last];
+        memcpy(s->color[i], s->color[last], sizeof s->color[i]);
+        s->cooldown[i] = s->cooldown[last];
+        s->owner[i] = s->owner[last];
+        s->flags[i] = s->flags[last];
+        s->handle[i] = s->handle[last];
+        s->slots[entity_slot(s->handle[i])].dense = i;
+    }
+
+    entity_slot_t* sl = &s->slots[entity_slot(h)];
+    sl->dense = -1;
+    sl->gen = (sl->gen + 1) & ((1u << (32 - ENTITY_SLOT_BITS)) - 1);
+    sl->next_free = s->free_head;
+    s->free_head = entity_slot(h);
+    return 0;
+}
+
+// Dense index of the entity owned by client `owner`, or -1.
+static inline int entity_find_owner(const entity_store_t* s, int32_t owner) {
+    for (int i = 0; i < s->count; i++)
+        if (s->owner[i] == owner) return i;
+    return -1;
+}
+
+#endif
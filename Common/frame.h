@@ -0,0 +1,162 @@
+// Length-prefixed message framing.
+//
+// Every message on the wire is an 8 byte header followed by `len` payload
+// bytes:
+//
+//   u8 type | u8 flags | u16 len | u32 msg id      (network byte order)
+//
+// A frame_rx_t is the per-connection reassembly buffer: read() appends raw
+// bytes, frame_rx_next() pops complete frames as views that point straight
+// into the buffer (no copy). Views stay valid until the next fill.
+// Consumed space is reclaimed by moving the trailing partial frame (if any)
+// back to the front, so at most one partial frame is ever copied.
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#define FRAME_HDR_SIZE    8
+#define FRAME_MAX_PAYLOAD 4096
+#define FRAME_RX_CAP      (4 * (FRAME_HDR_SIZE + FRAME_MAX_PAYLOAD))
+
+enum {
+    FRAME_TEXT    = 1,  // console / chat line, payload is text without '\n'
+    FRAME_EXIT    = 2,  // peer is closing, empty payload
+    FRAME_MOVE    = 3,  // client -> server: bit-packed move packet (bitpack.h), id = input seq
+    FRAME_STATE   = 4,  // server -> client: the client's area of interest as a delta, id = tick (game_msg.h)
+    FRAME_WELCOME = 5,  // server -> client: player number, tick rate, board size (game_msg.h)
+    FRAME_PING    = 6,  // opaque payload (loadgen: send timestamp)...
+    FRAME_PONG    = 7,  // ...echoed back unchanged by the server
+    FRAME_ACK     = 8,  // client -> server: newest FRAME_STATE received, id = its tick, empty payload
+    FRAME_JOIN    = 9,  // client -> server, first: play in room id (RoomServer), empty payload; others ignore it
+};
+
+typedef struct {
+    uint8_t  type;
+    uint8_t  flags;
+    uint16_t len;
+    uint32_t id;
+} frame_hdr_t;
+
+typedef struct {
+    frame_hdr_t hdr;
+    const uint8_t* payload;  // view into the rx buffer, hdr.len bytes
+} frame_t;
+
+typedef struct {
+    uint8_t* buf;
+    uint32_t cap;
+    uint32_t head;   // first unconsumed byte
+    uint32_t tail;   // one past the last received byte
+} frame_rx_t;
+
+static inline void frame_hdr_pack(uint8_t* out, const frame_hdr_t* h) {
+    uint16_t len = htons(h->len);
+    uint32_t id  = htonl(h->id);
+    out[0] = h->type;
+    out[1] = h->flags;
+    memcpy(out + 2, &len, 2);
+    memcpy(out + 4, &id, 4);
+}
+
+static inline void frame_hdr_unpack(frame_hdr_t* h, const uint8_t* in) {
+    uint16_t len;
+    uint32_t id;
+    memcpy(&len, in + 2, 2);
+    memcpy(&id, in + 4, 4);
+    h->type  = in[0];
+    h->flags = in[1];
+    h->len   = ntohs(len);
+    h->id    = ntohl(id);
+}
+
+// Encode one frame into `out`. Returns bytes written, or 0 if it won't fit.
+static inline size_t frame_encode(uint8_t* out, size_t cap, uint8_t type, uint32_t id,
+                                  const void* payload, uint16_t len) {
+    if (len > FRAME_MAX_PAYLOAD || cap < FRAME_HDR_SIZE + (size_t)len) return 0;
+    frame_hdr_t h = { type, 0, len, id };
+    frame_hdr_pack(out, &h);
+    if (len) memcpy(out + FRAME_HDR_SIZE, payload, len);
+    return FRAME_HDR_SIZE + (size_t)len;
+}
+
+// Write one whole frame with a single writev. Intended for blocking fds
+// (the interactive client); servers queue frames instead. Returns 0 or -1.
+static inline int frame_send(int fd, uint8_t type, uint32_t id, const void* payload, uint16_t len) {
+    if (len > FRAME_MAX_PAYLOAD) { errno = EMSGSIZE; return -1; }
+    uint8_t hdr[FRAME_HDR_SIZE];
+    frame_hdr_t h = { type, 0, len, id };
+    frame_hdr_pack(hdr, &h);
+
+    struct iovec iov[2] = { { hdr, FRAME_HDR_SIZE }, { (void*)payload, len } };
+    int iovcnt = len ? 2 : 1;
+    size_t left = FRAME_HDR_SIZE + (size_t)len;
+    while (left > 0) {
+        ssize_t n = writev(fd, iov, iovcnt);
+        if (n < 0) { if (errno == EINTR) continue; return -1; }
+        left -= (size_t)n;
+        // advance the iovecs past what was written
+        for (int i = 0; i < iovcnt && n > 0; i++) {
+            size_t take = (size_t)n < iov[i].iov_len ? (size_t)n : iov[i].iov_len;
+            iov[i].iov_base = (uint8_t*)iov[i].iov_base + take;
+            iov[i].iov_len -= take;
+            n -= (ssize_t)take;
+        }
+    }
+    return 0;
+}
+
+static inline int frame_rx_init(frame_rx_t* rx, uint32_t cap) {
+    rx->buf = malloc(cap);
+    rx->cap = rx->buf ? cap : 0;
+    rx->head = rx->tail = 0;
+    return rx->buf ? 0 : -1;
+}
+
+static inline void frame_rx_free(frame_rx_t* rx) {
+    free(rx->buf);
+    rx->buf = NULL;
+    rx->cap = rx->head = rx->tail = 0;
+}
+
+// One read() into the free space. Returns bytes read, 0 on EOF, -1 on error
+// (errno == EAGAIN when a non-blocking socket is drained).
+static inline ssize_t frame_rx_fill(frame_rx_t* rx, int fd) {
+    if (rx->head == rx->tail) {
+        rx->head = rx->tail = 0;
+    } else if (rx->cap - rx->tail < FRAME_HDR_SIZE + FRAME_MAX_PAYLOAD && rx->head > 0) {
+        memmove(rx->buf, rx->buf + rx->head, rx->tail - rx->head);
+        rx->tail -= rx->head;
+        rx->head = 0;
+    }
+    if (rx->tail == rx->cap) { errno = ENOBUFS; return -1; }
+
+    ssize_t n;
+    do {
+        n = read(fd, rx->buf + rx->tail, rx->cap - rx->tail);
+    } while (n < 0 && errno == EINTR);
+    if (n > 0) rx->tail += (uint32_t)n;
+    return n;
+}
+
+// Pop the next complete frame. Returns 1 and fills `out`, 0 if more bytes
+// are needed, -1 if the stream is malformed (oversized frame).
+static inline int frame_rx_next(frame_rx_t* rx, frame_t* out) {
+    uint32_t avail = rx->tail - rx->head;
+    if (avail < FRAME_HDR_SIZE) return 0;
+    frame_hdr_unpack(&out->hdr, rx->buf + rx->head);
+    if (out->hdr.len > FRAME_MAX_PAYLOAD) return -1;
+    if (avail < FRAME_HDR_SIZE + (uint32_t)out->hdr.len) return 0;
+    out->payload = rx->buf + rx->head + FRAME_HDR_SIZE;
+    rx->head += FRAME_HDR_SIZE + out->hdr.len;
+    return 1;
+}
+
+#endif
@@ -0,0 +1,72 @@
+// Frame pacing for the windowed demos: draw only when something changed.
+//
+// The render loop marks the pacer dirty whenever input, the network or the
+// window (resize, expose) changes what is on screen, and asks it two
+// things each iteration: whether to draw now, and how long it may block
+// before it has to look again. While idle the answer is "forever" and the
+// loop sleeps in glfwWaitEvents()/epoll_wait; while active frames fall on
+// a grid one period apart. A loop that wakes a little late draws late but
+// keeps the grid, so the lateness doesn't add up into a lower frame rate;
+// after a stall or an idle spell the grid restarts at the next frame
+// rather than catching up in a burst. A wake-up time can be requested for
+// work that is due without any event, e.g. a held key whose move cooldown
+// runs out.
+//
+// Pure logic on mono_ns() timestamps, so it runs and tests headless.
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <stdint.h>
+
+typedef struct {
+    int64_t period_ns;  // minimum spacing of frames while active
+    int64_t last_ns;    // grid time of the last frame drawn
+    int64_t wake_ns;    // look again at this time, 0 = no request
+    int dirty;          // something on screen changed since last_ns
+    uint64_t frames;    // frames drawn
+} frame_pacer_t;
+
+// Starts dirty so the first frame is drawn immediately.
+static inline void frame_pacer_init(frame_pacer_t* p, int hz) {
+    p->period_ns = 1000000000LL / (hz > 0 ? hz : 60);
+    p->last_ns = INT64_MIN / 2;
+    p->wake_ns = 0;
+    p->dirty = 1;
+    p->frames = 0;
+}
+
+static inline void frame_pacer_mark(frame_pacer_t* p) {
+    p->dirty = 1;
+}
+
+// Ask to be woken at t even if nothing else happens; keeps the earliest.
+static inline void frame_pacer_wake_at(frame_pacer_t* p, int64_t t) {
+    if (p->wake_ns == 0 || t < p->wake_ns) p->wake_ns = t;
+}
+
+// Returns 1 if a frame should be drawn now (and counts it as drawn).
+static inline int frame_pacer_ready(frame_pacer_t* p, int64_t now) {
+    if (!p->dirty || now - p->last_ns < p->period_ns) return 0;
+    p->dirty = 0;
+    p->last_ns = now - p->last_ns < 2 * p->period_ns ? p->last_ns + p->period_ns : now;
+    p->frames++;
+    return 1;
+}
+
+// How long the loop may block, in ns: -1 means until the next event, 0
+// means don't block. An expired wake-up request is consumed here.
+static inline int64_t frame_pacer_timeout(frame_pacer_t* p, int64_t now) {
+    int64_t wait = -1;
+    if (p->dirty) {
+        wait = p->last_ns + p->period_ns - now;
+        if (wait < 0) wait = 0;
+    }
+    if (p->wake_ns) {
+        int64_t w = p->wake_ns - now;
+        if (w <= 0) { p->wake_ns = 0; w = 0; }
+        if (wait < 0 || w < wait) wait = w;
+    }
+    return wait;
+}
+
+#endif
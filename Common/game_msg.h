@@ -0,0 +1,223 @@
+// Payloads of the 2D game's server -> client messages.
+//
+// FRAME_WELCOME, once per connection:
+//
+//   u16 player (0xFFFF = spectator) | u8 cooldown ticks | u8 reserved |
+//   u16 tick Hz | u16 grid size | u16 max players | u16 view radius
+//
+// (network byte order). Grid size and max players fix the move_layout_for()
+// field widths both sides use from then on; a view radius of 0 means the
+// whole board.
+//
+// FRAME_STATE, per client, when something in its view changed. The frame
+// id is the server tick, which names the snapshot it describes
+// (snapshot.h):
+//
+//   u8 flags | u32 baseline tick | u16 baseline entries | u16 new entries |
+//   u32 input ack | changes | new entries      (the last two bit-packed)
+//
+// The state is coded against a baseline, an earlier snapshot the client
+// acknowledged with FRAME_ACK. Changes hold, for each baseline entry in key
+// order, one bit saying whether it changed, and for a changed one a 2-bit
+// code (0 left the view, 1 new x, 2 new y, 3 new x and y) followed by the
+// new coordinates. New entries are (player, x, y) of the entities not in
+// the baseline, ascending. With STATE_FULL there is no baseline (both
+// baseline fields are 0) and everything in view is a new entry. The ack is
+// the last input of the receiving client the server has processed (client
+// prediction, predict.h).
+#ifndef GAME_MSG_H
+#define GAME_MSG_H
+
+#include <stdint.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "bitpack.h"
+#include "snapshot.h"
+
+#define WELCOME_SIZE 12
+#define WELCOME_SPECTATOR 0xFFFF
+
+#define STATE_HDR_SIZE 13
+#define STATE_FULL 1
+
+typedef struct {
+    int player;          // -1 for spectators
+    int cooldown_ticks;
+    int tick_hz;
+    int grid;
+    int max_players;
+    int view_radius;     // 0 = whole board
+} welcome_t;
+
+typedef struct {
+    uint8_t flags;
+    uint32_t baseline;
+    int base_n;          // entries in the baseline
+    int added;           // new entries
+    uint32_t ack;
+    int updates;         // encoder: entities sent as new or moved
+    int leaves;          // encoder: entities sent as leaving
+} state_hdr_t;
+
+static inline void game_put16_(uint8_t* p, int v) {
+    uint16_t n = htons((uint16_t)v);
+    memcpy(p, &n, 2);
+}
+
+static inline int game_get16_(const uint8_t* p) {
+    uint16_t n;
+    memcpy(&n, p, 2);
+    return ntohs(n);
+}
+
+static inline void game_put32_(uint8_t* p, uint32_t v) {
+    uint32_t n = htonl(v);
+    memcpy(p, &n, 4);
+}
+
+static inline uint32_t game_get32_(const uint8_t* p) {
+    uint32_t n;
+    memcpy(&n, p, 4);
+    return ntohl(n);
+}
+
+static inline void welcome_encode(uint8_t out[WELCOME_SIZE], const welcome_t* w) {
+    game_put16_(out, w->player < 0 ? WELCOME_SPECTATOR : w->player);
+    out[2] = (uint8_t)w->cooldown_ticks;
+    out[3] = 0;
+    game_put16_(out + 4, w->tick_hz);
+    game_put16_(out + 6, w->grid);
+    game_put16_(out + 8, w->max_players);
+    game_put16_(out + 10, w->view_radius);
+}
+
+// Returns -1 if the payload is too short.
+static inline int welcome_decode(const uint8_t* p, uint16_t len, welcome_t* w) {
+    if (len < WELCOME_SIZE) return -1;
+    int player = game_get16_(p);
+    w->player = player == WELCOME_SPECTATOR ? -1 : player;
+    w->cooldown_ticks = p[2];
+    w->tick_hz = game_get16_(p + 4);
+    w->grid = game_get16_(p + 6);
+    w->max_players = game_get16_(p + 8);
+    w->view_radius = game_get16_(p + 10);
+    return 0;
+}
+
+// Most entities a full state of `bytes` can hold.
+static inline int state_max_entries(move_layout_t l, size_t bytes) {
+    return (int)((bytes - STATE_HDR_SIZE) * 8 / (size_t)move_packet_bits(l));
+}
+
+// Code snapshot cur against base, or as a full state if base is NULL.
+// Fills h (counts included). Returns bytes written, 0 if cap is too small.
+static inline size_t state_encode(uint8_t* buf, size_t cap, move_layout_t l, state_hdr_t* h, uint32_t ack,
+                                  const snapshot_t* base, const snapshot_t* cur) {
+    if (cap < STATE_HDR_SIZE) return 0;
+    h->flags = base ? 0 : STATE_FULL;
+    h->baseline = base ? base->tick : 0;
+    h->base_n = base ? base->n : 0;
+    h->ack = ack;
+    h->updates = h->leaves = 0;
+
+    bit_writer_t w;
+    bw_init(&w, buf + STATE_HDR_SIZE, cap - STATE_HDR_SIZE);
+    int kept = 0;
+    for (int i = 0, j = 0; i < h->base_n; i++) {
+        while (j < cur->n && cur->e[j].key < base->e[i].key) j++;
+        if (j == cur->n || cur->e[j].key != base->e[i].key) {
+            bw_put(&w, 1, 1);
+            bw_put(&w, 0, 2);
+            h->leaves++;
+            continue;
+        }
+        kept++;
+        uint32_t code = (uint32_t)(cur->e[j].x != base->e[i].x) | (uint32_t)(cur->e[j].y != base->e[i].y) << 1;
+        bw_put(&w, code != 0, 1);
+        if (!code) continue;
+        bw_put(&w, code, 2);
+        if (code & 1) bw_put(&w, (uint32_t)cur->e[j].x, l.coord_bits);
+        if (code & 2) bw_put(&w, (uint32_t)cur->e[j].y, l.coord_bits);
+        h->updates++;
+    }
+    h->added = cur->n - kept;
+    for (int i = 0, j = 0; j < cur->n; j++) {
+        while (i < h->base_n && base->e[i].key < cur->e[j].key) i++;
+        if (i < h->base_n && base->e[i].key == cur->e[j].key) continue;
+        move_put(&w, l, cur->e[j].key, cur->e[j].x, cur->e[j].y);
+    }
+    h->updates += h->added;
+    size_t n = bw_finish(&w);
+    if (w.overflow || h->added > 0xFFFF || h->base_n > 0xFFFF) return 0;
+
+    buf[0] = h->flags;
+    game_put32_(buf + 1, h->baseline);
+    game_put16_(buf + 5, h->base_n);
+    game_put16_(buf + 7, h->added);
+    game_put32_(buf + 9, h->ack);
+    return STATE_HDR_SIZE + n;
+}
+
+// Rebuild the snapshot a state describes into out (which must not be in
+// use as a baseline: pass snapshot_ring_next()), taking its baseline from
+// the snapshots received so far; out->tick is left to the caller. Returns
+// -1 if the payload is malformed, names a baseline no longer (or never)
+// held or out of memory; h is filled as far as it was read.
+static inline int state_decode(const uint8_t* buf, size_t len, move_layout_t l, state_hdr_t* h,
+                               snapshot_ring_t* got, snapshot_t* out) {
+    if (len < STATE_HDR_SIZE) return -1;
+    h->flags = buf[0];
+    h->baseline = game_get32_(buf + 1);
+    h->base_n = game_get16_(buf + 5);
+    h->added = game_get16_(buf + 7);
+    h->ack = game_get32_(buf + 9);
+    h->updates = h->leaves = 0;
+
+    const snapshot_t* base = NULL;
+    if (!(h->flags & STATE_FULL)) {
+        base = snapshot_ring_find(got, h->baseline);
+        if (!base || base == out || base->n != h->base_n) return -1;
+    } else if (h->base_n != 0) {
+        return -1;
+    }
+    // new entries are read in after the kept ones and merged in from the back
+    if (snapshot_reserve(out, h->base_n + 2 * h->added) < 0) return -1;
+
+    bit_reader_t r;
+    br_init(&r, buf + STATE_HDR_SIZE, len - STATE_HDR_SIZE);
+    int kept = 0;
+    for (int i = 0; i < h->base_n; i++) {
+        uint32_t code = br_get(&r, 1) ? br_get(&r, 2) : 4;
+        if (code == 0) continue;
+        out->e[kept].key = base->e[i].key;
+        out->e[kept].x = code & 1 ? (int32_t)br_get(&r, l.coord_bits) : base->e[i].x;
+        out->e[kept].y = code & 2 ? (int32_t)br_get(&r, l.coord_bits) : base->e[i].y;
+        kept++;
+    }
+    int at = kept + h->added;
+    for (int j = 0; j < h->added; j++) {
+        int id, x, y;
+        move_get(&r, l, &id, &x, &y);
+        if (j > 0 && id <= out->e[at + j - 1].key) return -1;
+        out->e[at + j].key = id;
+        out->e[at + j].x = x;
+        out->e[at + j].y = y;
+    }
+    if (r.overrun) return -1;
+
+    for (int i = kept - 1, j = h->added - 1, w = at - 1; j >= 0; w--) {
+        int from;
+        if (i >= 0 && out->e[i].key >= out->e[at + j].key) {
+            if (out->e[i].key == out->e[at + j].key) return -1;   // "new" but in the baseline
+            from = i--;
+        } else {
+            from = at + j--;
+        }
+        out->e[w] = out->e[from];
+    }
+    out->n = at;
+    return 0;
+}
+
+#endif
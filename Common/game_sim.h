@@ -0,0 +1,352 @@
+// The multiplayer demo's authoritative simulation, apart from the network.
+//
+// Players are entities (entity_store.h) whose slot is their player number,
+// tracked in a spatial hash for view queries. Moves a player asks for wait
+// in a short per-player queue; each sim_step() applies at most one of them
+// per player with the rule shared with client prediction (move_rules.h),
+// terrain that blocks, and a cooldown of cooldown_ticks between moves.
+//
+// Everything that changes the state goes through sim_spawn(),
+// sim_destroy(), sim_queue_move() and sim_step(), and nothing here reads a
+// clock or a random number: the same calls on the same board always give
+// the same state, which is what lets a journal (journal.h) play a match
+// back. sim_save() and sim_load() copy that state to and from a flat
+// little-endian buffer for the journal's keyframes.
+#ifndef GAME_SIM_H
+#define GAME_SIM_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "entity_store.h"
+#include "move_rules.h"
+#include "spatial_hash.h"
+#include "world.h"
+
+#define SIM_INPUT_QUEUE 16     // pending moves per player
+#define SIM_SPAWN_SEARCH 4096  // cells tried for an open tile to spawn on
+
+// Flags owned by the simulation; the rest (ENTITY_LOCAL) belong to the
+// process hosting it and are not saved
+#define SIM_FLAGS (ENTITY_MOVED | ENTITY_SETTLE)
+
+static const float sim_colors[4][3] = {{0.98f, 0.73f, 0.01f},{0.19f, 0.89f, 0.75f},{0.91f, 0.30f, 0.24f},{0.56f, 0.44f, 0.86f}};
+
+// Pending input of one player
+typedef struct {
+    int moves[SIM_INPUT_QUEUE][2];
+    uint32_t seqs[SIM_INPUT_QUEUE];
+    int len;
+    uint32_t last_seq;         // last input processed, acked to its client
+} sim_input_t;
+
+typedef struct {
+    int grid;
+    int max_players;
+    int cooldown_ticks;
+    world_t* terrain;          // walls and water block; NULL is open floor
+
+    // owner is the client id (0 for the server), cooldown the tick of the
+    // last move
+    entity_store_t ents;
+    spatial_hash_t nearby;     // entity slot -> bucket
+    sim_input_t* inputs;       // [max_players], by player number
+} sim_t;
+
+// bucket is the spatial hash bucket side in cells. Returns -1 if out of
+// memory.
+static inline int sim_init(sim_t* s, int grid, int max_players, int cooldown_ticks, world_t* terrain, int bucket) {
+    memset(s, 0, sizeof *s);
+    s->grid = grid;
+    s->max_players = max_players;
+    s->cooldown_ticks = cooldown_ticks;
+    s->terrain = terrain;
+    s->inputs = calloc((size_t)max_players, sizeof *s->inputs);
+    if (!s->inputs || entity_store_init(&s->ents, max_players) < 0 ||
+        spatial_hash_init(&s->nearby, grid, bucket) < 0)
+        return -1;
+    return 0;
+}
+
+static inline void sim_free(sim_t* s) {
+    entity_store_free(&s->ents);
+    spatial_hash_free(&s->nearby);
+    free(s->inputs);
+    s->inputs = NULL;
+}
+
+// A cell players cannot enter; damaged parts of the world file count too
+static inline int sim_blocked(const sim_t* s, int x, int y) {
+    if (!s->terrain) return 0;
+    int t = world_tile(s->terrain, x, y);
+    return t < 0 || tile_blocks(t);
+}
+
+// Players 0-3 start near the corners as on the original 16x16 board; the
+// rest are scattered with a multiplicative hash of the player number.
+static inline void sim_spawn_point(int grid, int p, int* x, int* y) {
+    int g = grid;
+    const int corner[4][2] = {{g - 2, g - 2}, {1, 1}, {1, g - 2}, {g - 2, 1}};
+    if (p < 4 && g >= 4) {
+        *x = corner[p][0];
+        *y = corner[p][1];
+        return;
+    }
+    uint32_t h = (uint32_t)p * 2654435761u;
+    *x = (int)((h >> 8) % (uint32_t)g);
+    *y = (int)((h >> 20 ^ h) % (uint32_t)g);
+}
+
+// Spawn point of player p, moved along the row to the next open tile
+static inline void sim_spawn_cell(const sim_t* s, int p, int* x, int* y) {
+    int g = s->grid;
+    sim_spawn_point(g, p, x, y);
+    for (int k = 0; k < SIM_SPAWN_SEARCH && sim_blocked(s, *x, *y); k++) {
+        if (++*x == g) { *x = 0; *y = (*y + 1) % g; }
+    }
+}
+
+// Create a player for client owner (0 = the server's own), or return
+// ENTITY_NONE when all player numbers are taken.
+static inline entity_t sim_spawn(sim_t* s, int32_t owner) {
+    if (s->ents.count >= s->max_players) return ENTITY_NONE;
+    entity_t h = entity_create(&s->ents);
+    if (h == ENTITY_NONE) return h;
+    int i = entity_index(&s->ents, h), p = entity_slot(h);
+    sim_spawn_cell(s, p, &s->ents.x[i], &s->ents.y[i]);
+    if (spatial_hash_insert(&s->nearby, p, s->ents.x[i], s->ents.y[i]) < 0) {
+        entity_destroy(&s->ents, h);
+        return ENTITY_NONE;
+    }
+    memcpy(s->ents.color[i], sim_colors[p % 4], sizeof sim_colors[0]);
+    s->ents.cooldown[i] = -s->cooldown_ticks;
+    s->ents.owner[i] = owner;
+    s->inputs[p].len = 0;
+    s->inputs[p].last_seq = 0;
+    return h;
+}
+
+// Returns -1 for a stale handle.
+static inline int sim_destroy(sim_t* s, entity_t h) {
+    int p = entity_slot(h);
+    if (entity_destroy(&s->ents, h) < 0) return -1;
+    spatial_hash_remove(&s->nearby, p);
+    s->inputs[p].len = 0;
+    return 0;
+}
+
+// Queue a requested destination for player p, applied by a later
+// sim_step(). seq is the client's input sequence number (0 for the
+// server's own player). Returns -1 if the queue is full (the client is
+// spamming) and the move was dropped.
+static inline int sim_queue_move(sim_t* s, int p, int x, int y, uint32_t seq) {
+    sim_input_t* q = &s->inputs[p];
+    if (q->len >= SIM_INPUT_QUEUE) return -1;
+    q->moves[q->len][0] = x;
+    q->moves[q->len][1] = y;
+    q->seqs[q->len] = seq;
+    q->len++;
+    return 0;
+}
+
+// Whether player i (dense index) is still cooling down at tick
+static inline int sim_cooling(const sim_t* s, int i, uint64_t tick) {
+    return (int64_t)tick - s->ents.cooldown[i] < s->cooldown_ticks;
+}
+
+// Run tick: apply at most one queued move per player. Processing a client
+// input, accepted or not, advances its last_seq so the client can
+// reconcile. A move flags the entity MOVED for this tick and SETTLE for
+// the next, so viewers get one more copy where it stopped. Returns how
+// many players moved.
+static inline int sim_step(sim_t* s, uint64_t tick) {
+    entity_store_t* e = &s->ents;
+    int moved = 0;
+    for (int i = 0; i < e->count; i++) {
+        int p = entity_slot(e->handle[i]);
+        e->flags[i] = (e->flags[i] & ~(ENTITY_MOVED | ENTITY_SETTLE)) |
+                      (e->flags[i] & ENTITY_MOVED ? ENTITY_SETTLE : 0);
+        sim_input_t* q = &s->inputs[p];
+        if (q->len == 0 || sim_cooling(s, i, tick)) continue;
+
+        int x = q->moves[0][0], y = q->moves[0][1];
+        uint32_t seq = q->seqs[0];
+        --q->len;
+        memmove(q->moves, q->moves + 1, (size_t)q->len * sizeof q->moves[0]);
+        memmove(q->seqs, q->seqs + 1, (size_t)q->len * sizeof q->seqs[0]);
+
+        if (seq) q->last_seq = seq;
+        int pos[2] = { e->x[i], e->y[i] };
+        if (sim_blocked(s, x, y) || !move_apply(pos, x, y, s->grid)) continue;
+        e->x[i] = pos[0];
+        e->y[i] = pos[1];
+        spatial_hash_move(&s->nearby, p, pos[0], pos[1]);
+        e->cooldown[i] = (int64_t)tick;
+        e->flags[i] |= ENTITY_MOVED;
+        moved++;
+    }
+    return moved;
+}
+
+// Saved state, little-endian:
+//   u32 count | u32 nslots | i32 free_head
+//   nslots x (u32 gen | i32 next_free)
+//   count x (u32 handle | i32 x | i32 y | i64 cooldown | i32 owner | u32 flags)
+//   u32 queues, then per player with input state:
+//     u16 player | u8 len | u32 last_seq | len x (i32 x | i32 y | u32 seq)
+// Slot generations and the free list are kept so handles created after a
+// load match the ones created after the save. Colours follow from slots.
+#define SIM_SAVE_HDR 12
+#define SIM_SAVE_SLOT 8
+#define SIM_SAVE_ENTITY 28
+#define SIM_SAVE_QUEUE 7
+#define SIM_SAVE_MOVE 12
+
+static inline void sim_put32_(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static inline uint32_t sim_get32_(const uint8_t* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// Most bytes sim_save() can need for max_players players
+static inline size_t sim_save_max(int max_players) {
+    return SIM_SAVE_HDR + 4 + (size_t)max_players *
+           (SIM_SAVE_SLOT + SIM_SAVE_ENTITY + SIM_SAVE_QUEUE + SIM_INPUT_QUEUE * SIM_SAVE_MOVE);
+}
+
+// Returns the bytes written, 0 if cap is too small.
+static inline size_t sim_save(const sim_t* s, uint8_t* buf, size_t cap) {
+    const entity_store_t* e = &s->ents;
+    int queues = 0;
+    for (int p = 0; p < s->max_players; p++)
+        if (s->inputs[p].len || s->inputs[p].last_seq) queues++;
+    size_t need = SIM_SAVE_HDR + (size_t)e->nslots * SIM_SAVE_SLOT + (size_t)e->count * SIM_SAVE_ENTITY + 4;
+    for (int p = 0; p < s->max_players; p++)
+        if (s->inputs[p].len || s->inputs[p].last_seq) need += SIM_SAVE_QUEUE + (size_t)s->inputs[p].len * SIM_SAVE_MOVE;
+    if (need > cap) return 0;
+
+    uint8_t* o = buf;
+    sim_put32_(o, (uint32_t)e->count);
+    sim_put32_(o + 4, (uint32_t)e->nslots);
+    sim_put32_(o + 8, (uint32_t)e->free_head);
+    o += SIM_SAVE_HDR;
+    for (int k = 0; k < e->nslots; k++, o += SIM_SAVE_SLOT) {
+        sim_put32_(o, e->slots[k].gen);
+        sim_put32_(o + 4, (uint32_t)e->slots[k].next_free);
+    }
+    for (int i = 0; i < e->count; i++, o += SIM_SAVE_ENTITY) {
+        sim_put32_(o, e->handle[i]);
+        sim_put32_(o + 4, (uint32_t)e->x[i]);
+        sim_put32_(o + 8, (uint32_t)e->y[i]);
+        sim_put32_(o + 12, (uint32_t)e->cooldown[i]);
+        sim_put32_(o + 16, (uint32_t)((uint64_t)e->cooldown[i] >> 32));
+        sim_put32_(o + 20, (uint32_t)e->owner[i]);
+        sim_put32_(o + 24, e->flags[i] & SIM_FLAGS);
+    }
+    sim_put32_(o, (uint32_t)queues);
+    o += 4;
+    for (int p = 0; p < s->max_players; p++) {
+        const sim_input_t* q = &s->inputs[p];
+        if (!q->len && !q->last_seq) continue;
+        o[0] = (uint8_t)p;
+        o[1] = (uint8_t)(p >> 8);
+        o[2] = (uint8_t)q->len;
+        sim_put32_(o + 3, q->last_seq);
+        o += SIM_SAVE_QUEUE;
+        for (int k = 0; k < q->len; k++, o += SIM_SAVE_MOVE) {
+            sim_put32_(o, (uint32_t)q->moves[k][0]);
+            sim_put32_(o + 4, (uint32_t)q->moves[k][1]);
+            sim_put32_(o + 8, q->seqs[k]);
+        }
+    }
+    return (size_t)(o - buf);
+}
+
+// Back to the state after sim_init(): no players, no input.
+static inline void sim_clear(sim_t* s) {
+    entity_store_t* e = &s->ents;
+    for (int i = 0; i < e->count; i++) spatial_hash_remove(&s->nearby, entity_slot(e->handle[i]));
+    e->count = 0;
+    e->nslots = 0;
+    e->free_head = -1;
+    memset(s->inputs, 0, (size_t)s->max_players * sizeof *s->inputs);
+}
+
+// Replace the state of s (initialised for the same board and player
+// count) with a saved one. Returns -1 if the buffer is malformed or memory
+// runs out; s is then cleared.
+static inline int sim_load(sim_t* s, const uint8_t* buf, size_t len) {
+    entity_store_t* e = &s->ents;
+    sim_clear(s);
+    if (len < SIM_SAVE_HDR) return -1;
+    int count = (int)sim_get32_(buf), nslots = (int)sim_get32_(buf + 4), free_head = (int)sim_get32_(buf + 8);
+    if (count < 0 || count > s->max_players || nslots < count || nslots > s->max_players ||
+        free_head < -1 || free_head >= nslots)
+        return -1;
+    size_t at = SIM_SAVE_HDR + (size_t)nslots * SIM_SAVE_SLOT + (size_t)count * SIM_SAVE_ENTITY;
+    if (len < at + 4) return -1;
+    if (entity_store_reserve(e, count) < 0) return -1;
+    if (nslots > e->slot_cap) {
+        entity_slot_t* sl = realloc(e->slots, (size_t)nslots * sizeof *sl);
+        if (!sl) return -1;
+        e->slots = sl;
+        e->slot_cap = nslots;
+    }
+
+    const uint8_t* in = buf + SIM_SAVE_HDR;
+    for (int k = 0; k < nslots; k++, in += SIM_SAVE_SLOT) {
+        e->slots[k].gen = sim_get32_(in);
+        e->slots[k].next_free = (int)sim_get32_(in + 4);
+        e->slots[k].dense = -1;
+        if (e->slots[k].next_free < -1 || e->slots[k].next_free >= nslots) return -1;
+    }
+    e->nslots = nslots;
+    for (int i = 0; i < count; i++, in += SIM_SAVE_ENTITY) {
+        entity_t h = sim_get32_(in);
+        int p = entity_slot(h);
+        if (p < 0 || p >= nslots || e->slots[p].dense >= 0 || e->slots[p].gen != h >> ENTITY_SLOT_BITS) goto bad;
+        e->slots[p].dense = i;
+        e->handle[i] = h;
+        e->x[i] = (int32_t)sim_get32_(in + 4);
+        e->y[i] = (int32_t)sim_get32_(in + 8);
+        e->cooldown[i] = (int64_t)((uint64_t)sim_get32_(in + 12) | (uint64_t)sim_get32_(in + 16) << 32);
+        e->owner[i] = (int32_t)sim_get32_(in + 20);
+        e->flags[i] = sim_get32_(in + 24) & SIM_FLAGS;
+        memcpy(e->color[i], sim_colors[p % 4], sizeof sim_colors[0]);
+        e->count = i + 1;
+        if (spatial_hash_insert(&s->nearby, p, e->x[i], e->y[i]) < 0) goto bad;
+    }
+    // the free list must be exactly the unused slots, without a cycle
+    int nfree = 0;
+    for (int k = free_head; k >= 0; k = e->slots[k].next_free)
+        if (e->slots[k].dense >= 0 || ++nfree > nslots - count) goto bad;
+    if (nfree != nslots - count) goto bad;
+    e->free_head = free_head;
+
+    uint32_t queues = sim_get32_(in);
+    in += 4;
+    const uint8_t* end = buf + len;
+    for (uint32_t k = 0; k < queues; k++) {
+        if (end - in < SIM_SAVE_QUEUE) goto bad;
+        int p = in[0] | in[1] << 8, n = in[2];
+        if (p >= s->max_players || n > SIM_INPUT_QUEUE || end - in < SIM_SAVE_QUEUE + n * SIM_SAVE_MOVE) goto bad;
+        sim_input_t* q = &s->inputs[p];
+        q->last_seq = sim_get32_(in + 3);
+        in += SIM_SAVE_QUEUE;
+        for (q->len = 0; q->len < n; q->len++, in += SIM_SAVE_MOVE) {
+            q->moves[q->len][0] = (int32_t)sim_get32_(in);
+            q->moves[q->len][1] = (int32_t)sim_get32_(in + 4);
+            q->seqs[q->len] = sim_get32_(in + 8);
+        }
+    }
+    return 0;
+
+bad:
+    sim_clear(s);
+    return -1;
+}
+
+#endif
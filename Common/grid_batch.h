@@ -0,0 +1,133 @@
+// CPU side of the batched grid renderer: one instance per quad.
+//
+// Instances [0, ncells) are the board cells in row-major order, followed by
+// one per player, so a single instanced draw paints the board and then the
+// players on top. The builder only rewrites instances whose values changed
+// and tracks the changed range, so the renderer can upload just that slice
+// (usually a couple of player instances) instead of the whole buffer.
+//
+// No GL here: the builder can be exercised and benchmarked without a
+// context. grid_renderer.h turns a batch into draw calls.
+#ifndef GRID_BATCH_H
+#define GRID_BATCH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GRID_CELL_GRAY   0.25f
+#define GRID_PLAYER_SIZE 0.9f   // players are drawn slightly smaller so grid lines show
+#define GRID_QUAD_VERTICES 6    // each instance is drawn as two triangles
+
+typedef struct {
+    float x, y;       // centre in clip space
+    float scale;      // side length in clip space
+    float r, g, b;
+} grid_instance_t;
+
+typedef struct {
+    grid_instance_t* inst;
+    int count;        // instances in use: ncells + nplayers
+    int cap;
+    int grid;         // cells per side
+    int ncells;
+    int nplayers;
+    float cell;       // cell size in clip space, 2 / grid
+    int dirty_lo;     // changed instances are [dirty_lo, dirty_hi)
+    int dirty_hi;
+} grid_batch_t;
+
+static inline void grid_batch_mark_(grid_batch_t* b, int i) {
+    if (i < b->dirty_lo) b->dirty_lo = i;
+    if (i + 1 > b->dirty_hi) b->dirty_hi = i + 1;
+}
+
+// Write instance i, marking it dirty only if a value actually changed.
+static inline void grid_batch_put_(grid_batch_t* b, int i, float x, float y, float scale,
+                                   const float rgb[3]) {
+    grid_instance_t v = { x, y, scale, rgb[0], rgb[1], rgb[2] };
+    if (memcmp(&b->inst[i], &v, sizeof v) == 0) return;
+    b->inst[i] = v;
+    grid_batch_mark_(b, i);
+}
+
+// Lay out a grid x grid board with room for max_players. Returns -1 if out
+// of memory. Everything starts dirty so the first upload is complete.
+static inline int grid_batch_init(grid_batch_t* b, int grid, int max_players) {
+    memset(b, 0, sizeof *b);
+    b->grid = grid;
+    b->ncells = grid * grid;
+    b->cap = b->ncells + max_players;
+    b->cell = 2.0f / (float)grid;
+    b->inst = calloc((size_t)b->cap, sizeof *b->inst);
+    if (!b->inst) return -1;
+
+    static const float gray[3] = { GRID_CELL_GRAY, GRID_CELL_GRAY, GRID_CELL_GRAY };
+    for (int y = 0; y < grid; y++)
+        for (int x = 0; x < grid; x++) {
+            grid_instance_t* c = &b->inst[y * grid + x];
+            c->x = -1.0f + b->cell * ((float)x + 0.5f);
+            c->y = -1.0f + b->cell * ((float)y + 0.5f);
+            c->scale = b->cell;
+            c->r = gray[0]; c->g = gray[1]; c->b = gray[2];
+        }
+    b->count = b->ncells;
+    b->dirty_lo = 0;
+    b->dirty_hi = b->ncells;
+    return 0;
+}
+
+static inline void grid_batch_free(grid_batch_t* b) {
+    free(b->inst);
+    memset(b, 0, sizeof *b);
+}
+
+static inline void grid_batch_set_cell(grid_batch_t* b, int x, int y, const float rgb[3]) {
+    if (x < 0 || x >= b->grid || y < 0 || y >= b->grid) return;
+    grid_instance_t* c = &b->inst[y * b->grid + x];
+    grid_batch_put_(b, y * b->grid + x, c->x, c->y, c->scale, rgb);
+}
+
+static inline void grid_batch_put_player_(grid_batch_t* b, int i, float x, float y,
+                                          const float rgb[3]) {
+    grid_batch_put_(b, b->ncells + i, -1.0f + b->cell * (x + 0.5f), -1.0f + b->cell * (y + 0.5f),
+                    b->cell * GRID_PLAYER_SIZE, rgb);
+}
+
+static inline int grid_batch_clamp_players_(grid_batch_t* b, int n) {
+    if (n > b->cap - b->ncells) n = b->cap - b->ncells;
+    b->nplayers = n;
+    b->count = b->ncells + n;
+    return n;
+}
+
+// Sync the player instances with the game's position and colour columns
+// (entity_store.h); n is clamped to the capacity given at init. Unchanged
+// players cost a compare, nothing more.
+static inline void grid_batch_set_players(grid_batch_t* b, const int32_t* x, const int32_t* y,
+                                          const float (*rgb)[3], int n) {
+    n = grid_batch_clamp_players_(b, n);
+    for (int i = 0; i < n; i++)
+        grid_batch_put_player_(b, i, (float)x[i], (float)y[i], rgb[i]);
+}
+
+// Same with fractional cell coordinates, for players drawn between cells
+// (interpolated remote players).
+static inline void grid_batch_set_players_f(grid_batch_t* b, const float* x, const float* y,
+                                            const float (*rgb)[3], int n) {
+    n = grid_batch_clamp_players_(b, n);
+    for (int i = 0; i < n; i++)
+        grid_batch_put_player_(b, i, x[i], y[i], rgb[i]);
+}
+
+// Hand out the changed range and reset it. Returns 0 if nothing changed.
+static inline int grid_batch_take_dirty(grid_batch_t* b, int* first, int* count) {
+    if (b->dirty_hi <= b->dirty_lo) return 0;
+    *first = b->dirty_lo;
+    *count = b->dirty_hi - b->dirty_lo;
+    b->dirty_lo = b->cap;
+    b->dirty_hi = 0;
+    return 1;
+}
+
+#endif
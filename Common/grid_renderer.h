@@ -0,0 +1,119 @@
+// GL side of the batched grid renderer (see grid_batch.h).
+//
+// One unit quad, one per-instance buffer holding offset/scale/colour, and
+// one glDrawArraysInstanced per frame for the whole board and every player,
+// in place of a uniform update and draw call per cell. Each frame uploads
+// only the instances the batch reports as changed.
+//
+// Include after glad/glad.h.
+#ifndef GRID_RENDERER_H
+#define GRID_RENDERER_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "grid_batch.h"
+
+typedef struct {
+    GLuint prog;
+    GLuint vao;
+    GLuint quad;      // unit quad, two triangles
+    GLuint inst;      // grid_instance_t per instance
+    int cap;          // instances the buffer was sized for
+} grid_renderer_t;
+
+static const char* const grid_vertex_src = "#version 330 core\n"
+"layout (location = 0) in vec2 aPos;\n"
+"layout (location = 1) in vec2 offset;\n"
+"layout (location = 2) in float scale;\n"
+"layout (location = 3) in vec3 color;\n"
+"out vec3 vColor;\n"
+"void main() {\n"
+"    vec2 p = aPos * scale + offset;\n"
+"    gl_Position = vec4(p, 0.0, 1.0);\n"
+"    vColor = color;\n"
+"}\n";
+
+static const char* const grid_fragment_src = "#version 330 core\n"
+"in vec3 vColor;\n"
+"out vec4 FragColor;\n"
+"void main() {\n"
+"    FragColor = vec4(vColor, 1.0);\n"
+"}\n";
+
+static inline void grid_renderer_init(grid_renderer_t* r, const grid_batch_t* b) {
+    // Define rectangle vertices (two triangles)
+    static const float vertices[] = {
+        -0.5f, -0.5f,
+         0.5f, -0.5f,
+         0.5f,  0.5f,
+        -0.5f, -0.5f,
+         0.5f,  0.5f,
+        -0.5f,  0.5f
+    };
+
+    glGenVertexArrays(1, &r->vao);
+    glGenBuffers(1, &r->quad);
+    glGenBuffers(1, &r->inst);
+    glBindVertexArray(r->vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, r->quad);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    // per-instance attributes advance once per quad
+    r->cap = b->cap;
+    glBindBuffer(GL_ARRAY_BUFFER, r->inst);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(r->cap * sizeof(grid_instance_t)), NULL, GL_DYNAMIC_DRAW);
+    GLsizei stride = sizeof(grid_instance_t);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(grid_instance_t, x));
+    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(grid_instance_t, scale));
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(grid_instance_t, r));
+    for (GLuint a = 1; a <= 3; a++) {
+        glEnableVertexAttribArray(a);
+        glVertexAttribDivisor(a, 1);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    // Compile shaders
+    GLuint vs = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vs, 1, &grid_vertex_src, NULL);
+    glCompileShader(vs);
+
+    GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fs, 1, &grid_fragment_src, NULL);
+    glCompileShader(fs);
+
+    r->prog = glCreateProgram();
+    glAttachShader(r->prog, vs);
+    glAttachShader(r->prog, fs);
+    glLinkProgram(r->prog);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+}
+
+// Upload what changed in the batch, then draw everything in one call.
+static inline void grid_renderer_draw(grid_renderer_t* r, grid_batch_t* b) {
+    glBindVertexArray(r->vao);
+    int first, count;
+    if (grid_batch_take_dirty(b, &first, &count)) {
+        glBindBuffer(GL_ARRAY_BUFFER, r->inst);
+        glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)(first * sizeof(grid_instance_t)),
+                        (GLsizeiptr)(count * sizeof(grid_instance_t)), b->inst + first);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    glUseProgram(r->prog);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, GRID_QUAD_VERTICES, b->count);
+}
+
+static inline void grid_renderer_free(grid_renderer_t* r) {
+    glDeleteVertexArrays(1, &r->vao);
+    glDeleteBuffers(1, &r->quad);
+    glDeleteBuffers(1, &r->inst);
+    glDeleteProgram(r->prog);
+}
+
+#endif
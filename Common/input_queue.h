@@ -0,0 +1,201 @@
+// Keyboard input as timestamped events, turned into moves off the frame rate.
+//
+// Key callbacks push (time, pad, direction, press/release) events into an
+// input_ring_t, a single-producer single-consumer ring that needs no lock
+// (the producer only writes head, the consumer only writes tail). Once per
+// frame the game runs an input_proc_t up to "now": it replays the events
+// in time order and emits move commands at the exact times they fall due,
+// so neither a tap that starts and ends between two frames nor a move
+// that came off cooldown mid-frame depends on when the frame happened.
+//
+// Rules, per pad (one player's set of four direction keys):
+//   - pressing a direction moves at once if the pad is off cooldown;
+//     during cooldown the press is remembered and fires when the cooldown
+//     ends, even if the key was let go by then
+//   - while keys are held the most recently pressed one repeats every
+//     cooldown
+//   - the apply callback can refuse a move (off the board, blocked); a
+//     refused move costs no cooldown, and a held key does not retry until
+//     the pad's keys change
+//
+// No clocks or GLFW here: times are whatever the caller stamps events with,
+// so a synthetic event stream gives the same moves every run.
+#ifndef INPUT_QUEUE_H
+#define INPUT_QUEUE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define INPUT_RING 256                 // power of two
+#define INPUT_MAX_PADS 4
+#define INPUT_NEVER INT64_MAX
+
+enum { INPUT_UP, INPUT_DOWN, INPUT_LEFT, INPUT_RIGHT, INPUT_DIRS };
+
+typedef struct {
+    int64_t t;                         // ns, caller's clock
+    uint8_t pad;
+    uint8_t dir;                       // INPUT_UP..INPUT_RIGHT
+    uint8_t press;                     // 1 press, 0 release
+} input_event_t;
+
+typedef struct {
+    input_event_t ev[INPUT_RING];
+    uint32_t head;                     // next write, producer only
+    uint32_t tail;                     // next read, consumer only
+    uint64_t dropped;                  // pushes refused while full
+} input_ring_t;
+
+typedef struct {
+    int64_t t;                         // when the move happens
+    int pad;
+    int dir;
+    int dx, dy;
+} input_cmd_t;
+
+// Return 1 if the move was made, 0 if refused.
+typedef int (*input_apply_fn)(void* ctx, const input_cmd_t* cmd);
+
+typedef struct {
+    uint8_t order[INPUT_DIRS];         // held directions, most recent last
+    int nheld;
+    int pending;                       // press waiting out the cooldown, -1 none
+    int stuck;                         // last move refused: wait for a key change
+    int64_t ready;                     // earliest time of the next move
+} input_pad_t;
+
+typedef struct {
+    input_pad_t pads[INPUT_MAX_PADS];
+    int npads;
+    int64_t cooldown_ns;
+    int64_t now;                       // how far events have been processed
+    uint64_t moves, refused;
+} input_proc_t;
+
+static const int input_dirs_[INPUT_DIRS][2] = { {0, 1}, {0, -1}, {-1, 0}, {1, 0} };
+
+static inline void input_ring_init(input_ring_t* q) {
+    memset(q, 0, sizeof *q);
+}
+
+// Producer side. Returns -1 if the ring is full (the event is dropped).
+static inline int input_ring_push(input_ring_t* q, int64_t t, int pad, int dir, int press) {
+    uint32_t head = q->head;
+    if (head - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) == INPUT_RING) { q->dropped++; return -1; }
+    input_event_t* e = &q->ev[head & (INPUT_RING - 1)];
+    e->t = t;
+    e->pad = (uint8_t)pad;
+    e->dir = (uint8_t)dir;
+    e->press = (uint8_t)(press != 0);
+    __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+// Consumer side: the oldest event, or NULL if empty. input_ring_pop()
+// releases it.
+static inline const input_event_t* input_ring_peek(input_ring_t* q) {
+    uint32_t tail = q->tail;
+    if (tail == __atomic_load_n(&q->head, __ATOMIC_ACQUIRE)) return NULL;
+    return &q->ev[tail & (INPUT_RING - 1)];
+}
+
+static inline void input_ring_pop(input_ring_t* q) {
+    __atomic_store_n(&q->tail, q->tail + 1, __ATOMIC_RELEASE);
+}
+
+static inline void input_proc_init(input_proc_t* p, int npads, int64_t cooldown_ns) {
+    memset(p, 0, sizeof *p);
+    p->npads = npads < INPUT_MAX_PADS ? npads : INPUT_MAX_PADS;
+    p->cooldown_ns = cooldown_ns;
+    p->now = INT64_MIN;
+    for (int i = 0; i < INPUT_MAX_PADS; i++) {
+        p->pads[i].pending = -1;
+        p->pads[i].ready = INT64_MIN;
+    }
+}
+
+// When pad i next moves on its own, INPUT_NEVER if it has nothing to do.
+static inline int64_t input_pad_due_(const input_pad_t* pd) {
+    if (pd->stuck || (pd->pending < 0 && pd->nheld == 0)) return INPUT_NEVER;
+    return pd->ready;
+}
+
+static inline void input_fire_(input_proc_t* p, int i, int64_t t, int dir, input_apply_fn apply, void* ctx) {
+    input_pad_t* pd = &p->pads[i];
+    input_cmd_t cmd = { t, i, dir, input_dirs_[dir][0], input_dirs_[dir][1] };
+    pd->pending = -1;
+    if (apply(ctx, &cmd)) {
+        pd->ready = t + p->cooldown_ns;
+        pd->stuck = 0;
+        p->moves++;
+    } else {
+        pd->stuck = 1;
+        p->refused++;
+    }
+}
+
+static inline void input_event_(input_proc_t* p, const input_event_t* e, input_apply_fn apply, void* ctx) {
+    if (e->pad >= p->npads || e->dir >= INPUT_DIRS) return;
+    input_pad_t* pd = &p->pads[e->pad];
+    int at = -1;
+    for (int k = 0; k < pd->nheld; k++)
+        if (pd->order[k] == e->dir) at = k;
+    if (at >= 0) {            // drop it; a press moves it to the end below
+        memmove(pd->order + at, pd->order + at + 1, (size_t)(pd->nheld - at - 1));
+        pd->nheld--;
+    }
+    pd->stuck = 0;
+    if (!e->press) return;
+    pd->order[pd->nheld++] = e->dir;
+    if (e->t >= pd->ready) input_fire_(p, e->pad, e->t, e->dir, apply, ctx);
+    else pd->pending = e->dir;
+}
+
+// Process queued events and due moves up to time `until`, calling apply
+// for each move in time order. Events stamped later than until stay
+// queued; ones stamped before the last run are treated as happening now.
+static inline void input_proc_run(input_proc_t* p, input_ring_t* q, int64_t until,
+                                  input_apply_fn apply, void* ctx) {
+    for (;;) {
+        const input_event_t* e = input_ring_peek(q);
+        int64_t te = e && e->t <= until ? (e->t > p->now ? e->t : p->now) : INPUT_NEVER;
+        int64_t limit = te != INPUT_NEVER ? te : until;
+
+        // moves due up to the next event, earliest first; a move due the
+        // same instant a key is let go still happens
+        for (;;) {
+            int best = -1;
+            int64_t due = INPUT_NEVER;
+            for (int i = 0; i < p->npads; i++) {
+                int64_t d = input_pad_due_(&p->pads[i]);
+                if (d < due) { due = d; best = i; }
+            }
+            if (best < 0 || due > limit) break;
+            input_pad_t* pd = &p->pads[best];
+            int dir = pd->pending >= 0 ? pd->pending : pd->order[pd->nheld - 1];
+            input_fire_(p, best, due > p->now ? due : p->now, dir, apply, ctx);
+        }
+        if (te == INPUT_NEVER) break;
+
+        input_event_t ev = *e;
+        ev.t = te;
+        input_ring_pop(q);
+        p->now = te;
+        input_event_(p, &ev, apply, ctx);
+    }
+    if (until > p->now) p->now = until;
+}
+
+// Time of the next move that needs no further input (a held key's
+// repeat, a press waiting out the cooldown), INPUT_NEVER if none; sleep
+// until then.
+static inline int64_t input_proc_next_due(const input_proc_t* p) {
+    int64_t due = INPUT_NEVER;
+    for (int i = 0; i < p->npads; i++) {
+        int64_t d = input_pad_due_(&p->pads[i]);
+        if (d < due) due = d;
+    }
+    return due;
+}
+
+#endif
@@ -0,0 +1,181 @@
+// Snapshot interpolation for remote entities.
+//
+// Every FRAME_STATE is stamped with the server tick it was taken on, which
+// puts snapshots on the server's timeline. Each remote entity keeps a
+// fixed-capacity ring of (server time, position) and is drawn at
+// render_time = now - offset - delay, between the two snapshots around it:
+//
+//   offset  local arrival time minus server time, tracked as the lower
+//           envelope of observed transit times (the least delayed packet),
+//           creeping up slowly so clock drift can't strand it;
+//   delay   how far behind the newest data to render: one snapshot period
+//           plus a multiple of the measured jitter, slewed gradually so the
+//           render clock never jumps.
+//
+// When render_time passes the newest snapshot (a late packet) an entity in
+// continuous motion, the same step over its last two snapshots, is
+// extrapolated for at most max_extrap_ns, then held. A lone step is held
+// where it ended: players rest between steps, and extrapolating one would
+// draw them past their cell and then pull them back.
+//
+// No allocation after init and no clocks: callers pass timestamps in.
+#ifndef INTERP_H
+#define INTERP_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define INTERP_RING 32
+
+enum { INTERP_EMPTY = 0, INTERP_HELD, INTERP_LERP, INTERP_EXTRAP };
+
+typedef struct {
+    int64_t t;            // server time, ns
+    float x, y;
+} interp_snap_t;
+
+typedef struct {
+    interp_snap_t ring[INTERP_RING];
+    int head;             // oldest
+    int count;
+} interp_track_t;
+
+typedef struct {
+    int64_t period_ns;    // server tick period: snapshot spacing while moving
+    int64_t offset_ns;    // local - server, see above
+    int have_offset;
+    int64_t jitter_ns;    // EWMA of transit above the envelope
+    int64_t delay_ns;     // current interpolation delay
+    int64_t target_ns;    // delay the jitter estimate asks for
+    int64_t max_delay_ns;
+    int64_t max_extrap_ns;
+    int64_t last_render_ns;
+} interp_clock_t;
+
+static inline void interp_clock_init(interp_clock_t* c, int64_t period_ns) {
+    memset(c, 0, sizeof *c);
+    c->period_ns = period_ns;
+    c->delay_ns = c->target_ns = period_ns;
+    c->max_delay_ns = 250000000LL > 4 * period_ns ? 250000000LL : 4 * period_ns;
+    c->max_extrap_ns = period_ns / 2;
+}
+
+// A snapshot taken at server time server_ns arrived at local time local_ns.
+static inline void interp_clock_observe(interp_clock_t* c, int64_t server_ns, int64_t local_ns) {
+    int64_t transit = local_ns - server_ns;
+    if (!c->have_offset || transit < c->offset_ns) {
+        c->offset_ns = transit;
+        c->have_offset = 1;
+    } else {
+        c->offset_ns += (transit - c->offset_ns) / 256;   // drift
+    }
+    c->jitter_ns += (transit - c->offset_ns - c->jitter_ns) / 16;
+
+    int64_t want = c->period_ns + 2 * c->jitter_ns;
+    if (want > c->max_delay_ns) want = c->max_delay_ns;
+    c->target_ns = want;
+}
+
+// Server time to draw at, local clock now_ns. Moves the delay toward its
+// target by at most 1/32 of the frame-to-frame step so playback speed
+// changes by a few percent, never jumps; a lower offset estimate pauses
+// playback rather than rewinding it.
+static inline int64_t interp_clock_render_time(interp_clock_t* c, int64_t now_ns, int64_t frame_ns) {
+    int64_t step = frame_ns / 32 + 1;
+    if (c->delay_ns < c->target_ns) c->delay_ns += c->target_ns - c->delay_ns < step ? c->target_ns - c->delay_ns : step;
+    else if (c->delay_ns > c->target_ns) c->delay_ns -= c->delay_ns - c->target_ns < step ? c->delay_ns - c->target_ns : step;
+    int64_t t = now_ns - c->offset_ns - c->delay_ns;
+    if (!c->have_offset) return t;
+    if (t < c->last_render_ns) t = c->last_render_ns;
+    c->last_render_ns = t;
+    return t;
+}
+
+static inline void interp_track_init(interp_track_t* tr) {
+    tr->head = tr->count = 0;
+}
+
+static inline interp_snap_t* interp_track_at_(interp_track_t* tr, int i) {
+    return &tr->ring[(tr->head + i) % INTERP_RING];
+}
+
+static inline void interp_track_put_(interp_track_t* tr, int64_t t, float x, float y) {
+    if (tr->count == INTERP_RING) {
+        tr->head = (tr->head + 1) % INTERP_RING;
+        tr->count--;
+    }
+    interp_snap_t* s = interp_track_at_(tr, tr->count++);
+    s->t = t;
+    s->x = x;
+    s->y = y;
+}
+
+// Add a snapshot. Out-of-order or duplicate times are ignored. The server
+// only sends state when something changed, so after a gap the entity was
+// still at its previous position one period before this snapshot; that
+// hold point is inserted so the move animates over one tick, not the gap.
+static inline void interp_track_push(interp_track_t* tr, int64_t t, float x, float y, int64_t period_ns) {
+    if (tr->count > 0) {
+        interp_snap_t last = *interp_track_at_(tr, tr->count - 1);
+        if (t <= last.t) return;
+        if (t - last.t > period_ns && (last.x != x || last.y != y))
+            interp_track_put_(tr, t - period_ns, last.x, last.y);
+    }
+    interp_track_put_(tr, t, x, y);
+}
+
+// Whether the last two snapshot intervals are the same move, so the entity
+// can be expected to keep going.
+static inline int interp_track_moving_(interp_track_t* tr) {
+    if (tr->count < 3) return 0;
+    interp_snap_t* c = interp_track_at_(tr, tr->count - 3);
+    interp_snap_t* a = interp_track_at_(tr, tr->count - 2);
+    interp_snap_t* b = interp_track_at_(tr, tr->count - 1);
+    return (a->x != b->x || a->y != b->y) && b->x - a->x == a->x - c->x && b->y - a->y == a->y - c->y &&
+           b->t - a->t == a->t - c->t;
+}
+
+// Position at server time t. Returns INTERP_EMPTY with no data, otherwise
+// how the value was obtained; INTERP_HELD means the entity is at rest.
+static inline int interp_track_sample(interp_track_t* tr, int64_t t, int64_t max_extrap_ns,
+                                      float* x, float* y) {
+    if (tr->count == 0) return INTERP_EMPTY;
+    interp_snap_t* first = interp_track_at_(tr, 0);
+    if (t <= first->t) { *x = first->x; *y = first->y; return INTERP_HELD; }
+
+    for (int i = 1; i < tr->count; i++) {
+        interp_snap_t* b = interp_track_at_(tr, i);
+        if (t < b->t) {
+            interp_snap_t* a = interp_track_at_(tr, i - 1);
+            float u = (float)(t - a->t) / (float)(b->t - a->t);
+            *x = a->x + (b->x - a->x) * u;
+            *y = a->y + (b->y - a->y) * u;
+            return a->x == b->x && a->y == b->y ? INTERP_HELD : INTERP_LERP;
+        }
+    }
+
+    // past the newest snapshot: keep a steady velocity for a little while
+    interp_snap_t* b = interp_track_at_(tr, tr->count - 1);
+    *x = b->x;
+    *y = b->y;
+    if (!interp_track_moving_(tr)) return INTERP_HELD;
+    interp_snap_t* a = interp_track_at_(tr, tr->count - 2);
+    int64_t dt = t - b->t;
+    if (dt > max_extrap_ns) dt = max_extrap_ns;
+    float u = (float)dt / (float)(b->t - a->t);
+    *x = b->x + (b->x - a->x) * u;
+    *y = b->y + (b->y - a->y) * u;
+    return t - b->t < max_extrap_ns ? INTERP_EXTRAP : INTERP_HELD;
+}
+
+// 1 once the entity is at rest for good at time t: past the newest
+// snapshot, and either not extrapolated or done extrapolating. Until then
+// the caller has to keep drawing frames.
+static inline int interp_track_settled(interp_track_t* tr, int64_t t, int64_t max_extrap_ns) {
+    if (tr->count == 0) return 1;
+    interp_snap_t* b = interp_track_at_(tr, tr->count - 1);
+    if (t < b->t) return 0;
+    return !interp_track_moving_(tr) || t - b->t >= max_extrap_ns;
+}
+
+#endif
@@ -0,0 +1,608 @@
+// Match journal: every input to the simulation (game_sim.h), for playback.
+//
+// The file (little-endian):
+//
+//   header (JOURNAL_HDR_SIZE bytes):
+//     "GJNL" | u32 version | u32 grid | u32 max_players | u32 cooldown_ticks |
+//     u32 tick_hz | u32 keyframe_every | u32 flags
+//   records, a type byte and its fields, numbers as LEB128 varints
+//   (coordinates and owners zigzagged):
+//     SPAWN     owner | handle               a player was created
+//     DESPAWN   handle                       and destroyed
+//     MOVE      player | x | y | seq         a move was queued
+//     TICK      ticks since the last TICK    sim_step() ran (the first counts from 0)
+//     KEYFRAME  u64 tick | u32 len | state   sim_save() after that tick
+//     END
+//   index (once closed): count x (u64 tick | u64 offset of the KEYFRAME) |
+//     u64 count | "GJIX" | u32 0
+//
+// Records between two TICKs happened between those ticks, in order, so
+// playing them into a sim_t in the same order rebuilds the match. A
+// journal cut short (a crash) is valid up to its last whole record; its
+// keyframes are then found by scanning.
+//
+// Writing never blocks the tick loop. Records go into a ring allocated up
+// front and become visible to a writer thread once per tick; the thread
+// writes them out and frees the space. If the ring fills anyway (the disk
+// is slower than the game), the tick that did not fit is dropped and
+// recording stops there, since a journal with a hole cannot be played.
+//
+// Reading maps the file; journal_seek() jumps to the keyframe at or before
+// a tick and plays forward from it.
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "game_sim.h"
+
+#define JOURNAL_MAGIC "GJNL"
+#define JOURNAL_INDEX_MAGIC "GJIX"
+#define JOURNAL_VERSION 1
+#define JOURNAL_HDR_SIZE 32
+#define JOURNAL_TAIL_SIZE 16           // u64 count | magic | u32 0
+#define JOURNAL_MAX_RECORD 32          // any record but a keyframe, bytes
+
+enum {
+    JOURNAL_END = 0,
+    JOURNAL_SPAWN = 1,
+    JOURNAL_DESPAWN = 2,
+    JOURNAL_MOVE = 3,
+    JOURNAL_TICK = 4,
+    JOURNAL_KEYFRAME = 5,
+};
+
+enum {
+    JOURNAL_TERRAIN = 1u << 0,         // recorded on a --world board
+};
+
+typedef struct {
+    uint32_t version;
+    uint32_t grid;
+    uint32_t max_players;
+    uint32_t cooldown_ticks;
+    uint32_t tick_hz;
+    uint32_t keyframe_every;           // ticks
+    uint32_t flags;                    // JOURNAL_TERRAIN
+} journal_hdr_t;
+
+static inline void journal_put32_(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static inline void journal_put64_(uint8_t* p, uint64_t v) {
+    journal_put32_(p, (uint32_t)v);
+    journal_put32_(p + 4, (uint32_t)(v >> 32));
+}
+
+static inline uint32_t journal_get32_(const uint8_t* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline uint64_t journal_get64_(const uint8_t* p) {
+    return (uint64_t)journal_get32_(p) | (uint64_t)journal_get32_(p + 4) << 32;
+}
+
+static inline uint8_t* journal_varint_(uint8_t* p, uint64_t v) {
+    while (v >= 0x80) { *p++ = (uint8_t)(v | 0x80); v >>= 7; }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+static inline uint64_t journal_zigzag_(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+// ---------------------------------------------------------------- writing
+
+typedef struct {
+    int fd;
+    uint8_t* ring;                     // NULL when not recording
+    size_t cap;                        // power of two
+    uint64_t head;                     // bytes published; producer writes
+    uint64_t tail;                     // bytes on disk; writer thread writes
+    uint64_t wpos;                     // end of the tick being recorded
+    uint64_t limit;                    // wpos may grow to here without checking tail
+    int full;                          // a record of this tick did not fit
+    int stopped;                       // recording gave up (ring full or disk error)
+    int error;                         // errno of a failed write, writer thread
+    int quit;
+    int efd;                           // wakes the writer thread
+    pthread_t thread;
+
+    uint64_t last_tick;
+    uint64_t next_key;                 // tick of the next keyframe
+    uint32_t every;
+    uint8_t* key;                      // keyframe scratch, sim_save_max() bytes
+    size_t key_cap;
+
+    uint64_t* key_tick;                // keyframe index, written on close
+    uint64_t* key_off;
+    int nkeys, keys_cap;
+
+    uint64_t ticks;                    // TICK records published
+    uint64_t stop_tick;                // first tick not recorded, once stopped
+} journal_t;
+
+static inline void* journal_writer_(void* arg) {
+    journal_t* j = arg;
+    for (;;) {
+        uint64_t n;
+        ssize_t r = read(j->efd, &n, sizeof n);
+        (void)r;
+        int quit = __atomic_load_n(&j->quit, __ATOMIC_ACQUIRE);
+        uint64_t head = __atomic_load_n(&j->head, __ATOMIC_ACQUIRE);
+        while (j->tail < head) {
+            size_t at = (size_t)(j->tail & (j->cap - 1));
+            size_t len = head - j->tail < j->cap - at ? (size_t)(head - j->tail) : j->cap - at;
+            ssize_t w = write(j->fd, j->ring + at, len);
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) {
+                __atomic_store_n(&j->error, w < 0 ? errno : EIO, __ATOMIC_RELEASE);
+                return NULL;
+            }
+            __atomic_store_n(&j->tail, j->tail + (uint64_t)w, __ATOMIC_RELEASE);
+        }
+        if (quit) return NULL;
+    }
+}
+
+// Start recording to path with a ring of ring_bytes (rounded up to a power
+// of two, and to at least two keyframes). Returns -1 with errno set.
+static inline int journal_open(journal_t* j, const char* path, const journal_hdr_t* h, size_t ring_bytes) {
+    memset(j, 0, sizeof *j);
+    j->efd = -1;
+    j->key_cap = sim_save_max((int)h->max_players);
+    j->cap = 4096;
+    while (j->cap < ring_bytes || j->cap < 2 * (j->key_cap + 16)) j->cap *= 2;
+    j->every = h->keyframe_every ? h->keyframe_every : 1;
+    j->next_key = j->every;
+
+    j->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (j->fd < 0) return -1;
+    uint8_t hdr[JOURNAL_HDR_SIZE];
+    memcpy(hdr, JOURNAL_MAGIC, 4);
+    journal_put32_(hdr + 4, JOURNAL_VERSION);
+    journal_put32_(hdr + 8, h->grid);
+    journal_put32_(hdr + 12, h->max_players);
+    journal_put32_(hdr + 16, h->cooldown_ticks);
+    journal_put32_(hdr + 20, h->tick_hz);
+    journal_put32_(hdr + 24, j->every);
+    journal_put32_(hdr + 28, h->flags);
+    j->ring = malloc(j->cap);
+    j->key = malloc(j->key_cap);
+    if (j->ring) memset(j->ring, 0, j->cap);   // fault the pages in now, not during a tick
+    if (j->key) memset(j->key, 0, j->key_cap);
+    j->efd = eventfd(0, EFD_CLOEXEC);
+    if (write(j->fd, hdr, sizeof hdr) != (ssize_t)sizeof hdr || !j->ring || !j->key || j->efd < 0 ||
+        (errno = pthread_create(&j->thread, NULL, journal_writer_, j)) != 0) {
+        int e = errno;
+        close(j->fd);
+        if (j->efd >= 0) close(j->efd);
+        free(j->ring);
+        free(j->key);
+        memset(j, 0, sizeof *j);
+        errno = e;
+        return -1;
+    }
+    return 0;
+}
+
+// Append n bytes to the tick being recorded, unless they do not fit. The
+// writer thread's tail is read again only when the space known free runs
+// out.
+static inline void journal_put_(journal_t* j, const uint8_t* p, size_t n) {
+    if (j->wpos + n > j->limit) {
+        j->limit = __atomic_load_n(&j->tail, __ATOMIC_ACQUIRE) + j->cap;
+        if (j->wpos + n > j->limit) { j->full = 1; return; }
+    }
+    if (j->full) return;
+    size_t at = (size_t)(j->wpos & (j->cap - 1));
+    if (n <= j->cap - at) {
+        memcpy(j->ring + at, p, n);
+    } else {
+        memcpy(j->ring + at, p, j->cap - at);
+        memcpy(j->ring, p + (j->cap - at), n - (j->cap - at));
+    }
+    j->wpos += n;
+}
+
+static inline int journal_on_(const journal_t* j) {
+    return j->ring && !j->stopped;
+}
+
+static inline void journal_spawn(journal_t* j, int32_t owner, entity_t h) {
+    if (!journal_on_(j)) return;
+    uint8_t rec[JOURNAL_MAX_RECORD], *p = rec;
+    *p++ = JOURNAL_SPAWN;
+    p = journal_varint_(p, journal_zigzag_(owner));
+    p = journal_varint_(p, h);
+    journal_put_(j, rec, (size_t)(p - rec));
+}
+
+static inline void journal_despawn(journal_t* j, entity_t h) {
+    if (!journal_on_(j)) return;
+    uint8_t rec[JOURNAL_MAX_RECORD], *p = rec;
+    *p++ = JOURNAL_DESPAWN;
+    p = journal_varint_(p, h);
+    journal_put_(j, rec, (size_t)(p - rec));
+}
+
+static inline void journal_move(journal_t* j, int player, int x, int y, uint32_t seq) {
+    if (!journal_on_(j)) return;
+    uint8_t rec[JOURNAL_MAX_RECORD], *p = rec;
+    *p++ = JOURNAL_MOVE;
+    p = journal_varint_(p, (uint64_t)player);
+    p = journal_varint_(p, journal_zigzag_(x));
+    p = journal_varint_(p, journal_zigzag_(y));
+    p = journal_varint_(p, seq);
+    journal_put_(j, rec, (size_t)(p - rec));
+}
+
+// Close the record of tick (after sim_step() ran it on s): add a keyframe
+// when one is due and hand the tick to the writer thread. Returns -1 the
+// first time recording stops (the ring filled or the disk failed); the
+// journal then ends before this tick.
+static inline int journal_tick(journal_t* j, uint64_t tick, const sim_t* s) {
+    if (!journal_on_(j)) return 0;
+    uint8_t rec[JOURNAL_MAX_RECORD], *p = rec;
+    *p++ = JOURNAL_TICK;
+    p = journal_varint_(p, tick - j->last_tick);
+    journal_put_(j, rec, (size_t)(p - rec));
+
+    if (tick >= j->next_key && !j->full) {
+        size_t len = sim_save(s, j->key, j->key_cap);
+        if (j->nkeys == j->keys_cap) {
+            int ncap = j->keys_cap ? 2 * j->keys_cap : 64;
+            uint64_t* kt = realloc(j->key_tick, (size_t)ncap * sizeof *kt);
+            if (kt) j->key_tick = kt;
+            uint64_t* ko = realloc(j->key_off, (size_t)ncap * sizeof *ko);
+            if (ko) j->key_off = ko;
+            if (kt && ko) j->keys_cap = ncap;
+        }
+        if (len && j->nkeys < j->keys_cap) {
+            uint64_t at = j->wpos;
+            rec[0] = JOURNAL_KEYFRAME;
+            journal_put64_(rec + 1, tick);
+            journal_put32_(rec + 9, (uint32_t)len);
+            journal_put_(j, rec, 13);
+            journal_put_(j, j->key, len);
+            if (j->full) {          // keyframes are optional: go without this one
+                j->wpos = at;
+                j->full = 0;
+            } else {
+                j->key_tick[j->nkeys] = tick;
+                j->key_off[j->nkeys++] = JOURNAL_HDR_SIZE + at;
+            }
+        }
+        j->next_key = tick + j->every;
+    }
+
+    if (j->full || __atomic_load_n(&j->error, __ATOMIC_ACQUIRE)) {
+        j->wpos = j->head;
+        j->stopped = 1;
+        j->stop_tick = tick;
+        return -1;
+    }
+    j->last_tick = tick;
+    j->ticks++;
+    __atomic_store_n(&j->head, j->wpos, __ATOMIC_RELEASE);
+    uint64_t one = 1;
+    ssize_t w = write(j->efd, &one, sizeof one);
+    (void)w;
+    return 0;
+}
+
+// Bytes recorded so far
+static inline uint64_t journal_bytes(const journal_t* j) {
+    return JOURNAL_HDR_SIZE + j->head;
+}
+
+// Let the writer thread finish, then end the file and write the keyframe
+// index. Returns -1 with errno set if anything failed to reach the file.
+static inline int journal_close(journal_t* j) {
+    if (!j->ring) return 0;
+    __atomic_store_n(&j->quit, 1, __ATOMIC_RELEASE);
+    uint64_t one = 1;
+    ssize_t w = write(j->efd, &one, sizeof one);
+    (void)w;
+    pthread_join(j->thread, NULL);
+
+    int err = j->error;
+    if (!err) {
+        // the index is written whole or not at all: a reader without it scans
+        size_t len = 1 + (size_t)j->nkeys * 16 + JOURNAL_TAIL_SIZE;
+        uint8_t* tail = malloc(len);
+        if (!tail) {
+            err = ENOMEM;
+        } else {
+            tail[0] = JOURNAL_END;
+            for (int k = 0; k < j->nkeys; k++) {
+                journal_put64_(tail + 1 + 16 * k, j->key_tick[k]);
+                journal_put64_(tail + 9 + 16 * k, j->key_off[k]);
+            }
+            uint8_t* t = tail + 1 + (size_t)j->nkeys * 16;
+            journal_put64_(t, (uint64_t)j->nkeys);
+            memcpy(t + 8, JOURNAL_INDEX_MAGIC, 4);
+            journal_put32_(t + 12, 0);
+            if (write(j->fd, tail, len) != (ssize_t)len) err = errno ? errno : EIO;
+            free(tail);
+        }
+    }
+    if (close(j->fd) < 0 && !err) err = errno;
+    close(j->efd);
+    free(j->ring);
+    free(j->key);
+    free(j->key_tick);
+    free(j->key_off);
+    memset(j, 0, sizeof *j);
+    if (err) { errno = err; return -1; }
+    return 0;
+}
+
+// ---------------------------------------------------------------- reading
+
+typedef struct {
+    int type;                          // JOURNAL_*
+    uint64_t tick;                     // TICK, KEYFRAME
+    int32_t owner;                     // SPAWN
+    entity_t handle;                   // SPAWN, DESPAWN
+    int player, x, y;                  // MOVE
+    uint32_t seq;
+    const uint8_t* state;              // KEYFRAME
+    size_t state_len;
+} journal_rec_t;
+
+typedef struct {
+    const uint8_t* map;
+    size_t len;
+    journal_hdr_t hdr;
+    size_t end;                        // records stop here
+    int indexed;                       // the index was read from the file
+    uint64_t* key_tick;
+    size_t* key_off;
+    int nkeys;
+    uint64_t first_tick, last_tick;    // ticks recorded
+    uint64_t ticks;
+} journal_reader_t;
+
+static inline int journal_uvarint_(const uint8_t** p, const uint8_t* end, uint64_t* v) {
+    *v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (*p == end) return -1;
+        uint8_t b = *(*p)++;
+        *v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return 0;
+    }
+    return -1;
+}
+
+static inline int journal_svarint_(const uint8_t** p, const uint8_t* end, int64_t* v) {
+    uint64_t u;
+    if (journal_uvarint_(p, end, &u) < 0) return -1;
+    *v = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+    return 0;
+}
+
+// Decode the record at *pos. *tick is the tick of the last TICK or
+// KEYFRAME read, and is updated. Returns 1 and moves *pos past the record,
+// 0 at the end, -1 for a malformed or cut-off record.
+static inline int journal_next(const journal_reader_t* r, size_t* pos, uint64_t* tick, journal_rec_t* rec) {
+    if (*pos >= r->end) return 0;
+    const uint8_t* p = r->map + *pos + 1;
+    const uint8_t* end = r->map + r->end;
+    uint64_t a, b;
+    int64_t sa, sb;
+    memset(rec, 0, sizeof *rec);
+    rec->type = r->map[*pos];
+    switch (rec->type) {
+    case JOURNAL_END:
+        return 0;
+    case JOURNAL_SPAWN:
+        if (journal_svarint_(&p, end, &sa) < 0 || journal_uvarint_(&p, end, &a) < 0) return -1;
+        rec->owner = (int32_t)sa;
+        rec->handle = (entity_t)a;
+        break;
+    case JOURNAL_DESPAWN:
+        if (journal_uvarint_(&p, end, &a) < 0) return -1;
+        rec->handle = (entity_t)a;
+        break;
+    case JOURNAL_MOVE:
+        if (journal_uvarint_(&p, end, &a) < 0 || journal_svarint_(&p, end, &sa) < 0 ||
+            journal_svarint_(&p, end, &sb) < 0 || journal_uvarint_(&p, end, &b) < 0)
+            return -1;
+        rec->player = (int)a;
+        rec->x = (int)sa;
+        rec->y = (int)sb;
+        rec->seq = (uint32_t)b;
+        break;
+    case JOURNAL_TICK:
+        if (journal_uvarint_(&p, end, &a) < 0) return -1;
+        rec->tick = *tick += a;
+        break;
+    case JOURNAL_KEYFRAME:
+        if (end - p < 12) return -1;
+        rec->tick = *tick = journal_get64_(p);
+        rec->state_len = journal_get32_(p + 8);
+        p += 12;
+        if ((size_t)(end - p) < rec->state_len) return -1;
+        rec->state = p;
+        p += rec->state_len;
+        break;
+    default:
+        return -1;
+    }
+    *pos = (size_t)(p - r->map);
+    return 1;
+}
+
+// Play one record into s. Returns -1 if the simulation no longer agrees
+// with the recording (a different build, board or world file).
+static inline int journal_apply(sim_t* s, const journal_rec_t* rec) {
+    switch (rec->type) {
+    case JOURNAL_SPAWN:
+        return sim_spawn(s, rec->owner) == rec->handle ? 0 : -1;
+    case JOURNAL_DESPAWN:
+        return sim_destroy(s, rec->handle);
+    case JOURNAL_MOVE:
+        if (rec->player < 0 || rec->player >= s->max_players) return -1;
+        return sim_queue_move(s, rec->player, rec->x, rec->y, rec->seq);
+    case JOURNAL_TICK:
+        sim_step(s, rec->tick);
+        return 0;
+    }
+    return 0;
+}
+
+static inline int journal_add_key_(journal_reader_t* r, uint64_t tick, size_t off) {
+    if ((r->nkeys & (r->nkeys - 1)) == 0) {           // 0, 1, 2, 4...: grow
+        int ncap = r->nkeys ? 2 * r->nkeys : 1;
+        uint64_t* kt = realloc(r->key_tick, (size_t)ncap * sizeof *kt);
+        if (kt) r->key_tick = kt;
+        size_t* ko = realloc(r->key_off, (size_t)ncap * sizeof *ko);
+        if (ko) r->key_off = ko;
+        if (!kt || !ko) return -1;
+    }
+    r->key_tick[r->nkeys] = tick;
+    r->key_off[r->nkeys++] = off;
+    return 0;
+}
+
+static inline void journal_unmap(journal_reader_t* r) {
+    if (r->map) munmap((void*)r->map, r->len);
+    free(r->key_tick);
+    free(r->key_off);
+    memset(r, 0, sizeof *r);
+}
+
+// Map a journal and find its keyframes: from the index of a closed one,
+// else by reading every record (the file then ends at the last whole one).
+// Returns -1 with errno set (EINVAL: not a journal).
+static inline int journal_map(journal_reader_t* r, const char* path) {
+    memset(r, 0, sizeof *r);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) < 0) { close(fd); return -1; }
+    if ((size_t)st.st_size < JOURNAL_HDR_SIZE) { close(fd); errno = EINVAL; return -1; }
+    void* m = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int e = errno;
+    close(fd);
+    if (m == MAP_FAILED) { errno = e; return -1; }
+    r->map = m;
+    r->len = (size_t)st.st_size;
+    madvise(m, r->len, MADV_SEQUENTIAL);
+
+    const uint8_t* h = r->map;
+    if (memcmp(h, JOURNAL_MAGIC, 4) != 0 || journal_get32_(h + 4) != JOURNAL_VERSION) goto bad;
+    r->hdr.version = JOURNAL_VERSION;
+    r->hdr.grid = journal_get32_(h + 8);
+    r->hdr.max_players = journal_get32_(h + 12);
+    r->hdr.cooldown_ticks = journal_get32_(h + 16);
+    r->hdr.tick_hz = journal_get32_(h + 20);
+    r->hdr.keyframe_every = journal_get32_(h + 24);
+    r->hdr.flags = journal_get32_(h + 28);
+    if (r->hdr.grid < 2 || r->hdr.max_players < 1 || r->hdr.max_players > ENTITY_SLOT_MASK) goto bad;
+    r->end = r->len;
+
+    // closed: take the index, after checking it points at keyframes
+    const uint8_t* t = r->map + r->len - JOURNAL_TAIL_SIZE;
+    if (r->len >= JOURNAL_HDR_SIZE + 1 + JOURNAL_TAIL_SIZE && memcmp(t + 8, JOURNAL_INDEX_MAGIC, 4) == 0) {
+        uint64_t n = journal_get64_(t);
+        size_t at = n <= (r->len - JOURNAL_HDR_SIZE - 1 - JOURNAL_TAIL_SIZE) / 16 ?
+                    r->len - JOURNAL_TAIL_SIZE - (size_t)n * 16 : 0;
+        if (at && r->map[at - 1] == JOURNAL_END) {
+            r->end = at - 1;
+            r->indexed = 1;
+            for (uint64_t k = 0; k < n && r->indexed; k++) {
+                uint64_t kt = journal_get64_(r->map + at + 16 * k);
+                uint64_t ko = journal_get64_(r->map + at + 16 * k + 8);
+                if (ko < JOURNAL_HDR_SIZE || ko >= r->end || r->map[ko] != JOURNAL_KEYFRAME ||
+                    (k && kt <= r->key_tick[k - 1]))
+                    r->indexed = 0;
+                else if (journal_add_key_(r, kt, (size_t)ko) < 0)
+                    goto nomem;
+            }
+            if (!r->indexed) r->nkeys = 0, r->end = r->len;
+        }
+    }
+
+    // one pass for the tick range (and the keyframes if there was no index)
+    size_t pos = JOURNAL_HDR_SIZE;
+    uint64_t tick = 0;
+    journal_rec_t rec;
+    int rc;
+    for (;;) {
+        size_t at = pos;
+        if ((rc = journal_next(r, &pos, &tick, &rec)) <= 0) {
+            // cut off or damaged: keep what came before
+            if (rc < 0 || !r->indexed) r->end = at;
+            while (r->nkeys && r->key_off[r->nkeys - 1] >= r->end) r->nkeys--;
+            break;
+        }
+        if (rec.type == JOURNAL_TICK) {
+            if (!r->ticks++) r->first_tick = rec.tick;
+            r->last_tick = rec.tick;
+        } else if (rec.type == JOURNAL_KEYFRAME && !r->indexed) {
+            if (journal_add_key_(r, rec.tick, at) < 0) goto nomem;
+        }
+    }
+    return 0;
+
+nomem:
+    journal_unmap(r);
+    errno = ENOMEM;
+    return -1;
+bad:
+    journal_unmap(r);
+    errno = EINVAL;
+    return -1;
+}
+
+// Put s (initialised for the journal's board) in the state after tick:
+// load the last keyframe at or before it, then play records forward. *pos
+// and *at are left as journal_next() leaves them after that tick, so *at
+// is the tick reached (an earlier one if tick was skipped or the journal
+// ends first). Returns -1 if playback diverged or a keyframe is bad.
+static inline int journal_seek(const journal_reader_t* r, sim_t* s, uint64_t tick, size_t* pos, uint64_t* at) {
+    int lo = 0, hi = r->nkeys;               // first keyframe after tick
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (r->key_tick[mid] <= tick) lo = mid + 1;
+        else hi = mid;
+    }
+    journal_rec_t rec;
+    *at = 0;
+    if (lo > 0) {
+        *pos = r->key_off[lo - 1];
+        if (journal_next(r, pos, at, &rec) != 1 || sim_load(s, rec.state, rec.state_len) < 0) return -1;
+    } else {
+        *pos = JOURNAL_HDR_SIZE;
+        sim_clear(s);
+    }
+    int reached = lo > 0 && *at >= tick;
+    while (!reached) {
+        size_t before = *pos;
+        uint64_t t = *at;
+        if (journal_next(r, pos, at, &rec) <= 0) break;
+        if (rec.type == JOURNAL_TICK && rec.tick > tick) {   // tick was never run (skipped)
+            *pos = before;
+            *at = t;
+            break;
+        }
+        if (journal_apply(s, &rec) < 0) return -1;
+        reached = rec.type == JOURNAL_TICK && rec.tick == tick;
+    }
+    return 0;
+}
+
+#endif
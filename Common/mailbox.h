@@ -0,0 +1,82 @@
+// Cross-thread mailbox: many posters, one owning event loop.
+//
+// Only for control traffic (console commands, global broadcasts), never the
+// per-packet hot path. Posting appends under a short mutex and bumps an
+// eventfd; the owner registers mailbox.efd in its epoll set and takes the
+// whole list in one go when it fires.
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+typedef struct mail {
+    struct mail* next;
+    int kind;
+    int id;
+    uint16_t len;
+    char data[];
+} mail_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    mail_t* head;
+    mail_t** tail;
+    int efd;
+} mailbox_t;
+
+static inline int mailbox_init(mailbox_t* mb) {
+    pthread_mutex_init(&mb->lock, NULL);
+    mb->head = NULL;
+    mb->tail = &mb->head;
+    mb->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return mb->efd < 0 ? -1 : 0;
+}
+
+// Returns 0, or -1 if out of memory.
+static inline int mailbox_post(mailbox_t* mb, int kind, int id, const void* data, uint16_t len) {
+    mail_t* m = malloc(sizeof *m + len);
+    if (!m) return -1;
+    m->next = NULL;
+    m->kind = kind;
+    m->id = id;
+    m->len = len;
+    if (len) memcpy(m->data, data, len);
+
+    pthread_mutex_lock(&mb->lock);
+    *mb->tail = m;
+    mb->tail = &m->next;
+    pthread_mutex_unlock(&mb->lock);
+
+    uint64_t one = 1;
+    ssize_t w = write(mb->efd, &one, sizeof one);
+    (void)w;
+    return 0;
+}
+
+// Detach everything posted so far, oldest first. Free each with free().
+static inline mail_t* mailbox_take(mailbox_t* mb) {
+    uint64_t n;
+    ssize_t r = read(mb->efd, &n, sizeof n);
+    (void)r;
+
+    pthread_mutex_lock(&mb->lock);
+    mail_t* list = mb->head;
+    mb->head = NULL;
+    mb->tail = &mb->head;
+    pthread_mutex_unlock(&mb->lock);
+    return list;
+}
+
+static inline void mailbox_destroy(mailbox_t* mb) {
+    mail_t* m = mailbox_take(mb);
+    while (m) { mail_t* next = m->next; free(m); m = next; }
+    close(mb->efd);
+    pthread_mutex_destroy(&mb->lock);
+}
+
+#endif
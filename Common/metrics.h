@@ -0,0 +1,161 @@
+// Runtime metrics: per-thread counters and fixed-bucket histograms.
+//
+// Every IO thread owns one metrics_t and is its only writer, so recording
+// is a load, an add and a relaxed store: no lock and no locked instruction,
+// a few nanoseconds per event. Any other thread (console, periodic dump) may
+// read concurrently with relaxed loads; it sees each value whole, possibly a
+// few events stale. Readers take a metrics_snapshot() and merge per-thread
+// snapshots with metrics_merge() before printing.
+//
+// Histograms bucket by powers of two: bucket b holds values in
+// [2^(b-1), 2^b), bucket 0 holds 0. Percentiles are reported as the upper
+// bound of the bucket they fall in, i.e. to within a factor of two.
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define METRICS_BUCKETS 40   // up to 2^39 (~9 min in ns, 512 GiB in bytes)
+
+enum {
+    MC_ACCEPTS,       // connections added
+    MC_DISCONNECTS,   // connections removed
+    MC_CLIENTS,       // gauge: live connections
+    MC_READ_CALLS,
+    MC_WRITE_CALLS,
+    MC_BYTES_IN,
+    MC_BYTES_OUT,
+    MC_FRAMES_IN,
+    MC_FRAMES_OUT,    // frames queued
+    MC_DROPPED,       // droppable frames skipped over the high-water mark
+    MC_KICKED,        // clients over the send-queue hard limit
+    MC_UDP_IN,        // gauge: datagrams received
+    MC_UDP_OUT,       // gauge: datagrams sent
+    MC_TICKS,
+    MC_AOI_UPDATES,   // entities sent as entering or moving in a client's view
+    MC_AOI_LEAVES,    // entities sent as leaving a client's view
+    MC_STATE_BYTES,   // FRAME_STATE payload bytes queued
+    MC_STATE_FULL,    // states sent with no acked baseline
+    MC_ALLOCS,        // heap calls by the loop, 0 unless built with COUNT_ALLOCS (alloc_count.h)
+    MC_COUNT
+};
+
+enum {
+    MH_TICK_NS,       // one simulation / housekeeping tick
+    MH_WAKE_NS,       // handling one event-loop wakeup
+    MH_READ_NS,       // one read() syscall
+    MH_WRITE_NS,      // one send-queue flush (writev calls)
+    MH_BACKLOG,       // bytes left queued after a flush
+    MH_REPLICATE_NS,  // building every client's state for one tick
+    MH_COUNT
+};
+
+static const char* const metrics_counter_names[MC_COUNT] = {
+    "accepts", "disconnects", "clients", "read_calls", "write_calls",
+    "bytes_in", "bytes_out", "frames_in", "frames_out", "dropped", "kicked",
+    "udp_in", "udp_out", "ticks", "aoi_updates", "aoi_leaves",
+    "state_bytes", "state_full", "allocs",
+};
+
+static const char* const metrics_hist_names[MH_COUNT] = {
+    "tick_ns", "wake_ns", "read_ns", "write_ns", "backlog_bytes", "replicate_ns",
+};
+
+typedef struct {
+    _Alignas(64) uint64_t counters[MC_COUNT];
+    uint64_t hist[MH_COUNT][METRICS_BUCKETS];
+    uint64_t hist_sum[MH_COUNT];
+    uint64_t hist_max[MH_COUNT];
+} metrics_t;
+
+static inline void metrics_init(metrics_t* m) {
+    memset(m, 0, sizeof *m);
+}
+
+// Writer side: only the owning thread may call these.
+static inline void metrics_add(metrics_t* m, int c, uint64_t n) {
+    __atomic_store_n(&m->counters[c], m->counters[c] + n, __ATOMIC_RELAXED);
+}
+
+static inline void metrics_set(metrics_t* m, int c, uint64_t v) {
+    __atomic_store_n(&m->counters[c], v, __ATOMIC_RELAXED);
+}
+
+static inline void metrics_observe(metrics_t* m, int h, uint64_t v) {
+    int b = v ? 64 - __builtin_clzll(v) : 0;
+    if (b >= METRICS_BUCKETS) b = METRICS_BUCKETS - 1;
+    __atomic_store_n(&m->hist[h][b], m->hist[h][b] + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&m->hist_sum[h], m->hist_sum[h] + v, __ATOMIC_RELAXED);
+    if (v > m->hist_max[h]) __atomic_store_n(&m->hist_max[h], v, __ATOMIC_RELAXED);
+}
+
+// Reader side: safe from any thread.
+static inline void metrics_snapshot(metrics_t* dst, const metrics_t* src) {
+    const uint64_t* s = (const uint64_t*)src;
+    uint64_t* d = (uint64_t*)dst;
+    for (size_t i = 0; i < sizeof *src / sizeof(uint64_t); i++) d[i] = __atomic_load_n(&s[i], __ATOMIC_RELAXED);
+}
+
+static inline void metrics_merge(metrics_t* dst, const metrics_t* src) {
+    for (int c = 0; c < MC_COUNT; c++) dst->counters[c] += src->counters[c];
+    for (int h = 0; h < MH_COUNT; h++) {
+        for (int b = 0; b < METRICS_BUCKETS; b++) dst->hist[h][b] += src->hist[h][b];
+        dst->hist_sum[h] += src->hist_sum[h];
+        if (src->hist_max[h] > dst->hist_max[h]) dst->hist_max[h] = src->hist_max[h];
+    }
+}
+
+static inline uint64_t metrics_hist_count(const metrics_t* m, int h) {
+    uint64_t n = 0;
+    for (int b = 0; b < METRICS_BUCKETS; b++) n += m->hist[h][b];
+    return n;
+}
+
+// Upper bound of the bucket holding the p-quantile (0 <= p <= 1).
+static inline uint64_t metrics_percentile(const metrics_t* m, int h, double p) {
+    uint64_t n = metrics_hist_count(m, h);
+    if (n == 0) return 0;
+    uint64_t rank = (uint64_t)(p * (double)(n - 1)) + 1, seen = 0;
+    for (int b = 0; b < METRICS_BUCKETS; b++) {
+        seen += m->hist[h][b];
+        if (seen >= rank) {
+            uint64_t hi = b ? (1ull << b) - 1 : 0;
+            return hi < m->hist_max[h] ? hi : m->hist_max[h];
+        }
+    }
+    return m->hist_max[h];
+}
+
+// Human-readable table for the console.
+static inline void metrics_print(FILE* f, const metrics_t* m) {
+    for (int c = 0; c < MC_COUNT; c++)
+        fprintf(f, "  %-12s %llu\n", metrics_counter_names[c], (unsigned long long)m->counters[c]);
+    fprintf(f, "  %-14s %10s %10s %10s %10s %10s %10s\n", "histogram", "count", "mean", "p50", "p99", "p999", "max");
+    for (int h = 0; h < MH_COUNT; h++) {
+        uint64_t n = metrics_hist_count(m, h);
+        fprintf(f, "  %-14s %10llu %10llu %10llu %10llu %10llu %10llu\n", metrics_hist_names[h],
+                (unsigned long long)n, (unsigned long long)(n ? m->hist_sum[h] / n : 0),
+                (unsigned long long)metrics_percentile(m, h, 0.50),
+                (unsigned long long)metrics_percentile(m, h, 0.99),
+                (unsigned long long)metrics_percentile(m, h, 0.999),
+                (unsigned long long)m->hist_max[h]);
+    }
+}
+
+// One key=value line per dump, easy to grep or load into a spreadsheet.
+static inline void metrics_dump(FILE* f, const metrics_t* m, double uptime_s) {
+    fprintf(f, "uptime_s=%.1f", uptime_s);
+    for (int c = 0; c < MC_COUNT; c++)
+        fprintf(f, " %s=%llu", metrics_counter_names[c], (unsigned long long)m->counters[c]);
+    for (int h = 0; h < MH_COUNT; h++)
+        fprintf(f, " %s_p50=%llu %s_p99=%llu %s_max=%llu",
+                metrics_hist_names[h], (unsigned long long)metrics_percentile(m, h, 0.50),
+                metrics_hist_names[h], (unsigned long long)metrics_percentile(m, h, 0.99),
+                metrics_hist_names[h], (unsigned long long)m->hist_max[h]);
+    fputc('\n', f);
+    fflush(f);
+}
+
+#endif
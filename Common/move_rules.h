@@ -0,0 +1,27 @@
+// The movement rule, shared by the server (authoritative) and the client
+// (prediction). Both sides must reach the same position from the same
+// inputs, so this is the only place the rule may live: keep it pure and
+// deterministic (integers only, no clocks, no randomness).
+#ifndef MOVE_RULES_H
+#define MOVE_RULES_H
+
+#include <stdlib.h>
+
+#define MOVE_DELAY_S 0.15   // seconds between steps while a key is held
+
+// A move names the destination cell; it is legal if that cell is on the
+// board and exactly one orthogonal step from pos.
+static inline int move_is_legal(const int pos[2], int x, int y, int grid) {
+    if (x < 0 || x >= grid || y < 0 || y >= grid) return 0;
+    return abs(x - pos[0]) + abs(y - pos[1]) == 1;
+}
+
+// Apply a move if legal. Returns 1 if pos changed.
+static inline int move_apply(int pos[2], int x, int y, int grid) {
+    if (!move_is_legal(pos, x, y, grid)) return 0;
+    pos[0] = x;
+    pos[1] = y;
+    return 1;
+}
+
+#endif
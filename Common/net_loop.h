@@ -0,0 +1,85 @@
+// Edge-triggered epoll event loop shared by the servers.
+//
+// Header-only so every demo still builds with a single `gcc file.c` line.
+// Descriptors registered with NET_EDGE must be non-blocking and drained
+// until EAGAIN, because epoll only reports the transition to readable.
+#ifndef NET_LOOP_H
+#define NET_LOOP_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#define NET_MAX_EVENTS 256
+
+#define NET_READ  EPOLLIN
+#define NET_WRITE EPOLLOUT
+#define NET_EDGE  EPOLLET
+
+typedef struct {
+    int epfd;
+    int nready;                                // events filled by the last wait
+    struct epoll_event events[NET_MAX_EVENTS];
+} net_loop_t;
+
+static inline int net_set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) return -1;
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+// Send small writes at once. For peers that batch their own frames per
+// write and send small acks: with Nagle on, a write behind an unacked one
+// waits for the peer's delayed ACK (up to 40 ms).
+static inline int net_set_nodelay(int fd) {
+    int one = 1;
+    return setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+}
+
+static inline int net_loop_init(net_loop_t* loop) {
+    loop->nready = 0;
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epfd < 0) { perror("epoll_create1"); return -1; }
+    return 0;
+}
+
+// Register fd; `events` is a mask of NET_READ / NET_WRITE / NET_EDGE.
+static inline int net_loop_add(net_loop_t* loop, int fd, uint32_t events) {
+    struct epoll_event ev = {0};
+    ev.events = events;
+    ev.data.fd = fd;
+    return epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+static inline int net_loop_mod(net_loop_t* loop, int fd, uint32_t events) {
+    struct epoll_event ev = {0};
+    ev.events = events;
+    ev.data.fd = fd;
+    return epoll_ctl(loop->epfd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+static inline int net_loop_del(net_loop_t* loop, int fd) {
+    return epoll_ctl(loop->epfd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+// Wait for events; timeout_ms < 0 blocks. Returns the number of ready
+// descriptors (0 on timeout or EINTR), or -1 on error.
+static inline int net_loop_wait(net_loop_t* loop, int timeout_ms) {
+    int n = epoll_wait(loop->epfd, loop->events, NET_MAX_EVENTS, timeout_ms);
+    if (n < 0 && errno == EINTR) n = 0;
+    loop->nready = n < 0 ? 0 : n;
+    return n;
+}
+
+static inline void net_loop_close(net_loop_t* loop) {
+    if (loop->epfd >= 0) close(loop->epfd);
+    loop->epfd = -1;
+}
+
+#endif
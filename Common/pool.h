@@ -0,0 +1,179 @@
+// Fixed-size object pools and a bump arena for the networking path.
+//
+// A slab_pool_t hands out objects of one size, carved from slabs of
+// per_slab objects. A freed object goes on a free list threaded through
+// itself and is the next one handed out; slabs are only returned by
+// slab_pool_free(). Once the pool has grown to the most objects ever live
+// at once, getting and putting one is a pointer swap and never calls
+// malloc.
+//
+// An arena_t is for memory that lives until a known point, such as the
+// end of a tick: arena_alloc() bumps a pointer through a chunk and
+// arena_reset() drops everything at once. Chunks are kept for the next
+// round, so an arena that has seen its largest round allocates no more.
+//
+// Neither locks: each belongs to one thread at a time, like the client
+// table or room that owns it.
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define POOL_ALIGN  16                 // of every object and allocation
+#define ARENA_CHUNK (64 * 1024)        // default chunk size
+
+static inline size_t pool_round_(size_t n) {
+    return (n + POOL_ALIGN - 1) & ~(size_t)(POOL_ALIGN - 1);
+}
+
+typedef struct slab {
+    struct slab* next;
+} slab_t;
+
+typedef struct {
+    size_t size;                       // per object, a multiple of POOL_ALIGN
+    int per_slab;
+    void* free;                        // free list, linked through the objects
+    slab_t* slabs;
+    int nslabs;
+    int live;                          // handed out and not put back
+    int peak;
+} slab_pool_t;
+
+static inline void slab_pool_init(slab_pool_t* p, size_t size, int per_slab) {
+    memset(p, 0, sizeof *p);
+    p->size = pool_round_(size < sizeof(void*) ? sizeof(void*) : size);
+    p->per_slab = per_slab > 0 ? per_slab : 1;
+}
+
+// Returns NULL if out of memory.
+static inline void* slab_pool_get(slab_pool_t* p) {
+    if (!p->free) {
+        // objects start one POOL_ALIGN past the slab header
+        slab_t* s = malloc(POOL_ALIGN + p->size * (size_t)p->per_slab);
+        if (!s) return NULL;
+        s->next = p->slabs;
+        p->slabs = s;
+        p->nslabs++;
+        uint8_t* o = (uint8_t*)s + POOL_ALIGN;
+        for (int i = p->per_slab - 1; i >= 0; i--) {
+            void** obj = (void**)(o + (size_t)i * p->size);
+            *obj = p->free;
+            p->free = obj;
+        }
+    }
+    void** obj = p->free;
+    p->free = *obj;
+    if (++p->live > p->peak) p->peak = p->live;
+    return obj;
+}
+
+static inline void slab_pool_put(slab_pool_t* p, void* obj) {
+    *(void**)obj = p->free;
+    p->free = obj;
+    p->live--;
+}
+
+static inline size_t slab_pool_bytes(const slab_pool_t* p) {
+    return (size_t)p->nslabs * (POOL_ALIGN + p->size * (size_t)p->per_slab);
+}
+
+// Frees every slab, objects still handed out included.
+static inline void slab_pool_free(slab_pool_t* p) {
+    while (p->slabs) {
+        slab_t* next = p->slabs->next;
+        free(p->slabs);
+        p->slabs = next;
+    }
+    slab_pool_init(p, p->size, p->per_slab);
+}
+
+typedef struct arena_chunk {
+    struct arena_chunk* next;
+    size_t cap;
+    size_t used;
+    _Alignas(POOL_ALIGN) uint8_t data[];
+} arena_chunk_t;
+
+typedef struct {
+    arena_chunk_t* first;
+    arena_chunk_t* cur;                // being filled; later ones are spare
+    size_t chunk;                      // size of new chunks
+    size_t used;                       // this round, across chunks
+    size_t peak;
+    int nchunks;
+} arena_t;
+
+static inline void arena_init(arena_t* a, size_t chunk) {
+    memset(a, 0, sizeof *a);
+    a->chunk = chunk ? pool_round_(chunk) : ARENA_CHUNK;
+}
+
+// n bytes until the next arena_reset(); NULL if out of memory.
+static inline void* arena_alloc(arena_t* a, size_t n) {
+    n = pool_round_(n);
+    arena_chunk_t* c = a->cur;
+    while (c && c->cap - c->used < n) {
+        // the rest of a chunk too small for this stays unused this round
+        c = c->next;
+        if (c) c->used = 0;
+    }
+    if (!c) {
+        size_t cap = n > a->chunk ? n : a->chunk;
+        c = malloc(sizeof *c + cap);
+        if (!c) return NULL;
+        c->cap = cap;
+        c->used = 0;
+        c->next = NULL;
+        if (a->cur) {
+            // after cur, ahead of the spares too small for n
+            c->next = a->cur->next;
+            a->cur->next = c;
+        } else {
+            a->first = c;
+        }
+        a->nchunks++;
+    }
+    a->cur = c;
+    void* p = c->data + c->used;
+    c->used += n;
+    a->used += n;
+    if (a->used > a->peak) a->peak = a->used;
+    return p;
+}
+
+// Shrink the latest allocation, p, to n bytes.
+static inline void arena_shrink(arena_t* a, void* p, size_t n) {
+    arena_chunk_t* c = a->cur;
+    size_t at = (size_t)((uint8_t*)p - c->data), was = c->used - at;
+    n = pool_round_(n);
+    if (n >= was) return;
+    c->used = at + n;
+    a->used -= was - n;
+}
+
+static inline void arena_reset(arena_t* a) {
+    a->cur = a->first;
+    if (a->cur) a->cur->used = 0;
+    a->used = 0;
+}
+
+static inline size_t arena_bytes(const arena_t* a) {
+    size_t n = 0;
+    for (const arena_chunk_t* c = a->first; c; c = c->next) n += sizeof *c + c->cap;
+    return n;
+}
+
+static inline void arena_free(arena_t* a) {
+    while (a->first) {
+        arena_chunk_t* next = a->first->next;
+        free(a->first);
+        a->first = next;
+    }
+    arena_init(a, a->chunk);
+}
+
+#endif
@@ -0,0 +1,76 @@
+// Client-side prediction with server reconciliation for the local player.
+//
+// Each local move gets a sequence number, is applied to the predicted
+// position straight away with move_apply() and is kept in a ring of
+// inputs the server has not acknowledged yet. The server reports, per
+// player, the last input sequence it has processed alongside the
+// authoritative positions. predict_reconcile() drops everything up to that
+// ack, rewinds to the server's position and replays the rest, so the
+// prediction converges on the server's result once the inputs are acked,
+// and a rejected move snaps back instead of drifting.
+//
+// No sockets or clocks here; the caller sends the move and feeds in state.
+#ifndef PREDICT_H
+#define PREDICT_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "move_rules.h"
+
+#define PREDICT_RING 64   // unacked inputs kept; more and input stalls
+
+typedef struct {
+    uint32_t seq;
+    int x, y;             // destination, as sent to the server
+} predict_input_t;
+
+typedef struct {
+    predict_input_t ring[PREDICT_RING];
+    int head;
+    int count;
+    uint32_t next_seq;    // first sequence is 1; 0 means "none acked"
+    int pos[2];           // predicted position of the local player
+    int grid;
+    uint64_t corrections; // reconciliations that moved the prediction
+} predictor_t;
+
+static inline void predict_init(predictor_t* pr, int grid, int x, int y) {
+    memset(pr, 0, sizeof *pr);
+    pr->grid = grid;
+    pr->next_seq = 1;
+    pr->pos[0] = x;
+    pr->pos[1] = y;
+}
+
+// Predict a move to (x, y). Returns its sequence number to send with it,
+// or 0 if it is illegal from the predicted position or the ring is full.
+static inline uint32_t predict_input(predictor_t* pr, int x, int y) {
+    if (pr->count == PREDICT_RING) return 0;
+    if (!move_apply(pr->pos, x, y, pr->grid)) return 0;
+    predict_input_t* in = &pr->ring[(pr->head + pr->count++) % PREDICT_RING];
+    in->seq = pr->next_seq++;
+    in->x = x;
+    in->y = y;
+    return in->seq;
+}
+
+// Authoritative state arrived: the server is at (x, y) after processing
+// every input up to and including `ack`. Rewind and replay the rest.
+static inline void predict_reconcile(predictor_t* pr, uint32_t ack, int x, int y) {
+    while (pr->count > 0 && pr->ring[pr->head].seq <= ack) {
+        pr->head = (pr->head + 1) % PREDICT_RING;
+        pr->count--;
+    }
+
+    int before[2] = { pr->pos[0], pr->pos[1] };
+    pr->pos[0] = x;
+    pr->pos[1] = y;
+    for (int i = 0; i < pr->count; i++) {
+        const predict_input_t* in = &pr->ring[(pr->head + i) % PREDICT_RING];
+        move_apply(pr->pos, in->x, in->y, pr->grid);
+    }
+    if (pr->pos[0] != before[0] || pr->pos[1] != before[1]) pr->corrections++;
+}
+
+#endif
@@ -0,0 +1,167 @@
+// Scoped-timer profiler with Chrome trace export.
+//
+//   PROF_SCOPE("tick");        // times from here to the end of the block
+//
+// declares a timer that records (name, start, duration) when it goes out
+// of scope (the cleanup attribute of GCC and Clang stands in for a
+// destructor, so early returns are covered). Names must be string
+// literals: only the pointer is stored. Each thread records into its own
+// ring, created on first use and linked onto a lock-free list, so a
+// record is two clock reads and a few stores with no lock or shared cache
+// line; a full ring overwrites its oldest events.
+//
+// prof_write_trace() writes everything still in the rings as Chrome trace
+// JSON ("X" events, microseconds) for chrome://tracing or ui.perfetto.dev.
+// It may run on any thread while the others keep recording; an event
+// being overwritten while it is copied is left out.
+//
+// Compiled out unless PROFILE is defined: PROF_SCOPE expands to nothing and
+// prof_write_trace() fails with ENOSYS. Like the rest of Common this is
+// header-only, so each translation unit has its own list of rings (every
+// program here is a single one).
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef PROFILE
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#ifndef PROF_RING
+#define PROF_RING 32768                // events kept per thread, power of two
+#endif
+
+typedef struct {
+    const char* name;
+    int64_t begin_ns;
+    int64_t dur_ns;
+} prof_event_t;
+
+typedef struct prof_ring {
+    struct prof_ring* next;
+    int tid;
+    char thread[32];
+    uint64_t head;                     // events ever recorded; written by the owner only
+    prof_event_t ev[PROF_RING];
+} prof_ring_t;
+
+typedef struct {
+    const char* name;
+    int64_t begin_ns;
+} prof_scope_t;
+
+static prof_ring_t* prof_rings_;
+static __thread prof_ring_t* prof_mine_;
+
+static inline int64_t prof_now_(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static inline prof_ring_t* prof_ring_(void) {
+    if (prof_mine_) return prof_mine_;
+    prof_ring_t* r = calloc(1, sizeof *r);
+    if (!r) return NULL;
+    r->tid = (int)syscall(SYS_gettid);
+    snprintf(r->thread, sizeof r->thread, "thread %d", r->tid);
+    r->next = __atomic_load_n(&prof_rings_, __ATOMIC_ACQUIRE);
+    while (!__atomic_compare_exchange_n(&prof_rings_, &r->next, r, 1, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE))
+        ;
+    prof_mine_ = r;
+    return r;
+}
+
+// Label the calling thread in the trace.
+static inline void prof_thread_name(const char* name) {
+    prof_ring_t* r = prof_ring_();
+    if (r) snprintf(r->thread, sizeof r->thread, "%s", name);
+}
+
+static inline void prof_record(const char* name, int64_t begin_ns, int64_t dur_ns) {
+    prof_ring_t* r = prof_ring_();
+    if (!r) return;
+    uint64_t h = r->head;
+    prof_event_t* e = &r->ev[h & (PROF_RING - 1)];
+    e->name = name;
+    e->begin_ns = begin_ns;
+    e->dur_ns = dur_ns;
+    __atomic_store_n(&r->head, h + 1, __ATOMIC_RELEASE);
+}
+
+static inline prof_scope_t prof_scope_begin_(const char* name) {
+    prof_scope_t s = { name, prof_now_() };
+    return s;
+}
+
+static inline void prof_scope_end_(prof_scope_t* s) {
+    prof_record(s->name, s->begin_ns, prof_now_() - s->begin_ns);
+}
+
+#define PROF_CAT_(a, b) a##b
+#define PROF_CAT(a, b) PROF_CAT_(a, b)
+#define PROF_SCOPE(name) \
+    prof_scope_t PROF_CAT(prof_scope_, __LINE__) __attribute__((cleanup(prof_scope_end_))) = prof_scope_begin_(name)
+
+// Write the trace to path. Returns the number of events written, or -1
+// with errno set.
+static inline long prof_write_trace(const char* path) {
+    prof_event_t* copy = malloc(sizeof(prof_event_t) * PROF_RING);
+    if (!copy) return -1;
+    FILE* f = fopen(path, "w");
+    if (!f) { free(copy); return -1; }
+
+    int pid = (int)getpid();
+    long written = 0;
+    const char* sep = "";
+    fprintf(f, "{\"traceEvents\":[\n");
+    for (prof_ring_t* r = __atomic_load_n(&prof_rings_, __ATOMIC_ACQUIRE); r; r = r->next, sep = ",\n") {
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                sep, pid, r->tid, r->thread);
+
+        // copy, then see how far the owner got meanwhile: anything it may
+        // have overwritten during the copy is dropped
+        uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        uint64_t first = head > PROF_RING ? head - PROF_RING : 0;
+        for (uint64_t i = first; i < head; i++) copy[i & (PROF_RING - 1)] = r->ev[i & (PROF_RING - 1)];
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        uint64_t now = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+        if (now >= PROF_RING && now - PROF_RING + 1 > first) first = now - PROF_RING + 1;
+
+        for (uint64_t i = first; i < head; i++) {
+            const prof_event_t* e = &copy[i & (PROF_RING - 1)];
+            fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    e->name, pid, r->tid, e->begin_ns / 1e3, e->dur_ns / 1e3);
+            written++;
+        }
+    }
+    fprintf(f, "\n]}\n");
+    free(copy);
+    if (fclose(f) != 0) return -1;
+    return written;
+}
+
+#else
+
+#define PROF_SCOPE(name) ((void)0)
+
+static inline void prof_thread_name(const char* name) {
+    (void)name;
+}
+
+static inline long prof_write_trace(const char* path) {
+    (void)path;
+    errno = ENOSYS;
+    return -1;
+}
+
+#endif
+
+#endif
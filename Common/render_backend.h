@@ -0,0 +1,131 @@
+// Render backend interface for the grid demos, plus the null backend.
+//
+// A backend owns whatever presents a grid_batch_t: a window and GL context
+// (render_gl.h) or nothing at all. Callers only see this interface, so code
+// built on it compiles and runs without GLFW or a GPU:
+//
+//   open     create the view for a batch's capacity; -1 on failure
+//   pump     process pending window events without blocking; returns 1
+//            if the view needs repainting (resize, expose)
+//   closed   1 once the view was closed by the user
+//   key_down state of a RENDER_KEY_*
+//   draw     clear, upload what the batch marks dirty, draw, present
+//   close    release everything open acquired
+//
+// The null backend records draw commands instead of issuing them and keeps
+// a mirror of the instance buffer a GPU would hold, so tests and headless
+// runs can check exactly what would have been drawn. Key state and the
+// closed flag are plain fields a test can set.
+#ifndef RENDER_BACKEND_H
+#define RENDER_BACKEND_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "grid_batch.h"
+
+enum {
+    RENDER_KEY_ESCAPE,
+    RENDER_KEY_UP,          // arrows, or WASD
+    RENDER_KEY_DOWN,
+    RENDER_KEY_LEFT,
+    RENDER_KEY_RIGHT,
+    RENDER_KEY_COUNT
+};
+
+typedef struct render_backend {
+    const char* name;
+    int (*open)(struct render_backend* rb, const grid_batch_t* b, const char* title);
+    int (*pump)(struct render_backend* rb);
+    int (*closed)(struct render_backend* rb);
+    int (*key_down)(struct render_backend* rb, int key);
+    void (*draw)(struct render_backend* rb, grid_batch_t* b);
+    void (*close)(struct render_backend* rb);
+    void* impl;
+} render_backend_t;
+
+// --- null / recording backend ---
+
+#define RENDER_RECORD_CMDS 256   // most recent draw commands kept
+
+typedef struct {
+    uint64_t frame;          // 1-based draw number
+    int first;               // uploaded instance range [first, first + uploaded)
+    int uploaded;
+    int drawn;               // instances in the draw call
+} render_cmd_t;
+
+typedef struct {
+    render_cmd_t cmds[RENDER_RECORD_CMDS];
+    uint64_t frames;         // draws so far; cmds holds the last RENDER_RECORD_CMDS
+    uint64_t uploaded;       // instances uploaded in total
+    grid_instance_t* mirror; // contents of the instance buffer after the last draw
+    int cap;
+    int keys[RENDER_KEY_COUNT];
+    int closed;
+} render_record_t;
+
+// Command for draw number frame (1-based), or NULL if it was not kept.
+static inline const render_cmd_t* render_record_cmd(const render_record_t* rec, uint64_t frame) {
+    if (frame == 0 || frame > rec->frames || rec->frames - frame >= RENDER_RECORD_CMDS) return NULL;
+    return &rec->cmds[(frame - 1) % RENDER_RECORD_CMDS];
+}
+
+static inline int render_null_open_(render_backend_t* rb, const grid_batch_t* b, const char* title) {
+    render_record_t* rec = rb->impl;
+    free(rec->mirror);
+    memset(rec, 0, sizeof *rec);
+    rec->cap = b->cap;
+    rec->mirror = calloc((size_t)rec->cap, sizeof *rec->mirror);
+    return rec->mirror ? 0 : -1;
+}
+
+static inline int render_null_pump_(render_backend_t* rb) {
+    return 0;
+}
+
+static inline int render_null_closed_(render_backend_t* rb) {
+    return ((render_record_t*)rb->impl)->closed;
+}
+
+static inline int render_null_key_down_(render_backend_t* rb, int key) {
+    render_record_t* rec = rb->impl;
+    return key >= 0 && key < RENDER_KEY_COUNT && rec->keys[key];
+}
+
+static inline void render_null_draw_(render_backend_t* rb, grid_batch_t* b) {
+    render_record_t* rec = rb->impl;
+    render_cmd_t* cmd = &rec->cmds[rec->frames % RENDER_RECORD_CMDS];
+    cmd->frame = ++rec->frames;
+    cmd->first = cmd->uploaded = 0;
+    cmd->drawn = b->count;
+    int first, count;
+    if (grid_batch_take_dirty(b, &first, &count)) {
+        if (first + count > rec->cap) count = rec->cap - first;
+        memcpy(rec->mirror + first, b->inst + first, (size_t)count * sizeof *rec->mirror);
+        cmd->first = first;
+        cmd->uploaded = count;
+        rec->uploaded += (uint64_t)count;
+    }
+}
+
+static inline void render_null_close_(render_backend_t* rb) {
+    render_record_t* rec = rb->impl;
+    free(rec->mirror);
+    rec->mirror = NULL;
+}
+
+static inline void render_null_backend(render_backend_t* rb, render_record_t* rec) {
+    memset(rec, 0, sizeof *rec);
+    rb->name = "null";
+    rb->open = render_null_open_;
+    rb->pump = render_null_pump_;
+    rb->closed = render_null_closed_;
+    rb->key_down = render_null_key_down_;
+    rb->draw = render_null_draw_;
+    rb->close = render_null_close_;
+    rb->impl = rec;
+}
+
+#endif
@@ -0,0 +1,124 @@
+// GLFW window + OpenGL 3.3 backend for render_backend.h, drawing through
+// grid_renderer.h. The window and context exist only between open and
+// close, so a process that never opens this backend never touches GLFW.
+//
+// Include after glad/glad.h and GLFW/glfw3.h.
+#ifndef RENDER_GL_H
+#define RENDER_GL_H
+
+#include <stdio.h>
+
+#include "grid_renderer.h"
+#include "render_backend.h"
+
+typedef struct {
+    GLFWwindow* window;
+    grid_renderer_t renderer;
+    int damaged;            // resized or exposed since the last pump
+} render_gl_t;
+
+static inline void render_gl_resized_(GLFWwindow* window, int width, int height) {
+    render_gl_t* gl = glfwGetWindowUserPointer(window);
+    glViewport(0, 0, width, height);
+    if (gl) gl->damaged = 1;
+}
+
+static inline void render_gl_refresh_(GLFWwindow* window) {
+    render_gl_t* gl = glfwGetWindowUserPointer(window);
+    if (gl) gl->damaged = 1;
+}
+
+static inline int render_gl_open_(render_backend_t* rb, const grid_batch_t* b, const char* title) {
+    render_gl_t* gl = rb->impl;
+    if (!glfwInit()) {
+        printf("Failed to initialize GLFW\n");
+        return -1;
+    }
+
+    // OpenGL 3.3 Core Profile
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    gl->window = glfwCreateWindow(600, 600, title, NULL, NULL);
+    if (!gl->window) {
+        printf("Failed to create GLFW window\n");
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(gl->window);
+    glfwSetWindowUserPointer(gl->window, gl);
+    glfwSetFramebufferSizeCallback(gl->window, render_gl_resized_);
+    glfwSetWindowRefreshCallback(gl->window, render_gl_refresh_);
+
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        printf("Failed to initialize GLAD\n");
+        glfwDestroyWindow(gl->window);
+        glfwTerminate();
+        return -1;
+    }
+
+    int w, h;
+    glfwGetFramebufferSize(gl->window, &w, &h);
+    glViewport(0, 0, w, h);
+
+    grid_renderer_init(&gl->renderer, b);
+    gl->damaged = 1;
+    return 0;
+}
+
+static inline int render_gl_pump_(render_backend_t* rb) {
+    render_gl_t* gl = rb->impl;
+    glfwPollEvents();
+    int damaged = gl->damaged;
+    gl->damaged = 0;
+    return damaged;
+}
+
+static inline int render_gl_closed_(render_backend_t* rb) {
+    return glfwWindowShouldClose(((render_gl_t*)rb->impl)->window);
+}
+
+static inline int render_gl_key_down_(render_backend_t* rb, int key) {
+    static const int keys[RENDER_KEY_COUNT][2] = {
+        [RENDER_KEY_ESCAPE] = { GLFW_KEY_ESCAPE, GLFW_KEY_ESCAPE },
+        [RENDER_KEY_UP]     = { GLFW_KEY_UP,     GLFW_KEY_W },
+        [RENDER_KEY_DOWN]   = { GLFW_KEY_DOWN,   GLFW_KEY_S },
+        [RENDER_KEY_LEFT]   = { GLFW_KEY_LEFT,   GLFW_KEY_A },
+        [RENDER_KEY_RIGHT]  = { GLFW_KEY_RIGHT,  GLFW_KEY_D },
+    };
+    GLFWwindow* window = ((render_gl_t*)rb->impl)->window;
+    if (key < 0 || key >= RENDER_KEY_COUNT) return 0;
+    return glfwGetKey(window, keys[key][0]) == GLFW_PRESS || glfwGetKey(window, keys[key][1]) == GLFW_PRESS;
+}
+
+static inline void render_gl_draw_(render_backend_t* rb, grid_batch_t* b) {
+    render_gl_t* gl = rb->impl;
+    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    grid_renderer_draw(&gl->renderer, b);
+    glfwSwapBuffers(gl->window);
+}
+
+static inline void render_gl_close_(render_backend_t* rb) {
+    render_gl_t* gl = rb->impl;
+    if (!gl->window) return;
+    grid_renderer_free(&gl->renderer);
+    glfwDestroyWindow(gl->window);
+    gl->window = NULL;
+    glfwTerminate();
+}
+
+static inline void render_gl_backend(render_backend_t* rb, render_gl_t* gl) {
+    memset(gl, 0, sizeof *gl);
+    rb->name = "gl";
+    rb->open = render_gl_open_;
+    rb->pump = render_gl_pump_;
+    rb->closed = render_gl_closed_;
+    rb->key_down = render_gl_key_down_;
+    rb->draw = render_gl_draw_;
+    rb->close = render_gl_close_;
+    rb->impl = gl;
+}
+
+#endif
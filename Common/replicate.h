@@ -0,0 +1,133 @@
+// Per-connection state replication, shared by the servers.
+//
+// A replica_t is what a server keeps for one connection: the states it sent
+// (the baselines for later deltas), the newest of them the client acked and
+// the player it controls. replica_build() makes this tick's FRAME_STATE
+// payload for it. The entities in range come from the spatial hash around
+// its player (spectators watch the whole board) and make this tick's
+// snapshot, which is coded against the newest one the client acked, or in
+// full if it has acked none still kept. Nothing needs to go out when the
+// view matches the last state sent and the input ack is unchanged, except
+// the tick after a player stopped: that copy tells interpolating clients to
+// hold it there instead of extrapolating.
+//
+// The caller queues the payload and calls replica_sent() once it is
+// queued. A state dropped at the send queue is not kept, so later deltas
+// never build on it.
+#ifndef REPLICATE_H
+#define REPLICATE_H
+
+#include <stdint.h>
+
+#include "aoi.h"
+#include "bitpack.h"
+#include "entity_store.h"
+#include "game_msg.h"
+#include "game_sim.h"
+#include "snapshot.h"
+#include "spatial_hash.h"
+
+typedef struct {
+    snapshot_ring_t sent;      // states sent, the baselines for later ones
+    int64_t acked;             // newest snapshot tick the client acked, -1 none
+    entity_t player;           // ENTITY_NONE for spectators
+    uint32_t ack_sent;         // input seq acked by the last state sent
+    uint32_t ack_built;        // ... by the one replica_build() made
+} replica_t;
+
+// How every view of one game is cut and coded
+typedef struct {
+    int view_radius;           // 0 = every client sees the whole board
+    move_layout_t layout;
+    int budget;                // most entities in one FRAME_STATE: what a full one can
+                               // carry, and no more than there can be players
+    int* in_range;             // scratch, max_players entries
+} replica_view_t;
+
+static inline void replica_init(replica_t* r) {
+    snapshot_ring_init(&r->sent);
+    r->acked = -1;
+    r->player = ENTITY_NONE;
+    r->ack_sent = r->ack_built = 0;
+}
+
+// Start over for a new connection, keeping the snapshots' storage; a
+// zeroed replica_t may be reset too.
+static inline void replica_reset(replica_t* r) {
+    snapshot_ring_reset(&r->sent);
+    r->acked = -1;
+    r->player = ENTITY_NONE;
+    r->ack_sent = r->ack_built = 0;
+}
+
+// Size every kept snapshot for v->budget entries up front, so building
+// states never allocates once a connection is set up. A slot's storage
+// outlives its connections (replica_reset()), so this only allocates the
+// first time. Returns -1 if out of memory.
+static inline int replica_reserve(replica_t* r, const replica_view_t* v) {
+    return snapshot_ring_reserve(&r->sent, v->budget);
+}
+
+static inline void replica_free(replica_t* r) {
+    snapshot_ring_free(&r->sent);
+    r->player = ENTITY_NONE;
+}
+
+// Player number, -1 for spectators
+static inline int replica_player(const replica_t* r) {
+    return r->player != ENTITY_NONE ? entity_slot(r->player) : -1;
+}
+
+// A FRAME_ACK: acks only move forward, and only to states still kept.
+static inline void replica_ack(replica_t* r, uint32_t tick) {
+    if ((int64_t)tick > r->acked && snapshot_ring_find(&r->sent, tick)) r->acked = tick;
+}
+
+// Build r's state for tick into buf (FRAME_MAX_PAYLOAD bytes are enough).
+// Returns the payload length, or 0 when there is nothing to send.
+static inline size_t replica_build(replica_t* r, const sim_t* s, const replica_view_t* v, uint32_t tick,
+                                   uint8_t* buf, size_t cap, state_hdr_t* h) {
+    int cx = s->grid / 2, cy = s->grid / 2, radius = s->grid;
+    uint32_t ack = 0;
+    int i = entity_index(&s->ents, r->player);
+    if (i >= 0) {
+        cx = s->ents.x[i];
+        cy = s->ents.y[i];
+        if (v->view_radius > 0) radius = v->view_radius;
+        ack = s->inputs[entity_slot(r->player)].last_seq;
+    }
+
+    // the cap keeps a full state inside one frame; past it, who is left
+    // out is arbitrary
+    int n = spatial_hash_query(&s->nearby, cx, cy, radius, v->in_range, v->budget);
+    aoi_sort(v->in_range, n);
+    snapshot_t* cur = snapshot_ring_next(&r->sent);
+    if (snapshot_reserve(cur, n) < 0) return 0;
+    cur->tick = tick;
+    cur->n = n;
+    int settling = 0;
+    for (int k = 0; k < n; k++) {
+        int d = s->ents.slots[v->in_range[k]].dense;
+        cur->e[k].key = v->in_range[k];
+        cur->e[k].x = s->ents.x[d];
+        cur->e[k].y = s->ents.y[d];
+        settling |= s->ents.flags[d] & ENTITY_SETTLE;
+    }
+    snapshot_t* last = snapshot_ring_latest(&r->sent);
+    if (last && !settling && ack == r->ack_sent && snapshot_same(cur, last)) return 0;
+
+    // a delta can outgrow the frame (many entered and many left): send it full
+    snapshot_t* base = r->acked >= 0 ? snapshot_ring_find(&r->sent, (uint32_t)r->acked) : NULL;
+    size_t len = base ? state_encode(buf, cap, v->layout, h, ack, base, cur) : 0;
+    if (!len) len = state_encode(buf, cap, v->layout, h, ack, NULL, cur);
+    r->ack_built = ack;
+    return len;
+}
+
+// The state replica_build() made was queued: keep it as a baseline.
+static inline void replica_sent(replica_t* r) {
+    snapshot_ring_push(&r->sent);
+    r->ack_sent = r->ack_built;
+}
+
+#endif
@@ -0,0 +1,259 @@
+// Per-client send queues over shared, ref-counted message buffers.
+//
+// A broadcast is serialised once into a msg_buf_t and the same buffer is
+// queued on every subscriber; each queue entry only holds a reference and
+// its own write offset. sendq_flush() drains a queue with one writev() per
+// batch of up to SENDQ_IOV entries, so everything queued during a tick goes
+// out in as few syscalls as the socket allows, and never blocks.
+//
+// Backpressure: once a client has more than SENDQ_HIGH_WATER bytes queued,
+// droppable messages (state that the next tick supersedes) are skipped for
+// it; past SENDQ_KICK_LIMIT the caller should disconnect it.
+//
+// Buffers come from the heap, from a msg_pool_t (slab pools in a few size
+// classes, see pool.h) or from a tick arena. An arena buffer is for a
+// message built this tick: it is only valid until the arena is reset, so
+// before that sendq_spill() copies the ones still queued into the pool.
+#ifndef SENDQ_H
+#define SENDQ_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "frame.h"
+#include "pool.h"
+
+#define SENDQ_IOV        64
+#define SENDQ_HIGH_WATER (64 * 1024)
+#define SENDQ_KICK_LIMIT (256 * 1024)
+
+#define MSG_POOL_CLASSES 4
+#define MSG_POOL_SLAB    (16 * 1024)   // default bytes per slab
+
+enum { MSG_HEAP, MSG_SLAB, MSG_ARENA };
+
+typedef struct {
+    int refs;
+    uint32_t len;
+    slab_pool_t* pool;     // MSG_SLAB: the class it goes back to
+    uint8_t from;          // MSG_HEAP, MSG_SLAB or MSG_ARENA
+    uint8_t data[];
+} msg_buf_t;
+
+// Buffers by size class, the largest holding one frame of FRAME_MAX_PAYLOAD
+typedef struct {
+    slab_pool_t cls[MSG_POOL_CLASSES];
+} msg_pool_t;
+
+typedef struct {
+    msg_buf_t* buf;
+    uint32_t off;      // bytes of buf already written
+} sendq_entry_t;
+
+typedef struct {
+    sendq_entry_t* ring;
+    int head;
+    int count;
+    int cap;           // power of two
+    size_t bytes;      // unsent bytes across all entries
+    uint64_t sent;     // bytes written over the queue's lifetime
+    uint64_t writes;   // writev() calls over the queue's lifetime
+} sendq_t;
+
+enum {
+    SENDQ_OK      = 0,
+    SENDQ_DROPPED = 1,   // over the high-water mark, droppable message skipped
+    SENDQ_KICK    = -1,  // over the hard limit (or out of memory)
+};
+
+// Slabs of about slab bytes (0 for MSG_POOL_SLAB), at least one buffer
+// each: small for a pool that serves a handful of clients.
+static inline void msg_pool_init(msg_pool_t* mp, size_t slab) {
+    static const size_t data[MSG_POOL_CLASSES] = { 48, 240, 1008, FRAME_HDR_SIZE + FRAME_MAX_PAYLOAD };
+    if (!slab) slab = MSG_POOL_SLAB;
+    for (int i = 0; i < MSG_POOL_CLASSES; i++) {
+        size_t size = sizeof(msg_buf_t) + data[i];
+        slab_pool_init(&mp->cls[i], size, slab > size ? (int)(slab / size) : 1);
+    }
+}
+
+static inline void msg_pool_free(msg_pool_t* mp) {
+    for (int i = 0; i < MSG_POOL_CLASSES; i++) slab_pool_free(&mp->cls[i]);
+}
+
+static inline size_t msg_pool_bytes(const msg_pool_t* mp) {
+    size_t n = 0;
+    for (int i = 0; i < MSG_POOL_CLASSES; i++) n += slab_pool_bytes(&mp->cls[i]);
+    return n;
+}
+
+// A buffer for cap bytes: from the smallest class of mp it fits in, from
+// the heap if mp is NULL or it fits none.
+static inline msg_buf_t* msg_buf_new(msg_pool_t* mp, size_t cap) {
+    msg_buf_t* b = NULL;
+    slab_pool_t* cls = NULL;
+    for (int i = 0; mp && i < MSG_POOL_CLASSES && !cls; i++)
+        if (sizeof *b + cap <= mp->cls[i].size) cls = &mp->cls[i];
+    b = cls ? slab_pool_get(cls) : malloc(sizeof *b + cap);
+    if (!b) return NULL;
+    b->refs = 1;
+    b->len = 0;
+    b->pool = cls;
+    b->from = cls ? MSG_SLAB : MSG_HEAP;
+    return b;
+}
+
+static inline void msg_buf_release_(msg_buf_t* b) {
+    if (b->from == MSG_SLAB) slab_pool_put(b->pool, b);
+    else if (b->from == MSG_HEAP) free(b);
+}
+
+// Allocate a buffer holding exactly one encoded frame.
+static inline msg_buf_t* msg_buf_frame(msg_pool_t* mp, uint8_t type, uint32_t id, const void* payload, uint16_t len) {
+    msg_buf_t* b = msg_buf_new(mp, FRAME_HDR_SIZE + (size_t)len);
+    if (!b) return NULL;
+    b->len = (uint32_t)frame_encode(b->data, FRAME_HDR_SIZE + (size_t)len, type, id, payload, len);
+    if (b->len == 0) { msg_buf_release_(b); return NULL; }
+    return b;
+}
+
+// Room in the arena for one frame of up to cap payload bytes, to be
+// written in place at b->data + FRAME_HDR_SIZE and closed with
+// msg_buf_arena_end() before anything else comes from the arena.
+static inline msg_buf_t* msg_buf_arena(arena_t* a, size_t cap) {
+    msg_buf_t* b = arena_alloc(a, sizeof *b + FRAME_HDR_SIZE + cap);
+    if (!b) return NULL;
+    b->refs = 1;
+    b->len = 0;
+    b->pool = NULL;
+    b->from = MSG_ARENA;
+    return b;
+}
+
+// Add the header for len payload bytes and give the arena back the rest.
+// With len 0 the whole buffer goes back and NULL is returned.
+static inline msg_buf_t* msg_buf_arena_end(arena_t* a, msg_buf_t* b, uint8_t type, uint32_t id, uint16_t len) {
+    if (!len) {
+        arena_shrink(a, b, 0);
+        return NULL;
+    }
+    frame_hdr_t h = { type, 0, len, id };
+    frame_hdr_pack(b->data, &h);
+    b->len = FRAME_HDR_SIZE + (uint32_t)len;
+    arena_shrink(a, b, sizeof *b + b->len);
+    return b;
+}
+
+static inline msg_buf_t* msg_buf_ref(msg_buf_t* b) {
+    b->refs++;
+    return b;
+}
+
+// Arena buffers only go with the arena.
+static inline void msg_buf_unref(msg_buf_t* b) {
+    if (b && --b->refs == 0) msg_buf_release_(b);
+}
+
+static inline void sendq_init(sendq_t* q) {
+    memset(q, 0, sizeof *q);
+}
+
+// Drop everything queued but keep the ring, for the next connection.
+static inline void sendq_reset(sendq_t* q) {
+    for (int i = 0; i < q->count; i++)
+        msg_buf_unref(q->ring[(q->head + i) & (q->cap - 1)].buf);
+    sendq_entry_t* ring = q->ring;
+    int cap = q->cap;
+    sendq_init(q);
+    q->ring = ring;
+    q->cap = cap;
+}
+
+static inline void sendq_clear(sendq_t* q) {
+    sendq_reset(q);
+    free(q->ring);
+    sendq_init(q);
+}
+
+// Copy the arena buffers still queued into mp (the heap if NULL), before
+// the arena is reset. Returns -1 if out of memory.
+static inline int sendq_spill(sendq_t* q, msg_pool_t* mp) {
+    for (int i = 0; i < q->count; i++) {
+        sendq_entry_t* e = &q->ring[(q->head + i) & (q->cap - 1)];
+        if (e->buf->from != MSG_ARENA) continue;
+        msg_buf_t* b = msg_buf_new(mp, e->buf->len);
+        if (!b) return -1;
+        memcpy(b->data, e->buf->data, e->buf->len);
+        b->len = e->buf->len;
+        msg_buf_unref(e->buf);
+        e->buf = b;
+    }
+    return 0;
+}
+
+// Queue a reference to b. Returns SENDQ_OK, SENDQ_DROPPED or SENDQ_KICK.
+static inline int sendq_push(sendq_t* q, msg_buf_t* b, int droppable) {
+    if (q->bytes + b->len > SENDQ_KICK_LIMIT) return SENDQ_KICK;
+    if (droppable && q->bytes > SENDQ_HIGH_WATER) return SENDQ_DROPPED;
+
+    if (q->count == q->cap) {
+        int ncap = q->cap ? q->cap * 2 : 8;
+        sendq_entry_t* nr = malloc((size_t)ncap * sizeof *nr);
+        if (!nr) return SENDQ_KICK;
+        for (int i = 0; i < q->count; i++) nr[i] = q->ring[(q->head + i) & (q->cap - 1)];
+        free(q->ring);
+        q->ring = nr;
+        q->cap = ncap;
+        q->head = 0;
+    }
+    sendq_entry_t* e = &q->ring[(q->head + q->count) & (q->cap - 1)];
+    e->buf = msg_buf_ref(b);
+    e->off = 0;
+    q->count++;
+    q->bytes += b->len;
+    return SENDQ_OK;
+}
+
+// Write as much as the socket takes. Returns 1 when the queue is empty,
+// 0 if data is left (socket full, wait for writable), -1 on a hard error.
+static inline int sendq_flush(sendq_t* q, int fd) {
+    while (q->count > 0) {
+        struct iovec iov[SENDQ_IOV];
+        int n = q->count < SENDQ_IOV ? q->count : SENDQ_IOV;
+        for (int i = 0; i < n; i++) {
+            sendq_entry_t* e = &q->ring[(q->head + i) & (q->cap - 1)];
+            iov[i].iov_base = e->buf->data + e->off;
+            iov[i].iov_len = e->buf->len - e->off;
+        }
+
+        ssize_t w = writev(fd, iov, n);
+        q->writes++;
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
+        }
+        q->bytes -= (size_t)w;
+        q->sent += (uint64_t)w;
+
+        // retire fully written entries, remember the offset into a partial one
+        while (w > 0) {
+            sendq_entry_t* e = &q->ring[q->head];
+            size_t left = e->buf->len - e->off;
+            if ((size_t)w < left) { e->off += (uint32_t)w; break; }
+            w -= (ssize_t)left;
+            msg_buf_unref(e->buf);
+            q->head = (q->head + 1) & (q->cap - 1);
+            q->count--;
+        }
+        if (n == SENDQ_IOV) continue;   // more entries than one writev took
+        if (q->count > 0) return 0;     // short write: socket buffer is full
+    }
+    return 1;
+}
+
+#endif
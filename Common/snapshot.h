@@ -0,0 +1,104 @@
+// Recent snapshots of a client's area of interest, for delta-coded state.
+//
+// A snapshot_t is the picture one FRAME_STATE gives a client at a server
+// tick: the keys (entity slots) in its view, ascending, with positions.
+// Both ends keep their last SNAPSHOT_RING in a snapshot_ring_t (the server
+// the ones it sent, the client the ones it received) and the client acks
+// the newest one it holds. The server codes each state against the newest
+// snapshot the client acked (game_msg.h): a state dropped on the way only
+// makes the next delta larger, and a client with no acked snapshot left in
+// the ring gets a full one.
+//
+// Fill snapshot_ring_next() and commit it with snapshot_ring_push(); until
+// then it is scratch and overwrites nothing that can still be a baseline.
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SNAPSHOT_RING 32               // history kept, about 1 s at 30 Hz
+
+// Entries are read together, and a view is usually a handful of them: one
+// array of records keeps a snapshot on as few cache lines as possible.
+typedef struct {
+    int32_t key;
+    int32_t x, y;
+} snapshot_entry_t;
+
+typedef struct {
+    uint32_t tick;
+    int n;
+    int cap;
+    snapshot_entry_t* e;               // ascending by key
+} snapshot_t;
+
+typedef struct {
+    snapshot_t snaps[SNAPSHOT_RING + 1];   // one spare for the snapshot being built
+    uint32_t pushed;
+} snapshot_ring_t;
+
+static inline void snapshot_ring_init(snapshot_ring_t* r) {
+    memset(r, 0, sizeof *r);
+}
+
+// Forget every snapshot but keep their storage, for the next connection.
+static inline void snapshot_ring_reset(snapshot_ring_t* r) {
+    r->pushed = 0;
+}
+
+static inline void snapshot_ring_free(snapshot_ring_t* r) {
+    for (int i = 0; i <= SNAPSHOT_RING; i++) free(r->snaps[i].e);
+    snapshot_ring_init(r);
+}
+
+// Make room for n entries. Returns -1 if out of memory.
+static inline int snapshot_reserve(snapshot_t* s, int n) {
+    if (n <= s->cap) return 0;
+    int ncap = s->cap ? s->cap : 16;
+    while (ncap < n) ncap *= 2;
+    snapshot_entry_t* e = realloc(s->e, (size_t)ncap * sizeof *e);
+    if (!e) return -1;
+    s->e = e;
+    s->cap = ncap;
+    return 0;
+}
+
+// Make room for n entries in every slot, so snapshots of up to n never
+// grow later. Returns -1 if out of memory.
+static inline int snapshot_ring_reserve(snapshot_ring_t* r, int n) {
+    for (int i = 0; i <= SNAPSHOT_RING; i++)
+        if (snapshot_reserve(&r->snaps[i], n) < 0) return -1;
+    return 0;
+}
+
+static inline snapshot_t* snapshot_ring_next(snapshot_ring_t* r) {
+    return &r->snaps[r->pushed % (SNAPSHOT_RING + 1)];
+}
+
+static inline void snapshot_ring_push(snapshot_ring_t* r) {
+    r->pushed++;
+}
+
+// The newest snapshot, NULL if none.
+static inline snapshot_t* snapshot_ring_latest(snapshot_ring_t* r) {
+    return r->pushed ? &r->snaps[(r->pushed - 1) % (SNAPSHOT_RING + 1)] : NULL;
+}
+
+// The snapshot of `tick` if it is still kept, else NULL.
+static inline snapshot_t* snapshot_ring_find(snapshot_ring_t* r, uint32_t tick) {
+    uint32_t kept = r->pushed < SNAPSHOT_RING ? r->pushed : SNAPSHOT_RING;
+    for (uint32_t i = 1; i <= kept; i++) {
+        snapshot_t* s = &r->snaps[(r->pushed - i) % (SNAPSHOT_RING + 1)];
+        if (s->tick == tick) return s;
+    }
+    return NULL;
+}
+
+// Same entities at the same places (ticks aside).
+static inline int snapshot_same(const snapshot_t* a, const snapshot_t* b) {
+    return a->n == b->n && (a->n == 0 || memcmp(a->e, b->e, (size_t)a->n * sizeof *a->e) == 0);
+}
+
+#endif
@@ -0,0 +1,147 @@
+// Uniform spatial grid over the board for neighbourhood queries.
+//
+// The board is cut into square buckets of `bucket` cells. Every tracked
+// entity sits on the intrusive doubly linked list of the bucket holding its
+// cell, keyed by a small integer (the entity's slot, see entity_store.h),
+// so insert, remove and move are O(1) and a move within the same bucket
+// only updates the stored position. A query visits the buckets overlapping
+// the square of radius r around a cell and keeps entities inside it, so
+// its cost follows the local density, not the board size or entity count.
+//
+// Radius is Chebyshev (a square view): |dx| <= r and |dy| <= r.
+#ifndef SPATIAL_HASH_H
+#define SPATIAL_HASH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    int grid;          // board cells per side
+    int bucket;        // cells per bucket side
+    int nb;            // buckets per side
+    int* head;         // [nb * nb] first key in each bucket, -1 empty
+
+    // per key, [0, cap)
+    int* next;
+    int* prev;
+    int* where;        // bucket index, -1 when not tracked
+    int32_t* x;
+    int32_t* y;
+    int cap;
+    int count;         // keys tracked
+} spatial_hash_t;
+
+static inline int spatial_hash_init(spatial_hash_t* h, int grid, int bucket) {
+    memset(h, 0, sizeof *h);
+    h->grid = grid;
+    h->bucket = bucket > 0 ? bucket : 1;
+    h->nb = (grid + h->bucket - 1) / h->bucket;
+    h->head = malloc((size_t)h->nb * (size_t)h->nb * sizeof *h->head);
+    if (!h->head) return -1;
+    for (int i = 0; i < h->nb * h->nb; i++) h->head[i] = -1;
+    return 0;
+}
+
+static inline void spatial_hash_free(spatial_hash_t* h) {
+    free(h->head);
+    free(h->next);
+    free(h->prev);
+    free(h->where);
+    free(h->x);
+    free(h->y);
+    memset(h, 0, sizeof *h);
+}
+
+static inline int spatial_hash_reserve_(spatial_hash_t* h, int key) {
+    if (key < h->cap) return 0;
+    int ncap = h->cap ? h->cap : 64;
+    while (ncap <= key) ncap *= 2;
+    int* next = realloc(h->next, (size_t)ncap * sizeof *next);
+    if (next) h->next = next;
+    int* prev = realloc(h->prev, (size_t)ncap * sizeof *prev);
+    if (prev) h->prev = prev;
+    int* where = realloc(h->where, (size_t)ncap * sizeof *where);
+    if (where) h->where = where;
+    int32_t* x = realloc(h->x, (size_t)ncap * sizeof *x);
+    if (x) h->x = x;
+    int32_t* y = realloc(h->y, (size_t)ncap * sizeof *y);
+    if (y) h->y = y;
+    if (!next || !prev || !where || !x || !y) return -1;
+    for (int i = h->cap; i < ncap; i++) h->where[i] = -1;
+    h->cap = ncap;
+    return 0;
+}
+
+static inline int spatial_hash_bucket_of_(const spatial_hash_t* h, int x, int y) {
+    if (x < 0) x = 0;
+    if (y < 0) y = 0;
+    if (x >= h->grid) x = h->grid - 1;
+    if (y >= h->grid) y = h->grid - 1;
+    return (y / h->bucket) * h->nb + x / h->bucket;
+}
+
+static inline void spatial_hash_link_(spatial_hash_t* h, int key, int b) {
+    h->where[key] = b;
+    h->prev[key] = -1;
+    h->next[key] = h->head[b];
+    if (h->head[b] >= 0) h->prev[h->head[b]] = key;
+    h->head[b] = key;
+}
+
+static inline void spatial_hash_unlink_(spatial_hash_t* h, int key) {
+    int b = h->where[key];
+    if (h->prev[key] >= 0) h->next[h->prev[key]] = h->next[key];
+    else h->head[b] = h->next[key];
+    if (h->next[key] >= 0) h->prev[h->next[key]] = h->prev[key];
+    h->where[key] = -1;
+}
+
+// Start tracking key at (x, y). Returns -1 if out of memory.
+static inline int spatial_hash_insert(spatial_hash_t* h, int key, int x, int y) {
+    if (key < 0 || spatial_hash_reserve_(h, key) < 0) return -1;
+    if (h->where[key] >= 0) spatial_hash_unlink_(h, key);
+    else h->count++;
+    h->x[key] = x;
+    h->y[key] = y;
+    spatial_hash_link_(h, key, spatial_hash_bucket_of_(h, x, y));
+    return 0;
+}
+
+static inline void spatial_hash_remove(spatial_hash_t* h, int key) {
+    if (key < 0 || key >= h->cap || h->where[key] < 0) return;
+    spatial_hash_unlink_(h, key);
+    h->count--;
+}
+
+static inline void spatial_hash_move(spatial_hash_t* h, int key, int x, int y) {
+    if (key < 0 || key >= h->cap || h->where[key] < 0) return;
+    h->x[key] = x;
+    h->y[key] = y;
+    int b = spatial_hash_bucket_of_(h, x, y);
+    if (b == h->where[key]) return;
+    spatial_hash_unlink_(h, key);
+    spatial_hash_link_(h, key, b);
+}
+
+// Keys within radius r of (x, y), in no particular order. Writes at most
+// max keys to out and returns how many it wrote.
+static inline int spatial_hash_query(const spatial_hash_t* h, int x, int y, int r, int* out, int max) {
+    int bx0 = (x - r < 0 ? 0 : x - r) / h->bucket;
+    int by0 = (y - r < 0 ? 0 : y - r) / h->bucket;
+    int bx1 = (x + r >= h->grid ? h->grid - 1 : x + r) / h->bucket;
+    int by1 = (y + r >= h->grid ? h->grid - 1 : y + r) / h->bucket;
+    int n = 0;
+    for (int by = by0; by <= by1; by++) {
+        for (int bx = bx0; bx <= bx1; bx++) {
+            for (int k = h->head[by * h->nb + bx]; k >= 0; k = h->next[k]) {
+                if (abs(h->x[k] - x) > r || abs(h->y[k] - y) > r) continue;
+                if (n == max) return n;
+                out[n++] = k;
+            }
+        }
+    }
+    return n;
+}
+
+#endif
@@ -0,0 +1,300 @@
+// Work-stealing thread pool for short, independent tasks.
+//
+// Every worker owns a deque of tasks (Chase and Lev's, with the memory
+// orders of Le et al., "Correct and Efficient Work-Stealing for Weak
+// Memory Models"): the worker pushes and pops at the bottom with no lock,
+// and a worker with nothing left steals from the top of another's with one
+// compare-and-swap. Tasks submitted from outside the pool go to a shared
+// queue under a mutex. A worker takes its share of that queue at once,
+// runs the first and keeps the rest in its deque, where idle workers steal
+// them: a batch of uneven tasks ends up spread over every worker, and one
+// that runs long does not hold up the ones behind it. A worker that finds
+// nothing anywhere sleeps on a condition variable until the next
+// submission, so an idle pool costs no CPU.
+//
+// Tasks belong to the caller and nothing is allocated per task. The pool
+// does not touch a task_t once it has started running, so it may be
+// submitted again from then on (from inside its own run as well).
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "profile.h"
+#include "tick.h"
+
+#define TASK_DEQUE_SLOTS 1024          // per worker, a power of two
+
+typedef struct task {
+    void (*run)(void* arg);
+    void* arg;
+    struct task* next;                 // the pool's while queued
+} task_t;
+
+// Per worker; written by the worker only, read with task_pool_stats()
+typedef struct {
+    uint64_t ran;
+    uint64_t stolen;                   // tasks taken from another worker's deque
+    uint64_t shared;                   // tasks taken from the shared queue
+    uint64_t sleeps;
+    uint64_t busy_ns;                  // time spent running tasks
+} task_stats_t;
+
+struct task_pool;
+
+typedef struct {
+    _Alignas(64) int64_t top;          // thieves take from here...
+    _Alignas(64) int64_t bottom;       // ...the owner pushes and pops here
+    task_t** slots;
+    int64_t mask;
+
+    task_stats_t stats;
+    struct task_pool* pool;
+    int index;
+    uint32_t rng;                      // victim choice
+    pthread_t thread;
+} task_worker_t;
+
+typedef struct task_pool {
+    task_worker_t* workers;
+    int nworkers;
+    int started;                       // threads running
+
+    pthread_mutex_t lock;              // the shared queue and sleeping
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    task_t* head;
+    task_t** tail;
+    int64_t queued;                    // in the shared queue; written under lock, peeked without
+    int sleeping;
+    int stop;
+
+    int64_t pending;                   // submitted, not started; atomic
+    int64_t unfinished;                // submitted, not finished; atomic
+} task_pool_t;
+
+static __thread int task_worker_index_ = -1;
+
+// Index of the worker running the caller, -1 outside the pool: for state
+// kept per worker, such as scratch memory.
+static inline int task_pool_worker(void) {
+    return task_worker_index_;
+}
+
+static inline void task_count_(uint64_t* c, uint64_t n) {
+    __atomic_store_n(c, *c + n, __ATOMIC_RELAXED);
+}
+
+// Owner only. Returns -1 when the deque is full.
+static inline int task_deque_push_(task_worker_t* w, task_t* t) {
+    int64_t b = __atomic_load_n(&w->bottom, __ATOMIC_RELAXED);
+    int64_t top = __atomic_load_n(&w->top, __ATOMIC_ACQUIRE);
+    if (b - top > w->mask) return -1;
+    __atomic_store_n(&w->slots[b & w->mask], t, __ATOMIC_RELAXED);
+    __atomic_store_n(&w->bottom, b + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+// Owner only: the newest task, or NULL.
+static inline task_t* task_deque_pop_(task_worker_t* w) {
+    int64_t b = __atomic_load_n(&w->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&w->bottom, b, __ATOMIC_SEQ_CST);
+    int64_t top = __atomic_load_n(&w->top, __ATOMIC_SEQ_CST);
+    if (top > b) {
+        __atomic_store_n(&w->bottom, b + 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    task_t* t = __atomic_load_n(&w->slots[b & w->mask], __ATOMIC_RELAXED);
+    if (top == b) {
+        // the last one: race the thieves for it
+        if (!__atomic_compare_exchange_n(&w->top, &top, top + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) t = NULL;
+        __atomic_store_n(&w->bottom, b + 1, __ATOMIC_RELAXED);
+    }
+    return t;
+}
+
+// Any thread: the oldest task, or NULL if there is none or another thief
+// got it first.
+static inline task_t* task_deque_steal_(task_worker_t* w) {
+    int64_t top = __atomic_load_n(&w->top, __ATOMIC_SEQ_CST);
+    int64_t b = __atomic_load_n(&w->bottom, __ATOMIC_SEQ_CST);
+    if (top >= b) return NULL;
+    task_t* t = __atomic_load_n(&w->slots[top & w->mask], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&w->top, &top, top + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) return NULL;
+    return t;
+}
+
+// This worker's share of the shared queue: it runs the first, the rest go
+// in its deque for it or a thief.
+static inline task_t* task_take_shared_(task_pool_t* p, task_worker_t* w) {
+    if (__atomic_load_n(&p->queued, __ATOMIC_RELAXED) == 0) return NULL;
+    pthread_mutex_lock(&p->lock);
+    task_t* first = p->head;
+    if (first) {
+        int64_t share = (p->queued + p->nworkers - 1) / p->nworkers, n = 1;
+        task_t* t = first->next;
+        while (t && n < share && task_deque_push_(w, t) == 0) { t = t->next; n++; }
+        p->head = t;
+        if (!t) p->tail = &p->head;
+        __atomic_store_n(&p->queued, p->queued - n, __ATOMIC_RELAXED);
+        task_count_(&w->stats.shared, (uint64_t)n);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return first;
+}
+
+static inline task_t* task_steal_(task_pool_t* p, task_worker_t* w) {
+    w->rng = w->rng * 1664525u + 1013904223u;
+    int start = (int)((w->rng >> 16) % (uint32_t)p->nworkers);
+    for (int k = 0; k < p->nworkers; k++) {
+        task_worker_t* v = &p->workers[(start + k) % p->nworkers];
+        if (v == w) continue;
+        task_t* t = task_deque_steal_(v);
+        if (t) {
+            task_count_(&w->stats.stolen, 1);
+            return t;
+        }
+    }
+    return NULL;
+}
+
+static inline void task_run_(task_pool_t* p, task_worker_t* w, task_t* t) {
+    __atomic_fetch_sub(&p->pending, 1, __ATOMIC_RELAXED);
+    int64_t t0 = mono_ns();
+    t->run(t->arg);                    // t may be submitted again from here on
+    task_count_(&w->stats.busy_ns, (uint64_t)(mono_ns() - t0));
+    task_count_(&w->stats.ran, 1);
+    if (__atomic_sub_fetch(&p->unfinished, 1, __ATOMIC_ACQ_REL) == 0) {
+        pthread_mutex_lock(&p->lock);
+        pthread_cond_broadcast(&p->done);
+        pthread_mutex_unlock(&p->lock);
+    }
+}
+
+static inline void* task_worker_main_(void* arg) {
+    task_worker_t* w = arg;
+    task_pool_t* p = w->pool;
+    task_worker_index_ = w->index;
+    char name[32];
+    snprintf(name, sizeof name, "worker %d", w->index);
+    prof_thread_name(name);
+
+    for (;;) {
+        task_t* t = task_deque_pop_(w);
+        if (!t) t = task_take_shared_(p, w);
+        if (!t) t = task_steal_(p, w);
+        if (t) {
+            task_run_(p, w, t);
+            continue;
+        }
+
+        // Nothing found. Tasks still pending sit in a deque or are on their
+        // way to one: try again. Otherwise sleep until a submission, which
+        // raises pending under the same lock.
+        pthread_mutex_lock(&p->lock);
+        int idle = !p->head && __atomic_load_n(&p->pending, __ATOMIC_RELAXED) == 0;
+        if (idle && !p->stop) {
+            p->sleeping++;
+            task_count_(&w->stats.sleeps, 1);
+            pthread_cond_wait(&p->wake, &p->lock);
+            p->sleeping--;
+        }
+        int stop = p->stop;
+        pthread_mutex_unlock(&p->lock);
+        if (stop) break;
+        if (!idle) sched_yield();
+    }
+    return NULL;
+}
+
+// Start nworkers threads. Returns -1 on failure; task_pool_destroy()
+// then stops any that started.
+static inline int task_pool_init(task_pool_t* p, int nworkers) {
+    memset(p, 0, sizeof *p);
+    if (nworkers < 1) return -1;
+    p->tail = &p->head;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->wake, NULL);
+    pthread_cond_init(&p->done, NULL);
+    p->workers = aligned_alloc(64, (size_t)nworkers * sizeof *p->workers);
+    if (!p->workers) return -1;
+    memset(p->workers, 0, (size_t)nworkers * sizeof *p->workers);
+    p->nworkers = nworkers;
+    for (int i = 0; i < nworkers; i++) {
+        task_worker_t* w = &p->workers[i];
+        w->slots = calloc(TASK_DEQUE_SLOTS, sizeof *w->slots);
+        if (!w->slots) return -1;
+        w->mask = TASK_DEQUE_SLOTS - 1;
+        w->pool = p;
+        w->index = i;
+        w->rng = 2654435761u * (uint32_t)(i + 1);
+    }
+    for (int i = 0; i < nworkers; i++) {
+        if (pthread_create(&p->workers[i].thread, NULL, task_worker_main_, &p->workers[i]) != 0) return -1;
+        p->started++;
+    }
+    return 0;
+}
+
+// Queue a chain of tasks linked through next and ending in NULL; from any
+// thread, inside a task too.
+static inline void task_pool_submit(task_pool_t* p, task_t* first) {
+    if (!first) return;
+    int64_t n = 1;
+    task_t* last = first;
+    while (last->next) { last = last->next; n++; }
+
+    pthread_mutex_lock(&p->lock);
+    __atomic_fetch_add(&p->unfinished, n, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&p->pending, n, __ATOMIC_RELAXED);
+    *p->tail = first;
+    p->tail = &last->next;
+    __atomic_store_n(&p->queued, p->queued + n, __ATOMIC_RELAXED);
+    if (n >= p->sleeping) pthread_cond_broadcast(&p->wake);
+    else for (int64_t i = 0; i < n; i++) pthread_cond_signal(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+}
+
+// Block until every task submitted so far has finished.
+static inline void task_pool_wait(task_pool_t* p) {
+    pthread_mutex_lock(&p->lock);
+    while (__atomic_load_n(&p->unfinished, __ATOMIC_ACQUIRE) > 0) pthread_cond_wait(&p->done, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+}
+
+// Counters of one worker, or of all of them with worker -1; from any thread.
+static inline void task_pool_stats(const task_pool_t* p, int worker, task_stats_t* out) {
+    memset(out, 0, sizeof *out);
+    for (int i = 0; i < p->nworkers; i++) {
+        if (worker >= 0 && i != worker) continue;
+        const task_stats_t* s = &p->workers[i].stats;
+        out->ran += __atomic_load_n(&s->ran, __ATOMIC_RELAXED);
+        out->stolen += __atomic_load_n(&s->stolen, __ATOMIC_RELAXED);
+        out->shared += __atomic_load_n(&s->shared, __ATOMIC_RELAXED);
+        out->sleeps += __atomic_load_n(&s->sleeps, __ATOMIC_RELAXED);
+        out->busy_ns += __atomic_load_n(&s->busy_ns, __ATOMIC_RELAXED);
+    }
+}
+
+// Finish what was submitted, then stop the workers.
+static inline void task_pool_destroy(task_pool_t* p) {
+    task_pool_wait(p);
+    pthread_mutex_lock(&p->lock);
+    p->stop = 1;
+    pthread_cond_broadcast(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+    for (int i = 0; i < p->started; i++) pthread_join(p->workers[i].thread, NULL);
+    for (int i = 0; p->workers && i < p->nworkers; i++) free(p->workers[i].slots);
+    free(p->workers);
+    pthread_cond_destroy(&p->done);
+    pthread_cond_destroy(&p->wake);
+    pthread_mutex_destroy(&p->lock);
+    memset(p, 0, sizeof *p);
+}
+
+#endif
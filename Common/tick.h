@@ -0,0 +1,90 @@
+// Fixed-rate tick scheduler on a monotonic clock.
+//
+// The ticker is a CLOCK_MONOTONIC timerfd, so it can sit in the same epoll
+// set as the sockets and wake the loop with sub-millisecond accuracy
+// instead of relying on epoll_wait's millisecond timeout. Reading the fd
+// yields how many periods have elapsed; tick_timer_due() turns that into
+// the number of ticks to simulate now, catching up after a slow tick but
+// never by more than max_catchup (the rest are skipped and counted).
+#ifndef TICK_H
+#define TICK_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+static inline int64_t mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+typedef struct {
+    int fd;
+    int hz;
+    int max_catchup;      // most ticks run back-to-back after a stall
+    int64_t period_ns;
+    int64_t start_ns;     // time of tick 0
+    uint64_t tick;        // ticks simulated so far
+    uint64_t overruns;    // ticks whose work took longer than period_ns
+    uint64_t skipped;     // ticks dropped because we fell too far behind
+    int64_t max_late_ns;  // worst wakeup delay past the scheduled time
+} tick_timer_t;
+
+static inline int tick_timer_init(tick_timer_t* t, int hz, int max_catchup) {
+    t->hz = hz;
+    t->max_catchup = max_catchup > 0 ? max_catchup : 1;
+    t->period_ns = 1000000000LL / hz;
+    t->tick = t->overruns = t->skipped = 0;
+    t->max_late_ns = 0;
+
+    t->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (t->fd < 0) { perror("timerfd_create"); return -1; }
+
+    t->start_ns = mono_ns();
+    int64_t first = t->start_ns + t->period_ns;
+    struct itimerspec its = {
+        .it_interval = { t->period_ns / 1000000000LL, t->period_ns % 1000000000LL },
+        .it_value    = { first / 1000000000LL, first % 1000000000LL },
+    };
+    if (timerfd_settime(t->fd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+        perror("timerfd_settime");
+        close(t->fd);
+        t->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+// Consume the timer and return how many ticks to run now (0 if none).
+static inline int tick_timer_due(tick_timer_t* t) {
+    uint64_t expirations = 0;
+    ssize_t n = read(t->fd, &expirations, sizeof expirations);
+    if (n != (ssize_t)sizeof expirations) return 0;
+
+    int64_t late = mono_ns() - (t->start_ns + (int64_t)(t->tick + expirations) * t->period_ns);
+    if (late > t->max_late_ns) t->max_late_ns = late;
+
+    if (expirations > (uint64_t)t->max_catchup) {
+        t->skipped += expirations - (uint64_t)t->max_catchup;
+        t->tick += expirations - (uint64_t)t->max_catchup;  // keep tick numbers on the wall clock
+        expirations = (uint64_t)t->max_catchup;
+    }
+    return (int)expirations;
+}
+
+// Call after each simulated tick with the mono_ns() taken before it.
+static inline void tick_timer_end(tick_timer_t* t, int64_t began_ns) {
+    t->tick++;
+    if (mono_ns() - began_ns > t->period_ns) t->overruns++;
+}
+
+static inline void tick_timer_close(tick_timer_t* t) {
+    if (t->fd >= 0) close(t->fd);
+    t->fd = -1;
+}
+
+#endif
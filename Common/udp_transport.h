@@ -0,0 +1,568 @@
+// UDP transport with a small reliability/sequencing layer.
+//
+// Runs beside the TCP path for traffic where head-of-line blocking hurts:
+// a lost state update is simply superseded by the next one instead of
+// stalling everything behind it.
+//
+// Datagram layout (network byte order):
+//
+//   u8 kind | u32 salt | u16 seq | u16 ack | u32 ack_bits | messages...
+//   message: u8 channel | u8 type | u16 len | [u16 rel_seq] | payload
+//
+// `salt` is picked by the client in CONNECT and echoed by every packet of
+// the connection, so stray or spoofed datagrams from the same address are
+// ignored. `ack` is the newest packet seq seen from the peer and bit i of
+// `ack_bits` acknowledges ack-1-i, so every packet acks the last 33.
+//
+// Channels:
+//   UDP_CH_SEQUENCED  unreliable; anything older than the newest packet
+//                     already delivered on this channel is dropped
+//   UDP_CH_RELIABLE   resent every UDP_RESEND_NS until its packet is acked,
+//                     delivered exactly once and in order (rel_seq)
+//
+// Datagrams are received with recvmmsg() and sent with sendmmsg() in
+// batches of UDP_BATCH, so a tick's worth of traffic is one syscall each
+// way. Message `type` values are the FRAME_* ids from frame.h.
+//
+// Reliable payloads, in flight or waiting for an earlier one, are held in
+// msg_buf_t buffers (sendq.h) from the endpoint's `msgs` pool if it is set,
+// the heap if not, so a connection slot stays a few KB however large its
+// window is.
+//
+// recvmmsg()/sendmmsg() need _GNU_SOURCE defined before the first include.
+#ifndef UDP_TRANSPORT_H
+#define UDP_TRANSPORT_H
+
+#ifndef _GNU_SOURCE
+#error "define _GNU_SOURCE before any #include to use udp_transport.h"
+#endif
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "net_loop.h"
+#include "sendq.h"
+
+#define UDP_MTU         1200
+#define UDP_HDR_SIZE    13
+#define UDP_MAX_MSG     (UDP_MTU - UDP_HDR_SIZE - 6)
+#define UDP_BATCH       64
+#define UDP_MAX_CONNS   1024
+#define UDP_REL_WINDOW  64          // reliable messages in flight per peer
+#define UDP_SEQ_QUEUE   (4 * UDP_MTU)
+#define UDP_RESEND_NS   100000000LL // 100 ms
+#define UDP_TIMEOUT_NS  5000000000LL
+
+enum { UDP_PKT_CONNECT = 1, UDP_PKT_ACCEPT = 2, UDP_PKT_DATA = 3, UDP_PKT_DISCONNECT = 4 };
+enum { UDP_CH_SEQUENCED = 0, UDP_CH_RELIABLE = 1 };
+enum { UDP_FREE = 0, UDP_CONNECTING, UDP_CONNECTED };
+
+typedef struct {
+    msg_buf_t* buf;         // the payload, buf->len bytes; NULL = slot free
+    uint16_t rel_seq;
+    uint8_t type;
+    uint16_t last_pkt;      // packet seq it was last sent in
+    int64_t last_sent;      // 0 = not sent yet
+} udp_rel_msg_t;
+
+typedef struct {
+    int state;
+    struct sockaddr_in addr;
+    uint32_t salt;
+    int64_t last_recv;
+    int64_t last_send;
+
+    uint16_t seq;           // next outgoing packet seq
+    uint16_t remote_seq;    // newest packet seq received
+    uint32_t recv_bits;     // bit i: remote_seq-1-i received
+    int have_remote;
+    int ack_pending;
+
+    int have_seq_in;
+    uint16_t seq_in_last;   // newest packet that delivered sequenced data
+
+    uint16_t rel_out_next;  // rel_seq for the next reliable message
+    udp_rel_msg_t rel_out[UDP_REL_WINDOW];
+    int rel_out_count;
+
+    uint16_t rel_in_next;   // next rel_seq to deliver
+    udp_rel_msg_t rel_in[UDP_REL_WINDOW];  // out-of-order arrivals
+
+    uint8_t seq_queue[UDP_SEQ_QUEUE];      // encoded sequenced messages
+    int seq_len;
+} udp_conn_t;
+
+struct udp_endpoint;
+typedef struct {
+    void (*connected)(struct udp_endpoint* ep, int conn, void* user);
+    void (*message)(struct udp_endpoint* ep, int conn, uint8_t type,
+                    const uint8_t* payload, uint16_t len, void* user);
+    void (*disconnected)(struct udp_endpoint* ep, int conn, void* user);
+    void* user;
+} udp_handler_t;
+
+typedef struct udp_endpoint {
+    int fd;
+    int is_server;
+
+    udp_conn_t* conns;          // max_conns slots
+    msg_pool_t* msgs;           // optional, set after udp_open(): reliable payloads come from here
+    int max_conns;              // UDP_MAX_CONNS for servers, 1 for clients
+    int active[UDP_MAX_CONNS];  // dense list of live slots
+    int nactive;
+    int hash[2 * UDP_MAX_CONNS];// address -> slot, -1 empty, -2 deleted
+
+    // batched I/O
+    struct mmsghdr rx_msgs[UDP_BATCH];
+    struct iovec rx_iov[UDP_BATCH];
+    struct sockaddr_in rx_addr[UDP_BATCH];
+    uint8_t rx_buf[UDP_BATCH][UDP_MTU];
+
+    struct mmsghdr tx_msgs[UDP_BATCH];
+    struct iovec tx_iov[UDP_BATCH];
+    struct sockaddr_in tx_addr[UDP_BATCH];
+    uint8_t tx_buf[UDP_BATCH][UDP_MTU];
+    int ntx;
+
+    uint64_t packets_in, packets_out, dropped_in;
+} udp_endpoint_t;
+
+// --- helpers ---
+
+static inline int udp_seq_newer(uint16_t a, uint16_t b) {
+    return (int16_t)(a - b) > 0;
+}
+
+static inline void udp_put16(uint8_t* p, uint16_t v) { v = htons(v); memcpy(p, &v, 2); }
+static inline void udp_put32(uint8_t* p, uint32_t v) { v = htonl(v); memcpy(p, &v, 4); }
+static inline uint16_t udp_get16(const uint8_t* p) { uint16_t v; memcpy(&v, p, 2); return ntohs(v); }
+static inline uint32_t udp_get32(const uint8_t* p) { uint32_t v; memcpy(&v, p, 4); return ntohl(v); }
+
+static inline unsigned udp_addr_hash(const struct sockaddr_in* a) {
+    uint32_t h = a->sin_addr.s_addr * 2654435761u ^ (uint32_t)a->sin_port * 40503u;
+    return (h ^ (h >> 15)) & (2 * UDP_MAX_CONNS - 1);
+}
+
+static inline int udp_addr_eq(const struct sockaddr_in* a, const struct sockaddr_in* b) {
+    return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
+static inline int udp_find(udp_endpoint_t* ep, const struct sockaddr_in* a) {
+    unsigned h = udp_addr_hash(a);
+    for (int i = 0; i < 2 * UDP_MAX_CONNS; i++, h = (h + 1) & (2 * UDP_MAX_CONNS - 1)) {
+        int s = ep->hash[h];
+        if (s == -1) return -1;
+        if (s >= 0 && udp_addr_eq(&ep->conns[s].addr, a)) return s;
+    }
+    return -1;
+}
+
+// --- endpoint ---
+
+// Bind a UDP socket on `port` (0 = any, for clients). Returns 0 or -1.
+static inline int udp_open(udp_endpoint_t* ep, int port, int is_server) {
+    memset(ep, 0, sizeof *ep);
+    for (int i = 0; i < 2 * UDP_MAX_CONNS; i++) ep->hash[i] = -1;
+    ep->is_server = is_server;
+    ep->max_conns = is_server ? UDP_MAX_CONNS : 1;
+    ep->conns = calloc((size_t)ep->max_conns, sizeof *ep->conns);
+    if (!ep->conns) return -1;
+
+    ep->fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (ep->fd < 0) { perror("socket"); return -1; }
+    if (is_server) {
+        // lets sharded servers bind one UDP socket per IO thread
+        int opt = 1;
+        setsockopt(ep->fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof opt);
+    }
+    struct sockaddr_in a = {0};
+    a.sin_family = AF_INET;
+    a.sin_addr.s_addr = htonl(INADDR_ANY);
+    a.sin_port = htons(port);
+    if (bind(ep->fd, (struct sockaddr*)&a, sizeof a) < 0) { perror("bind udp"); close(ep->fd); return -1; }
+    net_set_nonblocking(ep->fd);
+
+    for (int i = 0; i < UDP_BATCH; i++) {
+        ep->rx_iov[i].iov_base = ep->rx_buf[i];
+        ep->rx_iov[i].iov_len = UDP_MTU;
+        ep->tx_iov[i].iov_base = ep->tx_buf[i];
+    }
+    return 0;
+}
+
+// Give back a connection's reliable payloads
+static inline void udp_conn_clear_(udp_conn_t* c) {
+    for (int i = 0; i < UDP_REL_WINDOW; i++) {
+        msg_buf_unref(c->rel_out[i].buf);
+        msg_buf_unref(c->rel_in[i].buf);
+        c->rel_out[i].buf = c->rel_in[i].buf = NULL;
+    }
+    c->rel_out_count = 0;
+}
+
+// Before the pool in ep->msgs is freed, if there is one.
+static inline void udp_close(udp_endpoint_t* ep) {
+    if (ep->fd >= 0) close(ep->fd);
+    for (int i = 0; ep->conns && i < ep->nactive; i++) udp_conn_clear_(&ep->conns[ep->active[i]]);
+    free(ep->conns);
+    ep->conns = NULL;
+    ep->fd = -1;
+}
+
+// Send everything queued with one sendmmsg() per UDP_BATCH datagrams.
+static inline void udp_flush_tx(udp_endpoint_t* ep) {
+    int off = 0;
+    while (off < ep->ntx) {
+        int n = sendmmsg(ep->fd, ep->tx_msgs + off, (unsigned)(ep->ntx - off), 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;  // EAGAIN: the kernel buffer is full; drop like the network would
+        }
+        ep->packets_out += (uint64_t)n;
+        off += n;
+    }
+    ep->ntx = 0;
+}
+
+// Claim the next outgoing datagram slot for `to`.
+static inline uint8_t* udp_tx_slot(udp_endpoint_t* ep, const struct sockaddr_in* to) {
+    if (ep->ntx == UDP_BATCH) udp_flush_tx(ep);
+    int i = ep->ntx;
+    ep->tx_addr[i] = *to;
+    memset(&ep->tx_msgs[i], 0, sizeof ep->tx_msgs[i]);
+    ep->tx_msgs[i].msg_hdr.msg_name = &ep->tx_addr[i];
+    ep->tx_msgs[i].msg_hdr.msg_namelen = sizeof ep->tx_addr[i];
+    ep->tx_msgs[i].msg_hdr.msg_iov = &ep->tx_iov[i];
+    ep->tx_msgs[i].msg_hdr.msg_iovlen = 1;
+    return ep->tx_buf[i];
+}
+
+static inline void udp_tx_commit(udp_endpoint_t* ep, size_t len) {
+    ep->tx_iov[ep->ntx].iov_len = len;
+    ep->ntx++;
+}
+
+static inline size_t udp_write_header(udp_conn_t* c, uint8_t* p, uint8_t kind) {
+    p[0] = kind;
+    udp_put32(p + 1, c->salt);
+    udp_put16(p + 5, c->seq);
+    udp_put16(p + 7, c->remote_seq);
+    udp_put32(p + 9, c->recv_bits);
+    return UDP_HDR_SIZE;
+}
+
+static inline void udp_send_control(udp_endpoint_t* ep, udp_conn_t* c, uint8_t kind) {
+    uint8_t* p = udp_tx_slot(ep, &c->addr);
+    udp_tx_commit(ep, udp_write_header(c, p, kind));
+}
+
+static inline int udp_alloc(udp_endpoint_t* ep, const struct sockaddr_in* a) {
+    if (ep->nactive == ep->max_conns) return -1;
+    int s = 0;
+    while (ep->conns[s].state != UDP_FREE) s++;   // nactive < max, so one is free
+    udp_conn_t* c = &ep->conns[s];
+    memset(c, 0, sizeof *c);
+    c->addr = *a;
+
+    unsigned h = udp_addr_hash(a);
+    while (ep->hash[h] >= 0) h = (h + 1) & (2 * UDP_MAX_CONNS - 1);
+    ep->hash[h] = s;
+    ep->active[ep->nactive++] = s;
+    return s;
+}
+
+static inline void udp_release(udp_endpoint_t* ep, int s) {
+    unsigned h = udp_addr_hash(&ep->conns[s].addr);
+    while (ep->hash[h] != s) h = (h + 1) & (2 * UDP_MAX_CONNS - 1);
+    ep->hash[h] = -2;
+    for (int i = 0; i < ep->nactive; i++)
+        if (ep->active[i] == s) { ep->active[i] = ep->active[--ep->nactive]; break; }
+    udp_conn_clear_(&ep->conns[s]);
+    ep->conns[s].state = UDP_FREE;
+}
+
+// Client side: start the handshake. Returns the connection slot.
+static inline int udp_connect(udp_endpoint_t* ep, const struct sockaddr_in* server, uint32_t salt) {
+    int s = udp_alloc(ep, server);
+    if (s < 0) return -1;
+    udp_conn_t* c = &ep->conns[s];
+    c->state = UDP_CONNECTING;
+    c->salt = salt ? salt : 1;
+    c->last_recv = 0;
+    return s;
+}
+
+static inline void udp_disconnect(udp_endpoint_t* ep, int s) {
+    udp_conn_t* c = &ep->conns[s];
+    if (c->state == UDP_CONNECTED) {
+        udp_send_control(ep, c, UDP_PKT_DISCONNECT);
+        udp_flush_tx(ep);
+    }
+    udp_release(ep, s);
+}
+
+// Queue a message. Returns 0, or -1 if the reliable window or the
+// sequenced queue is full (caller may retry next tick) or out of memory.
+static inline int udp_send(udp_endpoint_t* ep, int s, int channel, uint8_t type,
+                           const void* payload, uint16_t len) {
+    udp_conn_t* c = &ep->conns[s];
+    if (len > UDP_MAX_MSG) return -1;
+
+    if (channel == UDP_CH_RELIABLE) {
+        // the slot is busy while the message UDP_REL_WINDOW back is unacked
+        udp_rel_msg_t* m = &c->rel_out[c->rel_out_next % UDP_REL_WINDOW];
+        if (m->buf) return -1;
+        if (!(m->buf = msg_buf_new(ep->msgs, len))) return -1;
+        memcpy(m->buf->data, payload, len);
+        m->buf->len = len;
+        m->rel_seq = c->rel_out_next++;
+        m->type = type;
+        m->last_sent = 0;
+        c->rel_out_count++;
+        return 0;
+    }
+
+    if (c->seq_len + 4 + len > UDP_SEQ_QUEUE) return -1;
+    uint8_t* p = c->seq_queue + c->seq_len;
+    p[0] = UDP_CH_SEQUENCED;
+    p[1] = type;
+    udp_put16(p + 2, len);
+    memcpy(p + 4, payload, len);
+    c->seq_len += 4 + len;
+    return 0;
+}
+
+// Process the peer's view of our packets: retire acked reliable messages.
+static inline void udp_process_acks(udp_conn_t* c, uint16_t ack, uint32_t bits) {
+    for (int i = 0; i < UDP_REL_WINDOW && c->rel_out_count > 0; i++) {
+        udp_rel_msg_t* m = &c->rel_out[i];
+        if (!m->buf || m->last_sent == 0) continue;
+        uint16_t d = (uint16_t)(ack - m->last_pkt);
+        if (d == 0 || (d <= 32 && (bits & (1u << (d - 1))))) {
+            msg_buf_unref(m->buf);
+            m->buf = NULL;
+            c->rel_out_count--;
+        }
+    }
+}
+
+// Record an incoming packet seq. Returns 0 for a duplicate.
+static inline int udp_note_received(udp_conn_t* c, uint16_t seq) {
+    if (!c->have_remote) {
+        c->have_remote = 1;
+        c->remote_seq = seq;
+        c->recv_bits = 0;
+        return 1;
+    }
+    if (udp_seq_newer(seq, c->remote_seq)) {
+        uint16_t d = (uint16_t)(seq - c->remote_seq);
+        c->recv_bits = d > 32 ? 0 : ((c->recv_bits << 1) | 1u) << (d - 1);
+        c->remote_seq = seq;
+        return 1;
+    }
+    uint16_t d = (uint16_t)(c->remote_seq - seq);
+    if (d == 0 || d > 32) return 0;  // duplicate, or too old to tell
+    uint32_t bit = 1u << (d - 1);
+    if (c->recv_bits & bit) return 0;
+    c->recv_bits |= bit;
+    return 1;
+}
+
+static inline void udp_deliver_reliable(udp_endpoint_t* ep, int s, const udp_handler_t* h) {
+    udp_conn_t* c = &ep->conns[s];
+    for (;;) {
+        udp_rel_msg_t* m = &c->rel_in[c->rel_in_next % UDP_REL_WINDOW];
+        if (!m->buf || m->rel_seq != c->rel_in_next) break;
+        msg_buf_t* b = m->buf;  // out of the slot: the handler may release the connection
+        m->buf = NULL;
+        c->rel_in_next++;
+        if (h->message) h->message(ep, s, m->type, b->data, (uint16_t)b->len, h->user);
+        msg_buf_unref(b);
+        if (c->state == UDP_FREE) return;  // handler disconnected us
+    }
+}
+
+static inline void udp_handle_data(udp_endpoint_t* ep, int s, const uint8_t* p, size_t len,
+                                   uint16_t seq, const udp_handler_t* h) {
+    udp_conn_t* c = &ep->conns[s];
+    int fresh_seq = !c->have_seq_in || udp_seq_newer(seq, c->seq_in_last);
+    int delivered_seq = 0;
+
+    while (len >= 4 && c->state != UDP_FREE) {
+        uint8_t ch = p[0], type = p[1];
+        uint16_t mlen = udp_get16(p + 2);
+        size_t hdr = ch == UDP_CH_RELIABLE ? 6 : 4;
+        if (len < hdr + mlen || mlen > UDP_MAX_MSG) return;  // truncated
+        if (ch == UDP_CH_RELIABLE) {
+            uint16_t rs = udp_get16(p + 4);
+            uint16_t ahead = (uint16_t)(rs - c->rel_in_next);
+            if (ahead < UDP_REL_WINDOW) {
+                udp_rel_msg_t* m = &c->rel_in[rs % UDP_REL_WINDOW];
+                if (!m->buf && (m->buf = msg_buf_new(ep->msgs, mlen))) {   // else the resend will do
+                    memcpy(m->buf->data, p + hdr, mlen);
+                    m->buf->len = mlen;
+                    m->rel_seq = rs;
+                    m->type = type;
+                }
+            }
+        } else if (fresh_seq) {
+            delivered_seq = 1;
+            if (h->message) h->message(ep, s, type, p + hdr, mlen, h->user);
+        }
+        p += hdr + mlen;
+        len -= hdr + mlen;
+    }
+    if (c->state == UDP_FREE) return;
+    if (delivered_seq) { c->have_seq_in = 1; c->seq_in_last = seq; }
+    udp_deliver_reliable(ep, s, h);
+}
+
+// Drain the socket with recvmmsg() and dispatch every datagram.
+static inline void udp_poll(udp_endpoint_t* ep, int64_t now, const udp_handler_t* h) {
+    for (;;) {
+        for (int i = 0; i < UDP_BATCH; i++) {
+            memset(&ep->rx_msgs[i].msg_hdr, 0, sizeof ep->rx_msgs[i].msg_hdr);
+            ep->rx_msgs[i].msg_hdr.msg_name = &ep->rx_addr[i];
+            ep->rx_msgs[i].msg_hdr.msg_namelen = sizeof ep->rx_addr[i];
+            ep->rx_msgs[i].msg_hdr.msg_iov = &ep->rx_iov[i];
+            ep->rx_msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        int n = recvmmsg(ep->fd, ep->rx_msgs, UDP_BATCH, MSG_DONTWAIT, NULL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        ep->packets_in += (uint64_t)n;
+
+        for (int i = 0; i < n; i++) {
+            const uint8_t* p = ep->rx_buf[i];
+            size_t len = ep->rx_msgs[i].msg_len;
+            if (len < UDP_HDR_SIZE) { ep->dropped_in++; continue; }
+
+            uint8_t kind = p[0];
+            uint32_t salt = udp_get32(p + 1);
+            uint16_t seq = udp_get16(p + 5);
+            int s = udp_find(ep, &ep->rx_addr[i]);
+
+            if (s < 0) {
+                if (!ep->is_server || kind != UDP_PKT_CONNECT) { ep->dropped_in++; continue; }
+                s = udp_alloc(ep, &ep->rx_addr[i]);
+                if (s < 0) { ep->dropped_in++; continue; }
+                ep->conns[s].state = UDP_CONNECTED;
+                ep->conns[s].salt = salt;
+                ep->conns[s].last_recv = now;
+                if (h->connected) h->connected(ep, s, h->user);
+            }
+            udp_conn_t* c = &ep->conns[s];
+            if (c->salt != salt) { ep->dropped_in++; continue; }
+            c->last_recv = now;
+
+            if (kind == UDP_PKT_CONNECT) {
+                udp_send_control(ep, c, UDP_PKT_ACCEPT);  // (re)confirm
+                continue;
+            }
+            if (kind == UDP_PKT_DISCONNECT) {
+                if (h->disconnected) h->disconnected(ep, s, h->user);
+                udp_release(ep, s);
+                continue;
+            }
+            if (kind == UDP_PKT_ACCEPT && c->state == UDP_CONNECTING) {
+                c->state = UDP_CONNECTED;
+                if (h->connected) h->connected(ep, s, h->user);
+                continue;
+            }
+            if (kind != UDP_PKT_DATA || c->state != UDP_CONNECTED) continue;
+
+            if (!udp_note_received(c, seq)) continue;
+            // only packets carrying messages need an ack; acking bare acks
+            // would have two peers bounce empty packets back and forth
+            if (len > UDP_HDR_SIZE) c->ack_pending = 1;
+            udp_process_acks(c, udp_get16(p + 7), udp_get32(p + 9));
+            udp_handle_data(ep, s, p + UDP_HDR_SIZE, len - UDP_HDR_SIZE, seq, h);
+        }
+        if (n < UDP_BATCH) return;
+    }
+}
+
+// Build this tick's datagrams for one peer: due reliable messages first,
+// then queued sequenced messages, then a bare ack if nothing else went.
+static inline void udp_write_conn(udp_endpoint_t* ep, udp_conn_t* c, int64_t now) {
+    int rel_due = 0;
+    for (int i = 0; i < UDP_REL_WINDOW; i++) {
+        udp_rel_msg_t* m = &c->rel_out[i];
+        if (m->buf && (m->last_sent == 0 || now - m->last_sent >= UDP_RESEND_NS)) rel_due++;
+    }
+    if (!rel_due && c->seq_len == 0 && !c->ack_pending) return;
+
+    int seq_off = 0;
+    // oldest reliable first so in-order delivery isn't held up
+    uint16_t first = (uint16_t)(c->rel_out_next - UDP_REL_WINDOW);
+    int ri = 0;
+    do {
+        uint8_t* p = udp_tx_slot(ep, &c->addr);
+        size_t len = udp_write_header(c, p, UDP_PKT_DATA);
+
+        for (; ri < UDP_REL_WINDOW && rel_due > 0; ri++) {
+            udp_rel_msg_t* m = &c->rel_out[(uint16_t)(first + ri) % UDP_REL_WINDOW];
+            if (!m->buf || !(m->last_sent == 0 || now - m->last_sent >= UDP_RESEND_NS)) continue;
+            if (len + 6 + m->buf->len > UDP_MTU) break;
+            p[len] = UDP_CH_RELIABLE;
+            p[len + 1] = m->type;
+            udp_put16(p + len + 2, (uint16_t)m->buf->len);
+            udp_put16(p + len + 4, m->rel_seq);
+            memcpy(p + len + 6, m->buf->data, m->buf->len);
+            len += 6 + m->buf->len;
+            m->last_sent = now;
+            m->last_pkt = c->seq;
+            rel_due--;
+        }
+        while (seq_off < c->seq_len) {
+            size_t mlen = 4 + udp_get16(c->seq_queue + seq_off + 2);
+            if (len + mlen > UDP_MTU) break;
+            memcpy(p + len, c->seq_queue + seq_off, mlen);
+            len += mlen;
+            seq_off += (int)mlen;
+        }
+
+        udp_tx_commit(ep, len);
+        c->seq++;
+        c->last_send = now;
+    } while (rel_due > 0 || seq_off < c->seq_len);
+
+    c->seq_len = 0;
+    c->ack_pending = 0;
+}
+
+// Per-tick housekeeping: handshake retries, timeouts, then one batched
+// send of everything queued for every peer.
+static inline void udp_update(udp_endpoint_t* ep, int64_t now, const udp_handler_t* h) {
+    for (int i = 0; i < ep->nactive; ) {
+        int s = ep->active[i];
+        udp_conn_t* c = &ep->conns[s];
+        if (c->last_recv && now - c->last_recv > UDP_TIMEOUT_NS) {
+            if (h->disconnected) h->disconnected(ep, s, h->user);
+            udp_release(ep, s);   // swap-removes active[i]
+            continue;
+        }
+        if (c->state == UDP_CONNECTING) {
+            if (now - c->last_send >= UDP_RESEND_NS) {
+                udp_send_control(ep, c, UDP_PKT_CONNECT);
+                c->last_send = now;
+                if (!c->last_recv) c->last_recv = now;  // start the timeout clock
+            }
+        } else {
+            // keepalive so idle peers don't time out
+            if (now - c->last_send > UDP_TIMEOUT_NS / 4) c->ack_pending = 1;
+            udp_write_conn(ep, c, now);
+        }
+        i++;
+    }
+    udp_flush_tx(ep);
+}
+
+#endif
@@ -0,0 +1,331 @@
+// Chunked tile world, read from a memory-mapped world file.
+//
+// The world is a width x height grid of one-byte tiles cut into square
+// chunks (a power of two cells per side, 32 by default). The file is
+//
+//   header (WORLD_HDR_SIZE bytes, little-endian):
+//     "GWLD" | u32 version | u32 width | u32 height | u32 chunk |
+//     u32 chunks_x | u32 chunks_y | u32 reserved | u64 index offset |
+//     u64 data offset | 16 reserved bytes
+//   index: u64 per chunk, row-major by chunk
+//   data:  chunk * chunk tiles per stored chunk, row-major within it
+//
+// An index entry below 256 is a uniform chunk of that tile and takes no
+// data, so open floor costs eight bytes per chunk; anything else is the
+// file offset of the chunk's tiles.
+//
+// world_open() maps the file and reads only the header, so it costs the
+// same for any world size, and the OS pages the file in and out as it
+// likes, so a world may be larger than RAM. Tiles are read through a cache
+// of decoded chunks bounded by a memory budget: the first access to a
+// chunk copies it out of the mapping into a cache slot, later ones hit the
+// slot, and when the cache is full the least recently used chunk is
+// evicted. A chunk id -> slot hash table finds slots, the LRU order is an
+// intrusive list over them, and the last chunk touched is remembered so
+// runs of tiles in one chunk skip the lookup.
+//
+// Pointers from world_chunk() are valid until the next call that misses.
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define WORLD_MAGIC "GWLD"
+#define WORLD_VERSION 1
+#define WORLD_HDR_SIZE 64
+#define WORLD_DEFAULT_CHUNK 32
+#define WORLD_UNIFORM_MAX 256          // index entries below this are uniform chunks
+
+enum {
+    TILE_FLOOR = 0,
+    TILE_WALL  = 1,
+    TILE_WATER = 2,
+};
+
+// Tiles a player cannot stand on
+static inline int tile_blocks(int tile) {
+    return tile == TILE_WALL || tile == TILE_WATER;
+}
+
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+    uint32_t chunk;
+    uint32_t chunks_x;
+    uint32_t chunks_y;
+    uint64_t index_off;
+    uint64_t data_off;
+} world_hdr_t;
+
+typedef struct {
+    int fd;
+    const uint8_t* map;
+    size_t map_len;
+    world_hdr_t hdr;
+    int shift;                 // log2(chunk)
+    size_t chunk_bytes;
+
+    // chunk cache, [0, nslots)
+    uint8_t* tiles;            // nslots * chunk_bytes
+    int64_t* slot_chunk;       // chunk id held, -1 free
+    int* prev;                 // LRU list, most recent at lru_head
+    int* next;
+    int lru_head, lru_tail;
+    int nslots;
+    int used;
+
+    // chunk id -> slot, open addressing with linear probing
+    int* table;                // -1 empty
+    int table_mask;
+
+    int64_t last_chunk;        // memo of the last lookup
+    const uint8_t* last_tiles;
+
+    uint64_t hits, misses, evictions, bad_chunks;
+} world_t;
+
+static inline uint32_t world_le32_(const uint8_t* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline uint64_t world_le64_(const uint8_t* p) {
+    return (uint64_t)world_le32_(p) | (uint64_t)world_le32_(p + 4) << 32;
+}
+
+static inline void world_put32_(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static inline void world_put64_(uint8_t* p, uint64_t v) {
+    world_put32_(p, (uint32_t)v);
+    world_put32_(p + 4, (uint32_t)(v >> 32));
+}
+
+// Header for a width x height world of chunk-sized chunks; the index
+// follows the header and the data the index.
+static inline int world_hdr_init(world_hdr_t* h, uint32_t width, uint32_t height, uint32_t chunk) {
+    if (width == 0 || height == 0 || chunk < 2 || (chunk & (chunk - 1)) || chunk > 4096) return -1;
+    h->width = width;
+    h->height = height;
+    h->chunk = chunk;
+    h->chunks_x = (width + chunk - 1) / chunk;
+    h->chunks_y = (height + chunk - 1) / chunk;
+    h->index_off = WORLD_HDR_SIZE;
+    h->data_off = h->index_off + 8ull * h->chunks_x * h->chunks_y;
+    return 0;
+}
+
+static inline void world_hdr_encode(uint8_t out[WORLD_HDR_SIZE], const world_hdr_t* h) {
+    memset(out, 0, WORLD_HDR_SIZE);
+    memcpy(out, WORLD_MAGIC, 4);
+    world_put32_(out + 4, WORLD_VERSION);
+    world_put32_(out + 8, h->width);
+    world_put32_(out + 12, h->height);
+    world_put32_(out + 16, h->chunk);
+    world_put32_(out + 20, h->chunks_x);
+    world_put32_(out + 24, h->chunks_y);
+    world_put64_(out + 32, h->index_off);
+    world_put64_(out + 40, h->data_off);
+}
+
+static inline int world_hdr_decode(const uint8_t* p, size_t len, world_hdr_t* h) {
+    if (len < WORLD_HDR_SIZE || memcmp(p, WORLD_MAGIC, 4) != 0 || world_le32_(p + 4) != WORLD_VERSION)
+        return -1;
+    world_hdr_t want;
+    if (world_hdr_init(&want, world_le32_(p + 8), world_le32_(p + 12), world_le32_(p + 16)) < 0) return -1;
+    *h = want;
+    h->index_off = world_le64_(p + 32);
+    h->data_off = world_le64_(p + 40);
+    if (world_le32_(p + 20) != want.chunks_x || world_le32_(p + 24) != want.chunks_y) return -1;
+    if (h->index_off < WORLD_HDR_SIZE || h->index_off + 8ull * h->chunks_x * h->chunks_y > len) return -1;
+    return 0;
+}
+
+static inline void world_lru_unlink_(world_t* w, int s) {
+    if (w->prev[s] >= 0) w->next[w->prev[s]] = w->next[s];
+    else w->lru_head = w->next[s];
+    if (w->next[s] >= 0) w->prev[w->next[s]] = w->prev[s];
+    else w->lru_tail = w->prev[s];
+}
+
+static inline void world_lru_push_(world_t* w, int s) {
+    w->prev[s] = -1;
+    w->next[s] = w->lru_head;
+    if (w->lru_head >= 0) w->prev[w->lru_head] = s;
+    w->lru_head = s;
+    if (w->lru_tail < 0) w->lru_tail = s;
+}
+
+static inline int world_hash_(const world_t* w, int64_t id) {
+    uint64_t k = (uint64_t)id * 0x9E3779B97F4A7C15ull;
+    return (int)(k >> 32) & w->table_mask;
+}
+
+// Table position holding chunk id, or the empty one where it would go.
+static inline int world_find_(const world_t* w, int64_t id) {
+    int i = world_hash_(w, id);
+    while (w->table[i] >= 0 && w->slot_chunk[w->table[i]] != id) i = (i + 1) & w->table_mask;
+    return i;
+}
+
+// Remove table position i, shifting later probes back so no lookup stops
+// short (no tombstones).
+static inline void world_table_del_(world_t* w, int i) {
+    int j = i;
+    for (;;) {
+        w->table[i] = -1;
+        for (;;) {
+            j = (j + 1) & w->table_mask;
+            if (w->table[j] < 0) return;
+            int home = world_hash_(w, w->slot_chunk[w->table[j]]);
+            // move j back into i unless its home lies cyclically in (i, j]
+            if (i <= j ? (home <= i || home > j) : (home <= i && home > j)) break;
+        }
+        w->table[i] = w->table[j];
+        i = j;
+    }
+}
+
+// Map path and set up a chunk cache of at most budget bytes (at least one
+// chunk). Returns -1 with errno set (EINVAL for a malformed file).
+static inline int world_open(world_t* w, const char* path, size_t budget) {
+    memset(w, 0, sizeof *w);
+    w->fd = open(path, O_RDONLY);
+    if (w->fd < 0) return -1;
+    struct stat st;
+    if (fstat(w->fd, &st) < 0) { close(w->fd); return -1; }
+    w->map_len = (size_t)st.st_size;
+    void* m = w->map_len ? mmap(NULL, w->map_len, PROT_READ, MAP_SHARED, w->fd, 0) : MAP_FAILED;
+    if (m == MAP_FAILED) { if (!w->map_len) errno = EINVAL; close(w->fd); return -1; }
+    w->map = m;
+    // chunks are scattered through the file: don't read around each fault
+    madvise(m, w->map_len, MADV_RANDOM);
+
+    if (world_hdr_decode(w->map, w->map_len, &w->hdr) < 0) {
+        munmap(m, w->map_len);
+        close(w->fd);
+        errno = EINVAL;
+        return -1;
+    }
+    while ((1u << w->shift) < w->hdr.chunk) w->shift++;
+    w->chunk_bytes = (size_t)w->hdr.chunk * w->hdr.chunk;
+
+    w->nslots = budget / w->chunk_bytes > 0 ? (int)(budget / w->chunk_bytes) : 1;
+    if ((uint64_t)w->nslots > (uint64_t)w->hdr.chunks_x * w->hdr.chunks_y)
+        w->nslots = (int)((uint64_t)w->hdr.chunks_x * w->hdr.chunks_y);
+    int tsize = 16;
+    while (tsize < 2 * w->nslots) tsize *= 2;
+    w->table_mask = tsize - 1;
+    w->tiles = malloc((size_t)w->nslots * w->chunk_bytes);
+    w->slot_chunk = malloc((size_t)w->nslots * sizeof *w->slot_chunk);
+    w->prev = malloc((size_t)w->nslots * sizeof *w->prev);
+    w->next = malloc((size_t)w->nslots * sizeof *w->next);
+    w->table = malloc((size_t)tsize * sizeof *w->table);
+    if (!w->tiles || !w->slot_chunk || !w->prev || !w->next || !w->table) {
+        free(w->tiles); free(w->slot_chunk); free(w->prev); free(w->next); free(w->table);
+        munmap(m, w->map_len);
+        close(w->fd);
+        errno = ENOMEM;
+        return -1;
+    }
+    for (int i = 0; i < tsize; i++) w->table[i] = -1;
+    w->lru_head = w->lru_tail = -1;
+    w->last_chunk = -1;
+    return 0;
+}
+
+static inline void world_close(world_t* w) {
+    if (w->map) munmap((void*)w->map, w->map_len);
+    if (w->fd >= 0) close(w->fd);
+    free(w->tiles);
+    free(w->slot_chunk);
+    free(w->prev);
+    free(w->next);
+    free(w->table);
+    memset(w, 0, sizeof *w);
+    w->fd = -1;
+}
+
+// Fill dst with chunk id's tiles from the mapping. Returns -1 if its index
+// entry points outside the file.
+static inline int world_load_(world_t* w, int64_t id, uint8_t* dst) {
+    uint64_t off = world_le64_(w->map + w->hdr.index_off + 8 * (uint64_t)id);
+    if (off < WORLD_UNIFORM_MAX) {
+        memset(dst, (int)off, w->chunk_bytes);
+        return 0;
+    }
+    if (off < w->hdr.data_off || off > w->map_len || w->map_len - off < w->chunk_bytes) return -1;
+    memcpy(dst, w->map + off, w->chunk_bytes);
+    return 0;
+}
+
+// Tiles of chunk (cx, cy), chunk * chunk bytes row-major; NULL if out of
+// range or the file is damaged there.
+static inline const uint8_t* world_chunk(world_t* w, int cx, int cy) {
+    if (cx < 0 || cy < 0 || (uint32_t)cx >= w->hdr.chunks_x || (uint32_t)cy >= w->hdr.chunks_y) return NULL;
+    int64_t id = (int64_t)cy * w->hdr.chunks_x + cx;
+    if (id == w->last_chunk) { w->hits++; return w->last_tiles; }
+
+    int t = world_find_(w, id);
+    int s = w->table[t];
+    if (s >= 0) {
+        w->hits++;
+        if (w->lru_head != s) { world_lru_unlink_(w, s); world_lru_push_(w, s); }
+    } else {
+        w->misses++;
+        w->last_chunk = -1;                // its slot may be the one evicted
+        if (w->used < w->nslots) {
+            s = w->used++;
+        } else {
+            s = w->lru_tail;
+            world_lru_unlink_(w, s);
+            if (w->slot_chunk[s] >= 0) {
+                world_table_del_(w, world_find_(w, w->slot_chunk[s]));
+                w->evictions++;
+                t = world_find_(w, id);    // the delete may have shifted entries
+            }
+        }
+        uint8_t* dst = w->tiles + (size_t)s * w->chunk_bytes;
+        if (world_load_(w, id, dst) < 0) {
+            w->bad_chunks++;
+            w->slot_chunk[s] = -1;
+            // back on the free end of the list so it is reused first
+            w->prev[s] = w->lru_tail;
+            w->next[s] = -1;
+            if (w->lru_tail >= 0) w->next[w->lru_tail] = s;
+            else w->lru_head = s;
+            w->lru_tail = s;
+            return NULL;
+        }
+        w->slot_chunk[s] = id;
+        w->table[t] = s;
+        world_lru_push_(w, s);
+    }
+    w->last_chunk = id;
+    w->last_tiles = w->tiles + (size_t)s * w->chunk_bytes;
+    return w->last_tiles;
+}
+
+// Tile at (x, y); -1 off the world or in a damaged chunk.
+static inline int world_tile(world_t* w, int x, int y) {
+    if (x < 0 || y < 0 || (uint32_t)x >= w->hdr.width || (uint32_t)y >= w->hdr.height) return -1;
+    const uint8_t* c = world_chunk(w, x >> w->shift, y >> w->shift);
+    if (!c) return -1;
+    int mask = (int)w->hdr.chunk - 1;
+    return c[((y & mask) << w->shift) | (x & mask)];
+}
+
+// Chunk slots holding data (at most the budget)
+static inline int world_resident(const world_t* w) {
+    return w->used;
+}
+
+#endif
@@ -1,15 +1,117 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
 #include <sys/select.h>
 
+#include "../Common/frame.h"
+#include "../Common/profile.h"
+#include "../Common/tick.h"
+#include "../Common/udp_transport.h"
+
 #define PORT 8080
 #define MAX  1024
 
-int main() {
+static udp_endpoint_t udp;
+static int udp_state;  // 0 connecting, 1 connected, -1 done
+static const char* trace_path;  // --trace: written on exit (-DPROFILE builds)
+
+static void write_trace(void) {
+    if (!trace_path) return;
+    long n = prof_write_trace(trace_path);
+    if (n < 0) perror(errno == ENOSYS ? "trace (build with -DPROFILE)" : trace_path);
+    else printf("Wrote %ld trace events to %s\n", n, trace_path);
+}
+
+static void udp_connected(udp_endpoint_t* ep, int s, void* user) {
+    udp_state = 1;
+    printf("Connected to server on port %d (UDP).\n", PORT);
+    printf("Type a message and press Enter; 'exit' closes the client.\n");
+}
+
+static void udp_message(udp_endpoint_t* ep, int s, uint8_t type,
+                        const uint8_t* payload, uint16_t len, void* user) {
+    if (type == FRAME_EXIT) {
+        printf("Server requested exit. Closing.\n");
+        udp_state = -1;
+    } else if (type == FRAME_TEXT && len > 0) {
+        printf("From server: %.*s\n", (int)len, (const char*)payload);
+    }
+}
+
+static void udp_disconnected(udp_endpoint_t* ep, int s, void* user) {
+    if (udp_state == 1) printf("Server closed connection.\n");
+    else if (udp_state == 0) printf("Can't reach server.\n");
+    udp_state = -1;
+}
+
+// Same console client over the UDP transport; chat goes on the reliable
+// channel. udp_update() runs every 20 ms for acks and resends.
+static int run_udp(const char* host) {
+    struct sockaddr_in servaddr = {0};
+    servaddr.sin_family = AF_INET;
+    servaddr.sin_port   = htons(PORT);
+    servaddr.sin_addr.s_addr = inet_addr(host);
+
+    if (udp_open(&udp, 0, 0) < 0) exit(1);
+    udp_handler_t h = { udp_connected, udp_message, udp_disconnected, NULL };
+    int conn = udp_connect(&udp, &servaddr, (uint32_t)mono_ns() ^ (uint32_t)getpid());
+
+    while (udp_state >= 0) {
+        fd_set read_fds;
+        FD_ZERO(&read_fds);
+        // stdin waits until the handshake is done, or typed-ahead input
+        // would wake select() every time round without being read
+        if (udp_state == 1) FD_SET(STDIN_FILENO, &read_fds);
+        FD_SET(udp.fd, &read_fds);
+        struct timeval tv = { 0, 20000 };
+        if (select(udp.fd + 1, &read_fds, NULL, NULL, &tv) < 0) { perror("select"); break; }
+
+        if (FD_ISSET(udp.fd, &read_fds)) {
+            PROF_SCOPE("udp_poll");
+            udp_poll(&udp, mono_ns(), &h);
+        }
+
+        if (udp_state == 1 && FD_ISSET(STDIN_FILENO, &read_fds)) {
+            PROF_SCOPE("keyboard");
+            char line[MAX];
+            if (fgets(line, sizeof line, stdin)) {
+                if (strncmp(line, "exit", 4) == 0) {
+                    udp_send(&udp, conn, UDP_CH_RELIABLE, FRAME_EXIT, NULL, 0);
+                    udp_update(&udp, mono_ns(), &h);
+                    printf("Client exiting.\n");
+                    break;
+                }
+                size_t len = strcspn(line, "\n");
+                if (udp_send(&udp, conn, UDP_CH_RELIABLE, FRAME_TEXT, line, (uint16_t)len) < 0)
+                    printf("Too many unacknowledged messages, dropped.\n");
+            }
+        }
+        if (udp_state >= 0) {
+            PROF_SCOPE("udp_update");
+            udp_update(&udp, mono_ns(), &h);
+        }
+    }
+
+    if (udp.nactive > 0) udp_disconnect(&udp, conn);
+    udp_close(&udp);
+    write_trace();
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 2 && strcmp(argv[1], "--trace") == 0) {
+        trace_path = argv[2];
+        argv += 2;
+        argc -= 2;
+    }
+    if (argc > 1 && strcmp(argv[1], "--udp") == 0)
+        return run_udp(argc > 2 ? argv[2] : "127.0.0.1");
+
     int sockfd = socket(AF_INET, SOCK_STREAM, 0);
     if (sockfd < 0) { perror("socket"); exit(1); }
 
@@ -41,7 +143,12 @@ int main() {
     FD_SET(sockfd, &master);
     int fdmax = (sockfd > STDIN_FILENO) ? sockfd : STDIN_FILENO;
 
-    for (;;) {
+    frame_rx_t rx;
+    if (frame_rx_init(&rx, FRAME_RX_CAP) < 0) { perror("malloc"); exit(1); }
+    uint32_t tx_id = 0;
+    int done = 0;
+
+    while (!done) {
         read_fds = master;
         if (select(fdmax + 1, &read_fds, NULL, NULL, NULL) < 0) {
             perror("select");
@@ -50,34 +157,46 @@ int main() {
 
         // keyboard input
         if (FD_ISSET(STDIN_FILENO, &read_fds)) {
+            PROF_SCOPE("keyboard");
             char line[MAX];
             if (!fgets(line, sizeof line, stdin)) continue;
-            write(sockfd, line, strlen(line));
             if (strncmp(line, "exit", 4) == 0) {
+                frame_send(sockfd, FRAME_EXIT, tx_id++, NULL, 0);
                 printf("Client exiting.\n");
                 break;
             }
+            size_t len = strcspn(line, "\n");
+            frame_send(sockfd, FRAME_TEXT, tx_id++, line, (uint16_t)len);
         }
 
         // message from server
         if (FD_ISSET(sockfd, &read_fds)) {
-            char buf[MAX];
-            int n = read(sockfd, buf, sizeof buf - 1);
-            if (n <= 0) {
+            PROF_SCOPE("server_read");
+            ssize_t got = frame_rx_fill(&rx, sockfd);
+            if (got <= 0) {
                 printf("Server closed connection.\n");
                 break;
             }
-            buf[n] = '\0';
-            if (buf[0] != '\n') {
-                printf("From server: %s\n", buf);
+            frame_t f;
+            int r;
+            while ((r = frame_rx_next(&rx, &f)) > 0) {
+                if (f.hdr.type == FRAME_EXIT) {
+                    printf("Server requested exit. Closing.\n");
+                    done = 1;
+                    break;
+                }
+                if (f.hdr.type == FRAME_TEXT && f.hdr.len > 0)
+                    printf("From server: %.*s\n", (int)f.hdr.len, (const char*)f.payload);
             }
-            if (strncmp(buf, "exit", 4) == 0) {
-                printf("Server requested exit. Closing.\n");
+            if (r < 0) {
+                printf("Malformed frame from server. Closing.\n");
                 break;
             }
         }
     }
 
+    frame_rx_free(&rx);
     close(sockfd);
+    write_trace();
     return 0;
 }
@@ -0,0 +1,255 @@
+// Fuzz and throughput check of the stream framing (Common/frame.h).
+//
+// Headless and single-threaded: both ends of a non-blocking Unix socketpair
+// are driven from one loop, which writes a little, then reads everything
+// available with frame_rx_fill() and pops it with frame_rx_next(), the way
+// the servers do.
+//   fuzz    each round builds a stream of --frames frames with random
+//           types, ids and lengths (mostly small, some up to
+//           FRAME_MAX_PAYLOAD, empty ones included) and writes it in random
+//           pieces, from single bytes that split headers and payloads
+//           across reads to tens of KB that merge many frames into one.
+//           Every frame must come out in order with its type, id, length
+//           and payload intact. Rounds then end the stream either partway
+//           through one more frame, which must stay buffered, unreturned,
+//           when EOF arrives, or with a header whose length is over
+//           FRAME_MAX_PAYLOAD, which must be reported as malformed.
+//   speed   --speed-frames frames of --payload bytes written in large
+//           batches, and the frames/s and MB/s the read side parses.
+// Exits non-zero if any frame is lost, reordered or corrupted.
+//
+//   framefuzz [--rounds N] [--frames N] [--speed-frames N] [--payload BYTES] [--seed N]
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "../Common/frame.h"
+#include "../Common/tick.h"
+
+#define MAX_FRAME (FRAME_HDR_SIZE + FRAME_MAX_PAYLOAD)
+#define BATCH     (256 * 1024)   // speed: bytes written per turn
+
+static uint32_t rng;
+static int failures;
+
+static uint32_t next_random(void) {
+    rng = rng * 1664525u + 1013904223u;
+    return rng >> 8;
+}
+
+// Payload byte i of frame id: anything misplaced or stale shows up
+static uint8_t payload_byte(uint32_t id, int i) {
+    return (uint8_t)(id * 131u + (uint32_t)i * 7u + ((uint32_t)i >> 8));
+}
+
+static void fail(int round, const char* what, uint32_t frame) {
+    if (failures++ < 10) printf("round %d: %s at frame %u\n", round, what, frame);
+}
+
+static int open_pair(int sv[2]) {
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) { perror("socketpair"); return -1; }
+    for (int i = 0; i < 2; i++) fcntl(sv[i], F_SETFL, fcntl(sv[i], F_GETFL) | O_NONBLOCK);
+    return 0;
+}
+
+// Write up to len bytes; returns how many went, 0 when the socket is full
+static size_t write_some(int fd, const uint8_t* p, size_t len) {
+    ssize_t n = write(fd, p, len);
+    if (n < 0 && errno != EAGAIN && errno != EINTR) { perror("write"); exit(1); }
+    return n > 0 ? (size_t)n : 0;
+}
+
+typedef struct {
+    uint64_t reads, split, merged;   // reads, ending mid-frame, yielding 2+ frames
+} fuzz_stats_t;
+
+// One fuzz round; returns the bytes pushed through
+static size_t fuzz_round(int round, int nframes, uint8_t* stream, size_t cap, fuzz_stats_t* st) {
+    // the stream: nframes good frames, then a truncated or an oversized one
+    size_t len = 0;
+    uint8_t payload[FRAME_MAX_PAYLOAD];
+    uint8_t* types = malloc((size_t)nframes);
+    uint16_t* lens = malloc((size_t)nframes * sizeof *lens);
+    if (!types || !lens) { perror("malloc"); exit(1); }
+    for (int k = 0; k < nframes; k++) {
+        uint32_t r = next_random() % 100;
+        uint16_t n = r < 10 ? 0 : r < 85 ? (uint16_t)(next_random() % 64)
+                   : r < 98 ? (uint16_t)(next_random() % (FRAME_MAX_PAYLOAD + 1)) : FRAME_MAX_PAYLOAD;
+        types[k] = (uint8_t)(1 + next_random() % 255);
+        lens[k] = n;
+        for (int i = 0; i < n; i++) payload[i] = payload_byte((uint32_t)k, i);
+        size_t w = frame_encode(stream + len, cap - len, types[k], (uint32_t)k, payload, n);
+        if (!w) { printf("stream buffer too small\n"); exit(1); }
+        len += w;
+    }
+    int truncate = round % 2 == 0;
+    size_t cut = 0;
+    if (truncate) {
+        uint16_t n = (uint16_t)(1 + next_random() % FRAME_MAX_PAYLOAD);
+        for (int i = 0; i < n; i++) payload[i] = payload_byte((uint32_t)nframes, i);
+        frame_encode(stream + len, cap - len, FRAME_TEXT, (uint32_t)nframes, payload, n);
+        cut = 1 + next_random() % (FRAME_HDR_SIZE + n - 1u);    // 1 .. all but the last byte
+    } else {
+        frame_hdr_t h = { FRAME_TEXT, 0, (uint16_t)(FRAME_MAX_PAYLOAD + 1 + next_random() % 1000), (uint32_t)nframes };
+        frame_hdr_pack(stream + len, &h);
+        cut = FRAME_HDR_SIZE;
+    }
+    size_t total = len + cut;
+
+    int sv[2];
+    frame_rx_t rx;
+    if (open_pair(sv) < 0 || frame_rx_init(&rx, FRAME_RX_CAP) < 0) exit(1);
+    size_t wpos = 0;
+    int shut = 0, eof = 0, malformed = 0;
+    uint32_t want = 0;
+    while (!eof && !malformed) {
+        // writer: one piece, sized to split or merge frames
+        if (wpos < total) {
+            uint32_t kind = next_random() % 4;
+            size_t piece = kind == 0 ? 1 + next_random() % 8
+                         : kind == 1 ? 1 + next_random() % 200
+                         : kind == 2 ? 1 + next_random() % MAX_FRAME : 1 + next_random() % (64 * 1024);
+            if (piece > total - wpos) piece = total - wpos;
+            wpos += write_some(sv[0], stream + wpos, piece);
+        } else if (!shut) {
+            shutdown(sv[0], SHUT_WR);
+            shut = 1;
+        }
+
+        // reader: drain whatever is there, frame by frame
+        for (;;) {
+            ssize_t n = frame_rx_fill(&rx, sv[1]);
+            if (n == 0) { eof = 1; break; }
+            if (n < 0) {
+                if (errno == EAGAIN) break;
+                perror("frame_rx_fill");
+                fail(round, "read failed", want);
+                eof = 1;
+                break;
+            }
+            st->reads++;
+            frame_t f;
+            int r, got = 0;
+            while ((r = frame_rx_next(&rx, &f)) > 0) {
+                got++;
+                if (want >= (uint32_t)nframes) { fail(round, "frame past the end", want); continue; }
+                if (f.hdr.id != want) fail(round, "out of order", want);
+                else if (f.hdr.type != types[want] || f.hdr.len != lens[want]) fail(round, "wrong header", want);
+                else {
+                    for (int i = 0; i < f.hdr.len; i++)
+                        if (f.payload[i] != payload_byte(want, i)) { fail(round, "corrupt payload", want); break; }
+                }
+                want = f.hdr.id + 1;
+            }
+            if (r < 0) { malformed = 1; break; }
+            if (got > 1) st->merged++;
+            if (rx.tail != rx.head) st->split++;
+        }
+    }
+
+    if (want != (uint32_t)nframes) fail(round, "frames missing", want);
+    if (truncate) {
+        frame_t f;
+        if (malformed) fail(round, "truncated frame reported malformed", want);
+        else if (rx.tail - rx.head != cut || frame_rx_next(&rx, &f) != 0) fail(round, "truncated frame not left buffered", want);
+    } else if (!malformed) {
+        fail(round, "oversized frame not reported", want);
+    }
+    close(sv[0]);
+    close(sv[1]);
+    frame_rx_free(&rx);
+    free(types);
+    free(lens);
+    return total;
+}
+
+// Frames of `payload` bytes pushed through in large batches; returns the
+// seconds the read side took
+static double speed(long long nframes, int payload_len, uint8_t* batch) {
+    uint8_t payload[FRAME_MAX_PAYLOAD];
+    memset(payload, 'x', sizeof payload);
+    int per = BATCH / (FRAME_HDR_SIZE + payload_len);
+    size_t batch_len = 0;
+    for (int k = 0; k < per; k++)
+        batch_len += frame_encode(batch + batch_len, BATCH - batch_len, FRAME_PING, 0, payload, (uint16_t)payload_len);
+
+    int sv[2];
+    frame_rx_t rx;
+    if (open_pair(sv) < 0 || frame_rx_init(&rx, FRAME_RX_CAP) < 0) exit(1);
+    int sz = 4 * 1024 * 1024;
+    setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &sz, sizeof sz);
+    setsockopt(sv[1], SOL_SOCKET, SO_RCVBUF, &sz, sizeof sz);
+
+    long long written = 0, parsed = 0;
+    size_t off = 0;
+    int64_t t0 = mono_ns();
+    while (parsed < nframes) {
+        // top up the socket, a whole batch at a time, until it is full
+        while (written < nframes) {
+            size_t w = write_some(sv[0], batch + off, batch_len - off);
+            if (!w) break;
+            off += w;
+            if (off == batch_len) { off = 0; written += per; }
+        }
+        frame_t f;
+        ssize_t n;
+        while ((n = frame_rx_fill(&rx, sv[1])) > 0)
+            while (frame_rx_next(&rx, &f) > 0) parsed++;
+        if (n == 0 || (n < 0 && errno != EAGAIN)) { perror("frame_rx_fill"); exit(1); }
+    }
+    double secs = (double)(mono_ns() - t0) / 1e9;
+    close(sv[0]);
+    close(sv[1]);
+    frame_rx_free(&rx);
+    return secs;
+}
+
+int main(int argc, char** argv) {
+    int rounds = 200;
+    int nframes = 2000;
+    long long speed_frames = 20000000;
+    int payload_len = 32;
+    unsigned seed = 12345;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) rounds = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) nframes = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--speed-frames") == 0 && i + 1 < argc) speed_frames = atoll(argv[++i]);
+        else if (strcmp(argv[i], "--payload") == 0 && i + 1 < argc) payload_len = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = (unsigned)atoi(argv[++i]);
+        else {
+            printf("Usage: %s [--rounds N] [--frames N] [--speed-frames N] [--payload BYTES] [--seed N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (rounds < 2 || nframes < 1 || speed_frames < 1 || payload_len < 0 || payload_len > FRAME_MAX_PAYLOAD) {
+        printf("Rounds must be at least 2, frame counts positive and payload 0..%d\n", FRAME_MAX_PAYLOAD);
+        return 1;
+    }
+    rng = seed;
+
+    size_t cap = (size_t)(nframes + 1) * MAX_FRAME;
+    uint8_t* stream = malloc(cap > BATCH ? cap : BATCH);
+    if (!stream) { perror("malloc"); return 1; }
+
+    fuzz_stats_t st = {0};
+    size_t bytes = 0;
+    int64_t t0 = mono_ns();
+    for (int r = 0; r < rounds; r++) bytes += fuzz_round(r, nframes, stream, cap, &st);
+    double secs = (double)(mono_ns() - t0) / 1e9;
+    printf("fuzz    %d rounds of %d frames, %.1f MB in %llu reads: %llu ended mid-frame, %llu held 2+ frames\n",
+           rounds, nframes, bytes / 1e6, (unsigned long long)st.reads, (unsigned long long)st.split,
+           (unsigned long long)st.merged);
+    printf("        %.0f frames/s with random pieces\n", (double)rounds * nframes / secs);
+
+    secs = speed(speed_frames, payload_len, stream);
+    printf("speed   %lld frames of %d B: %.2f M frames/s, %.0f MB/s\n", speed_frames, payload_len,
+           speed_frames / secs / 1e6, speed_frames * (double)(FRAME_HDR_SIZE + payload_len) / secs / 1e6);
+    printf("check   %s\n", failures ? "MISMATCH" : "every frame whole and in order, truncated and oversized handled");
+    free(stream);
+    return failures ? 1 : 0;
+}
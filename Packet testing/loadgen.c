@@ -0,0 +1,635 @@
+// Headless load generator: N simulated clients from one process.
+//
+// Every bot connects to a local server (either the packet-testing server or
+// the 2D demo server), then on each send tick queues one bit-packed
+// FRAME_MOVE followed by a FRAME_PING whose payload is the send timestamp.
+// Both servers echo pings as FRAME_PONG on the same connection, right after
+// handling the move, so the pong's round trip covers the move's path through
+// the server loop. At the end it prints throughput and p50/p99/p999 RTT and,
+// with --csv, appends one row per run so sweeps can be plotted.
+//
+//   loadgen [--clients N] [--rate HZ] [--duration S] [--host IP] [--port P]
+//           [--udp] [--script UDLR...] [--grid N] [--rooms N] [--csv FILE]
+//           [--idle N] [--idle-step N] [--server-pid PID] [--slow-readers N]
+//
+// Against the 2D demo server the board size and player count come from
+// FRAME_WELCOME (overriding --grid). Bots decode every FRAME_STATE against
+// the snapshots they hold and ack it, like the game client, and the report
+// includes the state bytes each bot receives per server tick, which the
+// server's view radius bounds.
+//
+// Each TCP bot opens with a FRAME_JOIN; with --rooms N, bot i asks for room
+// i % N, which spreads the bots over N rooms of the room server (RoomServer)
+// and is ignored by the others.
+//
+// --udp runs the same workload over Common/udp_transport.h (sequenced
+// channel) against the packet-testing server, for a TCP vs UDP comparison.
+//
+// --idle N ramps up to N extra TCP connections that join and then only read
+// (acking states, like a spectator), --idle-step at a time. At each level it
+// times a few fresh connections from connect() to the pong of their first
+// ping (accept, registration and first service in the server's loop), runs
+// the --clients workload for --duration seconds and reports its RTT and,
+// with --server-pid, the server's CPU use from /proc/<pid>/stat. Running it
+// against a server built before and after a change to the event loop shows
+// how the per-wakeup cost grows with connections that have nothing to say.
+//
+// --slow-readers N makes the first N TCP bots stop reading once the run
+// starts, with a small receive buffer, while sending SLOW_PINGS full-size
+// pings a round, so the server's queue for them only grows until it kicks
+// them. The RTT reported is then that of the other bots, which the
+// stalled ones must not hold up, and the report says how many of the
+// stalled bots the server disconnected.
+#define _GNU_SOURCE
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "../Common/bitpack.h"
+#include "../Common/frame.h"
+#include "../Common/game_msg.h"
+#include "../Common/net_loop.h"
+#include "../Common/sendq.h"
+#include "../Common/snapshot.h"
+#include "../Common/tick.h"
+#include "../Common/udp_transport.h"
+
+#define DEFAULT_PORT     8080
+#define DEFAULT_CLIENTS  100
+#define DEFAULT_RATE     20
+#define DEFAULT_DURATION 10
+#define DRAIN_NS         (500 * 1000000LL)  // wait this long for late pongs
+#define PROBES           20                 // --idle: fresh connections timed per level
+#define SLOW_RCVBUF      4096               // --slow-readers: receive buffer of a stalled bot
+#define SLOW_PINGS       16                 // --slow-readers: full-size pings per round
+
+typedef struct {
+    int fd;
+    frame_rx_t rx;
+    sendq_t tx;
+    udp_endpoint_t* ep;  // --udp only
+    udp_handler_t h;
+    int conn;
+    int up;              // connected (TCP: always, UDP: after handshake)
+    int player;          // from FRAME_WELCOME, -1 = spectator / unknown
+    int x, y;
+    int step;            // position in the movement script
+    uint32_t seq;
+    snapshot_ring_t snaps;  // 2D server states received, baselines for the next
+    int64_t ack_due;     // newest state not acked yet, -1 none
+} bot_t;
+
+static bot_t* bots;
+static int nbots = DEFAULT_CLIENTS;
+static int nidle;           // --idle connections open, in bots[nbots..]; never send
+static int nslow;           // --slow-readers: bots[0..nslow) stop reading...
+static int stalled;         // ...once this is set, when the run starts
+static int* bot_of_fd;
+static int fd_cap;
+static net_loop_t loop;
+static move_layout_t layout;
+static int grid = 16;
+static const char* script;  // NULL = random walk
+static int use_udp;
+static int nrooms = 1;      // --rooms: bot i joins room i % nrooms
+static msg_pool_t frames;   // every bot's outgoing frames
+
+static uint64_t sent_msgs, sent_bytes, recv_msgs, recv_bytes, pongs, send_fail;
+static uint64_t states, state_bytes, full_states, bad_states;
+static uint64_t slow_msgs;   // sent by stalled bots, never answered
+static int server_hz;  // 2D server tick rate, from FRAME_WELCOME
+static int64_t* rtts;
+static size_t nrtt, rtt_cap;
+
+static void record_rtt(int64_t ns) {
+    if (nrtt == rtt_cap) {
+        size_t ncap = rtt_cap ? rtt_cap * 2 : 65536;
+        int64_t* n = realloc(rtts, ncap * sizeof *n);
+        if (!n) return;
+        rtts = n;
+        rtt_cap = ncap;
+    }
+    rtts[nrtt++] = ns;
+}
+
+// Next step of the walk: the script's next letter, or a random direction.
+static void next_position(bot_t* b) {
+    static const int dirs[4][2] = { {0, 1}, {0, -1}, {-1, 0}, {1, 0} };
+    int d;
+    if (script) {
+        const char* at = strchr("UDLR", script[b->step++ % strlen(script)]);
+        d = at ? (int)(at - "UDLR") : 0;
+    } else {
+        d = rand() & 3;
+    }
+    int nx = b->x + dirs[d][0], ny = b->y + dirs[d][1];
+    if (nx < 0 || nx >= grid || ny < 0 || ny >= grid) { nx = b->x - dirs[d][0]; ny = b->y - dirs[d][1]; }
+    b->x = nx;
+    b->y = ny;
+}
+
+static void handle_frame(bot_t* b, uint8_t type, uint32_t id, const uint8_t* payload, uint16_t len) {
+    recv_msgs++;
+    recv_bytes += FRAME_HDR_SIZE + len;
+    if (type == FRAME_PONG && len == sizeof(int64_t)) {
+        int64_t t0;
+        memcpy(&t0, payload, sizeof t0);
+        record_rtt(mono_ns() - t0);
+        pongs++;
+    } else if (type == FRAME_WELCOME) {
+        welcome_t w;
+        if (welcome_decode(payload, len, &w) < 0) return;
+        b->player = w.player;
+        server_hz = w.tick_hz;
+        if (w.grid >= 2 && w.max_players >= 1) {
+            grid = w.grid;
+            layout = move_layout_for(w.grid, w.max_players);
+            if (b->player >= 0) { b->x %= grid; b->y %= grid; }
+        }
+    } else if (type == FRAME_STATE) {
+        state_hdr_t h;
+        snapshot_t* s = snapshot_ring_next(&b->snaps);
+        if (state_decode(payload, len, layout, &h, &b->snaps, s) < 0) { bad_states++; return; }
+        s->tick = id;
+        snapshot_ring_push(&b->snaps);
+        b->ack_due = id;
+        states++;
+        state_bytes += FRAME_HDR_SIZE + len;
+        if (h.flags & STATE_FULL) full_states++;
+        // resync our position with the server's view of it
+        for (int i = 0; i < s->n; i++)
+            if (s->e[i].key == b->player) { b->x = s->e[i].x; b->y = s->e[i].y; }
+    }
+}
+
+// --- UDP transport callbacks ---
+static void udp_connected(udp_endpoint_t* ep, int s, void* user) {
+    ((bot_t*)user)->up = 1;
+}
+
+static void udp_message(udp_endpoint_t* ep, int s, uint8_t type,
+                        const uint8_t* payload, uint16_t len, void* user) {
+    handle_frame(user, type, 0, payload, len);
+}
+
+static void udp_disconnected(udp_endpoint_t* ep, int s, void* user) {
+    ((bot_t*)user)->up = 0;
+}
+
+static void track_fd(int fd, int i) {
+    if (fd >= fd_cap) {
+        int ncap = fd_cap ? fd_cap : 1024;
+        while (ncap <= fd) ncap *= 2;
+        int* n = realloc(bot_of_fd, (size_t)ncap * sizeof *n);
+        if (!n) { perror("realloc"); exit(1); }
+        bot_of_fd = n;
+        fd_cap = ncap;
+    }
+    bot_of_fd[fd] = i;
+}
+
+static int open_bot(bot_t* b, int i, const struct sockaddr_in* addr) {
+    b->player = -1;
+    b->ack_due = -1;
+    snapshot_ring_init(&b->snaps);
+    b->x = rand() % grid;
+    b->y = rand() % grid;
+    b->step = i;  // stagger scripted bots
+
+    if (use_udp) {
+        b->ep = calloc(1, sizeof *b->ep);
+        if (!b->ep || udp_open(b->ep, 0, 0) < 0) return -1;
+        b->fd = b->ep->fd;
+        b->h = (udp_handler_t){ udp_connected, udp_message, udp_disconnected, b };
+        b->conn = udp_connect(b->ep, addr, (uint32_t)mono_ns() ^ (uint32_t)i);
+        if (b->conn < 0) return -1;
+        udp_update(b->ep, mono_ns(), &b->h);
+    } else {
+        b->fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (b->fd < 0) return -1;
+        if (i < nslow) {
+            int sz = SLOW_RCVBUF;  // before connect(), so the window starts small
+            setsockopt(b->fd, SOL_SOCKET, SO_RCVBUF, &sz, sizeof sz);
+        }
+        if (connect(b->fd, (const struct sockaddr*)addr, sizeof *addr) < 0) { close(b->fd); return -1; }
+        if (frame_send(b->fd, FRAME_JOIN, (uint32_t)(i % nrooms), NULL, 0) < 0) { close(b->fd); return -1; }
+        net_set_nonblocking(b->fd);
+        net_set_nodelay(b->fd);
+        if (frame_rx_init(&b->rx, FRAME_RX_CAP) < 0) { close(b->fd); return -1; }
+        sendq_init(&b->tx);
+        b->up = 1;
+    }
+    track_fd(b->fd, i);
+    return net_loop_add(&loop, b->fd, NET_READ | NET_WRITE | NET_EDGE);
+}
+
+static void close_bot(bot_t* b) {
+    if (use_udp) {
+        if (!b->ep) return;
+        if (b->up) { udp_disconnect(b->ep, b->conn); udp_update(b->ep, mono_ns(), &b->h); }
+        udp_close(b->ep);
+        free(b->ep);
+        b->ep = NULL;
+    } else if (b->fd >= 0) {
+        frame_rx_free(&b->rx);
+        sendq_clear(&b->tx);
+        close(b->fd);
+    }
+    snapshot_ring_free(&b->snaps);
+    b->fd = -1;
+    b->up = 0;
+}
+
+static void queue_frame(bot_t* b, uint8_t type, const void* payload, uint16_t len) {
+    if (use_udp) {
+        if (udp_send(b->ep, b->conn, UDP_CH_SEQUENCED, type, payload, len) < 0) { send_fail++; return; }
+    } else {
+        msg_buf_t* m = msg_buf_frame(&frames, type, b->seq, payload, len);
+        if (!m) { send_fail++; return; }
+        int r = sendq_push(&b->tx, m, 0);
+        msg_buf_unref(m);
+        if (r != SENDQ_OK) { send_fail++; return; }
+    }
+    b->seq++;
+    sent_msgs++;
+    sent_bytes += FRAME_HDR_SIZE + len;
+}
+
+// One send tick for one bot: a move, then a timestamped ping.
+static void send_round(bot_t* b) {
+    if (!b->up) return;
+    next_position(b);
+    uint8_t mv[8];
+    size_t n = move_encode(mv, sizeof mv, layout, b->player < 0 ? 0 : b->player, b->x, b->y);
+    queue_frame(b, FRAME_MOVE, mv, (uint16_t)n);
+
+    int64_t now = mono_ns();
+    if (stalled && b - bots < nslow) {
+        // full-size pings, for full-size pongs nobody reads
+        static uint8_t big[FRAME_MAX_PAYLOAD];
+        memcpy(big, &now, sizeof now);
+        for (int i = 0; i < SLOW_PINGS; i++) queue_frame(b, FRAME_PING, big, sizeof big);
+        slow_msgs += 1 + SLOW_PINGS;
+    } else {
+        queue_frame(b, FRAME_PING, &now, sizeof now);
+    }
+
+    if (use_udp) {
+        udp_update(b->ep, now, &b->h);
+    } else if (sendq_flush(&b->tx, b->fd) < 0) {
+        net_loop_del(&loop, b->fd);
+        close_bot(b);
+    }
+}
+
+static void service_bot(bot_t* b, uint32_t events) {
+    if (use_udp) {
+        udp_poll(b->ep, mono_ns(), &b->h);
+        return;
+    }
+    if ((events & NET_WRITE) && sendq_flush(&b->tx, b->fd) < 0) events |= EPOLLERR;
+
+    int closed = (events & (EPOLLERR | EPOLLHUP)) != 0;
+    while (!closed && !(stalled && b - bots < nslow)) {
+        ssize_t n = frame_rx_fill(&b->rx, b->fd);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n <= 0) { closed = 1; break; }  // EOF, error or ENOBUFS
+        frame_t f;
+        int r;
+        while ((r = frame_rx_next(&b->rx, &f)) > 0) handle_frame(b, f.hdr.type, f.hdr.id, f.payload, f.hdr.len);
+        if (r < 0) closed = 1;
+    }
+    // ack the newest state once per drain; not counted as a sent message
+    if (!closed && b->ack_due >= 0) {
+        msg_buf_t* m = msg_buf_frame(&frames, FRAME_ACK, (uint32_t)b->ack_due, NULL, 0);
+        if (m && sendq_push(&b->tx, m, 0) == SENDQ_OK && sendq_flush(&b->tx, b->fd) < 0) closed = 1;
+        if (m) msg_buf_unref(m);
+        b->ack_due = -1;
+    }
+    if (closed) {
+        net_loop_del(&loop, b->fd);
+        close_bot(b);
+    }
+}
+
+// Drain every ready socket once; returns after timeout_ms at most.
+static void pump(int timeout_ms) {
+    int n = net_loop_wait(&loop, timeout_ms);
+    for (int i = 0; i < n; i++) {
+        int fd = loop.events[i].data.fd;
+        if (fd < 0 || fd >= fd_cap || bot_of_fd[fd] < 0) continue;  // -1: the ticker
+        bot_t* b = &bots[bot_of_fd[fd]];
+        if (b->fd == fd) service_bot(b, loop.events[i].events);
+    }
+}
+
+static int cmp_i64(const void* a, const void* b) {
+    int64_t x = *(const int64_t*)a, y = *(const int64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static double pct_of_us(const int64_t* sorted, size_t n, double p) {
+    if (n == 0) return 0.0;
+    size_t k = (size_t)(p * (double)(n - 1) + 0.5);
+    return (double)sorted[k] / 1000.0;
+}
+
+static double pct_us(double p) {
+    return pct_of_us(rtts, nrtt, p);
+}
+
+// Send a round on every tick for `ns`, then wait up to DRAIN_NS for the
+// pongs still in flight. Returns the seconds it took.
+static double run_for(tick_timer_t* ticker, int64_t ns) {
+    int64_t start = mono_ns();
+    int64_t end = start + ns;
+    int64_t now;
+    while ((now = mono_ns()) < end + DRAIN_NS) {
+        int n = net_loop_wait(&loop, 10);
+        for (int i = 0; i < n; i++) {
+            int fd = loop.events[i].data.fd;
+            if (fd == ticker->fd) {
+                int due = tick_timer_due(ticker);
+                if (due <= 0 || now >= end) continue;
+                for (int j = 0; j < nbots; j++) send_round(&bots[j]);
+                tick_timer_end(ticker, now);
+                continue;
+            }
+            if (fd < 0 || fd >= fd_cap) continue;
+            bot_t* b = &bots[bot_of_fd[fd]];
+            if (b->fd == fd) service_bot(b, loop.events[i].events);
+        }
+        if (use_udp)
+            for (int j = 0; j < nbots; j++) if (bots[j].ep) udp_update(bots[j].ep, mono_ns(), &bots[j].h);
+        if (now >= end && pongs == (sent_msgs - slow_msgs) / 2) break;
+    }
+    return (double)(mono_ns() - start) / 1e9;
+}
+
+// --- --idle ramp ---
+
+// A fresh connection timed from connect() to the pong of its first ping,
+// in ns; -1 if it failed or took over a second.
+static int64_t probe(const struct sockaddr_in* addr) {
+    int64_t t0 = mono_ns();
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    struct timeval tv = { 1, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+    frame_rx_t rx;
+    int64_t took = -1;
+    if (connect(fd, (const struct sockaddr*)addr, sizeof *addr) == 0 && net_set_nodelay(fd) == 0 &&
+        frame_send(fd, FRAME_JOIN, 0, NULL, 0) == 0 && frame_send(fd, FRAME_PING, 0, &t0, sizeof t0) == 0 &&
+        frame_rx_init(&rx, FRAME_RX_CAP) == 0) {
+        frame_t f;
+        int r = 0;
+        while (took < 0 && r >= 0 && frame_rx_fill(&rx, fd) > 0)
+            while ((r = frame_rx_next(&rx, &f)) > 0)
+                if (f.hdr.type == FRAME_PONG) took = mono_ns() - t0;
+        frame_rx_free(&rx);
+    }
+    close(fd);
+    return took;
+}
+
+// utime + stime of a process in clock ticks, -1 if unreadable
+static int64_t cpu_ticks(int pid) {
+    char path[64], buf[1024];
+    snprintf(path, sizeof path, "/proc/%d/stat", pid);
+    FILE* f = fopen(path, "r");
+    if (!f) return -1;
+    size_t n = fread(buf, 1, sizeof buf - 1, f);
+    fclose(f);
+    buf[n] = 0;
+    // skip "pid (comm)": comm may hold spaces; utime and stime are fields 14 and 15
+    char* p = strrchr(buf, ')');
+    unsigned long long ut, st;
+    if (!p || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &ut, &st) != 2) return -1;
+    return (int64_t)(ut + st);
+}
+
+// Open idle connections `step` at a time up to `max`, and at each level
+// time PROBES fresh connections and run the workload for `ns`. Returns the
+// seconds spent in the workload.
+static double ramp_idle(tick_timer_t* ticker, const struct sockaddr_in* addr, int max, int step, int64_t ns,
+                        int pid) {
+    double total = 0.0;
+    long hz = sysconf(_SC_CLK_TCK);
+    printf("%8s %10s %10s %10s %10s %10s %8s\n", "idle", "open ms", "join p50", "join max", "rtt p50", "rtt p99",
+           "cpu %");
+    while (nidle < max) {
+        int want = nidle + step < max ? nidle + step : max, failed = 0;
+        int64_t t0 = mono_ns();
+        for (; nidle < want; nidle++) {
+            if (open_bot(&bots[nbots + nidle], nbots + nidle, addr) < 0) {
+                fprintf(stderr, "idle connection %d: ", nidle);
+                perror("connect");
+                failed = 1;
+                break;
+            }
+        }
+        double open_ms = (double)(mono_ns() - t0) / 1e6;
+        for (int64_t settle = mono_ns() + 100000000LL; mono_ns() < settle;) pump(10);
+
+        int64_t join[PROBES];
+        size_t nj = 0;
+        for (int k = 0; k < PROBES; k++) {
+            int64_t took = probe(addr);
+            if (took >= 0) join[nj++] = took;
+        }
+        qsort(join, nj, sizeof *join, cmp_i64);
+
+        size_t first = nrtt;
+        int64_t cpu0 = pid > 0 ? cpu_ticks(pid) : -1;
+        double secs = run_for(ticker, ns);
+        int64_t cpu1 = pid > 0 ? cpu_ticks(pid) : -1;
+        total += secs;
+        qsort(rtts + first, nrtt - first, sizeof *rtts, cmp_i64);
+
+        char cpu[16] = "-";
+        if (cpu0 >= 0 && cpu1 >= 0) snprintf(cpu, sizeof cpu, "%.1f", 100.0 * (double)(cpu1 - cpu0) / (double)hz / secs);
+        printf("%8d %10.1f %10.1f %10.1f %10.1f %10.1f %8s", nidle, open_ms, pct_of_us(join, nj, 0.50),
+               nj ? (double)join[nj - 1] / 1000.0 : 0.0, pct_of_us(rtts + first, nrtt - first, 0.50),
+               pct_of_us(rtts + first, nrtt - first, 0.99), cpu);
+        if (nj < PROBES) printf("  (%zu/%d joins failed)", PROBES - nj, PROBES);
+        printf("\n");
+        if (failed) break;
+    }
+    printf("(join and rtt in us; join is connect() to the first pong)\n");
+    return total;
+}
+
+// Whether the server closed a stalled bot's connection: what it never read
+// is drained first, then EOF or a reset says so.
+static int kicked(bot_t* b) {
+    if (b->fd < 0) return 1;  // a write already failed
+    char buf[4096];
+    for (;;) {
+        ssize_t n = read(b->fd, buf, sizeof buf);
+        if (n > 0 || (n < 0 && errno == EINTR)) continue;
+        return n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+    }
+}
+
+static void raise_fd_limit(int want) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) < 0 || rl.rlim_cur >= (rlim_t)want) return;
+    rl.rlim_cur = rl.rlim_max < (rlim_t)want ? rl.rlim_max : (rlim_t)want;
+    setrlimit(RLIMIT_NOFILE, &rl);
+}
+
+int main(int argc, char** argv) {
+    const char* host = "127.0.0.1";
+    const char* csv = NULL;
+    int port = DEFAULT_PORT, rate = DEFAULT_RATE, duration = DEFAULT_DURATION;
+    int idle_max = 0, idle_step = 0, server_pid = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--clients") == 0 && i + 1 < argc) nbots = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) rate = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) duration = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--host") == 0 && i + 1 < argc) host = argv[++i];
+        else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) port = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--script") == 0 && i + 1 < argc) script = argv[++i];
+        else if (strcmp(argv[i], "--grid") == 0 && i + 1 < argc) grid = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--rooms") == 0 && i + 1 < argc) nrooms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) csv = argv[++i];
+        else if (strcmp(argv[i], "--udp") == 0) use_udp = 1;
+        else if (strcmp(argv[i], "--idle") == 0 && i + 1 < argc) idle_max = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--idle-step") == 0 && i + 1 < argc) idle_step = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--server-pid") == 0 && i + 1 < argc) server_pid = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--slow-readers") == 0 && i + 1 < argc) nslow = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--clients N] [--rate HZ] [--duration S] [--host IP] [--port P]\n"
+                            "          [--udp] [--script UDLR...] [--grid N] [--rooms N] [--csv FILE]\n"
+                            "          [--idle N] [--idle-step N] [--server-pid PID] [--slow-readers N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (nbots < 1 || rate < 1 || duration < 1 || nrooms < 1 || grid < 2 || (script && !*script)) {
+        fprintf(stderr, "clients, rate, duration, rooms must be positive, grid at least 2\n");
+        return 1;
+    }
+    if (idle_max < 0 || idle_step < 0 || (idle_max && use_udp)) {
+        fprintf(stderr, "idle counts must not be negative, and --idle is TCP only\n");
+        return 1;
+    }
+    if (nslow < 0 || nslow >= nbots || (nslow && use_udp)) {
+        fprintf(stderr, "slow readers must leave at least one bot reading, and are TCP only\n");
+        return 1;
+    }
+    if (idle_max && !idle_step) idle_step = idle_max < 10 ? 1 : idle_max / 10;
+    layout = move_layout_for(grid, 4);
+    srand((unsigned)mono_ns());
+    signal(SIGPIPE, SIG_IGN);  // a kicked slow reader fails its next write instead
+    raise_fd_limit(nbots + idle_max + 64);
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) { fprintf(stderr, "bad host %s\n", host); return 1; }
+
+    if (net_loop_init(&loop) < 0) { perror("epoll_create1"); exit(1); }
+    msg_pool_init(&frames, 0);
+    bots = calloc((size_t)nbots + (size_t)idle_max, sizeof *bots);
+    if (!bots) { perror("calloc"); exit(1); }
+    for (int i = 0; i < nbots; i++) {
+        if (open_bot(&bots[i], i, &addr) < 0) {
+            fprintf(stderr, "bot %d: ", i);
+            perror("connect");
+            nbots = i;
+            break;
+        }
+    }
+    if (nbots == 0) return 1;
+
+    // let the UDP handshakes and the 2D server's welcomes land (up to 1 s)
+    int64_t settle = mono_ns() + 1000000000LL;
+    int up = 0, rounds = 0;
+    while (mono_ns() < settle && (up < nbots || rounds++ < 10)) {
+        pump(10);
+        up = 0;
+        for (int i = 0; i < nbots; i++) {
+            if (use_udp && bots[i].ep) udp_update(bots[i].ep, mono_ns(), &bots[i].h);
+            up += bots[i].up;
+        }
+    }
+    printf("%d/%d bots connected to %s:%d over %s, %d Hz each for %d s\n",
+           up, nbots, host, port, use_udp ? "UDP" : "TCP", rate, duration);
+
+    tick_timer_t ticker;
+    if (tick_timer_init(&ticker, rate, 1) < 0) { perror("timerfd"); exit(1); }
+    track_fd(ticker.fd, -1);
+    net_loop_add(&loop, ticker.fd, NET_READ);
+
+    // ignore anything that arrived during setup
+    recv_msgs = recv_bytes = 0;
+    states = state_bytes = full_states = bad_states = 0;
+
+    stalled = 1;
+    int64_t ns = (int64_t)duration * 1000000000LL;
+    double secs = idle_max ? ramp_idle(&ticker, &addr, idle_max, idle_step, ns, server_pid) : run_for(&ticker, ns);
+
+    qsort(rtts, nrtt, sizeof *rtts, cmp_i64);
+    int alive = 0;
+    for (int i = 0; i < nbots; i++) alive += bots[i].up;
+    uint64_t pings = (sent_msgs - slow_msgs) / 2;
+    double lost = pings ? 100.0 * (double)(pings - pongs) / (double)pings : 0.0;
+
+    printf("sent     %llu msgs (%llu bytes), %.0f msg/s\n",
+           (unsigned long long)sent_msgs, (unsigned long long)sent_bytes, (double)sent_msgs / secs);
+    printf("received %llu msgs (%llu bytes), %.0f msg/s\n",
+           (unsigned long long)recv_msgs, (unsigned long long)recv_bytes, (double)recv_msgs / secs);
+    printf("per bot  %.0f B/s received, %.1f msg/s\n",
+           (double)recv_bytes / secs / nbots, (double)recv_msgs / secs / nbots);
+    if (states || bad_states)
+        printf("state    %.1f B per bot per tick at %d Hz, %llu states (%llu full, %llu undecodable)\n",
+               server_hz > 0 ? (double)state_bytes / nbots / (secs * server_hz) : 0.0, server_hz,
+               (unsigned long long)states, (unsigned long long)full_states, (unsigned long long)bad_states);
+    printf("pongs    %llu of %llu pings (%.2f%% lost), %llu send failures, %d/%d bots still up\n",
+           (unsigned long long)pongs, (unsigned long long)pings, lost, (unsigned long long)send_fail, alive, nbots);
+    printf("rtt us   p50 %.1f  p99 %.1f  p999 %.1f  max %.1f\n",
+           pct_us(0.50), pct_us(0.99), pct_us(0.999), nrtt ? (double)rtts[nrtt - 1] / 1000.0 : 0.0);
+    if (nslow) {
+        int gone = 0;
+        for (int i = 0; i < nslow; i++) gone += kicked(&bots[i]);
+        printf("slow     %d bots stopped reading (rtt above is the other %d), %d disconnected by the server\n",
+               nslow, nbots - nslow, gone);
+    }
+    printf("ticks    %llu sent, %llu skipped, max late %.2f ms\n",
+           (unsigned long long)ticker.tick, (unsigned long long)ticker.skipped, (double)ticker.max_late_ns / 1e6);
+
+    if (csv) {
+        FILE* f = fopen(csv, "a");
+        if (!f) { perror(csv); }
+        else {
+            if (ftell(f) == 0)
+                fprintf(f, "transport,clients,rate_hz,duration_s,sent,received,pings,pongs,"
+                           "send_msgs_per_s,recv_msgs_per_s,p50_us,p99_us,p999_us,max_us\n");
+            fprintf(f, "%s,%d,%d,%d,%llu,%llu,%llu,%llu,%.0f,%.0f,%.1f,%.1f,%.1f,%.1f\n",
+                    use_udp ? "udp" : "tcp", nbots, rate, duration,
+                    (unsigned long long)sent_msgs, (unsigned long long)recv_msgs,
+                    (unsigned long long)pings, (unsigned long long)pongs,
+                    (double)sent_msgs / secs, (double)recv_msgs / secs,
+                    pct_us(0.50), pct_us(0.99), pct_us(0.999),
+                    nrtt ? (double)rtts[nrtt - 1] / 1000.0 : 0.0);
+            fclose(f);
+        }
+    }
+
+    for (int i = 0; i < nbots + nidle; i++) close_bot(&bots[i]);
+    msg_pool_free(&frames);
+    tick_timer_close(&ticker);
+    net_loop_close(&loop);
+    free(bots);
+    free(bot_of_fd);
+    free(rtts);
+    return 0;
+}
@@ -0,0 +1,313 @@
+// Heap traffic and throughput of the server's per-tick network path.
+//
+// Headless and single-threaded, with no network: every client is one end
+// of a Unix socketpair and the bench plays the other. Each tick every
+// client pings and acks the newest state it has, the server side reads,
+// pongs and acks, the board steps with every player walking at random,
+// each client is sent its state (replicate.h) and the table flushes; then
+// the bench reads everything back. --churn percent of the clients
+// disconnect and are replaced every tick. The same run is made two ways:
+//   heap   frames from malloc, states copied in from the stack, a
+//          client's buffers and snapshots freed when it leaves
+//   pool   frames from slab pools (sendq.h), states built in a tick
+//          arena, client records and snapshots reused (client_table.h)
+// and for each it reports ticks per second and the malloc calls made per
+// tick after --warmup ticks, counted with alloc_count.h as the servers do
+// when built with -DCOUNT_ALLOCS.
+//
+//   poolbench [--clients N] [--ticks N] [--warmup N] [--churn PERCENT] [--view-radius CELLS]
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#define COUNT_ALLOCS 1         // always counted here
+#include "../Common/alloc_count.h"
+#include "../Common/client_table.h"
+#include "../Common/frame.h"
+#include "../Common/game_msg.h"
+#include "../Common/game_sim.h"
+#include "../Common/input_queue.h"
+#include "../Common/net_loop.h"
+#include "../Common/pool.h"
+#include "../Common/replicate.h"
+#include "../Common/sendq.h"
+#include "../Common/tick.h"
+
+// --- the bench ---
+
+#define GRID_PER_CLIENT 16     // board cells per client
+#define PING_SIZE 8
+
+typedef struct {
+    int fd;                    // the bench's end
+    int id;                    // server side client id
+    entity_t player;
+    frame_rx_t rx;
+    int64_t newest;            // newest state received, -1 none
+} peer_t;
+
+static int pooled;             // this run's mode
+static int nclients = 1000;
+static int view_radius = 8;
+static sim_t sim;
+static client_table_t clients;
+static msg_pool_t msgs;
+static arena_t tick_arena;
+static replica_t* replicas;    // by client slot
+static int replica_cap;
+static replica_view_t replication;
+static peer_t* peers;
+static uint32_t rng = 12345;
+static uint64_t tick;
+static uint64_t pongs, states;
+
+static uint32_t next_rand(void) {
+    rng = rng * 1664525u + 1013904223u;
+    return rng >> 8;
+}
+
+static replica_t* replica_of(client_t* c) {
+    if (c->slot >= replica_cap) {
+        int ncap = replica_cap ? replica_cap : 16;
+        while (ncap <= c->slot) ncap *= 2;
+        replica_t* r = realloc(replicas, (size_t)ncap * sizeof *r);
+        if (!r) { perror("realloc"); exit(1); }
+        memset(r + replica_cap, 0, (size_t)(ncap - replica_cap) * sizeof *r);
+        replicas = r;
+        replica_cap = ncap;
+    }
+    return &replicas[c->slot];
+}
+
+static void connect_peer(peer_t* p) {
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) { perror("socketpair"); exit(1); }
+    net_set_nonblocking(sv[0]);
+    net_set_nonblocking(sv[1]);
+    client_t* c = client_table_add(&clients, sv[0]);
+    if (!c) { perror("client_table_add"); exit(1); }
+    replica_t* r = replica_of(c);
+    if (pooled) replica_reset(r);
+    else replica_init(r);
+    if (pooled && replica_reserve(r, &replication) < 0) { perror("malloc"); exit(1); }
+    r->player = sim_spawn(&sim, c->id);
+
+    welcome_t w = { replica_player(r), 0, 30, sim.grid, nclients, view_radius };
+    uint8_t welcome[WELCOME_SIZE];
+    welcome_encode(welcome, &w);
+    client_send(&clients, c, FRAME_WELCOME, welcome, sizeof welcome);
+
+    p->fd = sv[1];
+    p->id = c->id;
+    p->player = r->player;
+    p->rx.head = p->rx.tail = 0;
+    p->newest = -1;
+}
+
+static void disconnect_peer(peer_t* p) {
+    client_t* c = client_table_by_id(&clients, p->id);
+    replica_t* r = &replicas[c->slot];
+    if (r->player != ENTITY_NONE) sim_destroy(&sim, r->player);
+    if (pooled) {
+        replica_reset(r);
+    } else {
+        replica_free(r);
+        replica_init(r);
+    }
+    close(c->fd);
+    client_table_remove(&clients, c);
+    if (!pooled) client_table_trim(&clients);
+    close(p->fd);
+}
+
+static void drop_flushed(client_t* c, void* ctx) {
+    fprintf(stderr, "client %d: write failed\n", c->id);
+    exit(1);
+}
+
+// The bench's side: a ping, and an ack of the newest state.
+static void send_peer(peer_t* p) {
+    uint8_t buf[2 * FRAME_HDR_SIZE + PING_SIZE];
+    uint64_t stamp = tick;
+    size_t n = frame_encode(buf, sizeof buf, FRAME_PING, (uint32_t)tick, &stamp, PING_SIZE);
+    if (p->newest >= 0) n += frame_encode(buf + n, sizeof buf - n, FRAME_ACK, (uint32_t)p->newest, NULL, 0);
+    if (write(p->fd, buf, n) != (ssize_t)n) { perror("write"); exit(1); }
+}
+
+static void read_peer(peer_t* p) {
+    for (;;) {
+        ssize_t n = frame_rx_fill(&p->rx, p->fd);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n <= 0) { perror("read"); exit(1); }
+        frame_t f;
+        while (frame_rx_next(&p->rx, &f) > 0) {
+            if (f.hdr.type == FRAME_STATE) {
+                p->newest = f.hdr.id;
+                states++;
+            } else if (f.hdr.type == FRAME_PONG) {
+                pongs++;
+            }
+        }
+    }
+}
+
+static void serve_client(client_t* c) {
+    for (;;) {
+        ssize_t n = client_read(&clients, c);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n <= 0) { perror("read"); exit(1); }
+    }
+    frame_t f;
+    while (client_next_frame(&clients, c, &f) > 0) {
+        if (f.hdr.type == FRAME_PING) client_send(&clients, c, FRAME_PONG, f.payload, f.hdr.len);
+        else if (f.hdr.type == FRAME_ACK) replica_ack(&replicas[c->slot], f.hdr.id);
+    }
+}
+
+// As the demo server does it: in the tick arena, or on the stack and then
+// copied into a frame of its own.
+static void replicate_to(client_t* c) {
+    replica_t* r = &replicas[c->slot];
+    state_hdr_t h;
+    msg_buf_t* state;
+    if (pooled) {
+        state = msg_buf_arena(&tick_arena, FRAME_MAX_PAYLOAD);
+        if (!state) return;
+        size_t len = replica_build(r, &sim, &replication, (uint32_t)tick, state->data + FRAME_HDR_SIZE,
+                                   FRAME_MAX_PAYLOAD, &h);
+        state = msg_buf_arena_end(&tick_arena, state, FRAME_STATE, (uint32_t)tick, (uint16_t)len);
+    } else {
+        uint8_t buf[FRAME_MAX_PAYLOAD];
+        size_t len = replica_build(r, &sim, &replication, (uint32_t)tick, buf, sizeof buf, &h);
+        state = len ? msg_buf_frame(NULL, FRAME_STATE, (uint32_t)tick, buf, (uint16_t)len) : NULL;
+    }
+    if (!state) return;
+    if (client_send_buf(&clients, c, state, 1) != SENDQ_DROPPED) replica_sent(r);
+    msg_buf_unref(state);
+}
+
+static void run_tick(int churn) {
+    for (int i = 0; i < nclients; i++) send_peer(&peers[i]);
+    for (int i = 0; i < clients.count; i++) serve_client(&clients.clients[i]);
+
+    // everyone off cooldown tries a random step on half of the ticks
+    for (int i = 0; i < sim.ents.count; i++) {
+        uint32_t r = next_rand();
+        if (r & 1 || sim_cooling(&sim, i, tick)) continue;
+        const int* d = input_dirs_[r >> 1 & 3];
+        sim_queue_move(&sim, entity_slot(sim.ents.handle[i]), sim.ents.x[i] + d[0], sim.ents.y[i] + d[1], 0);
+    }
+    sim_step(&sim, tick);
+    for (int i = 0; i < clients.count; i++) replicate_to(&clients.clients[i]);
+    client_table_flush(&clients, drop_flushed, NULL);
+    for (int i = 0; i < nclients; i++) read_peer(&peers[i]);
+
+    for (int k = 0; k < churn; k++) {
+        peer_t* p = &peers[next_rand() % (uint32_t)nclients];
+        disconnect_peer(p);
+        connect_peer(p);
+    }
+    tick++;
+}
+
+static void run(const char* name, int ticks, int warmup, int churn) {
+    int grid = 4;
+    while (grid * grid < nclients * GRID_PER_CLIENT) grid *= 2;
+    if (sim_init(&sim, grid, nclients, 2, NULL, view_radius > 0 ? view_radius : grid / 8) < 0) {
+        perror("malloc");
+        exit(1);
+    }
+    client_table_init(&clients);
+    if (pooled) {
+        msg_pool_init(&msgs, 0);
+        arena_init(&tick_arena, 0);
+        clients.msgs = &msgs;
+        clients.arena = &tick_arena;
+    }
+    move_layout_t layout = move_layout_for(grid, nclients);
+    replication = (replica_view_t){ view_radius, layout, state_max_entries(layout, FRAME_MAX_PAYLOAD), NULL };
+    if (replication.budget > nclients) replication.budget = nclients;
+    replication.in_range = malloc((size_t)nclients * sizeof *replication.in_range);
+    peers = calloc((size_t)nclients, sizeof *peers);
+    if (!replication.in_range || !peers) { perror("malloc"); exit(1); }
+    tick = 0;
+    pongs = states = 0;
+    for (int i = 0; i < nclients; i++) {
+        if (frame_rx_init(&peers[i].rx, FRAME_RX_CAP) < 0) { perror("malloc"); exit(1); }
+        connect_peer(&peers[i]);
+    }
+
+    for (int t = 0; t < warmup; t++) run_tick(churn);
+    uint64_t a0 = alloc_count(), p0 = pongs, s0 = states;
+    int64_t t0 = mono_ns();
+    for (int t = 0; t < ticks; t++) run_tick(churn);
+    double secs = (mono_ns() - t0) / 1e9;
+    uint64_t made = alloc_count() - a0;
+
+    printf("%-5s %9.0f ticks/s  %7.2f us/client-tick  %9.2f mallocs/tick  (%llu pongs, %llu states)\n", name,
+           ticks / secs, secs * 1e6 / ((double)ticks * nclients), (double)made / ticks,
+           (unsigned long long)(pongs - p0), (unsigned long long)(states - s0));
+    if (pooled)
+        printf("      %.1f KB of frame slabs, tick arena %.1f KB (peak %.1f KB in a tick)\n",
+               msg_pool_bytes(&msgs) / 1e3, arena_bytes(&tick_arena) / 1e3, tick_arena.peak / 1e3);
+
+    for (int i = 0; i < nclients; i++) {
+        disconnect_peer(&peers[i]);
+        frame_rx_free(&peers[i].rx);
+    }
+    client_table_free(&clients);
+    for (int i = 0; i < replica_cap; i++) replica_free(&replicas[i]);
+    free(replicas);
+    replicas = NULL;
+    replica_cap = 0;
+    if (pooled) {
+        msg_pool_free(&msgs);
+        arena_free(&tick_arena);
+    }
+    free(replication.in_range);
+    free(peers);
+    sim_free(&sim);
+}
+
+int main(int argc, char** argv) {
+    int ticks = 300;
+    int warmup = 1000;
+    double churnPct = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--clients") == 0 && i + 1 < argc) nclients = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) ticks = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) warmup = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--churn") == 0 && i + 1 < argc) churnPct = atof(argv[++i]);
+        else if (strcmp(argv[i], "--view-radius") == 0 && i + 1 < argc) view_radius = atoi(argv[++i]);
+        else {
+            printf("Usage: %s [--clients N] [--ticks N] [--warmup N] [--churn PERCENT] [--view-radius CELLS]\n",
+                   argv[0]);
+            return 1;
+        }
+    }
+    if (nclients < 1 || ticks < 1 || warmup < 0 || churnPct < 0 || view_radius < 0) {
+        printf("Counts must be positive\n");
+        return 1;
+    }
+    int churn = (int)(nclients * churnPct / 100 + 0.5);
+
+    // two descriptors per client
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < (rlim_t)(2 * nclients + 64)) {
+        rl.rlim_cur = rl.rlim_max < (rlim_t)(2 * nclients + 64) ? rl.rlim_max : (rlim_t)(2 * nclients + 64);
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    printf("%d clients, view radius %d, %d clients replaced per tick, %d ticks after %d of warm-up\n", nclients,
+           view_radius, churn, ticks, warmup);
+    pooled = 0;
+    run("heap", ticks, warmup, churn);
+    pooled = 1;
+    run("pool", ticks, warmup, churn);
+    return 0;
+}
@@ -1,155 +1,470 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
-#include <sys/select.h>
+
+#include "../Common/net_loop.h"
+#include "../Common/client_table.h"
+#include "../Common/alloc_count.h"
+#include "../Common/mailbox.h"
+#include "../Common/metrics.h"
+#include "../Common/profile.h"
+#include "../Common/tick.h"
+#include "../Common/udp_transport.h"
 
 #define PORT 8080
 #define MAX  1024
+#define UDP_TICK_HZ 50  // how often UDP acks/resends/keepalives go out
+#define MAX_SHARDS 64
+#define DEFAULT_STATS_EVERY 10  // seconds between --stats-file dumps
+#define DEFAULT_TRACE "server_trace.json"  // 'trace' with no path (-DPROFILE builds)
+
+// Console -> shard commands, delivered through each shard's mailbox.
+enum { MAIL_SEND = 1, MAIL_BROADCAST, MAIL_EXIT, MAIL_CLIENT_STATS };
 
+// One IO thread. Each shard has its own SO_REUSEPORT listen and UDP
+// sockets, event loop and client table, and owns its connections outright;
+// the kernel spreads new connections across shards. Nothing on the
+// per-packet path is shared between shards.
 typedef struct {
-    int id;      // simple numeric ID
-    int fd;      // socket descriptor
-    int active;
-} client_t;
+    int index;
+    pthread_t thread;
+    net_loop_t loop;
+    client_table_t clients;
+    int listenfd;
+    udp_endpoint_t udp;
+    udp_handler_t udp_handler;
+    tick_timer_t udp_ticker;
+    int udp_client[UDP_MAX_CONNS];  // UDP slot -> local client id
+    mailbox_t mail;
+    metrics_t metrics;              // written by this shard only
+    msg_pool_t msgs;                // frames queued to this shard's clients
+} shard_t;
 
-int main() {
-    int listenfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (listenfd < 0) { perror("socket"); exit(1); }
+static shard_t* shards;
+static int nshards = 1;
+static int64_t start_ns;
 
-    int opt = 1;
-    setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+// Periodic dumps are written by shard 0 from its UDP ticker.
+static FILE* stats_file;
+static int64_t stats_every_ns;
+static int64_t next_stats_ns;
 
-    struct sockaddr_in servaddr = {0};
-    servaddr.sin_family = AF_INET;
-    servaddr.sin_addr.s_addr = htonl(INADDR_ANY);
-    servaddr.sin_port = htons(PORT);
+// Client ids shown on the console are unique across shards: the slot part
+// of a shard-local id (see client_table.h) is interleaved with the shard
+// index, the generation bits are kept. With one shard ids are unchanged.
+// Shards take at most CT_SLOT_MASK / nshards slots each (shard_open), so
+// the interleaved slot never carries into the generation.
+static int global_id(shard_t* sh, int local) {
+    uint32_t slot = ((uint32_t)local & CT_SLOT_MASK) - 1;
+    return (int)(((uint32_t)local & ~CT_SLOT_MASK) | (slot * (uint32_t)nshards + (uint32_t)sh->index + 1));
+}
+
+static int shard_of(int id) { return (int)((((uint32_t)id & CT_SLOT_MASK) - 1) % (uint32_t)nshards); }
 
-    if (bind(listenfd, (struct sockaddr*)&servaddr, sizeof(servaddr)) < 0) {
-        perror("bind"); exit(1);
+static int local_id(int id) {
+    uint32_t low = ((uint32_t)id & CT_SLOT_MASK) - 1;
+    return (int)(((uint32_t)id & ~CT_SLOT_MASK) | (low / (uint32_t)nshards + 1));
+}
+
+static void drop_client(client_t* c, void* ctx) {
+    shard_t* sh = ctx;
+    if (c->udp >= 0) {
+        udp_disconnect(&sh->udp, c->udp);
+    } else {
+        net_loop_del(&sh->loop, c->fd);
+        close(c->fd);
     }
-    if (listen(listenfd, 10) < 0) { perror("listen"); exit(1); }
+    client_table_remove(&sh->clients, c);
+}
 
-    fd_set master, read_fds;
-    FD_ZERO(&master);
-    FD_SET(listenfd, &master);
-    FD_SET(STDIN_FILENO, &master);
-    int fdmax = (listenfd > STDIN_FILENO) ? listenfd : STDIN_FILENO;
+// Queue a frame for any client, whichever transport it is on.
+static int send_to(shard_t* sh, client_t* c, uint8_t type, const void* payload, uint16_t len) {
+    if (c->udp >= 0)
+        return udp_send(&sh->udp, c->udp, UDP_CH_RELIABLE, type, payload, len) < 0 ? SENDQ_KICK : SENDQ_OK;
+    return client_send(&sh->clients, c, type, payload, len);
+}
 
-    client_t clients[FD_SETSIZE];
-    for (int i = 0; i < FD_SETSIZE; i++) clients[i].active = 0;
+// --- UDP transport callbacks ---
 
-    int next_id = 1;
+static void udp_connected(udp_endpoint_t* ep, int s, void* user) {
+    shard_t* sh = user;
+    client_t* c = client_table_add(&sh->clients, -1);
+    if (!c) { udp_disconnect(ep, s); return; }
+    c->udp = s;
+    sh->udp_client[s] = c->id;
+    printf("New UDP client connected with id %d\n", global_id(sh, c->id));
+}
 
-    printf("Server listening on port %d\n", PORT);
-    printf("Commands from server console:\n");
-    printf("   <id> <message>   send message to a client\n");
-    printf("   exit             shut down server (sends exit to all)\n");
+static void udp_message(udp_endpoint_t* ep, int s, uint8_t type,
+                        const uint8_t* payload, uint16_t len, void* user) {
+    shard_t* sh = user;
+    client_t* c = client_table_by_id(&sh->clients, sh->udp_client[s]);
+    if (!c) return;
+    c->frames_in++;
+    c->bytes_in += len;
+    metrics_add(&sh->metrics, MC_FRAMES_IN, 1);
+    metrics_add(&sh->metrics, MC_BYTES_IN, len);
+    if (type == FRAME_EXIT) {
+        printf("Client %d requested exit\n", global_id(sh, c->id));
+        drop_client(c, sh);
+    } else if (type == FRAME_TEXT) {
+        printf("Client %d: %.*s\n", global_id(sh, c->id), (int)len, (const char*)payload);
+    } else if (type == FRAME_PING) {
+        udp_send(ep, s, UDP_CH_SEQUENCED, FRAME_PONG, payload, len);
+    }
+}
+
+static void udp_disconnected(udp_endpoint_t* ep, int s, void* user) {
+    shard_t* sh = user;
+    client_t* c = client_table_by_id(&sh->clients, sh->udp_client[s]);
+    if (!c) return;
+    printf("UDP client %d disconnected\n", global_id(sh, c->id));
+    client_table_remove(&sh->clients, c);  // the transport releases the slot itself
+}
 
+// --- shard event handlers ---
+
+static void accept_clients(shard_t* sh) {
     for (;;) {
-        read_fds = master;
-        if (select(fdmax + 1, &read_fds, NULL, NULL, NULL) < 0) {
-            perror("select");
+        int newfd = accept(sh->listenfd, NULL, NULL);
+        if (newfd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                perror("accept");
+            if (errno == EINTR) continue;
             break;
         }
+        client_t* c = client_table_add(&sh->clients, newfd);
+        if (!c) {
+            fprintf(stderr, "client table full, dropping fd %d\n", newfd);
+            close(newfd);
+            continue;
+        }
+        net_set_nonblocking(newfd);
+        net_loop_add(&sh->loop, newfd, NET_READ | NET_WRITE | NET_EDGE);
+        printf("New client connected with id %d (fd=%d)\n", global_id(sh, c->id), newfd);
+    }
+}
 
-        // --- server console input ---
-        if (FD_ISSET(STDIN_FILENO, &read_fds)) {
-            char line[MAX];
-            if (!fgets(line, sizeof line, stdin)) continue;
-
-            if (strncmp(line, "exit", 4) == 0) {
-                // tell all clients to exit and close
-                for (int i = 0; i < FD_SETSIZE; i++) {
-                    if (clients[i].active) {
-                        write(clients[i].fd, "exit\n", 5);
-                        close(clients[i].fd);
-                        clients[i].active = 0;
-                    }
-                }
-                printf("Server shutting down.\n");
+static void service_client(shard_t* sh, int fd, uint32_t events) {
+    client_t* c = client_table_by_fd(&sh->clients, fd);
+    if (!c) return;
+    int cid = global_id(sh, c->id);
+
+    // --- socket drained its send buffer: finish queued output ---
+    if (events & NET_WRITE) {
+        if (client_flush(&sh->clients, c) < 0) {
+            printf("Client fd %d disconnected\n", fd);
+            drop_client(c, sh);
+            return;
+        }
+    }
+    if (!(events & (NET_READ | EPOLLHUP | EPOLLERR))) return;
+
+    // --- existing client activity: read until EAGAIN ---
+    // one read() may carry many frames, or only part of one
+    int closed = 0;
+    while (!closed) {
+        ssize_t n = client_read(&sh->clients, c);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n <= 0) {
+            // client closed (or sent garbage that overflowed the buffer)
+            printf("Client fd %d disconnected\n", fd);
+            closed = 1;
+            break;
+        }
+
+        frame_t f;
+        int r;
+        while ((r = client_next_frame(&sh->clients, c, &f)) > 0) {
+            if (f.hdr.type == FRAME_EXIT) {
+                // drop only this client, after a best-effort goodbye
+                client_send(&sh->clients, c, FRAME_EXIT, NULL, 0);
+                client_flush(&sh->clients, c);
+                printf("Client %d requested exit\n", cid);
+                closed = 1;
                 break;
-            } else {
-                // expected format:  <id> <message>
-                int id;
-                char msg[MAX];
-                if (sscanf(line, "%d %[^\n]", &id, msg) == 2) {
-                    int sent = 0;
-                    for (int i = 0; i < FD_SETSIZE; i++) {
-                        if (clients[i].active && clients[i].id == id) {
-                            write(clients[i].fd, msg, strlen(msg));
-                            write(clients[i].fd, "\n", 1);
-                            printf("Sent to client %d: %s\n", id, msg);
-                            sent = 1;
-                            break;
-                        }
-                    }
-                    if (!sent) printf("No such client id: %d\n", id);
-                } else {
-                    printf("Usage: <id> <message>\n");
-                }
             }
+            if (f.hdr.type == FRAME_TEXT)
+                printf("Client %d: %.*s\n", cid, (int)f.hdr.len, (const char*)f.payload);
+            else if (f.hdr.type == FRAME_PING && client_send(&sh->clients, c, FRAME_PONG, f.payload, f.hdr.len) == SENDQ_KICK)
+                closed = 1;
+            // NOTE: we no longer echo chat back to the client
+        }
+        if (r < 0) {
+            printf("Client %d sent a malformed frame\n", cid);
+            closed = 1;
         }
+    }
+    if (closed) drop_client(c, sh);
+}
 
-        // --- existing client activity ---
-        for (int i = 0; i <= fdmax; i++) {
-            if (i == listenfd || i == STDIN_FILENO) continue;
-            if (!FD_ISSET(i, &read_fds)) continue;
-
-            char buf[MAX];
-            int n = read(i, buf, sizeof buf - 1);
-            if (n <= 0) {
-                // client closed
-                close(i);
-                FD_CLR(i, &master);
-                for (int j = 0; j < FD_SETSIZE; j++)
-                    if (clients[j].active && clients[j].fd == i) clients[j].active = 0;
-                printf("Client fd %d disconnected\n", i);
+// Apply console commands posted to this shard. Returns 0 on MAIL_EXIT.
+static int service_mail(shard_t* sh) {
+    int running = 1;
+    mail_t* m = mailbox_take(&sh->mail);
+    while (m) {
+        if (m->kind == MAIL_SEND) {
+            client_t* c = client_table_by_id(&sh->clients, m->id);
+            if (!c) {
+                printf("No such client id: %d\n", global_id(sh, m->id));
+            } else if (send_to(sh, c, FRAME_TEXT, m->data, m->len) == SENDQ_KICK) {
+                printf("Client %d is not reading, disconnecting\n", global_id(sh, m->id));
+                drop_client(c, sh);
             } else {
-                buf[n] = '\0';
-                // find client id
-                int cid = -1;
-                for (int j = 0; j < FD_SETSIZE; j++)
-                    if (clients[j].active && clients[j].fd == i) { cid = clients[j].id; break; }
-
-                if (strncmp(buf, "exit", 4) == 0) {
-                    // drop only this client
-                    write(i, "exit\n", 5);
-                    close(i);
-                    FD_CLR(i, &master);
-                    for (int j = 0; j < FD_SETSIZE; j++)
-                        if (clients[j].fd == i) clients[j].active = 0;
-                    printf("Client %d requested exit\n", cid);
-                } else {
-                    printf("Client %d: %s", cid, buf);
-                    // NOTE: we no longer echo back to the client
-                }
+                printf("Sent to client %d: %.*s\n", global_id(sh, m->id), (int)m->len, m->data);
+            }
+        } else if (m->kind == MAIL_BROADCAST || m->kind == MAIL_EXIT) {
+            // serialised once per shard, shared by every TCP client's queue
+            uint8_t type = m->kind == MAIL_EXIT ? FRAME_EXIT : FRAME_TEXT;
+            msg_buf_t* b = msg_buf_frame(&sh->msgs, type, 0, m->data, m->len);
+            for (int i = 0; b && i < sh->clients.count; ) {
+                client_t* c = &sh->clients.clients[i];
+                int r = c->udp >= 0 ? send_to(sh, c, type, m->data, m->len)
+                                    : client_send_buf(&sh->clients, c, b, 0);
+                if (r == SENDQ_KICK) { drop_client(c, sh); continue; }
+                i++;
+            }
+            msg_buf_unref(b);
+            if (m->kind == MAIL_EXIT) running = 0;
+        } else if (m->kind == MAIL_CLIENT_STATS) {
+            for (int i = 0; i < sh->clients.count; i++) {
+                client_t* c = &sh->clients.clients[i];
+                printf("  client %-8d shard %d %s  in %llu B / %llu frames  out %llu B  queued %zu B\n",
+                       global_id(sh, c->id), sh->index, c->udp >= 0 ? "udp" : "tcp",
+                       (unsigned long long)c->bytes_in, (unsigned long long)c->frames_in,
+                       (unsigned long long)c->tx.sent, c->tx.bytes);
             }
         }
+        mail_t* next = m->next;
+        free(m);
+        m = next;
+    }
+    return running;
+}
 
-        // --- new connection? ---
-        if (FD_ISSET(listenfd, &read_fds)) {
-            int newfd = accept(listenfd, NULL, NULL);
-            if (newfd >= 0) {
-                FD_SET(newfd, &master);
-                if (newfd > fdmax) fdmax = newfd;
-
-                for (int i = 0; i < FD_SETSIZE; i++) {
-                    if (!clients[i].active) {
-                        clients[i].active = 1;
-                        clients[i].fd = newfd;
-                        clients[i].id = next_id++;
-                        break;
+// Sum every shard's counters; safe from any thread.
+static void collect_stats(metrics_t* total) {
+    metrics_init(total);
+    for (int i = 0; i < nshards; i++) {
+        metrics_t snap;
+        metrics_snapshot(&snap, &shards[i].metrics);
+        metrics_merge(total, &snap);
+    }
+}
+
+static void* shard_main(void* arg) {
+    shard_t* sh = arg;
+    char name[32];
+    snprintf(name, sizeof name, "shard %d", sh->index);
+    prof_thread_name(name);
+
+    int running = 1;
+    while (running) {
+        int nready = net_loop_wait(&sh->loop, -1);
+        if (nready < 0) {
+            perror("epoll_wait");
+            break;
+        }
+        PROF_SCOPE("wakeup");
+        int64_t woke = mono_ns();
+        uint64_t allocs = alloc_count();
+
+        for (int e = 0; e < nready && running; e++) {
+            int fd = sh->loop.events[e].data.fd;
+            if (fd == sh->mail.efd) {
+                PROF_SCOPE("service_mail");
+                running = service_mail(sh);
+            } else if (fd == sh->udp.fd) {
+                // --- UDP datagrams (recvmmsg batches) and the UDP ticker ---
+                // replies go out right away, batched per wakeup like TCP
+                PROF_SCOPE("udp_poll");
+                int64_t now = mono_ns();
+                udp_poll(&sh->udp, now, &sh->udp_handler);
+                udp_update(&sh->udp, now, &sh->udp_handler);
+            } else if (fd == sh->udp_ticker.fd) {
+                if (tick_timer_due(&sh->udp_ticker) > 0) {
+                    PROF_SCOPE("udp_tick");
+                    int64_t began = mono_ns();
+                    udp_update(&sh->udp, began, &sh->udp_handler);
+                    tick_timer_end(&sh->udp_ticker, began);
+                    metrics_observe(&sh->metrics, MH_TICK_NS, (uint64_t)(mono_ns() - began));
+                    metrics_add(&sh->metrics, MC_TICKS, 1);
+                    if (sh->index == 0 && stats_file && began >= next_stats_ns) {
+                        metrics_t total;
+                        collect_stats(&total);
+                        metrics_dump(stats_file, &total, (began - start_ns) / 1e9);
+                        next_stats_ns = began + stats_every_ns;
                     }
                 }
-                printf("New client connected with id %d (fd=%d)\n",
-                       next_id - 1, newfd);
+            } else if (fd == sh->listenfd) {
+                // --- new connections: drain the accept queue (edge-triggered) ---
+                PROF_SCOPE("accept_clients");
+                accept_clients(sh);
+            } else {
+                PROF_SCOPE("service_client");
+                service_client(sh, fd, sh->loop.events[e].events);
             }
         }
+
+        // one writev per client for everything queued during this wakeup
+        {
+            PROF_SCOPE("flush");
+            client_table_flush(&sh->clients, drop_client, sh);
+        }
+        if (!running) udp_update(&sh->udp, mono_ns(), &sh->udp_handler);
+
+        metrics_set(&sh->metrics, MC_UDP_IN, sh->udp.packets_in);
+        metrics_set(&sh->metrics, MC_UDP_OUT, sh->udp.packets_out);
+        metrics_observe(&sh->metrics, MH_WAKE_NS, (uint64_t)(mono_ns() - woke));
+        metrics_add(&sh->metrics, MC_ALLOCS, alloc_count() - allocs);
+    }
+
+    while (sh->clients.count > 0) drop_client(&sh->clients.clients[0], sh);
+    return NULL;
+}
+
+static int shard_open(shard_t* sh, int index) {
+    sh->index = index;
+
+    sh->listenfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sh->listenfd < 0) { perror("socket"); return -1; }
+
+    int opt = 1;
+    setsockopt(sh->listenfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    // every shard binds the same port; the kernel load-balances accepts
+    setsockopt(sh->listenfd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+
+    struct sockaddr_in servaddr = {0};
+    servaddr.sin_family = AF_INET;
+    servaddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    servaddr.sin_port = htons(PORT);
+
+    if (bind(sh->listenfd, (struct sockaddr*)&servaddr, sizeof(servaddr)) < 0) {
+        perror("bind"); return -1;
+    }
+    if (listen(sh->listenfd, SOMAXCONN) < 0) { perror("listen"); return -1; }
+
+    net_set_nonblocking(sh->listenfd);
+
+    if (net_loop_init(&sh->loop) < 0) return -1;
+    net_loop_add(&sh->loop, sh->listenfd, NET_READ | NET_EDGE);
+
+    metrics_init(&sh->metrics);
+    client_table_init(&sh->clients);
+    sh->clients.max_slots = CT_SLOT_MASK / nshards;  // so global_id() fits the slot bits
+    sh->clients.metrics = &sh->metrics;
+    msg_pool_init(&sh->msgs, 0);
+    sh->clients.msgs = &sh->msgs;
+
+    // UDP transport on the same port number, serviced on its own ticker
+    sh->udp_handler = (udp_handler_t){ udp_connected, udp_message, udp_disconnected, sh };
+    if (udp_open(&sh->udp, PORT, 1) < 0 || tick_timer_init(&sh->udp_ticker, UDP_TICK_HZ, 1) < 0) return -1;
+    sh->udp.msgs = &sh->msgs;
+    net_loop_add(&sh->loop, sh->udp.fd, NET_READ | NET_EDGE);
+    net_loop_add(&sh->loop, sh->udp_ticker.fd, NET_READ);
+
+    if (mailbox_init(&sh->mail) < 0) { perror("eventfd"); return -1; }
+    net_loop_add(&sh->loop, sh->mail.efd, NET_READ);
+    return 0;
+}
+
+static void shard_close(shard_t* sh) {
+    client_table_free(&sh->clients);
+    udp_close(&sh->udp);
+    msg_pool_free(&sh->msgs);
+    mailbox_destroy(&sh->mail);
+    tick_timer_close(&sh->udp_ticker);
+    net_loop_close(&sh->loop);
+    close(sh->listenfd);
+}
+
+int main(int argc, char** argv) {
+    const char* stats_path = NULL;
+    int stats_every = DEFAULT_STATS_EVERY;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--shards") == 0 && i + 1 < argc) nshards = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--stats-file") == 0 && i + 1 < argc) stats_path = argv[++i];
+        else if (strcmp(argv[i], "--stats-every") == 0 && i + 1 < argc) stats_every = atoi(argv[++i]);
+        else { printf("Usage: %s [--shards N] [--stats-file PATH] [--stats-every SECONDS]\n", argv[0]); return 1; }
+    }
+    if (nshards < 1 || nshards > MAX_SHARDS) { printf("Shards must be 1..%d\n", MAX_SHARDS); return 1; }
+    if (stats_every < 1) { printf("Stats interval must be at least 1 second\n"); return 1; }
+
+    // a client that vanishes mid-flush is handled by the write error
+    signal(SIGPIPE, SIG_IGN);
+
+    start_ns = mono_ns();
+    if (stats_path) {
+        stats_file = fopen(stats_path, "a");
+        if (!stats_file) { perror(stats_path); return 1; }
+        stats_every_ns = (int64_t)stats_every * 1000000000LL;
+        next_stats_ns = start_ns + stats_every_ns;
+    }
+
+    shards = calloc((size_t)nshards, sizeof *shards);
+    if (!shards) { perror("calloc"); exit(1); }
+    for (int i = 0; i < nshards; i++)
+        if (shard_open(&shards[i], i) < 0) exit(1);
+    for (int i = 0; i < nshards; i++)
+        pthread_create(&shards[i].thread, NULL, shard_main, &shards[i]);
+
+    printf("Server listening on port %d (TCP and UDP, %d IO thread%s)\n",
+           PORT, nshards, nshards > 1 ? "s" : "");
+    printf("Commands from server console:\n");
+    printf("   <id> <message>   send message to a client\n");
+    printf("   all <message>    send message to every client\n");
+    printf("   stats            print server metrics ('stats clients' lists clients)\n");
+    printf("   trace [path]     write a Chrome trace of recent shard activity (-DPROFILE builds)\n");
+    printf("   exit             shut down server (sends exit to all)\n");
+
+    // --- server console input: routed to the owning shard(s) ---
+    char line[MAX];
+    while (fgets(line, sizeof line, stdin)) {
+        int id;
+        char msg[MAX];
+        if (strncmp(line, "exit", 4) == 0) {
+            // tell all clients to exit
+            for (int i = 0; i < nshards; i++) mailbox_post(&shards[i].mail, MAIL_EXIT, 0, NULL, 0);
+            printf("Server shutting down.\n");
+            break;
+        } else if (strncmp(line, "stats clients", 13) == 0) {
+            for (int i = 0; i < nshards; i++) mailbox_post(&shards[i].mail, MAIL_CLIENT_STATS, 0, NULL, 0);
+        } else if (strncmp(line, "stats", 5) == 0) {
+            metrics_t total;
+            collect_stats(&total);
+            printf("Server metrics after %.1f s (%d shard%s):\n", (mono_ns() - start_ns) / 1e9,
+                   nshards, nshards > 1 ? "s" : "");
+            metrics_print(stdout, &total);
+        } else if (strncmp(line, "trace", 5) == 0) {
+            // shards keep recording while their rings are copied
+            char path[MAX];
+            if (sscanf(line + 5, "%1023s", path) != 1) strcpy(path, DEFAULT_TRACE);
+            long n = prof_write_trace(path);
+            if (n < 0) perror(errno == ENOSYS ? "trace (build with -DPROFILE)" : path);
+            else printf("Wrote %ld trace events to %s\n", n, path);
+        } else if (sscanf(line, "all %[^\n]", msg) == 1) {
+            for (int i = 0; i < nshards; i++)
+                mailbox_post(&shards[i].mail, MAIL_BROADCAST, 0, msg, (uint16_t)strlen(msg));
+        } else if (sscanf(line, "%d %[^\n]", &id, msg) == 2) {
+            // expected format:  <id> <message>
+            if (id > 0) mailbox_post(&shards[shard_of(id)].mail, MAIL_SEND, local_id(id), msg, (uint16_t)strlen(msg));
+            else printf("No such client id: %d\n", id);
+        } else {
+            printf("Usage: <id> <message>\n");
+        }
     }
 
-    close(listenfd);
+    for (int i = 0; i < nshards; i++) {
+        pthread_join(shards[i].thread, NULL);
+        shard_close(&shards[i]);
+    }
+    free(shards);
+    if (stats_file) fclose(stats_file);
     return 0;
 }
@@ -0,0 +1,131 @@
+// Matches stepped per second on one core: many tiny rooms through the
+// batch kernel (Common/batch_sim.h) against the general simulation.
+//
+// Headless and single-threaded. Every room is the original game, a 16x16
+// board with four players, and each player holds a random direction on
+// about half of the ticks. Reports, per room and tick:
+//   sim     one game_sim.h sim_t per room, stepped one room at a time,
+//           which is what hosting rooms costs without the kernel (at most
+//           --sim-rooms of them, it is slow)
+//   scalar  batch_step_scalar(), all rooms in one call, player by player
+//   vector  batch_step(), all rooms in one call, BATCH_LANES at a time
+// and checks that all three end with the players in the same places.
+// Build with -O2; -march=native lets the vectors use AVX2 or AVX-512.
+//
+//   BatchSimBench [--rooms N] [--ticks N] [--sim-rooms N]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../Common/batch_sim.h"
+#include "../Common/game_sim.h"
+#include "../Common/tick.h"
+
+#define GRID 16
+#define PLAYERS 4
+#define COOLDOWN 5             // ticks, 0.15 s at 30 Hz
+#define FRAMES 64              // input frames generated, cycled through
+
+// Input frame f for every player, 0 (none) half the time
+uint8_t* makeInputs(int n) {
+    uint8_t* in = malloc((size_t)FRAMES * n);
+    if (!in) return NULL;
+    uint32_t rng = 12345;
+    for (size_t i = 0; i < (size_t)FRAMES * n; i++) {
+        rng = rng * 1664525u + 1013904223u;
+        in[i] = rng >> 31 ? (uint8_t)(1 + (rng >> 28 & 3)) : 0;
+    }
+    return in;
+}
+
+void report(const char* name, double ns, long long roomTicks, double baseline) {
+    printf("%-7s %8.2f ns/room-tick  %8.2f M rooms/s", name, ns / roomTicks, roomTicks / ns * 1e3);
+    if (baseline > 0) printf("  %6.1fx sim", baseline / (ns / roomTicks));
+    printf("\n");
+}
+
+int main(int argc, char** argv) {
+    int rooms = 10000;
+    int ticks = 1000;
+    int simRooms = 1000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rooms") == 0 && i + 1 < argc) rooms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) ticks = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--sim-rooms") == 0 && i + 1 < argc) simRooms = atoi(argv[++i]);
+        else { printf("Usage: %s [--rooms N] [--ticks N] [--sim-rooms N]\n", argv[0]); return 1; }
+    }
+    if (rooms < 1 || ticks < 1 || simRooms < 0) { printf("Counts must be positive\n"); return 1; }
+    if (simRooms > rooms) simRooms = rooms;
+
+    int n = rooms * PLAYERS;
+    uint8_t* inputs = makeInputs(n);
+    batch_sim_t scalar, vec;
+    sim_t* sims = calloc(simRooms ? (size_t)simRooms : 1, sizeof *sims);
+    if (!inputs || !sims || batch_init(&scalar, rooms, PLAYERS, GRID, COOLDOWN) < 0 ||
+        batch_init(&vec, rooms, PLAYERS, GRID, COOLDOWN) < 0) {
+        perror("malloc");
+        return 1;
+    }
+    for (int r = 0; r < simRooms; r++) {
+        if (sim_init(&sims[r], GRID, PLAYERS, COOLDOWN, NULL, 4) < 0) { perror("malloc"); return 1; }
+        for (int k = 0; k < PLAYERS; k++) sim_spawn(&sims[r], k);
+    }
+    printf("%d rooms of %d players on %dx%d, %d ticks, %d-lane vectors\n", rooms, PLAYERS, GRID, GRID, ticks,
+           BATCH_LANES);
+
+    // the general simulation: an input only reaches a player off cooldown,
+    // which is what the kernel does with it
+    double simNs = 0;
+    if (simRooms) {
+        int64_t t0 = mono_ns();
+        for (int t = 0; t < ticks; t++) {
+            const uint8_t* in = inputs + (size_t)(t % FRAMES) * n;
+            for (int r = 0; r < simRooms; r++) {
+                sim_t* s = &sims[r];
+                for (int i = 0; i < s->ents.count; i++) {
+                    int p = entity_slot(s->ents.handle[i]), d = in[r * PLAYERS + p];
+                    if (d && !sim_cooling(s, i, (uint64_t)t))
+                        sim_queue_move(s, p, s->ents.x[i] + input_dirs_[d - 1][0], s->ents.y[i] + input_dirs_[d - 1][1], 0);
+                }
+                sim_step(s, (uint64_t)t);
+            }
+        }
+        simNs = (double)(mono_ns() - t0);
+    }
+
+    long long scalarMoves = 0, vecMoves = 0;
+    int64_t t0 = mono_ns();
+    for (int t = 0; t < ticks; t++) scalarMoves += batch_step_scalar(&scalar, t, inputs + (size_t)(t % FRAMES) * n);
+    double scalarNs = (double)(mono_ns() - t0);
+
+    t0 = mono_ns();
+    for (int t = 0; t < ticks; t++) vecMoves += batch_step(&vec, t, inputs + (size_t)(t % FRAMES) * n);
+    double vecNs = (double)(mono_ns() - t0);
+
+    double simPer = simRooms ? simNs / ((long long)simRooms * ticks) : 0;
+    if (simRooms) report("sim", simNs, (long long)simRooms * ticks, 0);
+    report("scalar", scalarNs, (long long)rooms * ticks, simPer);
+    report("vector", vecNs, (long long)rooms * ticks, simPer);
+    printf("moves   %.2f per room-tick, vector %.1fx scalar\n", (double)vecMoves / ((long long)rooms * ticks),
+           scalarNs / vecNs);
+
+    // all three must agree
+    int same = scalarMoves == vecMoves && memcmp(scalar.x, vec.x, (size_t)n * sizeof *vec.x) == 0 &&
+               memcmp(scalar.y, vec.y, (size_t)n * sizeof *vec.y) == 0 &&
+               memcmp(scalar.ready, vec.ready, (size_t)n * sizeof *vec.ready) == 0;
+    for (int r = 0; r < simRooms && same; r++) {
+        const sim_t* s = &sims[r];
+        for (int i = 0; i < s->ents.count; i++) {
+            int k = r * PLAYERS + entity_slot(s->ents.handle[i]);
+            if (s->ents.x[i] != vec.x[k] || s->ents.y[i] != vec.y[k]) same = 0;
+        }
+    }
+    printf("check   %s\n", same ? "scalar, vector and sim agree" : "MISMATCH");
+
+    for (int r = 0; r < simRooms; r++) sim_free(&sims[r]);
+    free(sims);
+    batch_free(&scalar);
+    batch_free(&vec);
+    free(inputs);
+    return same ? 0 : 1;
+}
@@ -0,0 +1,242 @@
+// Bytes per update and ns per entity of the movement/state codec
+// (Common/bitpack.h, Common/game_msg.h) as the board grows.
+//
+// Headless. For each board size, --players entities start at random places
+// and about a tenth of them move one cell each update. Per update it
+// reports:
+//   packet  one move_encode() per moved entity, which is what a client
+//           sends: bytes per move
+//   list    move_encode_list() / move_decode_list() of every entity, next
+//           to the same through the bit writer and reader
+//           (move_encode_list_bitwise()), which must give the same bytes
+//   full    state_encode() with no baseline, and state_decode()
+//   delta   state_encode() against the previous update, and state_decode()
+//           chained the way a client applies them
+// in bytes per update and encode/decode ns per entity, next to raw int32
+// (id, x, y) triples at 12 bytes an entity. Every decode is checked against
+// what was encoded.
+//
+//   CodecBench [--players N] [--updates N] [--max-grid N]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../Common/bitpack.h"
+#include "../Common/game_msg.h"
+#include "../Common/tick.h"
+
+#define FRAMES 64              // updates generated, cycled through
+
+uint32_t rng = 12345;
+
+uint32_t nextRandom(void) {
+    rng = rng * 1664525u + 1013904223u;
+    return rng >> 8;
+}
+
+// frames[0] at random, then a tenth of the entities step each frame
+int makeFrames(snapshot_t* frames, int n, int grid) {
+    for (int f = 0; f < FRAMES; f++) {
+        snapshot_t* s = &frames[f];
+        if (snapshot_reserve(s, n) < 0) return -1;
+        s->tick = (uint32_t)f;
+        s->n = n;
+        for (int i = 0; i < n; i++) {
+            snapshot_entry_t e = { i, (int32_t)(nextRandom() % (uint32_t)grid), (int32_t)(nextRandom() % (uint32_t)grid) };
+            if (f > 0) {
+                e = frames[f - 1].e[i];
+                if (nextRandom() % 10 == 0) {
+                    int d = (int)(nextRandom() % 4);
+                    e.x += d == 0 ? 1 : d == 1 ? -1 : 0;
+                    e.y += d == 2 ? 1 : d == 3 ? -1 : 0;
+                    if (e.x < 0 || e.x >= grid) e.x = frames[f - 1].e[i].x;
+                    if (e.y < 0 || e.y >= grid) e.y = frames[f - 1].e[i].y;
+                }
+            }
+            s->e[i] = e;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int players = 256;
+    int updates = 2000;
+    int maxGrid = 4096;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--players") == 0 && i + 1 < argc) players = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--updates") == 0 && i + 1 < argc) updates = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--max-grid") == 0 && i + 1 < argc) maxGrid = atoi(argv[++i]);
+        else { printf("Usage: %s [--players N] [--updates N] [--max-grid N]\n", argv[0]); return 1; }
+    }
+    if (players < 1 || players > 0xFFFF || updates < 1 || maxGrid < 16) {
+        printf("Players must be 1..65535, updates positive and the largest grid at least 16\n");
+        return 1;
+    }
+
+    int n = players;
+    size_t cap = STATE_HDR_SIZE + (size_t)n * 16;      // wider than any layout needs
+    snapshot_t frames[FRAMES] = {0};
+    uint8_t* buf = malloc(cap);
+    uint8_t* ref = malloc(cap);
+    uint8_t* deltas = malloc((size_t)FRAMES * cap);
+    size_t* deltaLen = malloc(FRAMES * sizeof *deltaLen);
+    int32_t* ids = malloc((size_t)n * sizeof *ids);
+    int32_t* xs = malloc((size_t)n * sizeof *xs);
+    int32_t* ys = malloc((size_t)n * sizeof *ys);
+    int* outId = malloc((size_t)n * sizeof *outId);
+    int* outX = malloc((size_t)n * sizeof *outX);
+    int* outY = malloc((size_t)n * sizeof *outY);
+    snapshot_ring_t got;
+    snapshot_ring_init(&got);
+    if (!buf || !ref || !deltas || !deltaLen || !ids || !xs || !ys || !outId || !outX || !outY) { perror("malloc"); return 1; }
+
+    printf("%d entities, %d updates per measurement, raw (id, x, y) %d B/update\n", n, updates, 12 * n);
+    printf("%-11s %-9s %6s | %8s %6s %6s %7s %7s | %8s %6s %6s | %8s %6s %6s\n", "board", "bits", "packet",
+           "list B", "enc", "dec", "bit enc", "bit dec", "full B", "enc", "dec", "delta B", "enc", "dec");
+
+    int ok = 1;
+    volatile size_t sink = 0;
+    for (int grid = 16; grid <= maxGrid; grid *= 4) {
+        move_layout_t l = move_layout_for(grid, n);
+        if (makeFrames(frames, n, grid) < 0) { perror("malloc"); return 1; }
+        double perEnt = (double)updates * n;
+
+        // packet: the moves of each update, one packet apiece
+        long long moves = 0, packetBytes = 0;
+        for (int u = 0; u < updates; u++) {
+            const snapshot_t* prev = &frames[u % (FRAMES - 1)];
+            const snapshot_t* cur = &frames[u % (FRAMES - 1) + 1];
+            for (int i = 0; i < n; i++) {
+                if (cur->e[i].x == prev->e[i].x && cur->e[i].y == prev->e[i].y) continue;
+                uint8_t mv[16];
+                int id, x, y;
+                size_t len = move_encode(mv, sizeof mv, l, i, cur->e[i].x, cur->e[i].y);
+                if (!len || move_decode(mv, len, l, &id, &x, &y) < 0 || id != i || x != cur->e[i].x ||
+                    y != cur->e[i].y)
+                    ok = 0;
+                moves++;
+                packetBytes += (long long)len;
+            }
+        }
+
+        // list: every entity from columns
+        size_t listBytes = 0;
+        int64_t t0 = mono_ns();
+        for (int u = 0; u < updates; u++) {
+            const snapshot_t* s = &frames[u % FRAMES];
+            for (int i = 0; i < n; i++) {
+                ids[i] = s->e[i].key;
+                xs[i] = s->e[i].x;
+                ys[i] = s->e[i].y;
+            }
+            listBytes = move_encode_list(buf, cap, l, ids, xs, ys, n);
+            sink += listBytes;
+        }
+        double listEnc = (double)(mono_ns() - t0) / perEnt;
+        t0 = mono_ns();
+        for (int u = 0; u < updates; u++) {
+            if (move_decode_list(buf, listBytes, l, outId, outX, outY, n) < 0) ok = 0;
+            sink += (size_t)outX[u % n];
+        }
+        double listDec = (double)(mono_ns() - t0) / perEnt;
+        const snapshot_t* last = &frames[(updates - 1) % FRAMES];
+        for (int i = 0; i < n; i++)
+            if (outId[i] != last->e[i].key || outX[i] != last->e[i].x || outY[i] != last->e[i].y) ok = 0;
+
+        // the same through the bit writer and reader: same bytes, slower
+        size_t refBytes = 0;
+        t0 = mono_ns();
+        for (int u = 0; u < updates; u++) {
+            const snapshot_t* s = &frames[u % FRAMES];
+            for (int i = 0; i < n; i++) {
+                ids[i] = s->e[i].key;
+                xs[i] = s->e[i].x;
+                ys[i] = s->e[i].y;
+            }
+            refBytes = move_encode_list_bitwise(ref, cap, l, ids, xs, ys, n);
+            sink += refBytes;
+        }
+        double bitEnc = (double)(mono_ns() - t0) / perEnt;
+        if (refBytes != listBytes || memcmp(ref, buf, listBytes) != 0) ok = 0;
+        t0 = mono_ns();
+        for (int u = 0; u < updates; u++) {
+            if (move_decode_list_bitwise(ref, refBytes, l, outId, outX, outY, n) < 0) ok = 0;
+            sink += (size_t)outX[u % n];
+        }
+        double bitDec = (double)(mono_ns() - t0) / perEnt;
+
+        // full states
+        state_hdr_t h;
+        size_t fullBytes = 0;
+        t0 = mono_ns();
+        for (int u = 0; u < updates; u++) {
+            fullBytes = state_encode(buf, cap, l, &h, 0, NULL, &frames[u % FRAMES]);
+            sink += fullBytes;
+        }
+        double fullEnc = (double)(mono_ns() - t0) / perEnt;
+        if (!fullBytes) ok = 0;
+        t0 = mono_ns();
+        for (int u = 0; u < updates; u++) {
+            snapshot_t* out = snapshot_ring_next(&got);
+            if (state_decode(buf, fullBytes, l, &h, &got, out) < 0) ok = 0;
+            out->tick = last->tick;
+            snapshot_ring_push(&got);
+        }
+        double fullDec = (double)(mono_ns() - t0) / perEnt;
+        if (!snapshot_same(snapshot_ring_latest(&got), last)) ok = 0;
+
+        // deltas, each against the update before it
+        long long deltaBytes = 0;
+        t0 = mono_ns();
+        for (int u = 0; u < updates; u++) {
+            int f = 1 + u % (FRAMES - 1);
+            deltaLen[f] = state_encode(deltas + (size_t)f * cap, cap, l, &h, 0, &frames[f - 1], &frames[f]);
+            deltaBytes += (long long)deltaLen[f];
+        }
+        double deltaEnc = (double)(mono_ns() - t0) / perEnt;
+
+        // a client holding frame 0 applies 1, 2, ... in turn
+        int64_t decodeNs = 0;
+        for (int u = 0; u < updates;) {
+            snapshot_t* out = snapshot_ring_next(&got);
+            size_t len = state_encode(buf, cap, l, &h, 0, NULL, &frames[0]);
+            if (!len || state_decode(buf, len, l, &h, &got, out) < 0) ok = 0;
+            out->tick = 0;
+            snapshot_ring_push(&got);
+            t0 = mono_ns();
+            for (int f = 1; f < FRAMES && u < updates; f++, u++) {
+                out = snapshot_ring_next(&got);
+                if (state_decode(deltas + (size_t)f * cap, deltaLen[f], l, &h, &got, out) < 0) ok = 0;
+                out->tick = (uint32_t)f;
+                snapshot_ring_push(&got);
+            }
+            decodeNs += mono_ns() - t0;
+            if (!snapshot_same(snapshot_ring_latest(&got), &frames[snapshot_ring_latest(&got)->tick])) ok = 0;
+        }
+        double deltaDec = (double)decodeNs / perEnt;
+
+        char board[24], bits[16];
+        snprintf(board, sizeof board, "%dx%d", grid, grid);
+        snprintf(bits, sizeof bits, "%d+%d+%d", l.id_bits, l.coord_bits, l.coord_bits);
+        printf("%-11s %-9s %4.2f B | %8zu %6.2f %6.2f %7.2f %7.2f | %8zu %6.2f %6.2f | %8.1f %6.2f %6.2f\n", board,
+               bits, moves ? (double)packetBytes / moves : 0.0, listBytes, listEnc, listDec, bitEnc, bitDec, fullBytes,
+               fullEnc, fullDec, (double)deltaBytes / updates, deltaEnc, deltaDec);
+    }
+    printf("(enc/dec in ns per entity)\n");
+    printf("check   %s\n", ok ? "every decode matches" : "MISMATCH");
+
+    for (int f = 0; f < FRAMES; f++) free(frames[f].e);
+    snapshot_ring_free(&got);
+    free(buf);
+    free(ref);
+    free(deltas);
+    free(deltaLen);
+    free(ids);
+    free(xs);
+    free(ys);
+    free(outId);
+    free(outX);
+    free(outY);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+// Per-entity cost of the SoA entity store as the entity count grows.
+//
+// Headless. For each size it times, in ns per entity:
+//   step    one simulation pass: move every entity one cell, flag it moved
+//   scan    one read-only pass over positions (what encoders and the
+//           renderer do)
+//   lookup  resolving a random handle to its dense index
+//   churn   destroying a random entity and creating a new one
+// and the same step and scan over an array-of-structs baseline holding the
+// same fields, which is how the demos stored players before.
+//
+//   EntityStoreBench [--passes N] [--max N]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../Common/entity_store.h"
+#include "../Common/tick.h"
+
+#define GRID 256
+
+typedef struct {
+    int32_t x, y;
+    float color[3];
+    int64_t cooldown;
+    int32_t owner;
+    uint32_t flags;
+    entity_t handle;
+} aos_entity_t;
+
+static volatile int64_t sink;   // keeps the scans from being optimised out
+
+int main(int argc, char** argv) {
+    int passes = 200;
+    int max = 65536;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--passes") == 0 && i + 1 < argc) passes = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--max") == 0 && i + 1 < argc) max = atoi(argv[++i]);
+        else { printf("Usage: %s [--passes N] [--max N]\n", argv[0]); return 1; }
+    }
+    if (passes < 1 || max < 1024) { printf("passes must be positive, max at least 1024\n"); return 1; }
+
+    printf("%8s %10s %10s %10s %10s %12s %12s\n", "entities", "step ns", "scan ns", "lookup ns",
+           "churn ns", "aos step ns", "aos scan ns");
+    for (int n = 1024; n <= max; n *= 4) {
+        entity_store_t s;
+        if (entity_store_init(&s, n) < 0) { perror("aligned_alloc"); return 1; }
+        entity_t* handles = malloc((size_t)n * sizeof *handles);
+        aos_entity_t* aos = calloc((size_t)n, sizeof *aos);
+        if (!handles || !aos) { perror("malloc"); return 1; }
+        for (int i = 0; i < n; i++) {
+            handles[i] = entity_create(&s);
+            s.x[i] = aos[i].x = i % GRID;
+            s.y[i] = aos[i].y = (i / GRID) % GRID;
+        }
+
+        // columns as restrict locals: x and flags may not alias, so the
+        // loop vectorises
+        int64_t t0 = mono_ns();
+        for (int p = 0; p < passes; p++) {
+            int32_t* restrict x = s.x;
+            uint32_t* restrict flags = s.flags;
+            for (int i = 0; i < s.count; i++) {
+                x[i] = (x[i] + 1) & (GRID - 1);
+                flags[i] |= ENTITY_MOVED;
+            }
+        }
+        double step = (double)(mono_ns() - t0) / passes / n;
+
+        t0 = mono_ns();
+        for (int p = 0; p < passes; p++) {
+            int64_t sum = 0;
+            for (int i = 0; i < s.count; i++) sum += s.x[i] + s.y[i];
+            sink += sum;
+        }
+        double scan = (double)(mono_ns() - t0) / passes / n;
+
+        t0 = mono_ns();
+        for (int p = 0; p < passes; p++) {
+            for (int i = 0; i < n; i++) {
+                aos[i].x = (aos[i].x + 1) & (GRID - 1);
+                aos[i].flags |= ENTITY_MOVED;
+            }
+        }
+        double aos_step = (double)(mono_ns() - t0) / passes / n;
+
+        t0 = mono_ns();
+        for (int p = 0; p < passes; p++) {
+            int64_t sum = 0;
+            for (int i = 0; i < n; i++) sum += aos[i].x + aos[i].y;
+            sink += sum;
+        }
+        double aos_scan = (double)(mono_ns() - t0) / passes / n;
+
+        uint32_t rng = 12345;
+        int ops = n * 4;
+        t0 = mono_ns();
+        int64_t found = 0;
+        for (int k = 0; k < ops; k++) {
+            rng = rng * 1664525u + 1013904223u;
+            found += entity_index(&s, handles[rng % (uint32_t)n]);
+        }
+        sink += found;
+        double lookup = (double)(mono_ns() - t0) / ops;
+
+        t0 = mono_ns();
+        for (int k = 0; k < ops; k++) {
+            rng = rng * 1664525u + 1013904223u;
+            int j = (int)(rng % (uint32_t)n);
+            entity_destroy(&s, handles[j]);
+            handles[j] = entity_create(&s);
+        }
+        double churn = (double)(mono_ns() - t0) / ops;
+        if (s.count != n) { printf("store lost entities: %d of %d\n", s.count, n); return 1; }
+
+        printf("%8d %10.2f %10.2f %10.2f %10.2f %12.2f %12.2f\n", n, step, scan, lookup, churn,
+               aos_step, aos_scan);
+        free(aos);
+        free(handles);
+        entity_store_free(&s);
+    }
+    return 0;
+}
@@ -0,0 +1,127 @@
+// Headless check of the frame pacer (Common/frame_pacer.h) on a fake clock.
+//
+// Drives frame_pacer_ready() and frame_pacer_timeout() the way the demos'
+// render loops do, advancing the clock by hand, and checks:
+//   idle      nothing marked: no frame, and the loop may block until an
+//             event
+//   deadline  the first mark draws at once; marked again, the timeout
+//             lands on the next frame and nothing draws before it
+//   wake      a wake-up request is reported on time, the earliest of two
+//             wins, and it is consumed once due
+//   drift     a loop that always wakes --late-us late still draws --hz
+//             frames a second, each one --late-us behind the grid
+//   stall     after a stall of several periods the next frame draws at
+//             once and the one after a full period later, with no burst
+// Exits non-zero if any check fails.
+//
+//   FramePacerTest [--hz N] [--late-us N]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../Common/frame_pacer.h"
+
+#define START_NS 1000000000LL  // fake clock at the first frame
+#define DRIFT_SECONDS 10
+
+int failures;
+
+void expect(int ok, const char* what) {
+    if (ok) return;
+    printf("check   FAILED: %s\n", what);
+    failures++;
+}
+
+// One render loop iteration: mark (if animating), maybe draw, then sleep
+// for the timeout plus the loop's lateness. Returns 1 if a frame was drawn.
+int iterate(frame_pacer_t* p, int64_t* now, int animating, int64_t lateNs) {
+    if (animating) frame_pacer_mark(p);
+    int drew = frame_pacer_ready(p, *now);
+    int64_t wait = frame_pacer_timeout(p, *now);
+    if (wait < 0) return drew;
+    *now += wait + lateNs;
+    return drew;
+}
+
+int main(int argc, char** argv) {
+    int hz = 60;
+    int lateUs = 1000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--hz") == 0 && i + 1 < argc) hz = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--late-us") == 0 && i + 1 < argc) lateUs = atoi(argv[++i]);
+        else { printf("Usage: %s [--hz N] [--late-us N]\n", argv[0]); return 1; }
+    }
+    if (hz < 1 || lateUs < 0) { printf("Rate must be positive and lateness not negative\n"); return 1; }
+
+    frame_pacer_t p;
+    frame_pacer_init(&p, hz);
+    int64_t period = p.period_ns, late = (int64_t)lateUs * 1000, now = START_NS;
+    if (late >= period) { printf("Lateness must be under one frame period (%lld us)\n", (long long)period / 1000); return 1; }
+
+    // idle: the initial frame, then nothing
+    expect(frame_pacer_ready(&p, now) == 1, "first frame draws at once");
+    expect(frame_pacer_timeout(&p, now) == -1, "idle pacer blocks until an event");
+    expect(frame_pacer_ready(&p, now + 10 * period) == 0, "idle pacer draws nothing");
+
+    // deadline: a mark long after the last frame draws at once, the next
+    // mark waits exactly one period
+    now += 10 * period;
+    frame_pacer_mark(&p);
+    expect(frame_pacer_ready(&p, now) == 1, "mark after idle draws at once");
+    frame_pacer_mark(&p);
+    expect(frame_pacer_timeout(&p, now) == period, "marked pacer waits one period");
+    expect(frame_pacer_ready(&p, now + period - 1) == 0, "no frame before the deadline");
+    expect(frame_pacer_timeout(&p, now + period / 2) == period - period / 2, "timeout counts down");
+    expect(frame_pacer_ready(&p, now + period) == 1, "frame on the deadline");
+    now += period;
+    expect(frame_pacer_timeout(&p, now) == -1, "drawn frame clears the mark");
+
+    // wake: the earliest request, reported once
+    frame_pacer_wake_at(&p, now + 10000000);
+    frame_pacer_wake_at(&p, now + 5000000);
+    frame_pacer_wake_at(&p, now + 7000000);
+    expect(frame_pacer_timeout(&p, now) == 5000000, "earliest wake-up wins");
+    expect(frame_pacer_timeout(&p, now + 5000000) == 0, "due wake-up returns at once");
+    expect(frame_pacer_timeout(&p, now + 5000000) == -1, "wake-up is consumed");
+    frame_pacer_mark(&p);
+    frame_pacer_wake_at(&p, now + 1000);
+    expect(frame_pacer_timeout(&p, now) == 1000, "wake-up before the frame deadline wins");
+    expect(frame_pacer_timeout(&p, now + 1000) == 0, "wake-up due while marked");
+    expect(frame_pacer_timeout(&p, now + 1000) == period - 1000, "then the frame deadline");
+    expect(frame_pacer_ready(&p, now + period) == 1, "marked frame draws on its deadline");
+    now += period;
+
+    // drift: late every time, but the rate holds; the last frame was at
+    // now, so the grid continues one period on
+    uint64_t before = p.frames;
+    int64_t start = now, grid = now + period, end = now + DRIFT_SECONDS * 1000000000LL;
+    int64_t worst = 0, prev = -1, minGap = INT64_MAX;
+    while (now < end) {
+        int64_t at = now;
+        if (iterate(&p, &now, 1, late)) {
+            int64_t behind = at - grid;
+            if (behind > worst) worst = behind;
+            if (prev >= 0 && at - prev < minGap) minGap = at - prev;
+            prev = at;
+            grid += period;
+        }
+    }
+    uint64_t drawn = p.frames - before;
+    uint64_t want = (uint64_t)((end - start) / period);
+    printf("drift   %llu frames in %d s at %d Hz waking %d us late: at most %.3f ms behind the grid\n",
+           (unsigned long long)drawn, DRIFT_SECONDS, hz, lateUs, worst / 1e6);
+    expect(drawn + 1 >= want && drawn <= want + 1, "late wake-ups keep the frame rate");
+    expect(worst <= late, "lateness does not accumulate");
+    expect(minGap >= period - late, "frames stay about a period apart");
+
+    // stall: five periods without a look, then back to normal pacing
+    now += 5 * period;
+    frame_pacer_mark(&p);
+    expect(frame_pacer_ready(&p, now) == 1, "first frame after a stall draws at once");
+    frame_pacer_mark(&p);
+    expect(frame_pacer_ready(&p, now + period / 2) == 0, "no catch-up burst after a stall");
+    expect(frame_pacer_timeout(&p, now) == period, "grid restarts at the stalled frame");
+
+    if (!failures) printf("check   frame pacer deadlines and drift as expected\n");
+    return failures ? 1 : 0;
+}
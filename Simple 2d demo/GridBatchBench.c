@@ -0,0 +1,152 @@
+// CPU cost per frame of the batched grid renderer as the board grows.
+//
+// Headless, no GL context needed: times the grid_batch.h work the render
+// loop does each frame (syncing moving players and collecting the dirty
+// range) against rebuilding the full instance buffer, and reports what each
+// would upload and how many draw calls the old per-cell loop needed. First
+// it checks the instances built for a known 4x4 board with two players
+// (counts, positions, colours and dirty ranges) and exits non-zero if any
+// differ.
+//
+//   GridBatchBench [--frames N] [--players N]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../Common/grid_batch.h"
+#include "../Common/tick.h"
+
+#define MAX_BENCH_PLAYERS 64
+
+int failures;
+
+void expect(int ok, const char* what) {
+    if (ok) return;
+    printf("check   FAILED: %s\n", what);
+    failures++;
+}
+
+int near(float a, float b) {
+    return a - b < 1e-6f && b - a < 1e-6f;
+}
+
+int instanceIs(const grid_batch_t* b, int i, float x, float y, float scale, const float rgb[3]) {
+    const grid_instance_t* v = &b->inst[i];
+    return near(v->x, x) && near(v->y, y) && near(v->scale, scale) && v->r == rgb[0] && v->g == rgb[1] &&
+           v->b == rgb[2];
+}
+
+int dirtyIs(grid_batch_t* b, int wantFirst, int wantCount) {
+    int first, count;
+    if (!grid_batch_take_dirty(b, &first, &count)) return wantCount == 0;
+    return first == wantFirst && count == wantCount;
+}
+
+// A 4x4 board has 0.5-wide cells centred at -0.75, -0.25, 0.25 and 0.75.
+void checkKnownBoard(void) {
+    static const float gray[3] = { GRID_CELL_GRAY, GRID_CELL_GRAY, GRID_CELL_GRAY };
+    static const float red[3] = { 1.0f, 0.0f, 0.0f };
+    static const float colors[3][3] = { { 0.98f, 0.73f, 0.01f }, { 0.0f, 0.5f, 1.0f }, { 1.0f, 1.0f, 1.0f } };
+    grid_batch_t b;
+    if (grid_batch_init(&b, 4, 2) < 0) { perror("calloc"); exit(1); }
+
+    expect(b.ncells == 16 && b.count == 16 && b.nplayers == 0, "empty board has one instance per cell");
+    expect(b.count * GRID_QUAD_VERTICES == 96, "empty board draws 96 vertices");
+    expect(instanceIs(&b, 0, -0.75f, -0.75f, 0.5f, gray), "cell (0,0)");
+    expect(instanceIs(&b, 6, 0.25f, -0.25f, 0.5f, gray), "cell (2,1) is row-major index 6");
+    expect(instanceIs(&b, 15, 0.75f, 0.75f, 0.5f, gray), "cell (3,3)");
+    expect(dirtyIs(&b, 0, 16), "first upload is the whole board");
+    expect(dirtyIs(&b, 0, 0), "nothing dirty after taking it");
+
+    grid_batch_set_cell(&b, 2, 1, red);
+    expect(instanceIs(&b, 6, 0.25f, -0.25f, 0.5f, red), "recoloured cell keeps its place");
+    expect(dirtyIs(&b, 6, 1), "recolouring dirties one cell");
+    grid_batch_set_cell(&b, 2, 1, red);
+    grid_batch_set_cell(&b, 4, 0, red);
+    expect(dirtyIs(&b, 0, 0), "same colour or off-board cell dirties nothing");
+
+    int32_t px[3] = { 0, 3, 1 }, py[3] = { 0, 2, 1 };
+    grid_batch_set_players(&b, px, py, colors, 2);
+    expect(b.count == 18 && b.nplayers == 2, "players follow the cells");
+    expect(b.count * GRID_QUAD_VERTICES == 108, "board and players draw 108 vertices");
+    expect(instanceIs(&b, 16, -0.75f, -0.75f, 0.5f * GRID_PLAYER_SIZE, colors[0]), "player 0 at (0,0)");
+    expect(instanceIs(&b, 17, 0.75f, 0.25f, 0.5f * GRID_PLAYER_SIZE, colors[1]), "player 1 at (3,2)");
+    expect(dirtyIs(&b, 16, 2), "new players dirty their instances");
+
+    px[1] = 2;
+    grid_batch_set_players(&b, px, py, colors, 2);
+    expect(instanceIs(&b, 17, 0.25f, 0.25f, 0.5f * GRID_PLAYER_SIZE, colors[1]), "player 1 moved to (2,2)");
+    expect(dirtyIs(&b, 17, 1), "a move dirties only the mover");
+    grid_batch_set_players(&b, px, py, colors, 2);
+    expect(dirtyIs(&b, 0, 0), "standing still dirties nothing");
+
+    grid_batch_set_players(&b, px, py, colors, 3);
+    expect(b.count == 18 && b.nplayers == 2, "players are clamped to the capacity");
+
+    float fx = 0.5f, fy = 0.0f;
+    grid_batch_set_players_f(&b, &fx, &fy, colors, 1);
+    expect(b.count == 17 && b.nplayers == 1, "fewer players shrink the count");
+    expect(instanceIs(&b, 16, -0.5f, -0.75f, 0.5f * GRID_PLAYER_SIZE, colors[0]), "player between cells");
+    expect(dirtyIs(&b, 16, 1), "a fractional move dirties the mover");
+    grid_batch_free(&b);
+
+    if (!failures) printf("check   4x4 board instances as expected\n");
+}
+
+int main(int argc, char** argv) {
+    int frames = 2000;
+    int nplayers = 4;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) frames = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--players") == 0 && i + 1 < argc) nplayers = atoi(argv[++i]);
+        else { printf("Usage: %s [--frames N] [--players N]\n", argv[0]); return 1; }
+    }
+    if (frames < 1 || nplayers < 1 || nplayers > MAX_BENCH_PLAYERS) {
+        printf("frames must be positive, players 1..%d\n", MAX_BENCH_PLAYERS);
+        return 1;
+    }
+
+    checkKnownBoard();
+
+    int32_t px[MAX_BENCH_PLAYERS], py[MAX_BENCH_PLAYERS];
+    float colors[MAX_BENCH_PLAYERS][3];
+    for (int i = 0; i < nplayers; i++) {
+        colors[i][0] = 0.98f; colors[i][1] = 0.73f; colors[i][2] = 0.01f;
+    }
+
+    printf("%8s %12s %14s %14s %14s %14s\n", "grid", "old draws", "batched us", "upload B",
+           "rebuild us", "rebuild B");
+    for (int grid = 16; grid <= 256; grid *= 2) {
+        grid_batch_t b;
+        if (grid_batch_init(&b, grid, nplayers) < 0) { perror("calloc"); return 1; }
+        for (int i = 0; i < nplayers; i++) { px[i] = i % grid; py[i] = (i * 7) % grid; }
+
+        // steady state: every player steps one cell per frame
+        int first, count;
+        grid_batch_take_dirty(&b, &first, &count);
+        size_t uploaded = 0;
+        int64_t t0 = mono_ns();
+        for (int f = 0; f < frames; f++) {
+            for (int i = 0; i < nplayers; i++) px[i] = (px[i] + 1) % grid;
+            grid_batch_set_players(&b, px, py, (const float (*)[3])colors, nplayers);
+            if (grid_batch_take_dirty(&b, &first, &count)) uploaded += (size_t)count * sizeof(grid_instance_t);
+        }
+        double batched_us = (double)(mono_ns() - t0) / 1e3 / frames;
+
+        // baseline: lay the whole board out again every frame
+        int reps = frames / 20 > 0 ? frames / 20 : 1;
+        t0 = mono_ns();
+        for (int f = 0; f < reps; f++) {
+            grid_batch_free(&b);
+            if (grid_batch_init(&b, grid, nplayers) < 0) { perror("calloc"); return 1; }
+            grid_batch_set_players(&b, px, py, (const float (*)[3])colors, nplayers);
+        }
+        double rebuild_us = (double)(mono_ns() - t0) / 1e3 / reps;
+
+        printf("%5dx%-3d %12d %14.3f %14zu %14.1f %14zu\n", grid, grid, grid * grid + nplayers,
+               batched_us, uploaded / (size_t)frames, rebuild_us,
+               (size_t)b.count * sizeof(grid_instance_t));
+        grid_batch_free(&b);
+    }
+    return failures ? 1 : 0;
+}
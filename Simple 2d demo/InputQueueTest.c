@@ -0,0 +1,237 @@
+// Headless check of the input queue (Common/input_queue.h) with synthetic
+// key event streams.
+//
+// Events are pushed with made-up timestamps and the processor is run once
+// per 30 Hz tick, as a fixed-step game loop would, recording each move's
+// time, pad, direction and the tick it was emitted in. Scripted streams
+// check a tap shorter than a tick, held-key repeats, presses during the
+// cooldown coalescing into one move, the most recent key winning, refused
+// moves, events stamped before the last run and a full ring. A long random
+// stream over several pads then checks that moves come out in time order,
+// each in the tick that contains its time, never closer than the cooldown
+// on a pad, and that a press on a pad off cooldown moves at that instant.
+// Exits non-zero if any check fails.
+//
+//   InputQueueTest [--events N]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../Common/input_queue.h"
+
+#define MS 1000000LL
+#define TICK_NS (1000000000LL / 30)
+#define COOLDOWN_NS (150 * MS)
+#define MAX_MOVES 100000
+
+typedef struct {
+    int64_t t;
+    int pad, dir;
+    uint64_t tick;              // the run that emitted it
+} move_t;
+
+typedef struct {
+    int64_t ms;
+    int pad, dir, press;
+} script_event_t;
+
+move_t moves[MAX_MOVES];
+int nmoves;
+uint64_t tick;                  // current run
+int wall = -1;                  // direction apply refuses, -1 none
+int failures;
+
+int recordMove(void* ctx, const input_cmd_t* cmd) {
+    if (cmd->dir == wall) return 0;
+    if (nmoves < MAX_MOVES) moves[nmoves++] = (move_t){ cmd->t, cmd->pad, cmd->dir, tick };
+    return 1;
+}
+
+// Run ticks [tick, until) of the fixed-step loop
+void runTicks(input_proc_t* p, input_ring_t* q, uint64_t until) {
+    for (; tick < until; tick++) input_proc_run(p, q, (int64_t)(tick + 1) * TICK_NS, recordMove, NULL);
+}
+
+// The tick whose run covers time t: run k processes up to (k + 1) ticks
+uint64_t tickOf(int64_t t) {
+    return t <= 0 ? 0 : (uint64_t)((t - 1) / TICK_NS);
+}
+
+// Push a script, run it for `ticks` and compare the moves with want
+// (times in ms, each expected in the tick covering its time).
+void expectScript(const char* name, const script_event_t* ev, int nev, const move_t* want, int nwant, int ticks) {
+    input_ring_t q;
+    input_proc_t p;
+    input_ring_init(&q);
+    input_proc_init(&p, 2, COOLDOWN_NS);
+    nmoves = 0;
+    tick = 0;
+    for (int i = 0; i < nev; i++) input_ring_push(&q, ev[i].ms * MS, ev[i].pad, ev[i].dir, ev[i].press);
+    runTicks(&p, &q, (uint64_t)ticks);
+
+    int ok = nmoves == nwant;
+    for (int i = 0; ok && i < nwant; i++) {
+        int64_t t = want[i].t * MS;
+        ok = moves[i].t == t && moves[i].pad == want[i].pad && moves[i].dir == want[i].dir &&
+             moves[i].tick == tickOf(t);
+    }
+    if (ok) return;
+    failures++;
+    printf("check   FAILED: %s\n  want:", name);
+    for (int i = 0; i < nwant; i++) printf(" %lldms/p%d/d%d", (long long)want[i].t, want[i].pad, want[i].dir);
+    printf("\n  got: ");
+    for (int i = 0; i < nmoves; i++)
+        printf(" %lldms/p%d/d%d@%llu", (long long)(moves[i].t / MS), moves[i].pad, moves[i].dir,
+               (unsigned long long)moves[i].tick);
+    printf("\n");
+}
+
+void expect(int ok, const char* what) {
+    if (ok) return;
+    printf("check   FAILED: %s\n", what);
+    failures++;
+}
+
+#define SCRIPT(name, ticks, ev, want) \
+    expectScript(name, ev, (int)(sizeof ev / sizeof ev[0]), want, (int)(sizeof want / sizeof want[0]), ticks)
+
+void scripted(void) {
+    {   // a tap that starts and ends between two runs still moves
+        script_event_t ev[] = { { 10, 0, INPUT_UP, 1 }, { 12, 0, INPUT_UP, 0 } };
+        move_t want[] = { { 10, 0, INPUT_UP, 0 } };
+        SCRIPT("tap shorter than a tick", 10, ev, want);
+    }
+    {   // held: repeats every cooldown until let go
+        script_event_t ev[] = { { 5, 0, INPUT_RIGHT, 1 }, { 500, 0, INPUT_RIGHT, 0 } };
+        move_t want[] = { { 5, 0, INPUT_RIGHT, 0 }, { 155, 0, INPUT_RIGHT, 0 }, { 305, 0, INPUT_RIGHT, 0 },
+                          { 455, 0, INPUT_RIGHT, 0 } };
+        SCRIPT("held key repeats on the cooldown", 30, ev, want);
+    }
+    {   // taps during the cooldown coalesce into one move, the latest
+        script_event_t ev[] = { { 0, 0, INPUT_UP, 1 },   { 20, 0, INPUT_UP, 0 },   { 50, 0, INPUT_LEFT, 1 },
+                                { 60, 0, INPUT_LEFT, 0 }, { 80, 0, INPUT_DOWN, 1 }, { 90, 0, INPUT_DOWN, 0 } };
+        move_t want[] = { { 0, 0, INPUT_UP, 0 }, { 150, 0, INPUT_DOWN, 0 } };
+        SCRIPT("presses during the cooldown coalesce", 30, ev, want);
+    }
+    {   // the most recently pressed of the held keys repeats; letting it go
+        // hands back to the one still held
+        script_event_t ev[] = { { 0, 0, INPUT_RIGHT, 1 }, { 200, 0, INPUT_UP, 1 }, { 400, 0, INPUT_UP, 0 },
+                                { 600, 0, INPUT_RIGHT, 0 } };
+        move_t want[] = { { 0, 0, INPUT_RIGHT, 0 }, { 150, 0, INPUT_RIGHT, 0 }, { 300, 0, INPUT_UP, 0 },
+                          { 450, 0, INPUT_RIGHT, 0 }, { 600, 0, INPUT_RIGHT, 0 } };
+        SCRIPT("most recent key wins", 40, ev, want);
+    }
+    {   // pads keep their own cooldowns and come out interleaved in time
+        script_event_t ev[] = { { 0, 0, INPUT_UP, 1 },   { 40, 1, INPUT_LEFT, 1 }, { 160, 0, INPUT_UP, 0 },
+                                { 200, 1, INPUT_LEFT, 0 } };
+        move_t want[] = { { 0, 0, INPUT_UP, 0 }, { 40, 1, INPUT_LEFT, 0 }, { 150, 0, INPUT_UP, 0 },
+                          { 190, 1, INPUT_LEFT, 0 } };
+        SCRIPT("pads in time order", 20, ev, want);
+    }
+    {   // a refused move costs no cooldown and a held key doesn't retry
+        // until the keys change
+        wall = INPUT_LEFT;
+        script_event_t ev[] = { { 0, 0, INPUT_LEFT, 1 }, { 100, 0, INPUT_UP, 1 }, { 120, 0, INPUT_UP, 0 },
+                                { 400, 0, INPUT_LEFT, 0 } };
+        move_t want[] = { { 100, 0, INPUT_UP, 0 } };
+        SCRIPT("refused moves", 20, ev, want);
+        wall = -1;
+    }
+
+    // an event stamped before the last run happens at the start of the next
+    input_ring_t q;
+    input_proc_t p;
+    input_ring_init(&q);
+    input_proc_init(&p, 1, COOLDOWN_NS);
+    nmoves = 0;
+    tick = 0;
+    runTicks(&p, &q, 3);
+    input_ring_push(&q, 10 * MS, 0, INPUT_DOWN, 1);
+    runTicks(&p, &q, 4);
+    expect(nmoves == 1 && moves[0].t == 3 * TICK_NS && moves[0].tick == 3, "late event lands in the next tick");
+    expect(input_proc_next_due(&p) == 3 * TICK_NS + COOLDOWN_NS, "held key is due a cooldown later");
+
+    // a full ring refuses and counts the overflow
+    input_ring_init(&q);
+    int refusedAt = -1;
+    for (int i = 0; i <= INPUT_RING && refusedAt < 0; i++)
+        if (input_ring_push(&q, i, 0, INPUT_UP, i % 2 == 0) < 0) refusedAt = i;
+    expect(refusedAt == INPUT_RING && q.dropped == 1, "full ring drops the next event");
+}
+
+// Random stream: properties that hold for any input
+void randomized(int nevents) {
+    input_ring_t q;
+    input_proc_t p;
+    input_ring_init(&q);
+    input_proc_init(&p, INPUT_MAX_PADS, COOLDOWN_NS);
+    nmoves = 0;
+    tick = 0;
+    uint32_t rng = 12345;
+    int64_t t = 0;
+    int held[INPUT_MAX_PADS][INPUT_DIRS] = {{0}};
+    int64_t* pressAt = malloc((size_t)nevents * sizeof *pressAt);   // every press, for the last check
+    int* pressPad = malloc((size_t)nevents * sizeof *pressPad);
+    int npress = 0;
+    int64_t lastMove[INPUT_MAX_PADS];
+    for (int i = 0; i < INPUT_MAX_PADS; i++) lastMove[i] = INT64_MIN / 2;
+    if (!pressAt || !pressPad) { perror("malloc"); exit(1); }
+
+    for (int k = 0; k < nevents; k++) {
+        rng = rng * 1664525u + 1013904223u;
+        t += (int64_t)(rng >> 8) % (60 * MS);                         // 0..60 ms apart
+        int pad = (int)(rng >> 4) % INPUT_MAX_PADS, dir = (int)(rng >> 12) % INPUT_DIRS;
+        int press = !held[pad][dir];
+        held[pad][dir] = press;
+        // the producer can only be a ring ahead of the consumer
+        while (q.head - q.tail == INPUT_RING || (uint64_t)t > (tick + 8) * (uint64_t)TICK_NS) runTicks(&p, &q, tick + 1);
+        input_ring_push(&q, t, pad, dir, press);
+
+        if (press) { pressAt[npress] = t; pressPad[npress++] = pad; }
+    }
+    runTicks(&p, &q, tickOf(t) + 100);
+
+    int ordered = 1, inTick = 1, spaced = 1, prompt = 1;
+    for (int i = 0; i < nmoves; i++) {
+        if (i > 0 && moves[i].t < moves[i - 1].t) ordered = 0;
+        if (moves[i].tick != tickOf(moves[i].t)) inTick = 0;
+        if (moves[i].t - lastMove[moves[i].pad] < COOLDOWN_NS) spaced = 0;
+        lastMove[moves[i].pad] = moves[i].t;
+    }
+    // every press on a pad whose previous move was a cooldown or more ago
+    // moved at the press time
+    for (int i = 0, m = 0; i < npress; i++) {
+        int64_t prev = INT64_MIN / 2;
+        while (m < nmoves && moves[m].t < pressAt[i]) m++;
+        for (int j = m - 1; j >= 0; j--)
+            if (moves[j].pad == pressPad[i]) { prev = moves[j].t; break; }
+        if (pressAt[i] - prev < COOLDOWN_NS) continue;
+        int found = 0;
+        for (int j = m; j < nmoves && moves[j].t == pressAt[i]; j++) found |= moves[j].pad == pressPad[i];
+        if (!found) prompt = 0;
+    }
+    printf("random  %d events on %d pads: %d moves over %llu ticks, %llu refused, %llu dropped\n", nevents,
+           INPUT_MAX_PADS, nmoves, (unsigned long long)tick, (unsigned long long)p.refused,
+           (unsigned long long)q.dropped);
+    expect(ordered, "random stream: moves in time order");
+    expect(inTick, "random stream: each move in the tick containing its time");
+    expect(spaced, "random stream: a cooldown between moves of a pad");
+    expect(prompt, "random stream: a press off cooldown moves at once");
+    expect(nmoves < MAX_MOVES, "random stream: move log overflowed");
+    free(pressAt);
+    free(pressPad);
+}
+
+int main(int argc, char** argv) {
+    int nevents = 20000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--events") == 0 && i + 1 < argc) nevents = atoi(argv[++i]);
+        else { printf("Usage: %s [--events N]\n", argv[0]); return 1; }
+    }
+    if (nevents < 1) { printf("Events must be positive\n"); return 1; }
+
+    scripted();
+    randomized(nevents);
+    printf("check   %s\n", failures ? "MISMATCH" : "order, coalescing and landing ticks as expected");
+    return failures ? 1 : 0;
+}
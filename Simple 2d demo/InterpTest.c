@@ -0,0 +1,170 @@
+// Headless check of snapshot interpolation (Common/interp.h) against
+// jittered snapshot traces.
+//
+// A remote player walks along a row of the board in bursts with rests
+// between, and the server sends a state on each move, one more when it
+// settles and, at random, when something else in view changed. It walks
+// twice: stepping one cell per 5-tick cooldown as in the demo, and running
+// a cell every tick. Each trace delays the states by a base latency plus
+// jitter from one of these profiles, in order as over TCP:
+//   steady    no jitter
+//   uniform   0..--jitter-ms, uniformly
+//   spikes    mostly steady, now and then a stall of 4x --jitter-ms that
+//             releases everything queued behind it at once
+//   drift     the client clock runs 0.1% fast against the server's
+// or, with --trace, the extra delay in ms of each state read one per line
+// from a recorded file (cycled). The client renders at 60 Hz and every
+// frame checks that
+//   - render time never goes backwards,
+//   - the drawn position stays on the board and never moves backwards
+//     along the walk, and stays within the cells the server has sent.
+// Only a running player is extrapolated when states are late, and may then
+// be drawn up to the extrapolation limit past the newest cell and fall
+// back to it (never further) once the next state shows where it stopped.
+// Exits non-zero if any check fails.
+//
+//   InterpTest [--seconds N] [--jitter-ms N] [--trace PATH]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../Common/interp.h"
+
+#define GRID 64
+#define TICK_HZ 30
+#define FRAME_HZ 60
+#define STEP_TICKS 5           // demo cooldown: ticks per step while walking
+#define LATENCY_MS 40          // base one-way delay
+#define MAX_TRACE 100000
+
+typedef enum { STEADY, UNIFORM, SPIKES, DRIFT, RECORDED, PROFILES } profile_t;
+
+static const char* const profileNames[PROFILES] = { "steady", "uniform", "spikes", "drift", "trace" };
+
+uint32_t rng = 12345;
+int jitterMs = 30;
+float* recorded;               // --trace delays, ms
+int nrecorded;
+
+uint32_t nextRandom(void) {
+    rng = rng * 1664525u + 1013904223u;
+    return rng >> 8;
+}
+
+// Extra delay of state k under a profile, ns
+int64_t jitterOf(profile_t profile, int k) {
+    switch (profile) {
+    case UNIFORM: return (int64_t)(nextRandom() % (uint32_t)(jitterMs + 1)) * 1000000;
+    case SPIKES: return nextRandom() % 50 == 0 ? (int64_t)jitterMs * 4 * 1000000 : 0;
+    case RECORDED: return (int64_t)(recorded[k % nrecorded] * 1e6f);
+    default: return 0;
+    }
+}
+
+int loadTrace(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) { perror(path); return -1; }
+    recorded = malloc(MAX_TRACE * sizeof *recorded);
+    if (!recorded) { perror("malloc"); fclose(f); return -1; }
+    while (nrecorded < MAX_TRACE && fscanf(f, "%f", &recorded[nrecorded]) == 1)
+        if (recorded[nrecorded] >= 0) nrecorded++;
+    fclose(f);
+    if (nrecorded == 0) { printf("No delays in %s\n", path); return -1; }
+    return 0;
+}
+
+// Replay one trace of a player taking a step every `cooldown` ticks;
+// returns how many checks failed.
+int replay(profile_t profile, int cooldown, int seconds) {
+    int64_t tickNs = 1000000000LL / TICK_HZ, frameNs = 1000000000LL / FRAME_HZ;
+    int ticks = seconds * TICK_HZ;
+
+    // server side: the walk, and when each state is sent and arrives
+    int* xs = malloc((size_t)ticks * sizeof *xs);
+    int64_t* arrive = malloc((size_t)ticks * sizeof *arrive);
+    if (!xs || !arrive) { perror("malloc"); exit(1); }
+    int x = 0, k = 0, moved = 0;
+    int64_t last = 0;
+    for (int t = 0; t < ticks; t++) {
+        int walking = t % (20 * cooldown) < 12 * cooldown;   // 12 steps, then rest
+        int step = walking && t % cooldown == 0 && x < GRID - 1;
+        int settle = moved;
+        moved = step;
+        if (step) x++;
+        xs[t] = x;
+        arrive[t] = -1;
+        if (!step && !settle && t != 0 && nextRandom() % 8) continue;   // nothing in view changed
+        int64_t at = (int64_t)t * tickNs + LATENCY_MS * 1000000LL + jitterOf(profile, k++);
+        if (profile == DRIFT) at += at / 1000;
+        if (at < last) at = last;
+        arrive[t] = last = at;
+    }
+
+    interp_clock_t clock;
+    interp_track_t track;
+    interp_clock_init(&clock, tickNs);
+    interp_track_init(&track);
+    int next = 0, failures = 0, extrapolated = 0, frames = 0, lowest = -1, highest = -1, prevHighest = -1;
+    float ahead = (float)clock.max_extrap_ns / (float)(cooldown * tickNs);   // most a run extrapolates
+    int64_t prevRender = INT64_MIN;
+    float prevX = -1;
+    int64_t end = (int64_t)ticks * tickNs;
+    for (int64_t now = 0; now < end; now += frameNs) {
+        // states that have arrived by this frame
+        for (; next < ticks && (arrive[next] < 0 || arrive[next] <= now); next++) {
+            if (arrive[next] < 0) continue;
+            int64_t serverNs = (int64_t)next * tickNs;
+            interp_clock_observe(&clock, serverNs, arrive[next]);
+            interp_track_push(&track, serverNs, (float)xs[next], 0.0f, tickNs);
+            if (lowest < 0) lowest = xs[next];
+            highest = xs[next];
+        }
+        if (lowest < 0) continue;
+
+        int64_t render = interp_clock_render_time(&clock, now, frameNs);
+        float sx = 0, sy = 0;
+        int how = interp_track_sample(&track, render, clock.max_extrap_ns, &sx, &sy);
+        frames++;
+        extrapolated += how == INTERP_EXTRAP;
+        const char* bad = NULL;
+        if (render < prevRender) bad = "render time went backwards";
+        else if (sx < 0 || sx > GRID - 1 || sy != 0) bad = "off the board";
+        else if (sx < prevX && (cooldown > 1 || sx < (float)prevHighest)) bad = "moved backwards";
+        else if (sx < (float)lowest) bad = "behind the cells sent";
+        else if (sx > (float)highest + (cooldown > 1 ? 0 : ahead)) bad = "ahead of the cells sent";
+        if (bad) {
+            if (failures++ < 5)
+                printf("  %s %s: %s at %.3f s, x %.3f after %.3f (cells %d..%d sent)\n", profileNames[profile],
+                       cooldown > 1 ? "walk" : "run", bad, now / 1e9, sx, prevX, lowest, highest);
+        }
+        prevRender = render;
+        prevX = sx;
+        prevHighest = highest;
+    }
+    printf("%-8s %-4s %6d frames, delay settled at %5.1f ms, jitter estimate %5.1f ms, %4d extrapolated, %d failed\n",
+           profileNames[profile], cooldown > 1 ? "walk" : "run", frames, clock.delay_ns / 1e6, clock.jitter_ns / 1e6,
+           extrapolated, failures);
+    free(xs);
+    free(arrive);
+    return failures;
+}
+
+int main(int argc, char** argv) {
+    int seconds = 60;
+    const char* tracePath = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) seconds = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--jitter-ms") == 0 && i + 1 < argc) jitterMs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) tracePath = argv[++i];
+        else { printf("Usage: %s [--seconds N] [--jitter-ms N] [--trace PATH]\n", argv[0]); return 1; }
+    }
+    if (seconds < 1 || jitterMs < 0) { printf("Seconds must be positive and jitter not negative\n"); return 1; }
+    if (tracePath && loadTrace(tracePath) < 0) return 1;
+
+    int failures = 0;
+    for (profile_t p = STEADY; p < PROFILES; p++)
+        if (p != RECORDED || tracePath) failures += replay(p, STEP_TICKS, seconds) + replay(p, 1, seconds);
+    printf("check   %s\n", failures ? "MISMATCH" : "render time and positions monotonic and in bounds");
+    free(recorded);
+    return failures ? 1 : 0;
+}
@@ -1,86 +1,389 @@
 #define GL_SILENCE_DEPRECATION
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
 #include "glad/glad.h"
 #include "GLFW/glfw3.h"
 
-// Grid size
-#define GRID_SIZE 16
-
-// Player buffer
-int players[2][2] = {{0,0}, {9,9}};
-float colors[2][3] = {{0.98f, 0.73f, 0.01f},{0.19f, 0.89f, 0.75f}};
-double playercooldown[2];
+#include "../Common/bitpack.h"
+#include "../Common/frame.h"
+#include "../Common/frame_pacer.h"
+#include "../Common/game_msg.h"
+#include "../Common/grid_renderer.h"
+#include "../Common/input_queue.h"
+#include "../Common/interp.h"
+#include "../Common/move_rules.h"
+#include "../Common/net_loop.h"
+#include "../Common/predict.h"
+#include "../Common/profile.h"
+#include "../Common/snapshot.h"
+
+#define PORT 8080
+
+// Frame rate cap while something is moving; idle windows don't redraw
+#define FRAME_HZ 60
+
+// Boards larger than this are shown through a window of this many cells
+// that follows our player
+#define CAMERA_CELLS 64
+
+#define WELCOME_TIMEOUT_MS 5000
+
+// A batch the socket would not take all of is retried this often, and
+// given this long to go out before the exit frame
+#define SEND_RETRY_NS 2000000
+#define EXIT_FLUSH_MS 500
+
+#define TRACE_PATH "client_trace.json"
+
+// Board size and player count, from the welcome
+int gridSize;
+int maxPlayers;
+int viewCells;                 // cells shown per side
+
+// Player buffer, by player number: the server's last word on every player
+// in our area of interest; our own entry is replaced by the prediction
+// when drawing
+int (*players)[2];
+int* present;
+const float colors[4][3] = {{0.98f, 0.73f, 0.01f},{0.19f, 0.89f, 0.75f},{0.91f, 0.30f, 0.24f},{0.56f, 0.44f, 0.86f}};
+
+// States arrive as deltas against earlier ones (game_msg.h); the newest
+// is acked once the socket is drained
+snapshot_ring_t snapshots;
+int64_t ackDue = -1;           // tick of a state not acked yet, -1 none
+
+int me = -1;                   // our player index, -1 while spectating
+double moveDelay = MOVE_DELAY_S; // replaced by the server's cooldown on welcome
+predictor_t pred;
+int predicting;                // set once the first state gives us a position
+
+// Everyone else is drawn from the server's snapshots, slightly in the past,
+// interpolating between them; states are stamped with the server tick
+interp_track_t* tracks;
+interp_clock_t interpClock;
+int64_t tickNs;                // server tick period, from the welcome
+
+// Key callbacks queue events; processInput() turns them into moves. Arrows
+// and WASD both drive our one player.
+input_ring_t keyEvents;
+input_proc_t keyInput;
+const int arrowKeys[INPUT_DIRS] = { GLFW_KEY_UP, GLFW_KEY_DOWN, GLFW_KEY_LEFT, GLFW_KEY_RIGHT };
+const int wasdKeys[INPUT_DIRS] = { GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D };
+
+// Moves made during one processInput(), plus the ack of the newest state,
+// sent with a single write. Whatever the socket does not take stays at the
+// front and goes ahead of the next batch.
+uint8_t moveBatch[16 * (FRAME_HDR_SIZE + 8) + FRAME_HDR_SIZE];
+size_t moveBatchLen;
+
+int sockfd = -1;
+frame_rx_t rx;
+uint32_t txId;
+move_layout_t layout;
+frame_pacer_t pacer;
+
+// Network wakeups: GLFW can only sleep on window events, so a helper
+// thread sleeps on the socket and nudges the render loop with
+// glfwPostEmptyEvent(). It then waits until the loop has drained the
+// socket, so pending data wakes the window once, not continuously.
+pthread_t netThread;
+sem_t netDrained;
+int netPending;
+int netStop;
+
+// Pacer timestamps are on GLFW's clock
+int64_t nowNs(void) {
+    return (int64_t)(glfwGetTime() * 1e9);
+}
 
 // Callback for window resize
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     glViewport(0, 0, width, height);
+    frame_pacer_mark(&pacer);
+}
+
+// Window exposed or damaged: its contents need drawing again
+void window_refresh_callback(GLFWwindow* window) {
+    frame_pacer_mark(&pacer);
 }
 
-// Handle input (ESC to close)
-void processInput(GLFWwindow* window) {
-    const double moveDelay = 0.15; // seconds between moves while holding
+// Recent frames as a Chrome trace (F12; build with -DPROFILE)
+void writeTrace(void) {
+    long n = prof_write_trace(TRACE_PATH);
+    if (n < 0) perror(errno == ENOSYS ? "trace (build with -DPROFILE)" : TRACE_PATH);
+    else printf("Wrote %ld trace events to %s\n", n, TRACE_PATH);
+}
 
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-        glfwSetWindowShouldClose(window, 1);
+// ESC closes, F12 writes a trace; direction keys go on the input queue stamped with the time
+// GLFW delivered them (it reports no event times of its own). Callbacks
+// run inside glfwPollEvents/glfwWaitEvents, so a tap shorter than a frame
+// still arrives as a press and a release. OS key repeat is ignored: the
+// input processor repeats held keys itself.
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) glfwSetWindowShouldClose(window, 1);
+    if (key == GLFW_KEY_F12 && action == GLFW_PRESS) writeTrace();
+    if (action == GLFW_REPEAT) return;
+    for (int d = 0; d < INPUT_DIRS; d++)
+        if (key == arrowKeys[d] || key == wasdKeys[d]) input_ring_push(&keyEvents, nowNs(), 0, d, action == GLFW_PRESS);
+}
 
-    double t = glfwGetTime();
-    if (t-playercooldown[0] < moveDelay && t-playercooldown[1] < moveDelay) {return;}
+// One step of our player: predicted locally at once and queued for the
+// server tagged with its input sequence number. Refused while spectating,
+// off the board, with too many moves unacknowledged or while the socket is
+// too backed up to queue it.
+int applyMove(void* ctx, const input_cmd_t* cmd) {
+    if (me < 0 || !predicting) return 0;
+    int x = pred.pos[0] + cmd->dx, y = pred.pos[1] + cmd->dy;
+    if (moveBatchLen + FRAME_HDR_SIZE + 8 > sizeof moveBatch) return 0;
+    uint32_t seq = predict_input(&pred, x, y);
+    if (!seq) return 0;
+
+    uint8_t mv[8];
+    size_t n = move_encode(mv, sizeof mv, layout, me, x, y);
+    moveBatchLen += frame_encode(moveBatch + moveBatchLen, sizeof moveBatch - moveBatchLen,
+                                 FRAME_MOVE, seq, mv, (uint16_t)n);
+    frame_pacer_mark(&pacer);
+    return 1;
+}
 
-    if (t-playercooldown[0] > moveDelay) {// At this point, enough time has passed -- check held keys:
-        if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) {
-            if (players[0][1] < GRID_SIZE-1) { players[0][1]++; playercooldown[0] = t; }
-        }
-        else if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) {
-            if (players[0][1] > 0) { players[0][1]--; playercooldown[0] = t; }
+// Write as much of the batch as the socket takes and keep the rest. Moves
+// are predicted already and a frame cut short would break the server's
+// framing, so nothing is dropped. Returns -1 if the connection failed.
+int sendMoves(void) {
+    size_t off = 0;
+    while (off < moveBatchLen) {
+        ssize_t n = write(sockfd, moveBatch + off, moveBatchLen - off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            perror("send");
+            return -1;
         }
-        else if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS) {
-            if (players[0][0] > 0) { players[0][0]--; playercooldown[0] = t; }
+        off += (size_t)n;
+    }
+    memmove(moveBatch, moveBatch + off, moveBatchLen - off);
+    moveBatchLen -= off;
+    return 0;
+}
+
+// Turn the keys queued since the last frame into moves, at the times they
+// fall due, and send them together. Returns 0 once the connection is gone.
+int processInput(void) {
+    PROF_SCOPE("processInput");
+    input_proc_run(&keyInput, &keyEvents, nowNs(), applyMove, NULL);
+    if (sendMoves() < 0) return 0;
+    if (moveBatchLen) frame_pacer_wake_at(&pacer, nowNs() + SEND_RETRY_NS);
+    return 1;
+}
+
+// While a movement key is held, wake up when its next step is due so it
+// is taken on time without OS key-repeat events.
+void scheduleKeyRepeat(void) {
+    int64_t due = input_proc_next_due(&keyInput);
+    if (due != INPUT_NEVER) frame_pacer_wake_at(&pacer, due);
+}
+
+// Board size, player count and our player number. The player arrays are
+// sized here, so nothing else is read from the server before it.
+int applyWelcome(const uint8_t* payload, uint16_t len) {
+    welcome_t w;
+    if (welcome_decode(payload, len, &w) < 0 || w.grid < 2 || w.max_players < 1 || players) return -1;
+    gridSize = w.grid;
+    maxPlayers = w.max_players;
+    viewCells = gridSize > CAMERA_CELLS ? CAMERA_CELLS : gridSize;
+    layout = move_layout_for(gridSize, maxPlayers);
+    players = calloc((size_t)maxPlayers, sizeof *players);
+    present = calloc((size_t)maxPlayers, sizeof *present);
+    tracks = calloc((size_t)maxPlayers, sizeof *tracks);
+    if (!players || !present || !tracks) { perror("malloc"); return -1; }
+    for (int p = 0; p < maxPlayers; p++) interp_track_init(&tracks[p]);
+
+    me = w.player < maxPlayers ? w.player : -1;
+    if (w.tick_hz > 0) {
+        moveDelay = (double)w.cooldown_ticks / w.tick_hz;
+        tickNs = 1000000000LL / w.tick_hz;
+        interp_clock_init(&interpClock, tickNs);
+    }
+    if (me < 0) printf("Server is full, spectating.\n");
+    else printf("Playing as player %d.\n", me);
+    printf("Board %dx%d, view radius %d%s.\n", gridSize, gridSize, w.view_radius,
+           w.view_radius ? "" : " (whole board)");
+    return 0;
+}
+
+// Drop a player from our view; its track starts over if it comes back
+void forgetPlayer(int p) {
+    present[p] = 0;
+    interp_track_init(&tracks[p]);
+}
+
+// Our area of interest at server tick `tick` (game_msg.h), rebuilt from
+// the delta against an earlier state, and the ack of our last input the
+// server processed. Players missing from it have left the view; everyone
+// in it gets an interpolation sample, so one that stopped is held where it
+// stopped. Returns -1 if the state can't be decoded.
+int applyState(const uint8_t* payload, uint16_t len, uint32_t tick) {
+    PROF_SCOPE("applyState");
+    state_hdr_t h;
+    snapshot_t* prev = snapshot_ring_latest(&snapshots);
+    snapshot_t* s = snapshot_ring_next(&snapshots);
+    if (!players || state_decode(payload, len, layout, &h, &snapshots, s) < 0) return -1;
+    if (s->n > 0 && s->e[s->n - 1].key >= maxPlayers) return -1;
+    s->tick = tick;
+    snapshot_ring_push(&snapshots);
+    ackDue = tick;
+
+    int64_t serverNs = (int64_t)tick * tickNs;
+    if (tickNs > 0) interp_clock_observe(&interpClock, serverNs, nowNs());
+
+    // both key lists are sorted: one merge finds who left
+    for (int i = 0, j = 0; prev && i < prev->n; i++) {
+        while (j < s->n && s->e[j].key < prev->e[i].key) j++;
+        if (j == s->n || s->e[j].key != prev->e[i].key) forgetPlayer(prev->e[i].key);
+    }
+
+    for (int i = 0; i < s->n; i++) {
+        int p = s->e[i].key;
+        present[p] = 1;
+        players[p][0] = s->e[i].x;
+        players[p][1] = s->e[i].y;
+        if (p != me) {
+            if (tickNs > 0) interp_track_push(&tracks[p], serverNs, (float)s->e[i].x, (float)s->e[i].y, tickNs);
+        } else if (!predicting) {
+            predict_init(&pred, gridSize, s->e[i].x, s->e[i].y);
+            predicting = 1;
         }
-        else if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) {
-            if (players[0][0] < GRID_SIZE-1) { players[0][0]++; playercooldown[0] = t; }
+    }
+    // the ack can advance without our position changing (a refused move)
+    if (predicting && present[me]) predict_reconcile(&pred, h.ack, players[me][0], players[me][1]);
+    frame_pacer_mark(&pacer);
+    return 0;
+}
+
+// Drain the socket. Returns 0 once the connection is gone.
+int readNetwork(void) {
+    PROF_SCOPE("readNetwork");
+    for (;;) {
+        ssize_t n = frame_rx_fill(&rx, sockfd);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // one ack covers every state read in this drain; it goes out
+            // with this frame's moves
+            if (ackDue >= 0 && frame_encode(moveBatch + moveBatchLen, sizeof moveBatch - moveBatchLen,
+                                            FRAME_ACK, (uint32_t)ackDue, NULL, 0)) {
+                moveBatchLen += FRAME_HDR_SIZE;
+                ackDue = -1;
+            }
+            return 1;
         }
-    } if (t-playercooldown[1] > moveDelay) {
-        if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-            if (players[1][1] < GRID_SIZE-1) { players[1][1]++; playercooldown[1] = t; }
+        if (n <= 0) {
+            printf("Server closed connection.\n");
+            return 0;
         }
-        else if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-            if (players[1][1] > 0) { players[1][1]--; playercooldown[1] = t; }
+
+        frame_t f;
+        int r;
+        while ((r = frame_rx_next(&rx, &f)) > 0) {
+            if (f.hdr.type == FRAME_EXIT) {
+                printf("Server requested exit. Closing.\n");
+                return 0;
+            } else if (f.hdr.type == FRAME_WELCOME) {
+                if (applyWelcome(f.payload, f.hdr.len) < 0) {
+                    printf("Bad welcome from server. Closing.\n");
+                    return 0;
+                }
+            } else if (f.hdr.type == FRAME_STATE) {
+                if (applyState(f.payload, f.hdr.len, f.hdr.id) < 0) {
+                    printf("Bad state from server. Closing.\n");
+                    return 0;
+                }
+            } else if (f.hdr.type == FRAME_TEXT && f.hdr.len > 0) {
+                printf("From server: %.*s\n", (int)f.hdr.len, (const char*)f.payload);
+            }
         }
-        else if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-            if (players[1][0] > 0) { players[1][0]--; playercooldown[1] = t; }
+        if (r < 0) {
+            printf("Malformed frame from server. Closing.\n");
+            return 0;
         }
-        else if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-            if (players[1][0] < GRID_SIZE-1) { players[1][0]++; playercooldown[1] = t; }
+    }
+}
+
+void* netWatch(void* arg) {
+    struct pollfd pfd = { sockfd, POLLIN, 0 };
+    while (!__atomic_load_n(&netStop, __ATOMIC_ACQUIRE)) {
+        if (poll(&pfd, 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
         }
+        __atomic_store_n(&netPending, 1, __ATOMIC_RELEASE);
+        glfwPostEmptyEvent();
+        sem_wait(&netDrained);
     }
-    // Do a tcp-sync packet here... basically something sending the movement to the server... or if the server, process the packet and send to all clients...
-    // Packet structure: 2 bits - client id (0=server), 5 bits - x coord, 5 bits - y c
+    return NULL;
 }
 
+// Connect and ask for a room; a server hosting a single game ignores the
+// request.
+int connectServer(const char* host, int room) {
+    struct sockaddr_in servaddr = {0};
+    servaddr.sin_family = AF_INET;
+    servaddr.sin_port = htons(PORT);
+    if (inet_pton(AF_INET, host, &servaddr.sin_addr) != 1) {
+        printf("Bad server address %s\n", host);
+        return -1;
+    }
 
-// Vertex and fragment shader sources (inline for simplicity)
-const char* vertexShaderSource = "#version 330 core\n"
-"layout (location = 0) in vec2 aPos;\n"
-"uniform vec2 offset;\n"
-"uniform float scale;\n"
-"void main() {\n"
-"    vec2 p = aPos * scale + offset;\n" 
-"    gl_Position = vec4(p, 0.0, 1.0);\n"
-"}\n";
+    sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sockfd < 0) { perror("socket"); return -1; }
+    if (connect(sockfd, (struct sockaddr*)&servaddr, sizeof(servaddr)) != 0) {
+        printf("Can't connect to host %s\n", host);
+        close(sockfd);
+        return -1;
+    }
+    if (frame_send(sockfd, FRAME_JOIN, (uint32_t)room, NULL, 0) < 0) {
+        perror("send");
+        close(sockfd);
+        return -1;
+    }
+    net_set_nonblocking(sockfd);
+    net_set_nodelay(sockfd);
+    if (frame_rx_init(&rx, FRAME_RX_CAP) < 0) { perror("malloc"); return -1; }
+    printf("Connected to server %s on port %d, room %d.\n", host, PORT, room);
+    return 0;
+}
 
-const char* fragmentShaderSource = "#version 330 core\n"
-"out vec4 FragColor;\n"
-"uniform vec3 color;\n"
-"void main() {\n"
-"    FragColor = vec4(color, 1.0);\n"
-"}\n";
+// The window and the player arrays are sized by the welcome, so wait for
+// it before opening anything.
+int awaitWelcome(void) {
+    struct pollfd pfd = { sockfd, POLLIN, 0 };
+    while (!players) {
+        int r = poll(&pfd, 1, WELCOME_TIMEOUT_MS);
+        if (r < 0 && errno != EINTR) { perror("poll"); return -1; }
+        if (r == 0) { printf("No welcome from server.\n"); return -1; }
+        if (!readNetwork()) return -1;
+    }
+    return 0;
+}
 
-int main() {
-    // Initialize GLFW
+int main(int argc, char** argv) {
+    const char* host = argc > 1 ? argv[1] : "127.0.0.1";
+    int room = argc > 2 ? atoi(argv[2]) : 0;
+    // Initialize GLFW; its clock stamps the states read while waiting
     if (!glfwInit()) {
         printf("Failed to initialize GLFW\n");
         return -1;
     }
+    if (connectServer(host, room) < 0 || awaitWelcome() < 0) {
+        glfwTerminate();
+        return 1;
+    }
 
     // OpenGL 3.3 Core Profile
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -96,6 +399,10 @@ int main() {
     }
     glfwMakeContextCurrent(window);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetWindowRefreshCallback(window, window_refresh_callback);
+    glfwSetKeyCallback(window, key_callback);
+    input_ring_init(&keyEvents);
+    input_proc_init(&keyInput, 1, (int64_t)(moveDelay * 1e9));
 
     // Load GLAD
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
@@ -108,98 +415,109 @@ int main() {
     glfwGetFramebufferSize(window, &w, &h);
     glViewport(0, 0, w, h);
 
-    // Define rectangle vertices (two triangles)
-    float vertices[] = {
-        -0.5f, -0.5f,
-         0.5f, -0.5f,
-         0.5f,  0.5f,
-        -0.5f, -0.5f,
-         0.5f,  0.5f,
-        -0.5f,  0.5f
-    };
-
-    // Create VAO & VBO
-    unsigned int VAO, VBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    // Vertex attributes
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-
-    // Compile shaders
-    unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-
-    unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-
-    // Link shader program
-    GLuint prog = glCreateProgram();
-    glAttachShader(prog, vertexShader);
-    glAttachShader(prog, fragmentShader);
-    glLinkProgram(prog);
-    // checkLink(prog);
-
-    // Uniform locations
-    GLint locOffset = glGetUniformLocation(prog, "offset");
-    GLint locScale  = glGetUniformLocation(prog, "scale");
-    GLint locColor  = glGetUniformLocation(prog, "color");
-
-    float cellScale = 2.0f / GRID_SIZE; // scale square to fit grid
-
-    // Render loop
+    // Board and players are drawn as one instanced batch
+    grid_batch_t batch;
+    if (grid_batch_init(&batch, viewCells, maxPlayers) < 0) {
+        printf("Out of memory\n");
+        glfwTerminate();
+        return -1;
+    }
+    grid_renderer_t renderer;
+    grid_renderer_init(&renderer, &batch);
+    float* shownX = malloc((size_t)maxPlayers * sizeof *shownX);
+    float* shownY = malloc((size_t)maxPlayers * sizeof *shownY);
+    float (*shownRgb)[3] = malloc((size_t)maxPlayers * sizeof *shownRgb);
+    if (!shownX || !shownY || !shownRgb) { perror("malloc"); return -1; }
+
+    sem_init(&netDrained, 0, 0);
+    pthread_create(&netThread, NULL, netWatch, NULL);
+
+    // Render loop: redraw only when something changed, otherwise sleep
+    // until input, a window event, a server message or a held key's next step
+    frame_pacer_init(&pacer, FRAME_HZ);
     while (!glfwWindowShouldClose(window)) {
-        processInput(window);
-
-        glUseProgram(prog);
-        glBindVertexArray(VAO);
-
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        if (locOffset == -1) fprintf(stderr, "Warning: 'offset' uniform not found\n");
-
-        // draw grid cells (light gray)
-        for (int y = 0; y < GRID_SIZE; ++y) {
-            for (int x = 0; x < GRID_SIZE; ++x) {
-                float ox = -1.0f + cellScale * (x + 0.5f);
-                float oy = -1.0f + cellScale * (y + 0.5f);
-                glUniform2f(locOffset, ox, oy);
-                glUniform1f(locScale, cellScale);
-                glUniform3f(locColor, 0.25f, 0.25f, 0.25f);
-                glDrawArrays(GL_TRIANGLES, 0, 6);
+        if (!readNetwork()) break;
+        if (__atomic_exchange_n(&netPending, 0, __ATOMIC_ACQ_REL)) sem_post(&netDrained);
+
+        if (!processInput()) break;
+        scheduleKeyRepeat();
+
+        if (frame_pacer_ready(&pacer, nowNs())) {
+            PROF_SCOPE("draw");
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            // our player where we predict it, the others as they were one
+            // interpolation delay ago; keep drawing while any is in motion.
+            // On a large board the camera keeps our player centred.
+            int64_t renderNs = interp_clock_render_time(&interpClock, nowNs(), pacer.period_ns);
+            int camX = 0, camY = 0;
+            if (viewCells < gridSize && me >= 0 && present[me]) {
+                camX = (predicting ? pred.pos[0] : players[me][0]) - viewCells / 2;
+                camY = (predicting ? pred.pos[1] : players[me][1]) - viewCells / 2;
+                camX = camX < 0 ? 0 : camX > gridSize - viewCells ? gridSize - viewCells : camX;
+                camY = camY < 0 ? 0 : camY > gridSize - viewCells ? gridSize - viewCells : camY;
+            }
+            int shown = 0;
+            for (int p = 0; p < maxPlayers; p++) {
+                if (!present[p]) continue;
+                float sx = (float)players[p][0], sy = (float)players[p][1];
+                if (p == me) {
+                    if (predicting) { sx = (float)pred.pos[0]; sy = (float)pred.pos[1]; }
+                } else if (tickNs > 0) {
+                    interp_track_sample(&tracks[p], renderNs, interpClock.max_extrap_ns, &sx, &sy);
+                    if (!interp_track_settled(&tracks[p], renderNs, interpClock.max_extrap_ns)) frame_pacer_mark(&pacer);
+                }
+                sx -= (float)camX;
+                sy -= (float)camY;
+                if (sx < -0.5f || sy < -0.5f || sx > viewCells - 0.5f || sy > viewCells - 0.5f) continue;
+                shownX[shown] = sx;
+                shownY[shown] = sy;
+                memcpy(shownRgb[shown++], colors[p % 4], sizeof colors[0]);
             }
-        }
-
-        // draw player (green)
-        for (int i = 0; i < sizeof(players)/sizeof(players[0]); i++){
-            float pox = -1.0f + cellScale * (players[i][0] + 0.5f);
-            float poy = -1.0f + cellScale * (players[i][1] + 0.5f);
-            glUniform2f(locOffset, pox, poy);
-            glUniform1f(locScale, cellScale * 0.9f); // slightly smaller so grid lines show
-            float* color = colors[i];
-            glUniform3f(locColor, color[0], color[1], color[2]);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
 
+            // only moved players are re-uploaded; the grid goes up once
+            grid_batch_set_players_f(&batch, shownX, shownY, (const float (*)[3])shownRgb, shown);
+            grid_renderer_draw(&renderer, &batch);
+            PROF_SCOPE("swap");
+            glfwSwapBuffers(window);
         }
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        PROF_SCOPE("wait");
+        int64_t wait = frame_pacer_timeout(&pacer, nowNs());
+        if (wait < 0) glfwWaitEvents();
+        else if (wait == 0) glfwPollEvents();
+        else glfwWaitEventsTimeout(wait / 1e9);
     }
 
+    // the exit goes after any half-sent batch, never inside a frame
+    struct pollfd out = { sockfd, POLLOUT, 0 };
+    while (moveBatchLen && sendMoves() == 0 && moveBatchLen && poll(&out, 1, EXIT_FLUSH_MS) > 0)
+        ;
+    if (!moveBatchLen) frame_send(sockfd, FRAME_EXIT, txId++, NULL, 0);
+    if (predicting) printf("Prediction corrections: %llu\n", (unsigned long long)pred.corrections);
+    if (tickNs > 0) printf("Interpolation delay %.1f ms, jitter %.1f ms\n",
+                           interpClock.delay_ns / 1e6, interpClock.jitter_ns / 1e6);
+
+    // wake the watcher out of poll() or sem_wait() and let it finish
+    __atomic_store_n(&netStop, 1, __ATOMIC_RELEASE);
+    shutdown(sockfd, SHUT_RDWR);
+    sem_post(&netDrained);
+    pthread_join(netThread, NULL);
+    sem_destroy(&netDrained);
+
     // Cleanup
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
+    grid_renderer_free(&renderer);
+    grid_batch_free(&batch);
+    free(shownX);
+    free(shownY);
+    free(shownRgb);
+    free(players);
+    free(present);
+    free(tracks);
+    snapshot_ring_free(&snapshots);
+    frame_rx_free(&rx);
+    close(sockfd);
 
     glfwTerminate();
     return 0;
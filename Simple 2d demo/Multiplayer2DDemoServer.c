@@ -1,82 +1,536 @@
 #define GL_SILENCE_DEPRECATION
 #include <stdio.h>
-#include "glad/glad.h"
-#include "GLFW/glfw3.h"
 #include <stdlib.h>
 #include <string.h>
+#include <signal.h>
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
-#include <sys/select.h>
+
+#include "../Common/net_loop.h"
+#include "../Common/client_table.h"
+#include "../Common/alloc_count.h"
+#include "../Common/bitpack.h"
+#include "../Common/entity_store.h"
+#include "../Common/frame_pacer.h"
+#include "../Common/game_msg.h"
+#include "../Common/game_sim.h"
+#include "../Common/journal.h"
+#include "../Common/metrics.h"
+#include "../Common/pool.h"
+#include "../Common/profile.h"
+#include "../Common/render_backend.h"
+#include "../Common/replicate.h"
+#include "../Common/snapshot.h"
+#include "../Common/tick.h"
+#include "../Common/world.h"
+
+// The server is headless unless asked for a spectator view. Build with
+// -DSERVER_NO_GL to drop the GL backend and link without GLFW/OpenGL.
+#ifndef SERVER_NO_GL
+#include "glad/glad.h"
+#include "GLFW/glfw3.h"
+#include "../Common/render_gl.h"
+#endif
 
 #define PORT 8080
 #define MAX  1024
 
-typedef struct {
-    int id;      // simple numeric ID
-    int fd;      // socket descriptor
-    int active;
-} client_t;
+// Board size and player slots when not given with --grid / --max-players
+#define DEFAULT_GRID 16
+#define DEFAULT_MAX_PLAYERS 4
+#define MAX_GRID 65535         // coordinates and sizes go out as u16
+#define MAX_PLAYERS_LIMIT 4096
+
+// Simulation rate when not given with --tick
+#define DEFAULT_TICK_HZ 30
+#define MAX_CATCHUP 5          // ticks run back-to-back after a stall
+
+// Frame rate cap for the spectator window while the board changes
+#define FRAME_HZ 60
+
+// Where 'trace' writes when not given a path (build with -DPROFILE)
+#define DEFAULT_TRACE "server_trace.json"
+
+#define DEFAULT_STATS_EVERY 10 // seconds between --stats-file dumps
+#define DEFAULT_WORLD_BUDGET_MB 4  // chunk cache for --world
+#define DEFAULT_KEYFRAME_EVERY 10  // seconds between --journal keyframes
+#define JOURNAL_RING_MB 8      // journal records waiting for the disk
+
+int gridSize = DEFAULT_GRID;
+int maxPlayers = DEFAULT_MAX_PLAYERS;
+int viewRadius;                // --view-radius, 0 = every client sees the whole board
+
+// Terrain from --world (world.h): walls and water block movement. Without
+// one the board is open floor.
+world_t terrain;
+int haveTerrain;
+
+// Authoritative state (game_sim.h): one entity per player in play. The
+// server's own player is created first; a client gets one on connect while
+// there is room and loses it on disconnect. The slot of an entity's handle
+// is its player number on the wire (always < maxPlayers, see
+// entity_store.h) and its key in the spatial hash. Every change to it is
+// also written to the --journal, if any.
+sim_t sim;
+entity_t serverPlayer;
+journal_t journal;
+
+// Replication state of a connection (replicate.h), by client slot. A
+// record is reset rather than freed when its client leaves, and the next
+// client in the slot reuses its snapshots.
+replica_t* peers;
+int peerCap;
+replica_view_t replication;    // view radius, layout and scratch for replicate()
+
+int cooldownTicks;             // moveDelay expressed in ticks, sim.cooldown_ticks
+int boardMoved;                // something moved this tick: redraw the view
+
+const double moveDelay = MOVE_DELAY_S;
+
+net_loop_t loop;
+client_table_t clients;
+msg_pool_t msgPool;            // every frame queued to clients (sendq.h)...
+arena_t tickArena;             // ...but states, built in place and reset on flush
+int listenfd;
+tick_timer_t ticker;
+move_layout_t layout;
+frame_pacer_t pacer;           // spectator view: redraw only on change
+
+metrics_t metrics;
+int64_t startNs;
+FILE* statsFile;               // --stats-file, appended every statsEveryTicks
+uint64_t statsEveryTicks;
+uint64_t nextStatsTick;        // skipped ticks can step over a multiple
+uint64_t replicateNs;          // replicate() totals, for 'stats'
+uint64_t replicateClientTicks;
+
+// Queue a requested destination for player p; applied on the next tick.
+// seq is the client's input sequence number (0 for the server's own player).
+void queueMove(int p, int x, int y, uint32_t seq) {
+    if (sim_queue_move(&sim, p, x, y, seq) == 0) journal_move(&journal, p, x, y, seq);
+}
+
+// Create a player entity for client ownerId (0 = the server's own), or
+// return ENTITY_NONE when all player numbers are taken.
+entity_t spawnPlayer(int32_t ownerId) {
+    entity_t h = sim_spawn(&sim, ownerId);
+    if (h == ENTITY_NONE) return h;
+    journal_spawn(&journal, ownerId, h);
+    boardMoved = 1;
+    return h;
+}
+
+void destroyPlayer(entity_t h) {
+    if (sim_destroy(&sim, h) < 0) return;
+    journal_despawn(&journal, h);
+    boardMoved = 1;
+}
 
-// Grid size
-#define GRID_SIZE 16
+// Keyboard of the spectator view. The server's own player goes through
+// the same queue as remote players so it obeys the same cooldown.
+void processInput(render_backend_t* view) {
+    int i = entity_index(&sim.ents, serverPlayer);
+    int p = entity_slot(serverPlayer);
+    if (i < 0 || sim.inputs[p].len > 0 || sim_cooling(&sim, i, ticker.tick)) return;
+
+    int x = sim.ents.x[i], y = sim.ents.y[i];
+    if (view->key_down(view, RENDER_KEY_UP)) y++;
+    else if (view->key_down(view, RENDER_KEY_DOWN)) y--;
+    else if (view->key_down(view, RENDER_KEY_LEFT)) x--;
+    else if (view->key_down(view, RENDER_KEY_RIGHT)) x++;
+    else return;
+    queueMove(p, x, y, 0);
+}
 
-// Player buffer
-int players[4][2] = {{14,14}, {1,1}};
-float colors[4][3] = {{0.98f, 0.73f, 0.01f},{0.19f, 0.89f, 0.75f}};
+// Player number of a client, -1 for spectators
+int playerOf(client_t* c) {
+    return c->slot < peerCap ? replica_player(&peers[c->slot]) : -1;
+}
 
-// Callback for window resize
-void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
-    glViewport(0, 0, width, height);
+replica_t* addPeer(client_t* c) {
+    if (c->slot >= peerCap) {
+        int ncap = peerCap ? peerCap : 16;
+        while (ncap <= c->slot) ncap *= 2;
+        replica_t* p = realloc(peers, (size_t)ncap * sizeof *p);
+        if (!p) return NULL;
+        memset(p + peerCap, 0, (size_t)(ncap - peerCap) * sizeof *p);
+        peers = p;
+        peerCap = ncap;
+    }
+    replica_t* pr = &peers[c->slot];
+    replica_reset(pr);
+    return replica_reserve(pr, &replication) < 0 ? NULL : pr;
 }
 
-// Handle input (ESC to close)
-void processInput(GLFWwindow* window) {
-    const double moveDelay = 0.15; // seconds between moves while holding
-    double playercooldown = 0;
+void dropClient(client_t* c) {
+    if (c->slot < peerCap) {
+        replica_t* pr = &peers[c->slot];
+        if (pr->player != ENTITY_NONE) destroyPlayer(pr->player);
+        replica_reset(pr);
+    }
+    net_loop_del(&loop, c->fd);
+    close(c->fd);
+    client_table_remove(&clients, c);
+}
 
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-        glfwSetWindowShouldClose(window, 1);
+void dropFlushed(client_t* c, void* ctx) {
+    printf("Client %d disconnected\n", c->id);
+    dropClient(c);
+}
 
-    double t = glfwGetTime();
-    if (t-playercooldown < moveDelay) {return;}
+// Build and queue one client's FRAME_STATE for this tick (replicate.h),
+// straight into the tick arena. Returns SENDQ_*.
+int replicateTo(client_t* c, replica_t* pr) {
+    msg_buf_t* state = msg_buf_arena(&tickArena, FRAME_MAX_PAYLOAD);
+    if (!state) return SENDQ_OK;
+    state_hdr_t h;
+    size_t len = replica_build(pr, &sim, &replication, (uint32_t)ticker.tick, state->data + FRAME_HDR_SIZE,
+                               FRAME_MAX_PAYLOAD, &h);
+    state = msg_buf_arena_end(&tickArena, state, FRAME_STATE, (uint32_t)ticker.tick, (uint16_t)len);
+    if (!state) return SENDQ_OK;
+    int rc = client_send_buf(&clients, c, state, 1);
+    msg_buf_unref(state);
+    if (rc == SENDQ_DROPPED) return rc;
+
+    replica_sent(pr);
+    metrics_add(&metrics, MC_AOI_UPDATES, (uint64_t)h.updates);
+    metrics_add(&metrics, MC_AOI_LEAVES, (uint64_t)h.leaves);
+    metrics_add(&metrics, MC_STATE_BYTES, (uint64_t)len);
+    if (h.flags & STATE_FULL) metrics_add(&metrics, MC_STATE_FULL, 1);
+    return rc;
+}
 
-    if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-        if (players[0][1] < GRID_SIZE-1) { players[0][1]++; playercooldown = t; }
+void replicate(void) {
+    PROF_SCOPE("replicate");
+    int64_t began = mono_ns();
+    for (int i = 0; i < clients.count; ) {
+        client_t* c = &clients.clients[i];
+        if (replicateTo(c, &peers[c->slot]) == SENDQ_KICK) {
+            printf("Client %d is not keeping up, disconnecting\n", c->id);
+            dropClient(c);  // swap-remove: re-examine index i
+            continue;
+        }
+        i++;
     }
-    else if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-        if (players[0][1] > 0) { players[0][1]--; playercooldown = t; }
+    uint64_t took = (uint64_t)(mono_ns() - began);
+    metrics_observe(&metrics, MH_REPLICATE_NS, took);
+    replicateNs += took;
+    replicateClientTicks += (uint64_t)clients.count;
+}
+
+// One fixed simulation step: apply at most one queued move per player
+// (game_sim.h), close the tick in the journal, then send every client what
+// changed in its view. State is droppable: a client over its high-water
+// mark skips this tick's copy (the next delta still builds on what it
+// acked) and is kicked past the hard limit.
+void simTick(void) {
+    PROF_SCOPE("simTick");
+    {
+        PROF_SCOPE("step");
+        boardMoved = sim_step(&sim, ticker.tick) > 0;
     }
-    else if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-        if (players[0][0] > 0) { players[0][0]--; playercooldown = t; }
+    if (boardMoved) frame_pacer_mark(&pacer);
+    if (journal_tick(&journal, ticker.tick, &sim) < 0)
+        printf("Journal could not keep up (%s), it ends before tick %llu\n",
+               journal.error ? strerror(journal.error) : "disk too slow", (unsigned long long)journal.stop_tick);
+    replicate();
+}
+
+void acceptClients(void) {
+    PROF_SCOPE("acceptClients");
+    for (;;) {
+        int newfd = accept(listenfd, NULL, NULL);
+        if (newfd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) perror("accept");
+            break;
+        }
+        client_t* c = client_table_add(&clients, newfd);
+        if (!c) { close(newfd); continue; }
+        replica_t* pr = addPeer(c);
+        if (!pr) { client_table_remove(&clients, c); close(newfd); continue; }
+        net_set_nonblocking(newfd);
+        net_loop_add(&loop, newfd, NET_READ | NET_WRITE | NET_EDGE);
+
+        // spectator if all players are taken; the state follows on the
+        // next tick, full since nothing has been acked yet
+        pr->player = spawnPlayer(c->id);
+        welcome_t w = { playerOf(c), cooldownTicks, ticker.hz, gridSize, maxPlayers, viewRadius };
+        uint8_t welcome[WELCOME_SIZE];
+        welcome_encode(welcome, &w);
+        client_send(&clients, c, FRAME_WELCOME, welcome, sizeof welcome);
+        printf("New client connected with id %d (fd=%d, player %d)\n", c->id, newfd, w.player);
     }
-    else if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-        if (players[0][0] < GRID_SIZE-1) { players[0][0]++; playercooldown = t; }
+}
+
+void serviceClient(int fd, uint32_t events) {
+    PROF_SCOPE("serviceClient");
+    client_t* c = client_table_by_fd(&clients, fd);
+    if (!c) return;
+
+    if (events & NET_WRITE) {
+        if (client_flush(&clients, c) < 0) {
+            printf("Client %d disconnected\n", c->id);
+            dropClient(c);
+            return;
+        }
+    }
+    if (!(events & (NET_READ | EPOLLHUP | EPOLLERR))) return;
+
+    for (;;) {
+        ssize_t n = client_read(&clients, c);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (n <= 0) {
+            printf("Client %d disconnected\n", c->id);
+            dropClient(c);
+            return;
+        }
+
+        frame_t f;
+        int r;
+        while ((r = client_next_frame(&clients, c, &f)) > 0) {
+            if (f.hdr.type == FRAME_EXIT) {
+                client_send(&clients, c, FRAME_EXIT, NULL, 0);
+                client_flush(&clients, c);
+                printf("Client %d requested exit\n", c->id);
+                dropClient(c);
+                return;
+            } else if (f.hdr.type == FRAME_MOVE) {
+                int id, x, y;
+                int p = playerOf(c);
+                if (p > 0 && move_decode(f.payload, f.hdr.len, layout, &id, &x, &y) == 0 && id == p)
+                    queueMove(p, x, y, f.hdr.id);
+            } else if (f.hdr.type == FRAME_TEXT) {
+                printf("Client %d: %.*s\n", c->id, (int)f.hdr.len, (const char*)f.payload);
+            } else if (f.hdr.type == FRAME_ACK) {
+                replica_ack(&peers[c->slot], f.hdr.id);
+            } else if (f.hdr.type == FRAME_PING) {
+                if (client_send(&clients, c, FRAME_PONG, f.payload, f.hdr.len) == SENDQ_KICK) {
+                    dropClient(c);
+                    return;
+                }
+            }
+        }
+        if (r < 0) {
+            printf("Client %d sent a malformed frame\n", c->id);
+            dropClient(c);
+            return;
+        }
     }
-    // Do a tcp-sync packet here... basically something sending the movement to the server... or if the server, process the packet and send to all clients...
-    // Packet structure: 2 bits - client id (0=server), 5 bits - x coord, 5 bits - y coord
 }
 
-// Vertex and fragment shader sources (inline for simplicity)
-const char* vertexShaderSource = "#version 330 core\n"
-"layout (location = 0) in vec2 aPos;\n"
-"uniform vec2 offset;\n"
-"uniform float scale;\n"
-"void main() {\n"
-"    vec2 p = aPos * scale + offset;\n" 
-"    gl_Position = vec4(p, 0.0, 1.0);\n"
-"}\n";
+// Returns 0 when the console asked the server to exit.
+int readConsole(void) {
+    PROF_SCOPE("readConsole");
+    char line[MAX];
+    if (!fgets(line, sizeof line, stdin)) {
+        net_loop_del(&loop, STDIN_FILENO);
+        return 1;
+    }
 
-const char* fragmentShaderSource = "#version 330 core\n"
-"out vec4 FragColor;\n"
-"uniform vec3 color;\n"
-"void main() {\n"
-"    FragColor = vec4(color, 1.0);\n"
-"}\n";
+    if (strncmp(line, "exit", 4) == 0) {
+        // tell all clients to exit; flushed before serviceNetwork returns
+        msg_buf_t* bye = msg_buf_frame(&msgPool, FRAME_EXIT, (uint32_t)ticker.tick, NULL, 0);
+        for (int i = 0; bye && i < clients.count; i++)
+            client_send_buf(&clients, &clients.clients[i], bye, 0);
+        msg_buf_unref(bye);
+        printf("Server shutting down.\n");
+        return 0;
+    }
+
+    if (strncmp(line, "stats", 5) == 0) {
+        printf("Server metrics after %.1f s (tick %llu, %d clients):\n",
+               (mono_ns() - startNs) / 1e9, (unsigned long long)ticker.tick, clients.count);
+        metrics_print(stdout, &metrics);
+        if (replicateClientTicks)
+            printf("replication: %.0f ns and %.1f state bytes per client per tick, view radius %d\n",
+                   (double)replicateNs / replicateClientTicks,
+                   (double)metrics.counters[MC_STATE_BYTES] / replicateClientTicks, viewRadius);
+        printf("buffers: %.1f KB of frame slabs, %.1f KB of tick arena (peak %.1f KB)\n",
+               msg_pool_bytes(&msgPool) / 1e3, arena_bytes(&tickArena) / 1e3, tickArena.peak / 1e3);
+        if (journal.ring)
+            printf("journal: %llu ticks, %d keyframes, %.1f KB%s\n", (unsigned long long)journal.ticks,
+                   journal.nkeys, journal_bytes(&journal) / 1e3, journal.stopped ? " (stopped)" : "");
+        if (haveTerrain)
+            printf("world: %d of %d chunks cached, %llu hits, %llu misses, %llu evictions, %llu damaged\n",
+                   world_resident(&terrain), terrain.nslots, (unsigned long long)terrain.hits,
+                   (unsigned long long)terrain.misses, (unsigned long long)terrain.evictions,
+                   (unsigned long long)terrain.bad_chunks);
+        if (strncmp(line, "stats clients", 13) == 0) {
+            for (int i = 0; i < clients.count; i++) {
+                client_t* c = &clients.clients[i];
+                printf("  client %-8d player %2d  in %llu B / %llu frames  out %llu B  queued %zu B\n",
+                       c->id, playerOf(c), (unsigned long long)c->bytes_in,
+                       (unsigned long long)c->frames_in, (unsigned long long)c->tx.sent, c->tx.bytes);
+            }
+        }
+        return 1;
+    }
+
+    if (strncmp(line, "trace", 5) == 0) {
+        char path[MAX];
+        if (sscanf(line + 5, "%1023s", path) != 1) strcpy(path, DEFAULT_TRACE);
+        long n = prof_write_trace(path);
+        if (n < 0) perror(errno == ENOSYS ? "trace (build with -DPROFILE)" : path);
+        else printf("Wrote %ld trace events to %s\n", n, path);
+        return 1;
+    }
+
+    // expected format:  <id> <message>
+    int id;
+    char msg[MAX];
+    if (sscanf(line, "%d %[^\n]", &id, msg) == 2) {
+        client_t* c = client_table_by_id(&clients, id);
+        if (c) {
+            if (client_send(&clients, c, FRAME_TEXT, msg, (uint16_t)strlen(msg)) == SENDQ_KICK) {
+                printf("Client %d is not reading, disconnecting\n", id);
+                dropClient(c);
+            } else {
+                printf("Sent to client %d: %s\n", id, msg);
+            }
+        } else {
+            printf("No such client id: %d\n", id);
+        }
+    } else {
+        printf("Usage: <id> <message>\n");
+    }
+    return 1;
+}
+
+// Wait up to timeout_ms for sockets, console or the ticker and run any due
+// ticks. Returns 0 once the server should stop.
+int serviceNetwork(int timeout_ms) {
+    int nready = net_loop_wait(&loop, timeout_ms);
+    if (nready < 0) { perror("epoll_wait"); return 0; }
+    if (nready == 0) return 1;
+    PROF_SCOPE("wakeup");
+    int64_t woke = mono_ns();
+    uint64_t allocs = alloc_count();
+
+    int running = 1;
+    for (int e = 0; e < nready && running; e++) {
+        int fd = loop.events[e].data.fd;
+        if (fd == STDIN_FILENO) {
+            running = readConsole();
+        } else if (fd == listenfd) {
+            acceptClients();
+        } else if (fd == ticker.fd) {
+            int due = tick_timer_due(&ticker);
+            for (int i = 0; i < due; i++) {
+                int64_t began = mono_ns();
+                simTick();
+                tick_timer_end(&ticker, began);
+                metrics_observe(&metrics, MH_TICK_NS, (uint64_t)(mono_ns() - began));
+                metrics_add(&metrics, MC_TICKS, 1);
+                if (statsFile && ticker.tick >= nextStatsTick) {
+                    metrics_dump(statsFile, &metrics, (mono_ns() - startNs) / 1e9);
+                    while (nextStatsTick <= ticker.tick) nextStatsTick += statsEveryTicks;
+                }
+            }
+        } else {
+            serviceClient(fd, loop.events[e].events);
+        }
+    }
+
+    // everything queued this wakeup goes out with one writev per client
+    {
+        PROF_SCOPE("flush");
+        client_table_flush(&clients, dropFlushed, NULL);
+    }
+    metrics_observe(&metrics, MH_WAKE_NS, (uint64_t)(mono_ns() - woke));
+    metrics_add(&metrics, MC_ALLOCS, alloc_count() - allocs);
+    return running;
+}
+
+int runView(render_backend_t* view);
+
+int main(int argc, char** argv) {
+    const char* viewName = NULL;
+    int tickHz = DEFAULT_TICK_HZ;
+    const char* statsPath = NULL;
+    int statsEvery = DEFAULT_STATS_EVERY;
+    const char* worldPath = NULL;
+    double worldBudgetMb = DEFAULT_WORLD_BUDGET_MB;
+    const char* journalPath = NULL;
+    int keyframeEvery = DEFAULT_KEYFRAME_EVERY;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0) viewName = NULL;
+        else if (strcmp(argv[i], "--window") == 0) viewName = "gl";
+        else if (strcmp(argv[i], "--view") == 0 && i + 1 < argc) viewName = argv[++i];
+        else if (strcmp(argv[i], "--tick") == 0 && i + 1 < argc) tickHz = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--stats-file") == 0 && i + 1 < argc) statsPath = argv[++i];
+        else if (strcmp(argv[i], "--stats-every") == 0 && i + 1 < argc) statsEvery = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--grid") == 0 && i + 1 < argc) gridSize = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--max-players") == 0 && i + 1 < argc) maxPlayers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--view-radius") == 0 && i + 1 < argc) viewRadius = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--world") == 0 && i + 1 < argc) worldPath = argv[++i];
+        else if (strcmp(argv[i], "--world-budget") == 0 && i + 1 < argc) worldBudgetMb = atof(argv[++i]);
+        else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc) journalPath = argv[++i];
+        else if (strcmp(argv[i], "--keyframe-every") == 0 && i + 1 < argc) keyframeEvery = atoi(argv[++i]);
+        else {
+            printf("Usage: %s [--headless | --window | --view gl|null] [--tick HZ] "
+                   "[--stats-file PATH] [--stats-every SECONDS]\n"
+                   "          [--grid N] [--max-players N] [--view-radius CELLS]\n"
+                   "          [--world FILE [--world-budget MB]] [--journal FILE [--keyframe-every SECONDS]]\n",
+                   argv[0]);
+            return 1;
+        }
+    }
+
+    // Spectator view, if any; chosen before binding so a bad name fails fast
+    render_backend_t view;
+    render_record_t record;
+#ifndef SERVER_NO_GL
+    render_gl_t gl;
+#endif
+    if (!viewName) {
+    } else if (strcmp(viewName, "null") == 0) {
+        render_null_backend(&view, &record);
+#ifndef SERVER_NO_GL
+    } else if (strcmp(viewName, "gl") == 0) {
+        render_gl_backend(&view, &gl);
+#endif
+    } else {
+        printf("Unknown view '%s' (this build has:%s null)\n", viewName,
+#ifndef SERVER_NO_GL
+               " gl"
+#else
+               ""
+#endif
+               );
+        return 1;
+    }
+    if (tickHz <= 0 || tickHz > 1000) { printf("Tick rate must be 1..1000 Hz\n"); return 1; }
+    if (worldPath) {
+        // only the header is read here; chunks load as players reach them
+        if (worldBudgetMb <= 0) { printf("World budget must be positive\n"); return 1; }
+        if (world_open(&terrain, worldPath, (size_t)(worldBudgetMb * 1e6)) < 0) { perror(worldPath); return 1; }
+        if (terrain.hdr.width != terrain.hdr.height || terrain.hdr.width > MAX_GRID) {
+            printf("World must be square, at most %d tiles a side\n", MAX_GRID);
+            return 1;
+        }
+        gridSize = (int)terrain.hdr.width;
+        haveTerrain = 1;
+    }
+    if (statsEvery < 1) { printf("Stats interval must be at least 1 second\n"); return 1; }
+    if (keyframeEvery < 1) { printf("Keyframe interval must be at least 1 second\n"); return 1; }
+    if (gridSize < 2 || gridSize > MAX_GRID) { printf("Grid must be 2..%d cells\n", MAX_GRID); return 1; }
+    if (maxPlayers < 1 || maxPlayers > MAX_PLAYERS_LIMIT) { printf("Max players must be 1..%d\n", MAX_PLAYERS_LIMIT); return 1; }
+    if (viewRadius < 0 || viewRadius >= gridSize) viewRadius = 0;
+    if (statsPath) {
+        statsFile = fopen(statsPath, "a");
+        if (!statsFile) { perror(statsPath); return 1; }
+        statsEveryTicks = (uint64_t)statsEvery * (uint64_t)tickHz;
+        nextStatsTick = statsEveryTicks;
+    }
+    startNs = mono_ns();
+
+    // a client that vanishes mid-flush is handled by the write error
+    signal(SIGPIPE, SIG_IGN);
 
-int main() {
     // Setup TCP socket to listn for client connections
-    int listenfd = socket(AF_INET, SOCK_STREAM, 0);
+    listenfd = socket(AF_INET, SOCK_STREAM, 0);
     if (listenfd < 0) { perror("socket"); exit(1); }
 
     int opt = 1;
@@ -90,150 +544,131 @@ int main() {
     if (bind(listenfd, (struct sockaddr*)&servaddr, sizeof(servaddr)) < 0) {
         perror("bind"); exit(1);
     }
-    if (listen(listenfd, 10) < 0) { perror("listen"); exit(1); }
-
-    fd_set master, read_fds;
-    FD_ZERO(&master);
-    FD_SET(listenfd, &master);
-    FD_SET(STDIN_FILENO, &master);
-    int fdmax = (listenfd > STDIN_FILENO) ? listenfd : STDIN_FILENO;
-
-    client_t clients[FD_SETSIZE];
-    for (int i = 0; i < FD_SETSIZE; i++) clients[i].active = 0;
-
-    int next_id = 1;
+    if (listen(listenfd, SOMAXCONN) < 0) { perror("listen"); exit(1); }
+
+    net_set_nonblocking(listenfd);
+
+    if (net_loop_init(&loop) < 0) exit(1);
+    net_loop_add(&loop, listenfd, NET_READ | NET_EDGE);
+    if (net_loop_add(&loop, STDIN_FILENO, NET_READ) < 0) perror("epoll_ctl stdin");
+
+    metrics_init(&metrics);
+    client_table_init(&clients);
+    clients.metrics = &metrics;
+    msg_pool_init(&msgPool, 0);
+    arena_init(&tickArena, 0);
+    clients.msgs = &msgPool;
+    clients.arena = &tickArena;
+    layout = move_layout_for(gridSize, maxPlayers);
+    replication.view_radius = viewRadius;
+    replication.layout = layout;
+    replication.budget = state_max_entries(layout, FRAME_MAX_PAYLOAD);
+    if (replication.budget > maxPlayers) replication.budget = maxPlayers;
+
+    if (tick_timer_init(&ticker, tickHz, MAX_CATCHUP) < 0) exit(1);
+    net_loop_add(&loop, ticker.fd, NET_READ);
+    cooldownTicks = (int)(moveDelay * tickHz + 0.999);
+
+    // buckets about one view across, so a query touches at most 3x3 of them
+    if (sim_init(&sim, gridSize, maxPlayers, cooldownTicks, haveTerrain ? &terrain : NULL,
+                 viewRadius > 0 ? (viewRadius < 4 ? 4 : viewRadius) : gridSize / 8) < 0) {
+        perror("malloc"); exit(1);
+    }
+    replication.in_range = malloc((size_t)maxPlayers * sizeof *replication.in_range);
+    if (!replication.in_range) { perror("malloc"); exit(1); }
+
+    // recording starts before the first player exists, so playback can
+    // begin from an empty board
+    if (journalPath) {
+        journal_hdr_t jh = { JOURNAL_VERSION, (uint32_t)gridSize, (uint32_t)maxPlayers, (uint32_t)cooldownTicks,
+                             (uint32_t)tickHz, (uint32_t)(keyframeEvery * tickHz), haveTerrain ? JOURNAL_TERRAIN : 0 };
+        if (journal_open(&journal, journalPath, &jh, (size_t)JOURNAL_RING_MB << 20) < 0) { perror(journalPath); exit(1); }
+    }
+    serverPlayer = spawnPlayer(0);
+    sim.ents.flags[entity_index(&sim.ents, serverPlayer)] |= ENTITY_LOCAL;
 
-    printf("Server listening on port %d\n", PORT);
+    printf("Server listening on port %d (%d Hz, %s, %dx%d board, %d players, view radius %d)\n", PORT, tickHz,
+           viewName ? viewName : "headless", gridSize, gridSize, maxPlayers, viewRadius);
     printf("Commands from server console:\n");
     printf("   <id> <message>   send message to a client\n");
+    printf("   stats            print server metrics ('stats clients' lists clients)\n");
+    printf("   trace [path]     write a Chrome trace of recent ticks (-DPROFILE builds)\n");
     printf("   exit             shut down server (sends exit to all)\n");
 
-
-    // Initialize GLFW
-    if (!glfwInit()) {
-        printf("Failed to initialize GLFW\n");
-        return -1;
+    int rc = 0;
+    if (!viewName || (rc = runView(&view)) < 0) {
+        if (viewName) printf("No spectator view, running headless\n");
+        rc = 0;
+        while (serviceNetwork(-1))
+            ;
+    }
+    if (viewName && strcmp(viewName, "null") == 0)
+        printf("View: %llu frames recorded, %llu instances uploaded\n",
+               (unsigned long long)record.frames, (unsigned long long)record.uploaded);
+
+    printf("Ticks: %llu, overruns: %llu, skipped: %llu, worst wakeup delay: %.3f ms\n",
+           (unsigned long long)ticker.tick, (unsigned long long)ticker.overruns,
+           (unsigned long long)ticker.skipped, ticker.max_late_ns / 1e6);
+    if (journalPath) {
+        // before clients are dropped: their leaving is not part of the match
+        unsigned long long ticks = journal.ticks, bytes = journal_bytes(&journal);
+        int keys = journal.nkeys;
+        if (journal_close(&journal) < 0) perror(journalPath);
+        else printf("Journal: %llu ticks, %d keyframes, %.1f KB in %s\n", ticks, keys, bytes / 1e3, journalPath);
     }
 
-    // OpenGL 3.3 Core Profile
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    tick_timer_close(&ticker);
+    while (clients.count > 0) dropClient(&clients.clients[0]);
+    client_table_free(&clients);
+    msg_pool_free(&msgPool);
+    arena_free(&tickArena);
+    for (int i = 0; i < peerCap; i++) replica_free(&peers[i]);
+    free(peers);
+    free(replication.in_range);
+    sim_free(&sim);
+    if (haveTerrain) world_close(&terrain);
+    net_loop_close(&loop);
+    close(listenfd);
+    if (statsFile) fclose(statsFile);
+    return rc;
+}
 
-    // Create window
-    GLFWwindow* window = glfwCreateWindow(600, 600, "Grid Demo", NULL, NULL);
-    if (!window) {
-        printf("Failed to create GLFW window\n");
-        glfwTerminate();
+// Spectator loop; the simulation still runs on the ticker, the view only
+// adds the server's own keyboard and a picture of the board. The loop
+// blocks in the network wait; the ticker wakes it every tick, which is
+// also when queued input is applied, and it redraws only after a tick
+// changed the board or the view needs repainting. Returns -1 if the view
+// could not be opened.
+int runView(render_backend_t* view) {
+    // Board and players are drawn as one instanced batch
+    grid_batch_t batch;
+    if (grid_batch_init(&batch, gridSize, maxPlayers) < 0) {
+        printf("Out of memory\n");
         return -1;
     }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-
-    // Load GLAD
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-        printf("Failed to initialize GLAD\n");
+    if (view->open(view, &batch, "Grid Demo") < 0) {
+        grid_batch_free(&batch);
         return -1;
     }
 
-    // set initial viewport (very important)
-    int w, h;
-    glfwGetFramebufferSize(window, &w, &h);
-    glViewport(0, 0, w, h);
-
-    // Define rectangle vertices (two triangles)
-    float vertices[] = {
-        -0.5f, -0.5f,
-         0.5f, -0.5f,
-         0.5f,  0.5f,
-        -0.5f, -0.5f,
-         0.5f,  0.5f,
-        -0.5f,  0.5f
-    };
-
-    // Create VAO & VBO
-    unsigned int VAO, VBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    // Vertex attributes
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-
-    // Compile shaders
-    unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-
-    unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-
-    // Link shader program
-    GLuint prog = glCreateProgram();
-    glAttachShader(prog, vertexShader);
-    glAttachShader(prog, fragmentShader);
-    glLinkProgram(prog);
-    // checkLink(prog);
-
-    // Uniform locations
-    GLint locOffset = glGetUniformLocation(prog, "offset");
-    GLint locScale  = glGetUniformLocation(prog, "scale");
-    GLint locColor  = glGetUniformLocation(prog, "color");
-
-    float cellScale = 2.0f / GRID_SIZE; // scale square to fit grid
-
-    // Render loop
-    while (!glfwWindowShouldClose(window)) {
-        processInput(window);
-
-        glUseProgram(prog);
-        glBindVertexArray(VAO);
-
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        if (locOffset == -1) fprintf(stderr, "Warning: 'offset' uniform not found\n");
-
-        // draw grid cells (light gray)
-        for (int y = 0; y < GRID_SIZE; ++y) {
-            for (int x = 0; x < GRID_SIZE; ++x) {
-                float ox = -1.0f + cellScale * (x + 0.5f);
-                float oy = -1.0f + cellScale * (y + 0.5f);
-                glUniform2f(locOffset, ox, oy);
-                glUniform1f(locScale, cellScale);
-                glUniform3f(locColor, 0.25f, 0.25f, 0.25f);
-                glDrawArrays(GL_TRIANGLES, 0, 6);
-            }
+    frame_pacer_init(&pacer, FRAME_HZ);
+    for (;;) {
+        if (view->pump(view)) frame_pacer_mark(&pacer);
+        if (view->closed(view) || view->key_down(view, RENDER_KEY_ESCAPE)) break;
+        processInput(view);
+
+        if (frame_pacer_ready(&pacer, mono_ns())) {
+            PROF_SCOPE("draw");
+            // only moved players are re-uploaded; the grid goes up once
+            grid_batch_set_players(&batch, sim.ents.x, sim.ents.y, (const float (*)[3])sim.ents.color, sim.ents.count);
+            view->draw(view, &batch);
         }
 
-        // draw player (green)
-        for (int i = 0; i < sizeof(players)/sizeof(players[0]); i++){
-            float pox = -1.0f + cellScale * (players[i][0] + 0.5f);
-            float poy = -1.0f + cellScale * (players[i][1] + 0.5f);
-            glUniform2f(locOffset, pox, poy);
-            glUniform1f(locScale, cellScale * 0.9f); // slightly smaller so grid lines show
-            float* color = colors[i];
-            glUniform3f(locColor, color[0], color[1], color[2]);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        }
-
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        int64_t wait = frame_pacer_timeout(&pacer, mono_ns());
+        if (!serviceNetwork(wait < 0 ? -1 : (int)((wait + 999999) / 1000000))) break;
     }
 
-    // Cleanup
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-
-    glfwTerminate();
+    view->close(view);
+    grid_batch_free(&batch);
     return 0;
 }
@@ -0,0 +1,158 @@
+// Headless check that client prediction (Common/predict.h) converges on the
+// server under latency.
+//
+// One client and the authoritative simulation (Common/game_sim.h) run in
+// lockstep ticks, joined by two in-order links like the demo's TCP
+// connection, each with --latency ticks of delay plus up to --jitter more.
+// The client takes a random step whenever its cooldown allows, predicting
+// it at once and sending it up; the server queues and steps it, and sends
+// back every tick the player's position and last processed input, which
+// the client reconciles against. --reject percent of moves are refused by
+// the server, which the client cannot foresee, so those predictions have
+// to be corrected. The client moves in bursts: after each one it stops long
+// enough for everything in flight to land, and the prediction must then
+// equal the server's position with nothing left unacknowledged. Without
+// rejected moves no correction may ever change the prediction.
+// Exits non-zero if either fails.
+//
+//   PredictTest [--ticks N] [--latency TICKS] [--jitter TICKS] [--reject PERCENT]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../Common/game_sim.h"
+#include "../Common/predict.h"
+
+#define GRID 16
+#define COOLDOWN 5             // ticks, 0.15 s at 30 Hz
+#define BURST 60               // ticks of moving between quiet spells
+#define LINK_CAP 1024          // messages in flight per direction
+#define MAX_DELAY 200          // latency + jitter, ticks
+
+typedef struct {
+    uint64_t at;               // tick it arrives
+    uint32_t seq;              // move: input sequence; state: ack
+    int x, y;
+} message_t;
+
+// In-order link: a message never overtakes the one before it
+typedef struct {
+    message_t q[LINK_CAP];
+    int head, count;
+    uint64_t last;
+} link_t;
+
+static const int dirs[4][2] = { {0, 1}, {0, -1}, {-1, 0}, {1, 0} };
+
+uint32_t rng = 12345;
+int latency = 3;
+int jitter = 2;
+
+uint32_t nextRandom(void) {
+    rng = rng * 1664525u + 1013904223u;
+    return rng >> 8;
+}
+
+int linkSend(link_t* l, uint64_t now, uint32_t seq, int x, int y) {
+    if (l->count == LINK_CAP) return -1;
+    uint64_t at = now + (uint64_t)latency + (jitter ? nextRandom() % (uint32_t)(jitter + 1) : 0);
+    if (at < l->last) at = l->last;
+    l->last = at;
+    l->q[(l->head + l->count++) % LINK_CAP] = (message_t){ at, seq, x, y };
+    return 0;
+}
+
+int linkReceive(link_t* l, uint64_t now, message_t* m) {
+    if (l->count == 0 || l->q[l->head].at > now) return 0;
+    *m = l->q[l->head];
+    l->head = (l->head + 1) % LINK_CAP;
+    l->count--;
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    int ticks = 20000;
+    int reject = 5;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) ticks = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--latency") == 0 && i + 1 < argc) latency = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--jitter") == 0 && i + 1 < argc) jitter = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--reject") == 0 && i + 1 < argc) reject = atoi(argv[++i]);
+        else { printf("Usage: %s [--ticks N] [--latency TICKS] [--jitter TICKS] [--reject PERCENT]\n", argv[0]); return 1; }
+    }
+    if (ticks < 1 || latency < 0 || jitter < 0 || latency + jitter > MAX_DELAY || reject < 0 || reject > 100) {
+        printf("Ticks must be positive, latency + jitter 0..%d and reject 0..100\n", MAX_DELAY);
+        return 1;
+    }
+
+    sim_t sim;
+    if (sim_init(&sim, GRID, 1, COOLDOWN, NULL, 4) < 0) { perror("malloc"); return 1; }
+    entity_t h = sim_spawn(&sim, 1);
+    int p = entity_slot(h), i = entity_index(&sim.ents, h);
+    predictor_t pred;
+    predict_init(&pred, GRID, sim.ents.x[i], sim.ents.y[i]);
+    static link_t up, down;
+
+    // a quiet spell outlasts a round trip plus the server's backlog
+    int quiet = 2 * (latency + jitter) + 4 * COOLDOWN + 2;
+    long long moves = 0, rejected = 0, spells = 0, diverged = 0;
+    int64_t lastMove = -COOLDOWN;
+    uint64_t t;
+    for (t = 0; t < (uint64_t)ticks || up.count || down.count || pred.count; t++) {
+        if (t > (uint64_t)ticks + 10 * (uint64_t)quiet) break;    // never drains: reported below
+        int phase = (int)(t % (uint64_t)(BURST + quiet));
+        int moving = t < (uint64_t)ticks && phase < BURST;
+
+        // client: a random step off cooldown, predicted and sent
+        if (moving && (int64_t)t - lastMove >= COOLDOWN) {
+            int d = (int)(nextRandom() % 4);
+            int x = pred.pos[0] + dirs[d][0], y = pred.pos[1] + dirs[d][1];
+            uint32_t seq = predict_input(&pred, x, y);
+            if (seq && linkSend(&up, t, seq, x, y) == 0) {
+                lastMove = (int64_t)t;
+                moves++;
+            }
+        }
+
+        // server: queue what arrived (a refused move is still processed and
+        // acked, it just goes nowhere), step, report back
+        message_t m;
+        while (linkReceive(&up, t, &m)) {
+            if (nextRandom() % 100 < (uint32_t)reject) {
+                m.x = -1;
+                rejected++;
+            }
+            if (sim_queue_move(&sim, p, m.x, m.y, m.seq) < 0) printf("server queue full at tick %llu\n", (unsigned long long)t);
+        }
+        sim_step(&sim, t);
+        if (linkSend(&down, t, sim.inputs[p].last_seq, sim.ents.x[i], sim.ents.y[i]) < 0) {
+            printf("link full at tick %llu\n", (unsigned long long)t);
+            return 1;
+        }
+
+        // client: reconcile against each state in turn
+        while (linkReceive(&down, t, &m)) predict_reconcile(&pred, m.seq, m.x, m.y);
+
+        // end of a quiet spell: everything has landed both ways
+        if (phase == BURST + quiet - 1) {
+            spells++;
+            if (pred.count || pred.pos[0] != sim.ents.x[i] || pred.pos[1] != sim.ents.y[i]) {
+                if (diverged++ < 5)
+                    printf("DIVERGED at tick %llu: predicted (%d, %d) with %d unacked, server (%d, %d)\n",
+                           (unsigned long long)t, pred.pos[0], pred.pos[1], pred.count, sim.ents.x[i], sim.ents.y[i]);
+            }
+        }
+    }
+    int settled = !pred.count && pred.pos[0] == sim.ents.x[i] && pred.pos[1] == sim.ents.y[i];
+    int ok = !diverged && settled && (reject > 0 || pred.corrections == 0);
+
+    printf("predict %lld moves over %llu ticks, %d+%d ticks each way, %lld refused, %llu corrections\n", moves,
+           (unsigned long long)t, latency, jitter, rejected, (unsigned long long)pred.corrections);
+    if (!reject && pred.corrections) printf("MISPREDICTED: corrections with every move accepted\n");
+    if (!settled) printf("DIVERGED at the end: predicted (%d, %d) with %d unacked, server (%d, %d)\n", pred.pos[0],
+                         pred.pos[1], pred.count, sim.ents.x[i], sim.ents.y[i]);
+    printf("check   %s\n", ok ? "prediction matched the server after every burst" : "MISMATCH");
+    printf("        (%lld quiet spells, %lld diverged)\n", spells, diverged);
+    sim_free(&sim);
+    return ok ? 0 : 1;
+}
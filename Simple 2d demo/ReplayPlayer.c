@@ -0,0 +1,165 @@
+// Plays back a match journal written by the server's --journal option
+// (Common/journal.h), with the server's own simulation (game_sim.h).
+//
+// Headless. The journal is memory-mapped, then:
+//   play    every tick from the start, checking the state against each
+//           keyframe on the way (a mismatch means the simulation is no
+//           longer deterministic or no longer the one that recorded it)
+//   seek    with --seek T: the state after tick T through the keyframe
+//           index, timed against playing from the start, and the players
+//           there
+//   bench   with --bench N: the whole journal played N times as fast as
+//           it goes, in ticks per second and times real time, a
+//           regression benchmark for the simulation
+// A journal recorded on a --world board needs the same world file.
+//
+//   ReplayPlayer JOURNAL [--world FILE] [--seek TICK] [--bench N]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../Common/game_sim.h"
+#include "../Common/journal.h"
+#include "../Common/tick.h"
+
+#define WORLD_BUDGET_MB 16
+#define LIST_PLAYERS 16        // players printed after a seek
+
+static const char* recordNames[] = { "end", "spawn", "despawn", "move", "tick", "keyframe" };
+
+// FNV-1a of the saved state, to compare states in one line
+uint64_t stateDigest(const sim_t* s, uint8_t* scratch, size_t cap) {
+    size_t n = sim_save(s, scratch, cap);
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < n; i++) h = (h ^ scratch[i]) * 1099511628211ull;
+    return h;
+}
+
+// Play the whole journal into s. With verify, compare the state with each
+// keyframe. Returns the keyframes checked, or -1 on a mismatch.
+int playAll(const journal_reader_t* r, sim_t* s, uint8_t* scratch, size_t cap, int verify) {
+    sim_clear(s);
+    size_t pos = JOURNAL_HDR_SIZE;
+    uint64_t tick = 0;
+    journal_rec_t rec;
+    int checked = 0;
+    while (journal_next(r, &pos, &tick, &rec) > 0) {
+        if (rec.type == JOURNAL_KEYFRAME) {
+            if (!verify) continue;
+            size_t n = sim_save(s, scratch, cap);
+            if (n != rec.state_len || memcmp(scratch, rec.state, n) != 0) {
+                printf("State after tick %llu differs from its keyframe\n", (unsigned long long)rec.tick);
+                return -1;
+            }
+            checked++;
+        } else if (journal_apply(s, &rec) < 0) {
+            printf("Playback diverged at a %s record after tick %llu\n", recordNames[rec.type],
+                   (unsigned long long)tick);
+            return -1;
+        }
+    }
+    return checked;
+}
+
+int main(int argc, char** argv) {
+    const char* path = NULL;
+    const char* worldPath = NULL;
+    long long seekTo = -1;
+    int benchRuns = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--world") == 0 && i + 1 < argc) worldPath = argv[++i];
+        else if (strcmp(argv[i], "--seek") == 0 && i + 1 < argc) seekTo = atoll(argv[++i]);
+        else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) benchRuns = atoi(argv[++i]);
+        else if (argv[i][0] != '-' && !path) path = argv[i];
+        else path = NULL, i = argc;
+    }
+    if (!path || benchRuns < 0) {
+        printf("Usage: %s JOURNAL [--world FILE] [--seek TICK] [--bench N]\n", argv[0]);
+        return 1;
+    }
+
+    journal_reader_t r;
+    int64_t t0 = mono_ns();
+    if (journal_map(&r, path) < 0) { perror(errno == EINVAL ? "not a journal" : path); return 1; }
+    double mapUs = (mono_ns() - t0) / 1e3;
+    const journal_hdr_t* h = &r.hdr;
+
+    world_t terrain;
+    if (h->flags & JOURNAL_TERRAIN) {
+        if (!worldPath) { printf("%s was recorded on a world; give it with --world\n", path); return 1; }
+        if (world_open(&terrain, worldPath, (size_t)WORLD_BUDGET_MB << 20) < 0) { perror(worldPath); return 1; }
+        if (terrain.hdr.width != h->grid || terrain.hdr.height != h->grid) {
+            printf("%s is %ux%u, the journal's board %ux%u\n", worldPath, terrain.hdr.width, terrain.hdr.height,
+                   h->grid, h->grid);
+            return 1;
+        }
+    }
+
+    sim_t sim;
+    size_t cap = sim_save_max((int)h->max_players);
+    uint8_t* scratch = malloc(cap);
+    if (!scratch || sim_init(&sim, (int)h->grid, (int)h->max_players, (int)h->cooldown_ticks,
+                             h->flags & JOURNAL_TERRAIN ? &terrain : NULL, (int)h->grid / 8) < 0) {
+        perror("malloc");
+        return 1;
+    }
+
+    double seconds = h->tick_hz && r.ticks ? (double)(r.last_tick - r.first_tick + 1) / h->tick_hz : 0;
+    printf("%s: %ux%u board, %u players, %u Hz, ticks %llu..%llu (%.1f s), %d keyframes (%s), %.1f KB, %.1f B per tick\n",
+           path, h->grid, h->grid, h->max_players, h->tick_hz, (unsigned long long)r.first_tick,
+           (unsigned long long)r.last_tick, seconds, r.nkeys, r.indexed ? "indexed" : "found by scanning, not closed",
+           r.end / 1e3, r.ticks ? (double)(r.end - JOURNAL_HDR_SIZE) / r.ticks : 0.0);
+    printf("map      %10.1f us\n", mapUs);
+
+    t0 = mono_ns();
+    int checked = playAll(&r, &sim, scratch, cap, 1);
+    double playMs = (mono_ns() - t0) / 1e6;
+    if (checked < 0) return 1;
+    printf("play     %10.1f ms  %d keyframes match, %d players at the end, state %016llx\n", playMs, checked,
+           sim.ents.count, (unsigned long long)stateDigest(&sim, scratch, cap));
+
+    if (seekTo >= 0) {
+        size_t pos;
+        uint64_t at;
+        t0 = mono_ns();
+        if (journal_seek(&r, &sim, (uint64_t)seekTo, &pos, &at) < 0) { printf("Seek failed: playback diverged\n"); return 1; }
+        double seekUs = (mono_ns() - t0) / 1e3;
+        uint64_t digest = stateDigest(&sim, scratch, cap);
+
+        // the same tick the long way, without keyframes
+        journal_reader_t linear = r;
+        linear.nkeys = 0;
+        uint64_t linearAt;
+        t0 = mono_ns();
+        if (journal_seek(&linear, &sim, (uint64_t)seekTo, &pos, &linearAt) < 0) { printf("Playback diverged\n"); return 1; }
+        double linearUs = (mono_ns() - t0) / 1e3;
+        int same = linearAt == at && stateDigest(&sim, scratch, cap) == digest;
+        printf("seek     %10.1f us to tick %llu (%.1f us from the start), state %016llx%s\n", seekUs,
+               (unsigned long long)at, linearUs, (unsigned long long)digest,
+               same ? "" : ", DIFFERS from playing from the start");
+        if (!same) return 1;
+
+        for (int i = 0; i < sim.ents.count && i < LIST_PLAYERS; i++)
+            printf("  player %3d  owner %-8d at %5d,%-5d  %d queued\n", entity_slot(sim.ents.handle[i]),
+                   sim.ents.owner[i], sim.ents.x[i], sim.ents.y[i], sim.inputs[entity_slot(sim.ents.handle[i])].len);
+        if (sim.ents.count > LIST_PLAYERS) printf("  ... %d more\n", sim.ents.count - LIST_PLAYERS);
+    }
+
+    if (benchRuns > 0) {
+        double best = 0;
+        for (int k = 0; k < benchRuns; k++) {
+            t0 = mono_ns();
+            playAll(&r, &sim, scratch, cap, 0);
+            double s = (mono_ns() - t0) / 1e9;
+            if (k == 0 || s < best) best = s;
+        }
+        printf("bench    %10.1f ns/tick  %.3g ticks/s  %.0fx real time  (best of %d)\n", best * 1e9 / (r.ticks ? r.ticks : 1),
+               r.ticks / best, seconds / best, benchRuns);
+    }
+
+    free(scratch);
+    sim_free(&sim);
+    if (h->flags & JOURNAL_TERRAIN) world_close(&terrain);
+    journal_unmap(&r);
+    return 0;
+}
@@ -0,0 +1,950 @@
+// Hosts many independent rooms of the multiplayer demo in one process.
+//
+// A room is one game of the demo server (Multiplayer2DDemoServer) with its
+// own board, players and connections, run by the same simulation
+// (game_sim.h) and replication (replicate.h) over the same protocol.
+// Clients connect to one port and open with FRAME_JOIN naming a room (the
+// demo client's second argument, loadgen --rooms). The main thread keeps a
+// connection in its lobby until then and hands it to the room, opening the
+// room if need be. A room opened that way closes when its last client
+// leaves; 'open' makes one that stays and 'close' shuts one down.
+//
+// The main thread keeps the tick clock too. Every tick it submits a task
+// for each room with something to do to a work-stealing pool
+// (task_pool.h), so busy rooms spread over the workers. The task reads the
+// room's sockets, runs its due ticks, replicates and flushes. A room is
+// touched only by its task, or by the main thread while none is queued or
+// running. A room where nobody moves and no socket has anything to say is
+// not scheduled at all: the main thread hears of new socket activity
+// through the room's own epoll set, watched one-shot from its own. An
+// empty room costs nothing. Input and pings wait for the room's next tick.
+//
+// A tick has to be done before the next one is due. One that is done
+// later is late, and a room still running when its next tick comes due
+// runs that tick late in its next task, catching up at most MAX_CATCHUP
+// ticks and skipping the rest. 'rooms' and 'stats' count both.
+//
+// --bench measures how many rooms fit, with no network: every room gets
+// --bots players that walk at random and get a state built every tick,
+// like clients, and each density listed runs for --bench-seconds. Built
+// with -DCOUNT_ALLOCS (alloc_count.h) it also reports the heap calls rooms
+// make per tick after the warm-up, and 'stats' counts them as allocs.
+//
+//   RoomServer [--port P] [--threads N] [--tick HZ] [--grid N] [--max-players N]
+//              [--view-radius CELLS] [--max-rooms N]
+//              [--bench ROOMS[,ROOMS...] [--bots N] [--bench-seconds S]]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "../Common/net_loop.h"
+#include "../Common/client_table.h"
+#include "../Common/alloc_count.h"
+#include "../Common/pool.h"
+#include "../Common/bitpack.h"
+#include "../Common/game_msg.h"
+#include "../Common/game_sim.h"
+#include "../Common/input_queue.h"
+#include "../Common/metrics.h"
+#include "../Common/profile.h"
+#include "../Common/replicate.h"
+#include "../Common/task_pool.h"
+#include "../Common/tick.h"
+
+#define DEFAULT_PORT 8080
+#define MAX  1024
+
+// Board size and player slots of every room when not given with --grid /
+// --max-players
+#define DEFAULT_GRID 16
+#define DEFAULT_MAX_PLAYERS 4
+
+#define ROOM_SLAB 2048         // bytes per slab of a room's frame pool: a handful of clients
+#define JOIN_SLAB 8            // joins per slab of the join pool
+#define MAX_GRID 65535         // coordinates and sizes go out as u16
+#define MAX_PLAYERS_LIMIT 4096
+
+#define DEFAULT_TICK_HZ 30
+#define MAX_CATCHUP 5          // ticks a room runs back-to-back after falling behind
+
+#define DEFAULT_MAX_ROOMS 4096 // room ids are 0..max-1
+#define MAX_ROOMS_LIMIT (1 << 20)
+#define LIST_ROOMS 32          // rooms printed by 'rooms'
+
+#define DEFAULT_BOTS 4
+#define DEFAULT_BENCH_SECONDS 5
+#define BENCH_WARMUP_S 1
+
+#define DEFAULT_TRACE "room_trace.json"
+
+// Room sockets report to the main loop with this tag and the room id in
+// the event data; everything else there carries its fd
+#define ROOM_EVENT (1ull << 32)
+
+// A connection on its way from the lobby into a room, with whatever it
+// sent after its FRAME_JOIN. From joinPool, which only the main thread
+// touches: the room task leaves the ones it took in on the room's adopted
+// list for the main thread to give back.
+typedef struct join {
+    struct join* next;
+    int fd;
+    uint32_t len;
+    uint8_t data[FRAME_RX_CAP];
+} join_t;
+
+// In-process player for --bench
+typedef struct {
+    replica_t view;
+    uint32_t rng;
+    uint32_t seq;
+} bot_t;
+
+typedef struct {
+    int id;
+    int persistent;            // made by 'open' or --bench: stays when empty
+    sim_t sim;
+    client_table_t clients;
+    msg_pool_t msgs;           // frames queued to clients (sendq.h)
+    replica_t* peers;          // by client slot, reset rather than freed when a client leaves
+    int peerCap;
+    replica_view_t replication;
+    bot_t* bots;
+    int nbots;
+    net_loop_t loop;           // this room's sockets
+    metrics_t metrics;         // written by whichever worker runs the room
+    task_t task;
+    uint64_t tick;             // next tick to run
+    uint64_t opened;           // tick the room opened at
+    int unsent;                // a state was dropped at a full send queue
+
+    // handed to the task by the main thread
+    uint64_t due;              // run ticks up to here (exclusive)...
+    int64_t deadline;          // ...and be done by then
+    join_t* joining;
+    int closing;
+
+    // left by the task for the main thread
+    join_t* adopted;           // joins taken in, for the main thread to give back to joinPool
+    int quiet;                 // nothing moves and nothing is owed: skip until socket activity
+    int closed;
+    int count;                 // clients; atomic
+    int armed;                 // socket activity will be reported; atomic
+    uint64_t ran;              // ticks run; atomic, as are late and skipped
+    uint64_t late;
+    uint64_t skipped;
+
+    // main thread only
+    int busy;                  // task queued or running; atomic
+    int activity;              // socket events since the task last ran
+    join_t* arriving;
+} room_t;
+
+int gridSize = DEFAULT_GRID;
+int maxPlayers = DEFAULT_MAX_PLAYERS;
+int viewRadius;                // --view-radius, 0 = every client sees the whole board
+int cooldownTicks;
+move_layout_t layout;
+int stateBudget;
+int botsPerRoom;               // --bench only
+
+room_t** rooms;                // by id, NULL if not open
+int maxRooms = DEFAULT_MAX_ROOMS;
+int liveRooms;
+uint64_t roomsOpened, roomsClosed;
+metrics_t retired;             // rooms already closed
+uint64_t retiredRan, retiredLate, retiredSkipped;
+
+task_pool_t pool;
+int threads;
+arena_t* arenas;               // by worker: states built by the room it runs, reset on flush
+net_loop_t loop;
+client_table_t lobby;          // connected, not joined yet
+slab_pool_t joinPool;          // join_t, main thread only
+int listenfd = -1;
+tick_timer_t ticker;
+int64_t startNs;
+
+void roomCount(uint64_t* c, uint64_t n) {
+    __atomic_store_n(c, *c + n, __ATOMIC_RELAXED);
+}
+
+// --- inside a room task ---
+
+int playerOf(room_t* r, client_t* c) {
+    return c->slot < r->peerCap ? replica_player(&r->peers[c->slot]) : -1;
+}
+
+replica_t* addPeer(room_t* r, client_t* c) {
+    if (c->slot >= r->peerCap) {
+        int ncap = r->peerCap ? r->peerCap : 4;
+        while (ncap <= c->slot) ncap *= 2;
+        replica_t* p = realloc(r->peers, (size_t)ncap * sizeof *p);
+        if (!p) return NULL;
+        memset(p + r->peerCap, 0, (size_t)(ncap - r->peerCap) * sizeof *p);
+        r->peers = p;
+        r->peerCap = ncap;
+    }
+    replica_t* pr = &r->peers[c->slot];
+    replica_reset(pr);
+    return replica_reserve(pr, &r->replication) < 0 ? NULL : pr;
+}
+
+void dropClient(room_t* r, client_t* c) {
+    if (c->slot < r->peerCap) {
+        replica_t* pr = &r->peers[c->slot];
+        if (pr->player != ENTITY_NONE) sim_destroy(&r->sim, pr->player);
+        replica_reset(pr);
+    }
+    net_loop_del(&r->loop, c->fd);
+    close(c->fd);
+    client_table_remove(&r->clients, c);
+}
+
+void dropFlushed(client_t* c, void* ctx) {
+    room_t* r = ctx;
+    printf("Room %d: client %d disconnected\n", r->id, c->id);
+    dropClient(r, c);
+}
+
+// Handle c's complete frames. Returns 0 if c was dropped.
+int handleFrames(room_t* r, client_t* c) {
+    frame_t f;
+    int rc;
+    while ((rc = client_next_frame(&r->clients, c, &f)) > 0) {
+        if (f.hdr.type == FRAME_EXIT) {
+            client_send(&r->clients, c, FRAME_EXIT, NULL, 0);
+            client_flush(&r->clients, c);
+            printf("Room %d: client %d requested exit\n", r->id, c->id);
+            dropClient(r, c);
+            return 0;
+        } else if (f.hdr.type == FRAME_MOVE) {
+            int id, x, y;
+            int p = playerOf(r, c);
+            if (p >= 0 && move_decode(f.payload, f.hdr.len, layout, &id, &x, &y) == 0 && id == p)
+                sim_queue_move(&r->sim, p, x, y, f.hdr.id);
+        } else if (f.hdr.type == FRAME_TEXT) {
+            printf("Room %d: client %d: %.*s\n", r->id, c->id, (int)f.hdr.len, (const char*)f.payload);
+        } else if (f.hdr.type == FRAME_ACK) {
+            replica_ack(&r->peers[c->slot], f.hdr.id);
+        } else if (f.hdr.type == FRAME_PING) {
+            if (client_send(&r->clients, c, FRAME_PONG, f.payload, f.hdr.len) == SENDQ_KICK) {
+                dropClient(r, c);
+                return 0;
+            }
+        }
+    }
+    if (rc < 0) {
+        printf("Room %d: client %d sent a malformed frame\n", r->id, c->id);
+        dropClient(r, c);
+        return 0;
+    }
+    return 1;
+}
+
+void serviceClient(room_t* r, int fd, uint32_t events) {
+    client_t* c = client_table_by_fd(&r->clients, fd);
+    if (!c) return;
+
+    if (events & NET_WRITE) {
+        if (client_flush(&r->clients, c) < 0) {
+            printf("Room %d: client %d disconnected\n", r->id, c->id);
+            dropClient(r, c);
+            return;
+        }
+    }
+    if (!(events & (NET_READ | EPOLLHUP | EPOLLERR))) return;
+
+    for (;;) {
+        ssize_t n = client_read(&r->clients, c);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (n <= 0) {
+            printf("Room %d: client %d disconnected\n", r->id, c->id);
+            dropClient(r, c);
+            return;
+        }
+        if (!handleFrames(r, c)) return;
+    }
+}
+
+// Take in the connections the lobby handed over: a player each while
+// there is room, spectators after that. A closing room sends them away.
+void adoptJoins(room_t* r) {
+    r->adopted = r->joining;
+    r->joining = NULL;
+    for (join_t* j = r->adopted; j; j = j->next) {
+        client_t* c = r->closing ? NULL : client_table_add(&r->clients, j->fd);
+        replica_t* pr = c ? addPeer(r, c) : NULL;
+        if (!pr) {
+            if (c) client_table_remove(&r->clients, c);
+            frame_send(j->fd, FRAME_EXIT, 0, NULL, 0);
+            close(j->fd);
+        } else {
+            net_loop_add(&r->loop, j->fd, NET_READ | NET_WRITE | NET_EDGE);
+            memcpy(c->rx.buf, j->data, j->len);
+            c->rx.tail = j->len;
+            pr->player = sim_spawn(&r->sim, c->id);
+            welcome_t w = { playerOf(r, c), cooldownTicks, ticker.hz, gridSize, maxPlayers, viewRadius };
+            uint8_t welcome[WELCOME_SIZE];
+            welcome_encode(welcome, &w);
+            client_send(&r->clients, c, FRAME_WELCOME, welcome, sizeof welcome);
+            printf("Room %d: client %d joined (fd=%d, player %d)\n", r->id, c->id, j->fd, w.player);
+            handleFrames(r, c);
+        }
+    }
+}
+
+// Bots press a random direction on about half of the ticks they could move.
+void moveBots(room_t* r, uint64_t tick) {
+    for (int k = 0; k < r->nbots; k++) {
+        bot_t* b = &r->bots[k];
+        int i = entity_index(&r->sim.ents, b->view.player), p = entity_slot(b->view.player);
+        b->rng = b->rng * 1664525u + 1013904223u;
+        if (i < 0 || b->rng >> 31 || r->sim.inputs[p].len > 0 || sim_cooling(&r->sim, i, tick)) continue;
+        const int* d = input_dirs_[b->rng >> 28 & 3];
+        sim_queue_move(&r->sim, p, r->sim.ents.x[i] + d[0], r->sim.ents.y[i] + d[1], ++b->seq);
+    }
+}
+
+// Build and queue one view's state (replicate.h) in the worker's tick
+// arena; c is NULL for a bot, whose state is built the same way, then
+// thrown away and acked.
+int replicateTo(room_t* r, client_t* c, replica_t* pr, uint32_t tick) {
+    arena_t* a = r->clients.arena;
+    msg_buf_t* state = msg_buf_arena(a, FRAME_MAX_PAYLOAD);
+    if (!state) return SENDQ_OK;
+    state_hdr_t h;
+    size_t len = replica_build(pr, &r->sim, &r->replication, tick, state->data + FRAME_HDR_SIZE,
+                               FRAME_MAX_PAYLOAD, &h);
+    state = msg_buf_arena_end(a, state, FRAME_STATE, tick, (uint16_t)len);
+    if (!state) return SENDQ_OK;
+    int rc = c ? client_send_buf(&r->clients, c, state, 1) : SENDQ_OK;
+    msg_buf_unref(state);
+    if (rc == SENDQ_DROPPED) {
+        r->unsent = 1;
+        return rc;
+    }
+
+    replica_sent(pr);
+    if (!c) replica_ack(pr, tick);
+    metrics_add(&r->metrics, MC_AOI_UPDATES, (uint64_t)h.updates);
+    metrics_add(&r->metrics, MC_AOI_LEAVES, (uint64_t)h.leaves);
+    metrics_add(&r->metrics, MC_STATE_BYTES, (uint64_t)len);
+    if (h.flags & STATE_FULL) metrics_add(&r->metrics, MC_STATE_FULL, 1);
+    return rc;
+}
+
+void replicate(room_t* r, uint32_t tick) {
+    int64_t began = mono_ns();
+    r->unsent = 0;
+    for (int i = 0; i < r->clients.count; ) {
+        client_t* c = &r->clients.clients[i];
+        if (replicateTo(r, c, &r->peers[c->slot], tick) == SENDQ_KICK) {
+            printf("Room %d: client %d is not keeping up, disconnecting\n", r->id, c->id);
+            dropClient(r, c);  // swap-remove: re-examine index i
+            continue;
+        }
+        i++;
+    }
+    for (int k = 0; k < r->nbots; k++) replicateTo(r, NULL, &r->bots[k].view, tick);
+    metrics_observe(&r->metrics, MH_REPLICATE_NS, (uint64_t)(mono_ns() - began));
+}
+
+// Nothing will change until a client says something: no bots, no input
+// waiting, nobody moved or settling, every view sent.
+int roomQuiet(room_t* r) {
+    if (r->nbots || r->unsent) return 0;
+    const entity_store_t* e = &r->sim.ents;
+    for (int i = 0; i < e->count; i++)
+        if ((e->flags[i] & SIM_FLAGS) || r->sim.inputs[entity_slot(e->handle[i])].len > 0) return 0;
+    return 1;
+}
+
+void closeRoom(room_t* r) {
+    while (r->clients.count > 0) {
+        client_t* c = &r->clients.clients[0];
+        client_send(&r->clients, c, FRAME_EXIT, NULL, 0);
+        client_flush(&r->clients, c);
+        dropClient(r, c);
+    }
+    r->closed = 1;
+}
+
+// Watch the room's sockets from the main loop again, unless still watched.
+void rearm(room_t* r) {
+    if (__atomic_exchange_n(&r->armed, 1, __ATOMIC_ACQ_REL)) return;
+    struct epoll_event ev = { EPOLLIN | EPOLLONESHOT, { .u64 = ROOM_EVENT | (uint32_t)r->id } };
+    if (epoll_ctl(loop.epfd, EPOLL_CTL_MOD, r->loop.epfd, &ev) < 0) perror("epoll_ctl room");
+}
+
+// The room task: joins, sockets, due ticks, replication, flush.
+void roomRun(void* arg) {
+    room_t* r = arg;
+    PROF_SCOPE("room");
+    int64_t began = mono_ns();
+    uint64_t allocs = alloc_count();
+    adoptJoins(r);
+    if (r->closing) {
+        closeRoom(r);
+        __atomic_store_n(&r->count, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&r->busy, 0, __ATOMIC_RELEASE);
+        return;
+    }
+
+    int n;
+    do {
+        n = net_loop_wait(&r->loop, 0);
+        for (int e = 0; e < n; e++) serviceClient(r, r->loop.events[e].data.fd, r->loop.events[e].events);
+    } while (n == NET_MAX_EVENTS);
+
+    // a quiet room's skipped ticks changed nothing: only the last one runs
+    uint64_t due = r->due, ran = 0;
+    if (r->quiet && due > r->tick) r->tick = due - 1;
+    if (due > r->tick + MAX_CATCHUP) {
+        roomCount(&r->skipped, due - MAX_CATCHUP - r->tick);
+        r->tick = due - MAX_CATCHUP;
+    }
+    for (; r->tick < due; r->tick++, ran++) {
+        moveBots(r, r->tick);
+        sim_step(&r->sim, r->tick);
+        metrics_add(&r->metrics, MC_TICKS, 1);
+    }
+    r->clients.arena = &arenas[task_pool_worker()];
+    if (r->tick > 0) replicate(r, (uint32_t)(r->tick - 1));
+    client_table_flush(&r->clients, dropFlushed, r);
+    r->clients.arena = NULL;
+    r->quiet = roomQuiet(r);
+    rearm(r);
+
+    // ticks caught up on were late already; the last one is if this ends
+    // after the next is due
+    int64_t end = mono_ns();
+    metrics_observe(&r->metrics, MH_TICK_NS, (uint64_t)(end - began));
+    metrics_add(&r->metrics, MC_ALLOCS, alloc_count() - allocs);
+    if (ran) {
+        roomCount(&r->ran, ran);
+        roomCount(&r->late, ran - 1 + (end > r->deadline));
+    }
+    __atomic_store_n(&r->count, r->clients.count, __ATOMIC_RELAXED);
+    __atomic_store_n(&r->busy, 0, __ATOMIC_RELEASE);
+}
+
+// --- main thread ---
+
+int roomBusy(room_t* r) {
+    return __atomic_load_n(&r->busy, __ATOMIC_ACQUIRE);
+}
+
+room_t* openRoom(int id, int persistent) {
+    room_t* r = aligned_alloc(64, sizeof *r);
+    if (!r) return NULL;
+    memset(r, 0, sizeof *r);
+    r->id = id;
+    r->persistent = persistent;
+    r->tick = r->opened = ticker.tick;
+    r->quiet = 1;
+    r->armed = 1;
+    r->task.run = roomRun;
+    r->task.arg = r;
+    metrics_init(&r->metrics);
+    client_table_init(&r->clients);
+    r->clients.metrics = &r->metrics;
+    msg_pool_init(&r->msgs, ROOM_SLAB);
+    r->clients.msgs = &r->msgs;
+    r->replication = (replica_view_t){ viewRadius, layout, stateBudget, NULL };
+    r->replication.in_range = malloc((size_t)maxPlayers * sizeof *r->replication.in_range);
+    int bucket = viewRadius > 0 ? (viewRadius < 4 ? 4 : viewRadius) : gridSize / 8;
+    if (!r->replication.in_range || sim_init(&r->sim, gridSize, maxPlayers, cooldownTicks, NULL, bucket) < 0) {
+        free(r->replication.in_range);
+        free(r);
+        return NULL;
+    }
+    if (net_loop_init(&r->loop) < 0) {
+        sim_free(&r->sim);
+        free(r->replication.in_range);
+        free(r);
+        return NULL;
+    }
+    struct epoll_event ev = { EPOLLIN | EPOLLONESHOT, { .u64 = ROOM_EVENT | (uint32_t)id } };
+    if (epoll_ctl(loop.epfd, EPOLL_CTL_ADD, r->loop.epfd, &ev) < 0) perror("epoll_ctl room");
+
+    if (botsPerRoom > 0) {
+        r->bots = calloc((size_t)botsPerRoom, sizeof *r->bots);
+        for (int k = 0; r->bots && k < botsPerRoom; k++) {
+            bot_t* b = &r->bots[r->nbots];
+            replica_init(&b->view);
+            b->view.player = sim_spawn(&r->sim, -1 - k);
+            if (b->view.player == ENTITY_NONE) break;
+            if (replica_reserve(&b->view, &r->replication) < 0) {
+                sim_destroy(&r->sim, b->view.player);
+                replica_free(&b->view);
+                break;
+            }
+            b->rng = (uint32_t)id * 2654435761u + (uint32_t)k;
+            r->nbots++;
+        }
+        r->quiet = 0;
+    }
+    rooms[id] = r;
+    liveRooms++;
+    roomsOpened++;
+    return r;
+}
+
+// Give a list of joins back to joinPool. Main thread, room idle.
+void releaseJoins(join_t** list) {
+    for (join_t* j = *list; j; ) {
+        join_t* next = j->next;
+        slab_pool_put(&joinPool, j);
+        j = next;
+    }
+    *list = NULL;
+}
+
+// Only while the room is idle. Connections still in it are closed.
+void destroyRoom(room_t* r) {
+    epoll_ctl(loop.epfd, EPOLL_CTL_DEL, r->loop.epfd, NULL);
+    while (r->clients.count > 0) dropClient(r, &r->clients.clients[0]);
+    for (join_t* j = r->arriving; j; j = j->next) close(j->fd);
+    releaseJoins(&r->arriving);
+    releaseJoins(&r->adopted);
+    for (int k = 0; k < r->nbots; k++) replica_free(&r->bots[k].view);
+    metrics_t snap;
+    metrics_snapshot(&snap, &r->metrics);
+    metrics_merge(&retired, &snap);
+    retiredRan += r->ran;
+    retiredLate += r->late;
+    retiredSkipped += r->skipped;
+
+    rooms[r->id] = NULL;
+    liveRooms--;
+    roomsClosed++;
+    client_table_free(&r->clients);
+    msg_pool_free(&r->msgs);
+    net_loop_close(&r->loop);
+    sim_free(&r->sim);
+    for (int i = 0; i < r->peerCap; i++) replica_free(&r->peers[i]);
+    free(r->peers);
+    free(r->bots);
+    free(r->replication.in_range);
+    free(r);
+}
+
+// Every tick: submit the rooms with something to do, all in one go, and
+// close the ones that are finished.
+void scheduleRooms(void) {
+    PROF_SCOPE("schedule");
+    task_t* first = NULL;
+    task_t** tail = &first;
+    int64_t deadline = ticker.start_ns + (int64_t)(ticker.tick + 1) * ticker.period_ns;
+    for (int id = 0; id < maxRooms; id++) {
+        room_t* r = rooms[id];
+        if (!r || roomBusy(r)) continue;
+        releaseJoins(&r->adopted);
+        if (r->closed || (!r->persistent && !r->arriving && r->nbots == 0 && r->tick > r->opened &&
+                          __atomic_load_n(&r->count, __ATOMIC_RELAXED) == 0)) {
+            printf("Room %d closed\n", id);
+            destroyRoom(r);
+            continue;
+        }
+        if (r->quiet && !r->activity && !r->arriving && !r->closing) continue;
+
+        r->joining = r->arriving;
+        r->arriving = NULL;
+        r->activity = 0;
+        r->due = ticker.tick;
+        r->deadline = deadline;
+        __atomic_store_n(&r->busy, 1, __ATOMIC_RELAXED);
+        r->task.next = NULL;
+        *tail = &r->task;
+        tail = &r->task.next;
+    }
+    task_pool_submit(&pool, first);
+}
+
+void acceptClients(void) {
+    for (;;) {
+        int newfd = accept(listenfd, NULL, NULL);
+        if (newfd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) perror("accept");
+            break;
+        }
+        client_t* c = client_table_add(&lobby, newfd);
+        if (!c) { close(newfd); continue; }
+        net_set_nonblocking(newfd);
+        net_loop_add(&loop, newfd, NET_READ | NET_WRITE | NET_EDGE);
+    }
+}
+
+void dropLobby(client_t* c) {
+    net_loop_del(&loop, c->fd);
+    close(c->fd);
+    client_table_remove(&lobby, c);
+}
+
+void dropLobbyFlushed(client_t* c, void* ctx) {
+    dropLobby(c);
+}
+
+// Send a joining client to its room, opening the room if need be.
+// Returns 0 if it could not go.
+int routeJoin(client_t* c, uint32_t id) {
+    const char* why = NULL;
+    room_t* r = NULL;
+    if (id >= (uint32_t)maxRooms) why = "no such room";
+    else if (!(r = rooms[id]) && !(r = openRoom((int)id, 0))) why = "out of memory";
+    else if (r->closing) why = "room is closing";
+    uint32_t left = c->rx.tail - c->rx.head;
+    join_t* j = why ? NULL : slab_pool_get(&joinPool);
+    if (!why && !j) why = "out of memory";
+    if (why) {
+        client_send(&lobby, c, FRAME_TEXT, why, (uint16_t)strlen(why));
+        client_send(&lobby, c, FRAME_EXIT, NULL, 0);
+        client_flush(&lobby, c);
+        dropLobby(c);
+        return 0;
+    }
+
+    j->next = NULL;
+    j->fd = c->fd;
+    j->len = left;
+    memcpy(j->data, c->rx.buf + c->rx.head, left);
+    join_t** at = &r->arriving;
+    while (*at) at = &(*at)->next;
+    *at = j;
+    net_loop_del(&loop, c->fd);
+    client_table_remove(&lobby, c);
+    return 1;
+}
+
+void serviceLobby(int fd, uint32_t events) {
+    client_t* c = client_table_by_fd(&lobby, fd);
+    if (!c) return;
+    if ((events & NET_WRITE) && client_flush(&lobby, c) < 0) { dropLobby(c); return; }
+    if (!(events & (NET_READ | EPOLLHUP | EPOLLERR))) return;
+
+    for (;;) {
+        ssize_t n = client_read(&lobby, c);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (n <= 0) { dropLobby(c); return; }
+
+        // anything before the join is ignored, but a goodbye
+        frame_t f;
+        int r;
+        while ((r = client_next_frame(&lobby, c, &f)) > 0) {
+            if (f.hdr.type == FRAME_JOIN) { routeJoin(c, f.hdr.id); return; }
+            if (f.hdr.type == FRAME_EXIT) { dropLobby(c); return; }
+        }
+        if (r < 0) { dropLobby(c); return; }
+    }
+}
+
+// Ticks and deadline misses of every room, closed ones included
+void totals(uint64_t* ran, uint64_t* late, uint64_t* skipped, metrics_t* m) {
+    *ran = retiredRan;
+    *late = retiredLate;
+    *skipped = retiredSkipped;
+    if (m) *m = retired;
+    for (int id = 0; id < maxRooms; id++) {
+        room_t* r = rooms[id];
+        if (!r) continue;
+        *ran += __atomic_load_n(&r->ran, __ATOMIC_RELAXED);
+        *late += __atomic_load_n(&r->late, __ATOMIC_RELAXED);
+        *skipped += __atomic_load_n(&r->skipped, __ATOMIC_RELAXED);
+        if (m) {
+            metrics_t snap;
+            metrics_snapshot(&snap, &r->metrics);
+            metrics_merge(m, &snap);
+        }
+    }
+}
+
+void printPool(void) {
+    task_stats_t s;
+    task_pool_stats(&pool, -1, &s);
+    double secs = (mono_ns() - startNs) / 1e9;
+    printf("pool: %d workers, %llu tasks, %llu stolen, %llu sleeps, workers %.1f%% busy\n", threads,
+           (unsigned long long)s.ran, (unsigned long long)s.stolen, (unsigned long long)s.sleeps,
+           secs > 0 ? 100.0 * (double)s.busy_ns / 1e9 / secs / threads : 0.0);
+}
+
+void listRooms(void) {
+    int shown = 0;
+    for (int id = 0; id < maxRooms; id++) {
+        room_t* r = rooms[id];
+        if (!r) continue;
+        if (shown++ == LIST_ROOMS) { printf("  ... %d more\n", liveRooms - LIST_ROOMS); break; }
+        metrics_t snap;
+        metrics_snapshot(&snap, &r->metrics);
+        printf("  room %-7d clients %4d  bots %3d  ticks %8llu  late %6llu  skipped %6llu  run p99 %7.1f us%s%s\n",
+               id, __atomic_load_n(&r->count, __ATOMIC_RELAXED), r->nbots,
+               (unsigned long long)__atomic_load_n(&r->ran, __ATOMIC_RELAXED),
+               (unsigned long long)__atomic_load_n(&r->late, __ATOMIC_RELAXED),
+               (unsigned long long)__atomic_load_n(&r->skipped, __ATOMIC_RELAXED),
+               metrics_percentile(&snap, MH_TICK_NS, 0.99) / 1e3, r->persistent ? "  persistent" : "",
+               r->closing ? "  closing" : "");
+    }
+    if (!shown) printf("  no rooms open\n");
+}
+
+// Returns 0 when the console asked the server to exit.
+int readConsole(void) {
+    char line[MAX];
+    if (!fgets(line, sizeof line, stdin)) {
+        net_loop_del(&loop, STDIN_FILENO);
+        return 1;
+    }
+    int id;
+    if (strncmp(line, "exit", 4) == 0) {
+        printf("Server shutting down.\n");
+        return 0;
+    } else if (strncmp(line, "rooms", 5) == 0) {
+        printf("%d rooms open (%llu opened, %llu closed):\n", liveRooms, (unsigned long long)roomsOpened,
+               (unsigned long long)roomsClosed);
+        listRooms();
+    } else if (strncmp(line, "stats", 5) == 0) {
+        uint64_t ran, late, skipped;
+        metrics_t m;
+        totals(&ran, &late, &skipped, &m);
+        printf("Server metrics after %.1f s (tick %llu, %d rooms, %d in the lobby):\n",
+               (mono_ns() - startNs) / 1e9, (unsigned long long)ticker.tick, liveRooms, lobby.count);
+        metrics_print(stdout, &m);
+        printf("room ticks: %llu run, %llu late, %llu skipped (%.3f%% missed their deadline)\n",
+               (unsigned long long)ran, (unsigned long long)late, (unsigned long long)skipped,
+               ran + skipped ? 100.0 * (double)(late + skipped) / (double)(ran + skipped) : 0.0);
+        printPool();
+    } else if (sscanf(line, "open %d", &id) == 1) {
+        if (id < 0 || id >= maxRooms) printf("Room ids are 0..%d\n", maxRooms - 1);
+        else if (rooms[id]) { rooms[id]->persistent = 1; printf("Room %d stays open\n", id); }
+        else if (!openRoom(id, 1)) printf("Out of memory\n");
+        else printf("Room %d open\n", id);
+    } else if (sscanf(line, "close %d", &id) == 1) {
+        if (id < 0 || id >= maxRooms || !rooms[id]) printf("No room %d\n", id);
+        else { rooms[id]->closing = 1; printf("Closing room %d\n", id); }
+    } else if (strncmp(line, "trace", 5) == 0) {
+        char path[MAX];
+        if (sscanf(line + 5, "%1023s", path) != 1) strcpy(path, DEFAULT_TRACE);
+        long n = prof_write_trace(path);
+        if (n < 0) perror(errno == ENOSYS ? "trace (build with -DPROFILE)" : path);
+        else printf("Wrote %ld trace events to %s\n", n, path);
+    } else {
+        printf("Commands: rooms | stats | open <room> | close <room> | trace [path] | exit\n");
+    }
+    return 1;
+}
+
+// Wait up to timeout_ms for the console, the lobby, room sockets or the
+// ticker. Returns 0 once the server should stop.
+int serviceNetwork(int timeout_ms) {
+    int nready = net_loop_wait(&loop, timeout_ms);
+    if (nready < 0) { perror("epoll_wait"); return 0; }
+    int running = 1;
+    for (int e = 0; e < nready && running; e++) {
+        struct epoll_event* ev = &loop.events[e];
+        if (ev->data.u64 & ROOM_EVENT) {
+            room_t* r = rooms[(uint32_t)ev->data.u64];
+            if (r) {
+                __atomic_store_n(&r->armed, 0, __ATOMIC_RELEASE);
+                r->activity = 1;
+            }
+        } else if (ev->data.fd == ticker.fd) {
+            int due = tick_timer_due(&ticker);
+            if (due > 0) {
+                ticker.tick += (uint64_t)due;
+                scheduleRooms();
+            }
+        } else if (ev->data.fd == STDIN_FILENO) {
+            running = readConsole();
+        } else if (ev->data.fd == listenfd) {
+            acceptClients();
+        } else {
+            serviceLobby(ev->data.fd, ev->events);
+        }
+    }
+    client_table_flush(&lobby, dropLobbyFlushed, NULL);
+    return running;
+}
+
+// Close every room: each sends its clients away in one last task.
+void closeAll(void) {
+    task_pool_wait(&pool);
+    for (int id = 0; id < maxRooms; id++) if (rooms[id]) rooms[id]->closing = 1;
+    scheduleRooms();
+    task_pool_wait(&pool);
+    for (int id = 0; id < maxRooms; id++) if (rooms[id]) destroyRoom(rooms[id]);
+}
+
+// Run the tick clock alone for the given time.
+void runFor(double seconds) {
+    int64_t end = mono_ns() + (int64_t)(seconds * 1e9);
+    while (mono_ns() < end) serviceNetwork(100);
+}
+
+// Fill each density of rooms with bots and count deadline misses.
+int runBench(const char* list, double seconds) {
+    printf("%d workers, %d Hz, %dx%d board, %d bots per room, %.0f s per density\n", threads, ticker.hz, gridSize,
+           gridSize, botsPerRoom, seconds);
+    printf("%8s %8s %12s %9s %9s %11s %11s %11s %7s %10s %13s\n", "rooms", "players", "ticks due", "late %",
+           "skipped %", "run p50 us", "run p99 us", "run max us", "busy %", "stolen", "mallocs/tick");
+    for (const char* p = list; *p; ) {
+        int n = atoi(p);
+        if (n < 1 || n > maxRooms) { printf("Densities must be 1..%d rooms (--max-rooms)\n", maxRooms); return 1; }
+        for (int id = 0; id < n; id++)
+            if (!openRoom(id, 1)) { perror("malloc"); return 1; }
+
+        // warm up, then count from a clean slate
+        runFor(BENCH_WARMUP_S);
+        task_pool_wait(&pool);
+        for (int id = 0; id < n; id++) {
+            room_t* r = rooms[id];
+            r->ran = r->late = r->skipped = 0;
+            metrics_init(&r->metrics);
+        }
+        task_stats_t before, after;
+        task_pool_stats(&pool, -1, &before);
+        uint64_t firstTick = ticker.tick;
+        int64_t t0 = mono_ns();
+        runFor(seconds);
+        task_pool_wait(&pool);
+        double secs = (mono_ns() - t0) / 1e9;
+        uint64_t due = (ticker.tick - firstTick) * (uint64_t)n;
+
+        uint64_t ran, late, skipped;
+        metrics_t m;
+        retiredRan = retiredLate = retiredSkipped = 0;
+        metrics_init(&retired);
+        totals(&ran, &late, &skipped, &m);
+        task_pool_stats(&pool, -1, &after);
+        char allocs[32] = "-";
+        if (ALLOC_COUNTING && ran) snprintf(allocs, sizeof allocs, "%.2f", (double)m.counters[MC_ALLOCS] / ran);
+        printf("%8d %8d %12llu %9.3f %9.3f %11.1f %11.1f %11.1f %7.1f %10llu %13s\n", n, n * botsPerRoom,
+               (unsigned long long)due, due ? 100.0 * (double)late / (double)due : 0.0,
+               due ? 100.0 * (double)skipped / (double)due : 0.0, metrics_percentile(&m, MH_TICK_NS, 0.50) / 1e3,
+               metrics_percentile(&m, MH_TICK_NS, 0.99) / 1e3, m.hist_max[MH_TICK_NS] / 1e3,
+               100.0 * (double)(after.busy_ns - before.busy_ns) / 1e9 / secs / threads,
+               (unsigned long long)(after.stolen - before.stolen), allocs);
+        fflush(stdout);
+        closeAll();
+
+        p = strchr(p, ',');
+        if (!p) break;
+        p++;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int port = DEFAULT_PORT;
+    int tickHz = DEFAULT_TICK_HZ;
+    const char* bench = NULL;
+    int bots = DEFAULT_BOTS;
+    double benchSeconds = DEFAULT_BENCH_SECONDS;
+    threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) port = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--tick") == 0 && i + 1 < argc) tickHz = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--grid") == 0 && i + 1 < argc) gridSize = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--max-players") == 0 && i + 1 < argc) maxPlayers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--view-radius") == 0 && i + 1 < argc) viewRadius = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--max-rooms") == 0 && i + 1 < argc) maxRooms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) bench = argv[++i];
+        else if (strcmp(argv[i], "--bots") == 0 && i + 1 < argc) bots = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--bench-seconds") == 0 && i + 1 < argc) benchSeconds = atof(argv[++i]);
+        else {
+            printf("Usage: %s [--port P] [--threads N] [--tick HZ] [--grid N] [--max-players N]\n"
+                   "          [--view-radius CELLS] [--max-rooms N]\n"
+                   "          [--bench ROOMS[,ROOMS...] [--bots N] [--bench-seconds S]]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (threads < 1) threads = 1;
+    if (tickHz <= 0 || tickHz > 1000) { printf("Tick rate must be 1..1000 Hz\n"); return 1; }
+    if (gridSize < 2 || gridSize > MAX_GRID) { printf("Grid must be 2..%d cells\n", MAX_GRID); return 1; }
+    if (maxPlayers < 1 || maxPlayers > MAX_PLAYERS_LIMIT) { printf("Max players must be 1..%d\n", MAX_PLAYERS_LIMIT); return 1; }
+    if (maxRooms < 1 || maxRooms > MAX_ROOMS_LIMIT) { printf("Max rooms must be 1..%d\n", MAX_ROOMS_LIMIT); return 1; }
+    if (bench && (bots < 0 || bots > maxPlayers || benchSeconds <= 0)) {
+        printf("Bots must be 0..max players, bench seconds positive\n");
+        return 1;
+    }
+    if (viewRadius < 0 || viewRadius >= gridSize) viewRadius = 0;
+    startNs = mono_ns();
+    signal(SIGPIPE, SIG_IGN);
+
+    rooms = calloc((size_t)maxRooms, sizeof *rooms);
+    if (!rooms) { perror("malloc"); exit(1); }
+    layout = move_layout_for(gridSize, maxPlayers);
+    stateBudget = state_max_entries(layout, FRAME_MAX_PAYLOAD);
+    if (stateBudget > maxPlayers) stateBudget = maxPlayers;
+    cooldownTicks = (int)(MOVE_DELAY_S * tickHz + 0.999);
+    metrics_init(&retired);
+    client_table_init(&lobby);
+    slab_pool_init(&joinPool, sizeof(join_t), JOIN_SLAB);
+    if (net_loop_init(&loop) < 0) exit(1);
+    if (tick_timer_init(&ticker, tickHz, MAX_CATCHUP) < 0) exit(1);
+    net_loop_add(&loop, ticker.fd, NET_READ);
+    arenas = calloc((size_t)threads, sizeof *arenas);
+    if (!arenas) { perror("malloc"); exit(1); }
+    for (int i = 0; i < threads; i++) arena_init(&arenas[i], 0);
+    if (task_pool_init(&pool, threads) < 0) { perror("task pool"); exit(1); }
+
+    int rc = 0;
+    if (bench) {
+        botsPerRoom = bots;
+        rc = runBench(bench, benchSeconds);
+    } else {
+        listenfd = socket(AF_INET, SOCK_STREAM, 0);
+        if (listenfd < 0) { perror("socket"); exit(1); }
+        int opt = 1;
+        setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        struct sockaddr_in servaddr = {0};
+        servaddr.sin_family = AF_INET;
+        servaddr.sin_addr.s_addr = htonl(INADDR_ANY);
+        servaddr.sin_port = htons((uint16_t)port);
+        if (bind(listenfd, (struct sockaddr*)&servaddr, sizeof(servaddr)) < 0) { perror("bind"); exit(1); }
+        if (listen(listenfd, SOMAXCONN) < 0) { perror("listen"); exit(1); }
+        net_set_nonblocking(listenfd);
+        net_loop_add(&loop, listenfd, NET_READ | NET_EDGE);
+        if (net_loop_add(&loop, STDIN_FILENO, NET_READ) < 0) perror("epoll_ctl stdin");
+
+        printf("Room server listening on port %d (%d workers, %d Hz, %dx%d boards, %d players, up to %d rooms)\n",
+               port, threads, tickHz, gridSize, gridSize, maxPlayers, maxRooms);
+        printf("Commands from server console:\n");
+        printf("   rooms            list open rooms\n");
+        printf("   stats            print metrics of all rooms and the pool\n");
+        printf("   open <room>      open a room that stays when empty\n");
+        printf("   close <room>     close a room (sends exit to its clients)\n");
+        printf("   trace [path]     write a Chrome trace of recent ticks (-DPROFILE builds)\n");
+        printf("   exit             shut down server (sends exit to all)\n");
+        while (serviceNetwork(-1))
+            ;
+
+        uint64_t ran, late, skipped;
+        totals(&ran, &late, &skipped, NULL);
+        printf("Ticks: %llu, rooms opened: %llu, room ticks: %llu run, %llu late, %llu skipped\n",
+               (unsigned long long)ticker.tick, (unsigned long long)roomsOpened, (unsigned long long)ran,
+               (unsigned long long)late, (unsigned long long)skipped);
+        closeAll();
+        while (lobby.count > 0) {
+            client_t* c = &lobby.clients[0];
+            client_send(&lobby, c, FRAME_EXIT, NULL, 0);
+            client_flush(&lobby, c);
+            dropLobby(c);
+        }
+        close(listenfd);
+    }
+
+    task_pool_destroy(&pool);
+    for (int i = 0; i < threads; i++) arena_free(&arenas[i]);
+    free(arenas);
+    tick_timer_close(&ticker);
+    client_table_free(&lobby);
+    slab_pool_free(&joinPool);
+    net_loop_close(&loop);
+    free(rooms);
+    return rc;
+}
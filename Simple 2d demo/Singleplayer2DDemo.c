@@ -1,81 +1,124 @@
 #define GL_SILENCE_DEPRECATION
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
 #include "glad/glad.h"
 #include "GLFW/glfw3.h"
 
+#include "../Common/entity_store.h"
+#include "../Common/frame_pacer.h"
+#include "../Common/grid_renderer.h"
+#include "../Common/input_queue.h"
+#include "../Common/move_rules.h"
+#include "../Common/profile.h"
+
 // Grid size
 #define GRID_SIZE 16
 
-// Player buffer
-int players[2][2] = {{0,0}, {9,9}};
-float colors[2][3] = {{0.98f, 0.73f, 0.01f},{0.19f, 0.89f, 0.75f}};
-double playercooldown[2];
+// Frame rate cap while something is moving; idle windows don't redraw
+#define FRAME_HZ 60
+
+#define TRACE_PATH "singleplayer_trace.json"
+
+// Players are entities; both live for the whole game, so entity i is
+// driven by keys[i] (input pad i). The cooldown column holds the last move
+// time in ns.
+#define NPLAYERS 2
+entity_store_t ents;
+const int spawn[NPLAYERS][2] = {{0,0}, {9,9}};
+const float colors[NPLAYERS][3] = {{0.98f, 0.73f, 0.01f},{0.19f, 0.89f, 0.75f}};
+const int keys[NPLAYERS][4] = {
+    { GLFW_KEY_UP, GLFW_KEY_DOWN, GLFW_KEY_LEFT, GLFW_KEY_RIGHT },
+    { GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D },
+};
+
+const int64_t moveDelayNs = (int64_t)(MOVE_DELAY_S * 1e9); // between moves while holding
+frame_pacer_t pacer;
+
+// Key callbacks queue events; processInput() turns them into moves
+input_ring_t keyEvents;
+input_proc_t keyInput;
+
+// Pacer timestamps are on GLFW's clock
+int64_t nowNs(void) {
+    return (int64_t)(glfwGetTime() * 1e9);
+}
 
 // Callback for window resize
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     glViewport(0, 0, width, height);
+    frame_pacer_mark(&pacer);
 }
 
-// Handle input (ESC to close)
-void processInput(GLFWwindow* window) {
-    const double moveDelay = 0.15; // seconds between moves while holding
-
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-        glfwSetWindowShouldClose(window, 1);
+// Window exposed or damaged: its contents need drawing again
+void window_refresh_callback(GLFWwindow* window) {
+    frame_pacer_mark(&pacer);
+}
 
-    double t = glfwGetTime();
-    if (t-playercooldown[0] < moveDelay && t-playercooldown[1] < moveDelay) {return;}
+// Recent frames as a Chrome trace (F12; build with -DPROFILE)
+void writeTrace(void) {
+    long n = prof_write_trace(TRACE_PATH);
+    if (n < 0) perror(errno == ENOSYS ? "trace (build with -DPROFILE)" : TRACE_PATH);
+    else printf("Wrote %ld trace events to %s\n", n, TRACE_PATH);
+}
 
-    if (t-playercooldown[0] > moveDelay) {// At this point, enough time has passed -- check held keys:
-        if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) {
-            if (players[0][1] < GRID_SIZE-1) { players[0][1]++; playercooldown[0] = t; }
-        }
-        else if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) {
-            if (players[0][1] > 0) { players[0][1]--; playercooldown[0] = t; }
-        }
-        else if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS) {
-            if (players[0][0] > 0) { players[0][0]--; playercooldown[0] = t; }
-        }
-        else if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) {
-            if (players[0][0] < GRID_SIZE-1) { players[0][0]++; playercooldown[0] = t; }
-        }
-    } if (t-playercooldown[1] > moveDelay) {
-        if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-            if (players[1][1] < GRID_SIZE-1) { players[1][1]++; playercooldown[1] = t; }
-        }
-        else if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-            if (players[1][1] > 0) { players[1][1]--; playercooldown[1] = t; }
-        }
-        else if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-            if (players[1][0] > 0) { players[1][0]--; playercooldown[1] = t; }
-        }
-        else if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-            if (players[1][0] < GRID_SIZE-1) { players[1][0]++; playercooldown[1] = t; }
-        }
-    }
-    // Do a tcp-sync packet here... basically something sending the movement to the server... or if the server, process the packet and send to all clients...
-    // Packet structure: 2 bits - client id (0=server), 5 bits - x coord, 5 bits - y c
+// ESC closes, F12 writes a trace; direction keys go on the input queue stamped with the time
+// GLFW delivered them (it reports no event times of its own). Callbacks
+// run inside glfwPollEvents/glfwWaitEvents, so a tap shorter than a frame
+// still arrives as a press and a release. OS key repeat is ignored: the
+// input processor repeats held keys itself.
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) glfwSetWindowShouldClose(window, 1);
+    if (key == GLFW_KEY_F12 && action == GLFW_PRESS) writeTrace();
+    if (action == GLFW_REPEAT) return;
+    for (int i = 0; i < NPLAYERS; i++)
+        for (int d = 0; d < INPUT_DIRS; d++)
+            if (keys[i][d] == key) input_ring_push(&keyEvents, nowNs(), i, d, action == GLFW_PRESS);
 }
 
+// One move of player cmd->pad at time cmd->t; moves off the board are
+// refused and cost no cooldown.
+int applyMove(void* ctx, const input_cmd_t* cmd) {
+    int i = cmd->pad;
+    int pos[2] = { ents.x[i], ents.y[i] };
+    if (!move_apply(pos, pos[0] + cmd->dx, pos[1] + cmd->dy, GRID_SIZE)) return 0;
+    ents.x[i] = pos[0];
+    ents.y[i] = pos[1];
+    ents.cooldown[i] = cmd->t;
+    ents.flags[i] |= ENTITY_MOVED;
+    return 1;
+}
 
-// Vertex and fragment shader sources (inline for simplicity)
-const char* vertexShaderSource = "#version 330 core\n"
-"layout (location = 0) in vec2 aPos;\n"
-"uniform vec2 offset;\n"
-"uniform float scale;\n"
-"void main() {\n"
-"    vec2 p = aPos * scale + offset;\n" 
-"    gl_Position = vec4(p, 0.0, 1.0);\n"
-"}\n";
+// Turn the keys queued since the last frame into moves, at the times they
+// fall due. Moved entities are flagged so the caller knows to redraw.
+void processInput(void) {
+    PROF_SCOPE("processInput");
+    for (int i = 0; i < ents.count; i++) ents.flags[i] &= ~ENTITY_MOVED;
+    input_proc_run(&keyInput, &keyEvents, nowNs(), applyMove, NULL);
+}
 
-const char* fragmentShaderSource = "#version 330 core\n"
-"out vec4 FragColor;\n"
-"uniform vec3 color;\n"
-"void main() {\n"
-"    FragColor = vec4(color, 1.0);\n"
-"}\n";
+// While a movement key is held, wake up when its next step is due so it
+// is taken on time without OS key-repeat events. (A key held against a
+// wall moves nothing, so it schedules nothing.)
+void scheduleKeyRepeat(void) {
+    int64_t due = input_proc_next_due(&keyInput);
+    if (due != INPUT_NEVER) frame_pacer_wake_at(&pacer, due);
+}
 
 int main() {
+    if (entity_store_init(&ents, NPLAYERS) < 0) {
+        printf("Out of memory\n");
+        return -1;
+    }
+    for (int p = 0; p < NPLAYERS; p++) {
+        int i = entity_index(&ents, entity_create(&ents));
+        ents.x[i] = spawn[p][0];
+        ents.y[i] = spawn[p][1];
+        memcpy(ents.color[i], colors[p], sizeof colors[p]);
+        ents.cooldown[i] = INT64_MIN / 2;
+        ents.flags[i] = ENTITY_LOCAL;
+    }
+
     // Initialize GLFW
     if (!glfwInit()) {
         printf("Failed to initialize GLFW\n");
@@ -96,6 +139,10 @@ int main() {
     }
     glfwMakeContextCurrent(window);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetWindowRefreshCallback(window, window_refresh_callback);
+    glfwSetKeyCallback(window, key_callback);
+    input_ring_init(&keyEvents);
+    input_proc_init(&keyInput, NPLAYERS, moveDelayNs);
 
     // Load GLAD
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
@@ -108,98 +155,48 @@ int main() {
     glfwGetFramebufferSize(window, &w, &h);
     glViewport(0, 0, w, h);
 
-    // Define rectangle vertices (two triangles)
-    float vertices[] = {
-        -0.5f, -0.5f,
-         0.5f, -0.5f,
-         0.5f,  0.5f,
-        -0.5f, -0.5f,
-         0.5f,  0.5f,
-        -0.5f,  0.5f
-    };
-
-    // Create VAO & VBO
-    unsigned int VAO, VBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    // Vertex attributes
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-
-    // Compile shaders
-    unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-
-    unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-
-    // Link shader program
-    GLuint prog = glCreateProgram();
-    glAttachShader(prog, vertexShader);
-    glAttachShader(prog, fragmentShader);
-    glLinkProgram(prog);
-    // checkLink(prog);
-
-    // Uniform locations
-    GLint locOffset = glGetUniformLocation(prog, "offset");
-    GLint locScale  = glGetUniformLocation(prog, "scale");
-    GLint locColor  = glGetUniformLocation(prog, "color");
-
-    float cellScale = 2.0f / GRID_SIZE; // scale square to fit grid
-
-    // Render loop
-    while (!glfwWindowShouldClose(window)) {
-        processInput(window);
-
-        glUseProgram(prog);
-        glBindVertexArray(VAO);
-
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        if (locOffset == -1) fprintf(stderr, "Warning: 'offset' uniform not found\n");
-
-        // draw grid cells (light gray)
-        for (int y = 0; y < GRID_SIZE; ++y) {
-            for (int x = 0; x < GRID_SIZE; ++x) {
-                float ox = -1.0f + cellScale * (x + 0.5f);
-                float oy = -1.0f + cellScale * (y + 0.5f);
-                glUniform2f(locOffset, ox, oy);
-                glUniform1f(locScale, cellScale);
-                glUniform3f(locColor, 0.25f, 0.25f, 0.25f);
-                glDrawArrays(GL_TRIANGLES, 0, 6);
-            }
-        }
-
-        // draw player (green)
-        for (int i = 0; i < sizeof(players)/sizeof(players[0]); i++){
-            float pox = -1.0f + cellScale * (players[i][0] + 0.5f);
-            float poy = -1.0f + cellScale * (players[i][1] + 0.5f);
-            glUniform2f(locOffset, pox, poy);
-            glUniform1f(locScale, cellScale * 0.9f); // slightly smaller so grid lines show
-            float* color = colors[i];
-            glUniform3f(locColor, color[0], color[1], color[2]);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
+    // Board and players are drawn as one instanced batch
+    grid_batch_t batch;
+    if (grid_batch_init(&batch, GRID_SIZE, NPLAYERS) < 0) {
+        printf("Out of memory\n");
+        glfwTerminate();
+        return -1;
+    }
+    grid_renderer_t renderer;
+    grid_renderer_init(&renderer, &batch);
 
+    // Render loop: redraw only when something changed, otherwise sleep
+    // until input, a window event or a held key's next step
+    frame_pacer_init(&pacer, FRAME_HZ);
+    while (!glfwWindowShouldClose(window)) {
+        processInput();
+        for (int i = 0; i < ents.count; i++)
+            if (ents.flags[i] & ENTITY_MOVED) frame_pacer_mark(&pacer);
+        scheduleKeyRepeat();
+
+        if (frame_pacer_ready(&pacer, nowNs())) {
+            PROF_SCOPE("draw");
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            // only moved players are re-uploaded; the grid goes up once
+            grid_batch_set_players(&batch, ents.x, ents.y, (const float (*)[3])ents.color, ents.count);
+            grid_renderer_draw(&renderer, &batch);
+            PROF_SCOPE("swap");
+            glfwSwapBuffers(window);
         }
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        PROF_SCOPE("wait");
+        int64_t wait = frame_pacer_timeout(&pacer, nowNs());
+        if (wait < 0) glfwWaitEvents();
+        else if (wait == 0) glfwPollEvents();
+        else glfwWaitEventsTimeout(wait / 1e9);
     }
 
     // Cleanup
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
+    grid_renderer_free(&renderer);
+    grid_batch_free(&batch);
+    entity_store_free(&ents);
 
     glfwTerminate();
     return 0;
@@ -0,0 +1,114 @@
+// Cost of reading a chunked world file (Common/world.h) through its cache.
+//
+// Headless. Reports, for the given world and cache budget:
+//   open     world_open(): mapping the file and reading the header
+//   stream   every chunk once in file order, ns per chunk and MB/s
+//   random   chunks picked uniformly at random, ns per access and hit rate
+//            (with a budget below the world size most of these miss)
+//   walk     tiles read along random walks of --walkers players, what the
+//            server does for moves: ns per tile read
+// The first pass after generating or copying a file may include disk
+// reads; later runs see the page cache.
+//
+//   WorldBench WORLD [--budget MB] [--reads N] [--walkers N]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../Common/tick.h"
+#include "../Common/world.h"
+
+static volatile uint64_t sink;   // keeps the reads from being optimised out
+
+int main(int argc, char** argv) {
+    const char* path = NULL;
+    double budgetMb = 16;
+    int reads = 1000000;
+    int walkers = 1000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc) budgetMb = atof(argv[++i]);
+        else if (strcmp(argv[i], "--reads") == 0 && i + 1 < argc) reads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--walkers") == 0 && i + 1 < argc) walkers = atoi(argv[++i]);
+        else if (argv[i][0] != '-' && !path) path = argv[i];
+        else path = NULL, i = argc;
+    }
+    if (!path || budgetMb <= 0 || reads < 1 || walkers < 1) {
+        printf("Usage: %s WORLD [--budget MB] [--reads N] [--walkers N]\n", argv[0]);
+        return 1;
+    }
+
+    world_t w;
+    int64_t t0 = mono_ns();
+    if (world_open(&w, path, (size_t)(budgetMb * 1e6)) < 0) { perror(path); return 1; }
+    double openUs = (mono_ns() - t0) / 1e3;
+    uint64_t nchunks = (uint64_t)w.hdr.chunks_x * w.hdr.chunks_y;
+    printf("%s: %ux%u tiles, %llu chunks of %u, %.1f MB file, cache %d chunks (%.1f MB)\n", path,
+           w.hdr.width, w.hdr.height, (unsigned long long)nchunks, w.hdr.chunk, w.map_len / 1e6,
+           w.nslots, (double)w.nslots * w.chunk_bytes / 1e6);
+    printf("open     %10.1f us\n", openUs);
+
+    t0 = mono_ns();
+    uint64_t sum = 0;
+    for (uint32_t cy = 0; cy < w.hdr.chunks_y; cy++) {
+        for (uint32_t cx = 0; cx < w.hdr.chunks_x; cx++) {
+            const uint8_t* c = world_chunk(&w, (int)cx, (int)cy);
+            if (c) sum += c[0] + c[w.chunk_bytes - 1];
+        }
+    }
+    double ns = (double)(mono_ns() - t0);
+    printf("stream   %10.1f ns/chunk  %8.1f MB/s\n", ns / nchunks, nchunks * w.chunk_bytes / (ns / 1e9) / 1e6);
+
+    uint64_t hits = w.hits, misses = w.misses;
+    uint32_t rng = 12345;
+    t0 = mono_ns();
+    for (int k = 0; k < reads; k++) {
+        rng = rng * 1664525u + 1013904223u;
+        uint32_t cx = (rng >> 8) % w.hdr.chunks_x;
+        rng = rng * 1664525u + 1013904223u;
+        uint32_t cy = (rng >> 8) % w.hdr.chunks_y;
+        const uint8_t* c = world_chunk(&w, (int)cx, (int)cy);
+        if (c) sum += c[0];
+    }
+    ns = (double)(mono_ns() - t0);
+    uint64_t h = w.hits - hits, m = w.misses - misses;
+    printf("random   %10.1f ns/access  %6.1f%% hits\n", ns / reads, h + m ? 100.0 * h / (h + m) : 0.0);
+
+    int* pos = malloc((size_t)walkers * 2 * sizeof *pos);
+    if (!pos) { perror("malloc"); return 1; }
+    for (int i = 0; i < walkers; i++) {
+        rng = rng * 1664525u + 1013904223u;
+        pos[2 * i] = (int)((rng >> 8) % w.hdr.width);
+        rng = rng * 1664525u + 1013904223u;
+        pos[2 * i + 1] = (int)((rng >> 8) % w.hdr.height);
+    }
+    hits = w.hits;
+    misses = w.misses;
+    static const int dirs[4][2] = { {0, 1}, {0, -1}, {-1, 0}, {1, 0} };
+    t0 = mono_ns();
+    int steps = reads / walkers > 0 ? reads / walkers : 1;
+    for (int s = 0; s < steps; s++) {
+        for (int i = 0; i < walkers; i++) {
+            rng = rng * 1664525u + 1013904223u;
+            const int* d = dirs[rng >> 30];
+            int x = pos[2 * i] + d[0], y = pos[2 * i + 1] + d[1];
+            int t = world_tile(&w, x, y);
+            if (t < 0 || tile_blocks(t)) continue;
+            pos[2 * i] = x;
+            pos[2 * i + 1] = y;
+            sum += (uint64_t)t;
+        }
+    }
+    ns = (double)(mono_ns() - t0);
+    h = w.hits - hits;
+    m = w.misses - misses;
+    printf("walk     %10.1f ns/tile    %6.1f%% hits  (%d walkers)\n", ns / ((double)steps * walkers),
+           h + m ? 100.0 * h / (h + m) : 0.0, walkers);
+    printf("cache    %llu hits, %llu misses, %llu evictions, %llu damaged chunks\n",
+           (unsigned long long)w.hits, (unsigned long long)w.misses,
+           (unsigned long long)w.evictions, (unsigned long long)w.bad_chunks);
+    sink = sum;
+
+    free(pos);
+    world_close(&w);
+    return 0;
+}
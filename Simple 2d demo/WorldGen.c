@@ -0,0 +1,119 @@
+// Writes a world file (Common/world.h) of procedurally placed terrain.
+//
+// Walls and water are blobs of smoothed value noise over open floor, so
+// most chunks come out uniform and cost only their index entry. Chunks are
+// generated and written one at a time; only the index is held in memory,
+// so worlds far larger than RAM can be generated.
+//
+//   WorldGen OUT [--size N | --width W --height H] [--chunk C] [--seed S]
+//                [--walls PERCENT] [--water PERCENT]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../Common/tick.h"
+#include "../Common/world.h"
+
+#define NOISE_CELL 16          // noise lattice spacing, in tiles
+
+static uint32_t seed = 1;
+
+static uint32_t hash2(uint32_t x, uint32_t y) {
+    uint32_t h = x * 0x8da6b343u ^ y * 0xd8163841u ^ seed * 0xcb1ab31fu;
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    return h;
+}
+
+// Value noise in [0, 1): a random value per lattice point, smoothly
+// interpolated in between. `salt` gives independent fields.
+static float noise(uint32_t x, uint32_t y, uint32_t salt) {
+    uint32_t gx = x / NOISE_CELL, gy = y / NOISE_CELL;
+    float fx = (float)(x % NOISE_CELL) / NOISE_CELL, fy = (float)(y % NOISE_CELL) / NOISE_CELL;
+    fx = fx * fx * (3 - 2 * fx);
+    fy = fy * fy * (3 - 2 * fy);
+    float v00 = (float)(hash2(gx + salt, gy) >> 8) / (1 << 24);
+    float v10 = (float)(hash2(gx + 1 + salt, gy) >> 8) / (1 << 24);
+    float v01 = (float)(hash2(gx + salt, gy + 1) >> 8) / (1 << 24);
+    float v11 = (float)(hash2(gx + 1 + salt, gy + 1) >> 8) / (1 << 24);
+    float a = v00 + (v10 - v00) * fx, b = v01 + (v11 - v01) * fx;
+    return a + (b - a) * fy;
+}
+
+int main(int argc, char** argv) {
+    const char* out = NULL;
+    uint32_t width = 1024, height = 1024, chunk = WORLD_DEFAULT_CHUNK;
+    int walls = 8, water = 4;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) width = height = (uint32_t)atol(argv[++i]);
+        else if (strcmp(argv[i], "--width") == 0 && i + 1 < argc) width = (uint32_t)atol(argv[++i]);
+        else if (strcmp(argv[i], "--height") == 0 && i + 1 < argc) height = (uint32_t)atol(argv[++i]);
+        else if (strcmp(argv[i], "--chunk") == 0 && i + 1 < argc) chunk = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = (uint32_t)atol(argv[++i]);
+        else if (strcmp(argv[i], "--walls") == 0 && i + 1 < argc) walls = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--water") == 0 && i + 1 < argc) water = atoi(argv[++i]);
+        else if (argv[i][0] != '-' && !out) out = argv[i];
+        else out = NULL, i = argc;
+    }
+    world_hdr_t hdr;
+    if (!out || walls < 0 || water < 0 || walls + water > 100 || world_hdr_init(&hdr, width, height, chunk) < 0) {
+        printf("Usage: %s OUT [--size N | --width W --height H] [--chunk C] [--seed S]\n"
+               "          [--walls PERCENT] [--water PERCENT]\n"
+               "chunk is a power of two from 2 to 4096\n", argv[0]);
+        return 1;
+    }
+
+    uint64_t nchunks = (uint64_t)hdr.chunks_x * hdr.chunks_y;
+    uint8_t* index = malloc(nchunks * 8);
+    uint8_t* tiles = malloc((size_t)chunk * chunk);
+    if (!index || !tiles) { perror("malloc"); return 1; }
+    FILE* f = fopen(out, "wb");
+    if (!f) { perror(out); return 1; }
+    if (fseeko(f, (off_t)hdr.data_off, SEEK_SET) < 0) { perror("fseeko"); return 1; }
+
+    // noise is roughly uniform, so these cut-offs give about the requested
+    // share of each tile
+    float wallAbove = 1.0f - walls / 100.0f, waterBelow = water / 100.0f;
+    int64_t t0 = mono_ns();
+    uint64_t stored = 0, off = hdr.data_off;
+    for (uint32_t cy = 0; cy < hdr.chunks_y; cy++) {
+        for (uint32_t cx = 0; cx < hdr.chunks_x; cx++) {
+            int uniform = 1;
+            for (uint32_t y = 0; y < chunk; y++) {
+                for (uint32_t x = 0; x < chunk; x++) {
+                    uint32_t wx = cx * chunk + x, wy = cy * chunk + y;
+                    uint8_t t = TILE_FLOOR;
+                    if (wx >= width || wy >= height) t = TILE_WALL;   // padding past the edge
+                    else if (noise(wx, wy, 0) >= wallAbove) t = TILE_WALL;
+                    else if (noise(wx, wy, 0x9e37) < waterBelow) t = TILE_WATER;
+                    tiles[y * chunk + x] = t;
+                    if (t != tiles[0]) uniform = 0;
+                }
+            }
+            uint8_t* e = index + 8 * ((uint64_t)cy * hdr.chunks_x + cx);
+            if (uniform) {
+                world_put64_(e, tiles[0]);
+                continue;
+            }
+            if (fwrite(tiles, 1, (size_t)chunk * chunk, f) != (size_t)chunk * chunk) { perror(out); return 1; }
+            world_put64_(e, off);
+            off += (uint64_t)chunk * chunk;
+            stored++;
+        }
+    }
+
+    uint8_t h[WORLD_HDR_SIZE];
+    world_hdr_encode(h, &hdr);
+    if (fseeko(f, 0, SEEK_SET) < 0 || fwrite(h, 1, sizeof h, f) != sizeof h ||
+        fwrite(index, 1, nchunks * 8, f) != nchunks * 8 || fclose(f) != 0) {
+        perror(out);
+        return 1;
+    }
+    printf("%s: %ux%u tiles, %ux%u chunks of %u, %llu stored, %llu uniform, %.1f MB in %.2f s\n",
+           out, width, height, hdr.chunks_x, hdr.chunks_y, chunk, (unsigned long long)stored,
+           (unsigned long long)(nchunks - stored), off / 1e6, (mono_ns() - t0) / 1e9);
+    free(index);
+    free(tiles);
+    return 0;
+}